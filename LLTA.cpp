@@ -61,8 +61,12 @@
 
 // MODIFICATION:
 //inlcude MachineCFGPrinter
+#include "Analysis/GraphFile.h"
+#include "Graph/ProgramGraph.h"
+#include "MIRPasses/PathAnalysisPass.h"
 #include "MIRPasses/TimingAnalysisPasses.h"
 #include "MIRPasses/WCETAnalysisPipeline.h"
+#include "Utility/Options.h"
 #include "llvm/CodeGen/MachineCFGPrinter.h"
 // END MODIFICATION
 using namespace llvm;
@@ -266,6 +270,29 @@ static int compileModule(char **, LLVMContext &);
   llvm_unreachable("reportError() should not return");
 }
 
+// MODIFICATION:
+// -load-graph: solve an archived analysis graph (see -save-graph) without
+// compiling or analyzing a module.
+static int solveLoadedGraph(StringRef Path) {
+  Expected<GraphFile> File = GraphFile::load(Path);
+  if (!File)
+    reportError(toString(File.takeError()));
+  LLVMContext Context;
+  Module M(Path, Context);
+  ProgramGraph PG;
+  AbstractStateGraph ASG;
+  File->buildAbstractStateGraph(ASG, PG, M);
+  outs() << "\n=== Path Analysis: Computing WCET via ILP ===\n";
+  outs() << "Loaded graph " << Path << ": " << File->nodes().size()
+         << " nodes, " << File->edges().size() << " edges, "
+         << File->callSites().size() << " call sites\n";
+  return solveAndReportWCET(ASG, File->getUnsoundReasons(),
+                            File->getUnsoundCallees())
+             ? 0
+             : 1;
+}
+// END MODIFICATION
+
 static std::unique_ptr<ToolOutputFile> GetOutputStream(const char *TargetName,
                                                        Triple::OSType OS,
                                                        const char *ProgName) {
@@ -371,6 +398,11 @@ int main(int argc, char **argv) {
 
   cl::ParseCommandLineOptions(argc, argv, "llvm system compiler\n");
 
+  // MODIFICATION:
+  if (!LoadGraphFile.empty())
+    return solveLoadedGraph(LoadGraphFile);
+  // END MODIFICATION
+
   if (!PassPipeline.empty() && !getRunPassNames().empty()) {
     errs() << "The `llc -run-pass=...` syntax for the new pass manager is "
               "not supported, please use `llc -passes=<pipeline>` (or the `-p` "
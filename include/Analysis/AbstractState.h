@@ -31,6 +31,12 @@ public:
    */
   virtual bool join(const AbstractState *Other) = 0;
 
+  /**
+   * A measure of how much the state holds (e.g. the cached lines of a cache
+   * state), reported by -fixpoint-stats. 0 if the domain defines none.
+   */
+  virtual unsigned getSize() const { return 0; }
+
   /**
    * Get a string representation of the state for debugging/graphing.
    */
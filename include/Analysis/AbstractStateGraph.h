@@ -2,16 +2,30 @@
 #define ABSTRACT_STATE_GRAPH_H
 
 #include "AbstractState.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/IR/Function.h"
+#include <iterator>
 #include <map>
 #include <memory>
-#include <set>
+#include <string>
 #include <vector>
 
 namespace llvm {
 
+class ProgramGraph;
+
+/**
+ * The graph the abstract interpretation and the IPET solver work on. Node ids
+ * are dense (0..N-1) and each node carries its abstract state and cost.
+ *
+ * The edges either belong to the graph (built with addEdge(), e.g. by hand in
+ * tests or by IPETReduction) or are read straight from a frozen ProgramGraph's
+ * CSR arrays after attachTo(): node I is then the ProgramGraph's dense node I,
+ * and only the per-node analysis data is stored here.
+ */
 class AbstractStateGraph {
 public:
   struct Node {
@@ -30,25 +44,94 @@ public:
           IsExit(false), IsLoopHeader(false), UpperLoopBound(0), Cost(0) {}
   };
 
-  AbstractStateGraph() : NextNodeId(0) {}
-
   struct Edge {
     unsigned To;
     bool IsBackEdge;
     bool operator<(const Edge &Other) const { return To < Other.To; }
   };
 
+  /// Out-edges of one node, ordered by target: a pair of parallel arrays
+  /// (targets, back-edge flags) that iterates as Edge values.
+  class EdgeRange {
+  public:
+    class iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = Edge;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const Edge *;
+      using reference = Edge;
+
+      iterator(const unsigned *To, const uint8_t *Back) : To(To), Back(Back) {}
+      Edge operator*() const { return {*To, *Back != 0}; }
+      iterator &operator++() {
+        ++To;
+        ++Back;
+        return *this;
+      }
+      bool operator==(const iterator &Other) const { return To == Other.To; }
+      bool operator!=(const iterator &Other) const { return To != Other.To; }
+
+    private:
+      const unsigned *To;
+      const uint8_t *Back;
+    };
+
+    EdgeRange(ArrayRef<unsigned> To, ArrayRef<uint8_t> Back)
+        : To(To), Back(Back) {}
+    iterator begin() const { return {To.begin(), Back.begin()}; }
+    iterator end() const { return {To.end(), Back.end()}; }
+    size_t size() const { return To.size(); }
+    bool empty() const { return To.empty(); }
+
+  private:
+    ArrayRef<unsigned> To;
+    ArrayRef<uint8_t> Back;
+  };
+
+  AbstractStateGraph() = default;
+  AbstractStateGraph(const AbstractStateGraph &) = delete;
+  AbstractStateGraph &operator=(const AbstractStateGraph &) = delete;
+  AbstractStateGraph(AbstractStateGraph &&) = default;
+  AbstractStateGraph &operator=(AbstractStateGraph &&) = default;
+
+  /**
+   * Make this graph a view over \p PG, which must be frozen and must outlive
+   * this graph unchanged. One node per dense ProgramGraph node is created
+   * with \p MakeState; edges, back-edge flags and predecessors are read from
+   * PG's CSR view. Any previous contents are dropped.
+   */
+  void attachTo(const ProgramGraph &PG,
+                function_ref<std::unique_ptr<AbstractState>()> MakeState);
+  /// The ProgramGraph this graph views, or null if it owns its edges.
+  const ProgramGraph *getBase() const { return Base; }
+
   unsigned addNode(std::unique_ptr<AbstractState> State,
                    const MachineBasicBlock *MBB = nullptr);
+  /// Adding an edge that already exists (same endpoints) has no effect.
   void addEdge(unsigned From, unsigned To, bool IsBackEdge = false);
   void removeEdge(unsigned From, unsigned To);
 
-  Node *getNode(unsigned Id);
-  const std::map<unsigned, std::unique_ptr<Node>> &getNodes() const {
-    return Nodes;
+  Node *getNode(unsigned Id) {
+    return Id < Nodes.size() ? &Nodes[Id] : nullptr;
   }
-  const std::set<Edge> &getSuccessors(unsigned Id) const;
-  const std::set<unsigned> &getPredecessors(unsigned Id) const;
+  const Node *getNode(unsigned Id) const {
+    return Id < Nodes.size() ? &Nodes[Id] : nullptr;
+  }
+  /// All nodes, indexed by id.
+  ArrayRef<Node> getNodes() const { return Nodes; }
+  unsigned getNumNodes() const { return Nodes.size(); }
+  EdgeRange getSuccessors(unsigned Id) const;
+  /// Predecessor ids of \p Id in ascending order.
+  ArrayRef<unsigned> getPredecessors(unsigned Id) const;
+
+  /**
+   * A readable name for node \p Id: "function:block" from the viewed
+   * ProgramGraph's node name and function, else "function:bb.N.name" from the
+   * node's MachineBasicBlock (whose MachineFunction must still be alive), else
+   * "n<Id>".
+   */
+  std::string getNodeLabel(unsigned Id) const;
 
   std::map<const Function *, unsigned> FunctionEntries;
   std::map<const Function *, std::vector<unsigned>> FunctionReturns;
@@ -56,16 +139,39 @@ public:
     unsigned CallNodeId;
     unsigned ReturnNodeId; // Successor of the call block
     const Function *Callee;
+    // Set when the callee instance is specific to this call site (context
+    // expansion, -context-depth); otherwise FunctionEntries/FunctionReturns
+    // of Callee apply.
+    unsigned EntryNodeId = ~0u;
+    std::vector<unsigned> ReturnNodeIds;
   };
   std::vector<CallSite> CallSites;
 
+  /// Entry node of the callee instance \p CS enters, or ~0u if unknown.
+  unsigned getCalleeEntry(const CallSite &CS) const {
+    if (CS.EntryNodeId != ~0u)
+      return CS.EntryNodeId;
+    auto It = FunctionEntries.find(CS.Callee);
+    return It == FunctionEntries.end() ? ~0u : It->second;
+  }
+  /// Return nodes of the callee instance \p CS enters.
+  ArrayRef<unsigned> getCalleeReturns(const CallSite &CS) const {
+    if (CS.EntryNodeId != ~0u)
+      return CS.ReturnNodeIds;
+    auto It = FunctionReturns.find(CS.Callee);
+    return It == FunctionReturns.end() ? ArrayRef<unsigned>()
+                                       : ArrayRef<unsigned>(It->second);
+  }
+
   void dump() const;
 
 private:
-  unsigned NextNodeId;
-  std::map<unsigned, std::unique_ptr<Node>> Nodes;
-  std::map<unsigned, std::set<Edge>> AdjacencyList;
-  std::map<unsigned, std::set<unsigned>> Predecessors;
+  std::vector<Node> Nodes;
+  const ProgramGraph *Base = nullptr;
+  /// Owned edges (Base == null), per node and sorted by target/source.
+  std::vector<std::vector<unsigned>> SuccTargets;
+  std::vector<std::vector<uint8_t>> SuccBackEdge;
+  std::vector<std::vector<unsigned>> Preds;
 };
 
 } // namespace llvm
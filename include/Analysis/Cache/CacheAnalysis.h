@@ -4,8 +4,11 @@
 #include "Analysis/AbstractAnalysable.h"
 #include "Analysis/Cache/CacheAccessMapper.h"
 #include "Analysis/Cache/CacheGeometry.h"
+#include "Analysis/Cache/CacheSetPool.h"
+#include "Analysis/Cache/CacheState.h"
 #include "Analysis/Cache/ReplacementPolicy.h"
 
+#include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineInstr.h"
 
 #include <cstdint>
@@ -14,8 +17,9 @@
 
 namespace llvm {
 
-/// Generic cache analysis engine (an AbstractAnalysable for the LLTA
-/// abstract-interpretation framework / WorklistSolver).
+/// Generic cache analysis domain, for the statically dispatched
+/// llta::WorklistSolver (include/Solver/WorklistSolver.h). States are
+/// CacheState values.
 ///
 /// Assembled from three interchangeable parts, with no target-specific logic:
 ///   - a CacheGeometry,
@@ -30,33 +34,92 @@ namespace llvm {
 ///
 /// A new cache analysis is built by supplying a different mapper/policy/geometry
 /// — no engine change.
-class CacheAnalysis : public AbstractAnalysable {
+class CacheDomain {
 public:
+  using StateType = CacheState;
+
   /// Called for each guaranteed-miss access in May mode (if set).
   using DefiniteMissSink =
       std::function<void(const MachineInstr *MI, uint64_t LineId)>;
 
-  CacheAnalysis(CacheGeometry Geo, unsigned MissPenalty,
-                const ReplacementPolicy &Policy, CacheAccessMapper &Mapper,
-                AnalysisKind Kind)
-      : Geo(Geo), MissPenalty(MissPenalty), Policy(&Policy), Mapper(&Mapper),
-        Kind(Kind) {}
+  CacheDomain(CacheGeometry Geo, unsigned MissPenalty,
+              const ReplacementPolicy &Policy, CacheAccessMapper &Mapper,
+              AnalysisKind Kind)
+      : Geo(Geo), MissPenalty(MissPenalty), Mapper(&Mapper), Kind(Kind),
+        Pool(std::make_shared<CacheSetPool>(Policy)) {}
 
   /// Enable/disable diagnostic reporting of guaranteed misses (May mode only).
   /// Leave unset during the fixpoint; set it for a final replay pass.
   void setDefiniteMissSink(DefiniteMissSink Sink) { this->Sink = std::move(Sink); }
 
-  std::unique_ptr<AbstractState> getInitialState() override;
+  /// Cold cache: every set empty. Sound for both directions (must: nothing
+  /// guaranteed; may: nothing possibly-cached yet).
+  CacheState getInitialState() const { return CacheState(Geo, Pool, Kind); }
+
+  bool join(CacheState &Into, const CacheState &Other) const {
+    return Into.join(Other);
+  }
+  bool equals(const CacheState &A, const CacheState &B) const {
+    return A.equals(B);
+  }
+  unsigned size(const CacheState &S) const { return S.getSize(); }
 
-  unsigned process(AbstractState *State, const MachineInstr *MI) override;
+  /// Apply the accesses of \p MI to \p S; return their cost.
+  unsigned transfer(CacheState &S, const MachineInstr *MI) const;
+
+  /// Apply the accesses of every instruction of \p MBB to \p S; return their
+  /// total cost.
+  unsigned transfer(CacheState &S, const MachineBasicBlock *MBB) const {
+    unsigned Cost = 0;
+    for (const MachineInstr &MI : *MBB)
+      Cost += transfer(S, &MI);
+    return Cost;
+  }
+
+  /// The per-set states shared by every state this domain creates.
+  const CacheSetPool &getPool() const { return *Pool; }
 
 private:
   CacheGeometry Geo;
   unsigned MissPenalty;
-  const ReplacementPolicy *Policy;
   CacheAccessMapper *Mapper;
   AnalysisKind Kind;
   DefiniteMissSink Sink;
+  std::shared_ptr<CacheSetPool> Pool;
+};
+
+/// CacheDomain as an AbstractAnalysable, for the virtual llvm::WorklistSolver
+/// and the rest of the abstract-interpretation framework. Its states are
+/// CacheStates behind AbstractState pointers.
+class CacheAnalysis : public AbstractAnalysable {
+public:
+  using DefiniteMissSink = CacheDomain::DefiniteMissSink;
+
+  CacheAnalysis(CacheGeometry Geo, unsigned MissPenalty,
+                const ReplacementPolicy &Policy, CacheAccessMapper &Mapper,
+                AnalysisKind Kind)
+      : Domain(Geo, MissPenalty, Policy, Mapper, Kind) {}
+
+  /// See CacheDomain::setDefiniteMissSink.
+  void setDefiniteMissSink(DefiniteMissSink Sink) {
+    Domain.setDefiniteMissSink(std::move(Sink));
+  }
+
+  std::unique_ptr<AbstractState> getInitialState() override {
+    return std::make_unique<CacheState>(Domain.getInitialState());
+  }
+
+  unsigned process(AbstractState *State, const MachineInstr *MI) override {
+    return Domain.transfer(*static_cast<CacheState *>(State), MI);
+  }
+
+  CacheDomain &getDomain() { return Domain; }
+
+  /// The per-set states shared by every state this analysis creates.
+  const CacheSetPool &getPool() const { return Domain.getPool(); }
+
+private:
+  CacheDomain Domain;
 };
 
 } // namespace llvm
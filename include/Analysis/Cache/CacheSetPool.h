@@ -0,0 +1,152 @@
+#ifndef ANALYSIS_CACHE_CACHE_SET_POOL_H
+#define ANALYSIS_CACHE_CACHE_SET_POOL_H
+
+#include "Analysis/Cache/ReplacementPolicy.h"
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+
+namespace llvm {
+
+/// Per-set states are reference counted by hand: the last reference hands
+/// the state back to its pool instead of deleting it.
+template <> struct IntrusiveRefCntPtrInfo<CacheSetState> {
+  static void retain(CacheSetState *S) { ++S->RefCount; }
+  static void release(CacheSetState *S);
+};
+
+/// A shared reference to a per-set state (see CacheSetPool).
+using CacheSetRef = IntrusiveRefCntPtr<CacheSetState>;
+
+/// Allocator and hash-consing table for the per-set states of one cache
+/// analysis (one ReplacementPolicy).
+///
+/// CacheStates share per-set states by reference and copy one only when they
+/// modify it while it is shared (copy-on-write), so a clone costs no set
+/// allocation at all. Sets produced by a join are interned: an equal set
+/// already in the table is reused, so the states at merge points mostly point
+/// at the same few set objects. Unreferenced states go to a free list and are
+/// overwritten by the next copy instead of being freed.
+///
+/// Not thread-safe: every analysis owns its pool, and states of one pool are
+/// only used by one thread at a time.
+class CacheSetPool {
+public:
+  explicit CacheSetPool(const ReplacementPolicy &Policy) : Policy(Policy) {
+    Empty = intern(adopt(Policy.makeEmpty()));
+  }
+  CacheSetPool(const CacheSetPool &) = delete;
+  CacheSetPool &operator=(const CacheSetPool &) = delete;
+  ~CacheSetPool() {
+    Empty = nullptr;
+    assert(NumLive == 0 && "cache set state outlives its pool");
+    for (CacheSetState *S : Free)
+      delete S;
+  }
+
+  const ReplacementPolicy &getPolicy() const { return Policy; }
+
+  /// The (interned) cold set.
+  const CacheSetRef &getEmpty() const { return Empty; }
+
+  /// Whether \p S may be modified in place: only its holder refers to it and
+  /// it is not interned.
+  static bool isExclusive(const CacheSetRef &S) {
+    return S->RefCount == 1 && !S->Interned;
+  }
+
+  /// A modifiable copy of \p S, from the free list when possible.
+  CacheSetRef copy(const CacheSetState &S) {
+    if (Free.empty()) {
+      ++NumAllocated;
+      return adopt(Policy.clone(S));
+    }
+    CacheSetState *R = Free.pop_back_val();
+    Policy.assign(*R, S);
+    ++NumRecycled;
+    ++NumLive;
+    return CacheSetRef(R);
+  }
+
+  /// The interned state equal to \p S: one already in the table, or \p S
+  /// itself, which must not be modified from then on.
+  CacheSetRef intern(CacheSetRef S) {
+    if (S->Interned)
+      return S;
+    const size_t H = Policy.hash(*S);
+    auto &Bucket = Table[H];
+    for (CacheSetState *T : Bucket)
+      if (Policy.equals(*T, *S)) {
+        ++NumInternHits;
+        return CacheSetRef(T);
+      }
+    S->Interned = true;
+    S->Hash = H;
+    Bucket.push_back(S.get());
+    ++NumInterned;
+    return S;
+  }
+
+  /// Set states allocated on the heap, and copies served from the free list.
+  unsigned getNumAllocated() const { return NumAllocated; }
+  unsigned getNumRecycled() const { return NumRecycled; }
+  /// Interned states alive, and interning requests answered by one of them.
+  unsigned getNumInterned() const { return NumInterned; }
+  unsigned getNumInternHits() const { return NumInternHits; }
+  /// Set states currently referenced.
+  unsigned getNumLive() const { return NumLive; }
+
+private:
+  friend struct IntrusiveRefCntPtrInfo<CacheSetState>;
+
+  const ReplacementPolicy &Policy;
+  CacheSetRef Empty;
+  /// Interned states by hash.
+  std::unordered_map<size_t, SmallVector<CacheSetState *, 1>> Table;
+  SmallVector<CacheSetState *, 16> Free;
+  unsigned NumAllocated = 0;
+  unsigned NumRecycled = 0;
+  unsigned NumInterned = 0;
+  unsigned NumInternHits = 0;
+  unsigned NumLive = 0;
+
+  CacheSetRef adopt(std::unique_ptr<CacheSetState> S) {
+    S->Owner = this;
+    ++NumLive;
+    return CacheSetRef(S.release());
+  }
+
+  void release(CacheSetState *S) {
+    --NumLive;
+    if (S->Interned) {
+      auto It = Table.find(S->Hash);
+      assert(It != Table.end() && "interned state missing from the table");
+      It->second.erase(llvm::find(It->second, S));
+      if (It->second.empty())
+        Table.erase(It);
+      S->Interned = false;
+      --NumInterned;
+    }
+    Free.push_back(S);
+  }
+};
+
+inline void IntrusiveRefCntPtrInfo<CacheSetState>::release(CacheSetState *S) {
+  assert(S->RefCount > 0 && "releasing an unreferenced cache set state");
+  if (--S->RefCount)
+    return;
+  if (S->Owner)
+    S->Owner->release(S);
+  else
+    delete S;
+}
+
+} // namespace llvm
+
+#endif // ANALYSIS_CACHE_CACHE_SET_POOL_H
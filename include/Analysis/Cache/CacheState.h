@@ -3,12 +3,15 @@
 
 #include "Analysis/AbstractState.h"
 #include "Analysis/Cache/CacheGeometry.h"
+#include "Analysis/Cache/CacheSetPool.h"
 #include "Analysis/Cache/ReplacementPolicy.h"
 
+#include "llvm/ADT/SmallVector.h"
+
 #include <cstdint>
 #include <memory>
 #include <string>
-#include <vector>
+#include <utility>
 
 namespace llvm {
 
@@ -16,72 +19,116 @@ namespace llvm {
 /// interpreted by the ReplacementPolicy) per cache set, plus the analysis
 /// direction (Must/May, which selects the join). Fully cache-/policy-agnostic;
 /// every lattice operation delegates to the policy.
+///
+/// The per-set states come from a CacheSetPool and are shared between states
+/// copy-on-write: clone() only copies references, access() copies the one set
+/// it changes, and join() interns the sets it changes.
 class CacheState : public AbstractState {
 public:
+  /// A cold state with a pool of its own.
   CacheState(CacheGeometry Geo, const ReplacementPolicy *Policy,
              AnalysisKind Kind)
-      : Geo(Geo), Policy(Policy), Kind(Kind) {
-    Sets.reserve(Geo.NumSets);
-    for (unsigned I = 0; I < Geo.NumSets; ++I)
-      Sets.push_back(Policy->makeEmpty());
-  }
+      : CacheState(Geo, std::make_shared<CacheSetPool>(*Policy), Kind) {}
+
+  /// A cold state whose sets come from \p Pool (shared by the states of one
+  /// analysis).
+  CacheState(CacheGeometry Geo, std::shared_ptr<CacheSetPool> Pool,
+             AnalysisKind Kind)
+      : Geo(Geo), Pool(std::move(Pool)), Kind(Kind),
+        Sets(Geo.NumSets, this->Pool->getEmpty()) {}
 
   /// Apply an access to line \p LineId; return whether the line was present
   /// (Must: a guaranteed hit; May: a possible hit, i.e. not a guaranteed miss).
   bool access(uint64_t LineId) {
-    unsigned S = Geo.setIndex(LineId);
-    bool Present = Policy->contains(*Sets[S], LineId);
-    Policy->update(*Sets[S], LineId);
+    const ReplacementPolicy &Policy = Pool->getPolicy();
+    CacheSetRef &Set = Sets[Geo.setIndex(LineId)];
+    bool Present = Policy.contains(*Set, LineId);
+    if (CacheSetPool::isExclusive(Set)) {
+      Policy.update(*Set, LineId);
+      return Present;
+    }
+    // Copy on write. An access that changes nothing (a hit that does not
+    // reorder) keeps the shared set.
+    CacheSetRef Copy = Pool->copy(*Set);
+    Policy.update(*Copy, LineId);
+    if (!Policy.equals(*Copy, *Set))
+      Set = std::move(Copy);
     return Present;
   }
 
   /// Conservatively wipe the whole cache (an unplaceable/unknown access).
   void barrier() {
     for (auto &S : Sets)
-      S = Policy->makeEmpty();
+      S = Pool->getEmpty();
   }
 
+  /// The state of set \p S. States sharing a set return the same object.
+  const CacheSetState *getSet(unsigned S) const { return Sets[S].get(); }
+
   std::unique_ptr<AbstractState> clone() const override {
-    auto C = std::make_unique<CacheState>(Geo, Policy, Kind);
-    for (unsigned I = 0; I < Sets.size(); ++I)
-      C->Sets[I] = Policy->clone(*Sets[I]);
-    return C;
+    return std::make_unique<CacheState>(*this);
   }
 
   bool equals(const AbstractState *Other) const override {
-    const auto *O = static_cast<const CacheState *>(Other);
-    if (Sets.size() != O->Sets.size())
+    return equals(*static_cast<const CacheState *>(Other));
+  }
+
+  bool join(const AbstractState *Other) override {
+    return join(*static_cast<const CacheState *>(Other));
+  }
+
+  /// The lattice operations on a known CacheState (no virtual dispatch; used
+  /// by CacheDomain).
+  bool equals(const CacheState &O) const {
+    if (Sets.size() != O.Sets.size())
       return false;
     for (unsigned I = 0; I < Sets.size(); ++I)
-      if (!Policy->equals(*Sets[I], *O->Sets[I]))
+      if (Sets[I] != O.Sets[I] &&
+          !Pool->getPolicy().equals(*Sets[I], *O.Sets[I]))
         return false;
     return true;
   }
 
-  bool join(const AbstractState *Other) override {
-    const auto *O = static_cast<const CacheState *>(Other);
+  bool join(const CacheState &O) {
     bool Changed = false;
-    for (unsigned I = 0; I < Sets.size() && I < O->Sets.size(); ++I)
-      if (Policy->join(*Sets[I], *O->Sets[I], Kind))
-        Changed = true;
+    for (unsigned I = 0; I < Sets.size() && I < O.Sets.size(); ++I) {
+      if (Sets[I] == O.Sets[I])
+        continue;
+      CacheSetRef Into = CacheSetPool::isExclusive(Sets[I])
+                             ? Sets[I]
+                             : Pool->copy(*Sets[I]);
+      if (!Pool->getPolicy().join(*Into, *O.Sets[I], Kind))
+        continue;
+      Sets[I] = Pool->intern(std::move(Into));
+      Changed = true;
+    }
     return Changed;
   }
 
+  /// The lines held over all sets.
+  unsigned getSize() const override {
+    unsigned Size = 0;
+    for (const auto &S : Sets)
+      Size += Pool->getPolicy().size(*S);
+    return Size;
+  }
+
   std::string toString() const override {
     std::string Res = "Cache[";
     for (unsigned I = 0; I < Sets.size(); ++I) {
       if (I)
         Res += " ";
-      Res += Policy->toString(*Sets[I]);
+      Res += Pool->getPolicy().toString(*Sets[I]);
     }
     return Res + "]";
   }
 
 private:
   CacheGeometry Geo;
-  const ReplacementPolicy *Policy;
+  /// Declared before Sets: the sets go back to the pool before it can go.
+  std::shared_ptr<CacheSetPool> Pool;
   AnalysisKind Kind;
-  std::vector<std::unique_ptr<CacheSetState>> Sets;
+  SmallVector<CacheSetRef, 4> Sets;
 };
 
 } // namespace llvm
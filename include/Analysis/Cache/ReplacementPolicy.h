@@ -1,9 +1,12 @@
 #ifndef ANALYSIS_CACHE_REPLACEMENT_POLICY_H
 #define ANALYSIS_CACHE_REPLACEMENT_POLICY_H
 
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/StringRef.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <optional>
@@ -38,10 +41,27 @@ enum class AnalysisKind { Must, May };
 // Adding PLRUPolicy etc. is just another subclass.
 //===----------------------------------------------------------------------===//
 
-/// Opaque per-set abstract state; each policy sub-classes this.
+class CacheSetPool;
+
+/// Opaque per-set abstract state; each policy sub-classes this. The private
+/// part is the bookkeeping of the CacheSetPool that allocated the state; it
+/// is neither copied nor compared.
 class CacheSetState {
 public:
+  CacheSetState() = default;
+  CacheSetState(const CacheSetState &) {}
+  CacheSetState &operator=(const CacheSetState &) { return *this; }
   virtual ~CacheSetState() = default;
+
+private:
+  friend class CacheSetPool;
+  friend struct IntrusiveRefCntPtrInfo<CacheSetState>;
+  /// The pool the state goes back to once unreferenced (null: deleted).
+  CacheSetPool *Owner = nullptr;
+  unsigned RefCount = 0;
+  /// Interned states are shared by value and never modified.
+  bool Interned = false;
+  size_t Hash = 0;
 };
 
 class ReplacementPolicy {
@@ -56,7 +76,13 @@ public:
   /// An empty (cold) set state.
   virtual std::unique_ptr<CacheSetState> makeEmpty() const = 0;
   virtual std::unique_ptr<CacheSetState> clone(const CacheSetState &S) const = 0;
+  /// Overwrite \p Into with a copy of \p From, reusing its storage.
+  virtual void assign(CacheSetState &Into, const CacheSetState &From) const = 0;
   virtual bool equals(const CacheSetState &A, const CacheSetState &B) const = 0;
+  /// A hash consistent with equals().
+  virtual size_t hash(const CacheSetState &S) const = 0;
+  /// The number of lines \p S holds.
+  virtual unsigned size(const CacheSetState &S) const = 0;
 
   /// Membership test (no mutation): is \p LineId in the abstract set? For a
   /// must-state this means "guaranteed present" (⇒ hit); for a may-state
@@ -107,10 +133,21 @@ public:
   std::unique_ptr<CacheSetState> clone(const CacheSetState &S) const override {
     return std::make_unique<UnknownSetState>(static_cast<const UnknownSetState &>(S));
   }
+  void assign(CacheSetState &Into, const CacheSetState &From) const override {
+    static_cast<UnknownSetState &>(Into) =
+        static_cast<const UnknownSetState &>(From);
+  }
   bool equals(const CacheSetState &A, const CacheSetState &B) const override {
     return static_cast<const UnknownSetState &>(A).Line ==
            static_cast<const UnknownSetState &>(B).Line;
   }
+  size_t hash(const CacheSetState &S) const override {
+    const auto &U = static_cast<const UnknownSetState &>(S);
+    return U.Line ? size_t(hash_value(*U.Line)) : 0;
+  }
+  unsigned size(const CacheSetState &S) const override {
+    return static_cast<const UnknownSetState &>(S).Line.has_value();
+  }
   bool contains(const CacheSetState &S, uint64_t LineId) const override {
     const auto &U = static_cast<const UnknownSetState &>(S);
     return U.Line.has_value() && *U.Line == LineId;
@@ -164,9 +201,22 @@ public:
   std::unique_ptr<CacheSetState> clone(const CacheSetState &S) const override {
     return std::make_unique<AgeSetState>(static_cast<const AgeSetState &>(S));
   }
+  void assign(CacheSetState &Into, const CacheSetState &From) const override {
+    static_cast<AgeSetState &>(Into) = static_cast<const AgeSetState &>(From);
+  }
   bool equals(const CacheSetState &A, const CacheSetState &B) const override {
-    return sorted(static_cast<const AgeSetState &>(A)) ==
-           sorted(static_cast<const AgeSetState &>(B));
+    return sameLines(static_cast<const AgeSetState &>(A).Lines,
+                     static_cast<const AgeSetState &>(B).Lines);
+  }
+  size_t hash(const CacheSetState &S) const override {
+    // Order-insensitive, like equals().
+    size_t H = 0;
+    for (const auto &P : static_cast<const AgeSetState &>(S).Lines)
+      H += hash_value(P);
+    return H;
+  }
+  unsigned size(const CacheSetState &S) const override {
+    return static_cast<const AgeSetState &>(S).Lines.size();
   }
   bool contains(const CacheSetState &S, uint64_t LineId) const override {
     const auto &L = static_cast<const AgeSetState &>(S).Lines;
@@ -193,9 +243,7 @@ public:
         if (!find(I, Q.first))
           Merged.push_back(Q);
     }
-    AgeSetState Tmp;
-    Tmp.Lines = Merged;
-    if (equals(Into, Tmp))
+    if (sameLines(I, Merged))
       return false;
     static_cast<AgeSetState &>(Into).Lines = std::move(Merged);
     return true;
@@ -231,6 +279,19 @@ protected:
         return &P.second;
     return nullptr;
   }
+  /// Same lines with the same ages, in any order (a line appears at most
+  /// once per set).
+  static bool sameLines(const std::vector<std::pair<uint64_t, unsigned>> &A,
+                        const std::vector<std::pair<uint64_t, unsigned>> &B) {
+    if (A.size() != B.size())
+      return false;
+    for (const auto &P : A) {
+      const unsigned *Age = find(B, P.first);
+      if (!Age || *Age != P.second)
+        return false;
+    }
+    return true;
+  }
   static std::vector<std::pair<uint64_t, unsigned>>
   sorted(const AgeSetState &S) {
     auto C = S.Lines;
@@ -0,0 +1,89 @@
+#ifndef FIXPOINT_STATS_H
+#define FIXPOINT_STATS_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+namespace json {
+class OStream;
+} // namespace json
+
+/**
+ * What one fixpoint run cost: one WorklistSolver::run or
+ * llta::WorklistSolver::solve with this record attached (setStats()).
+ *
+ * Solvers always count visits, updates, joins, transfers and clones and add
+ * them to the LLVM -stats counters (addFixpointStatistics()). Only a run with
+ * a record attached also times itself, measures every state it stores and
+ * counts visits per node, so the overhead without one is a few increments per
+ * visit.
+ */
+struct FixpointStats {
+  /// Nodes listed by getMostVisited() in the JSON report.
+  static constexpr unsigned NumMostVisited = 10;
+
+  /// Set by the caller: which analysis ran ("pipeline", "fram-cache-must",
+  /// ...) on which function (empty for a whole-program graph).
+  std::string Analysis;
+  std::string Function;
+  /// Set by the solver.
+  std::string Order;
+  unsigned Nodes = 0;
+  /// Nodes processed, and how many of those changed state.
+  unsigned Visits = 0;
+  unsigned Updates = 0;
+  /// Joins of a predecessor's state into an in-state.
+  unsigned Joins = 0;
+  /// Block transfers (visits of a node with a block to process).
+  unsigned Transfers = 0;
+  /// Predecessor states copied to start an in-state.
+  unsigned Clones = 0;
+  /// Size of the state stored by each update (AbstractState::getSize(), e.g.
+  /// the cached lines of a CacheState).
+  unsigned PeakStateSize = 0;
+  uint64_t TotalStateSize = 0;
+  double Seconds = 0;
+  /// Visits per node, indexed by node id (dense index for the template
+  /// engine), and an optional name per node for the report.
+  std::vector<unsigned> NodeVisits;
+  std::vector<std::string> NodeNames;
+
+  /// Start a run over \p NumNodes nodes: clear the counters, keep the names
+  /// set by the caller.
+  void reset(StringRef Order, unsigned NumNodes);
+  /// Count the size of a state stored by an update.
+  void addStateSize(unsigned Size) {
+    PeakStateSize = std::max(PeakStateSize, Size);
+    TotalStateSize += Size;
+  }
+  double getAverageStateSize() const {
+    return Updates ? double(TotalStateSize) / Updates : 0.0;
+  }
+  /// The (at most) \p N nodes visited more than once, most visits first and
+  /// the smaller id on ties, with their visit counts.
+  std::vector<std::pair<unsigned, unsigned>>
+  getMostVisited(unsigned N = NumMostVisited) const;
+
+  /// Write this run as one JSON object.
+  void writeJSON(json::OStream &J) const;
+};
+
+/// Add one run's counters to the LLVM -stats counters (thread-safe).
+void addFixpointStatistics(unsigned Visits, unsigned Updates, unsigned Joins,
+                           unsigned Transfers, unsigned Clones);
+
+/// Write \p Runs to \p Path as {"version": 1, "runs": [...]} (-fixpoint-stats).
+Error writeFixpointStats(StringRef Path, ArrayRef<FixpointStats> Runs);
+
+} // namespace llvm
+
+#endif // FIXPOINT_STATS_H
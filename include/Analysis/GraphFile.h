@@ -0,0 +1,158 @@
+#ifndef GRAPH_FILE_H
+#define GRAPH_FILE_H
+
+#include "Analysis/AbstractStateGraph.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <set>
+#include <string>
+
+namespace llvm {
+
+class Module;
+class ProgramGraph;
+
+/**
+ * Binary archive of a solve-ready analysis graph: the AbstractStateGraph the
+ * WCET ILP is built from (node costs, loop bounds, back-edge flags, call sites
+ * with their resolved callee entry/return nodes, function entry/return maps),
+ * each node's block and function name for the reports, plus the reasons the
+ * result is unsound (UnsoundReasons and the body-less callees from
+ * ProgramGraph::getUnsoundExternalCallees()).
+ *
+ * The format is versioned and little-endian. Every section is an array of
+ * fixed-size records of unaligned little-endian integers, laid out in a fixed
+ * order after the header and padded to 8 bytes, so a loaded file is a set of
+ * ArrayRefs into the mapped buffer: nothing is parsed or copied until
+ * buildAbstractStateGraph() materializes a graph for the solver.
+ *
+ * Node references inside the file are dense node indices (0..NumNodes-1);
+ * NodeRecord::Id keeps the node's id in the graph that was written.
+ */
+class GraphFile {
+public:
+  static constexpr char Magic[8] = {'L', 'L', 'T', 'A', 'G', 'R', 'P', 'H'};
+  static constexpr uint32_t Version = 2;
+  static constexpr uint32_t None = ~0u;
+
+  using U32 = support::ulittle32_t;
+
+  struct Header {
+    char Magic[8];
+    U32 Version;
+    U32 NumNodes;
+    U32 NumEdges;
+    U32 NumCallSites;
+    U32 NumFunctions;
+    U32 NumReturnIds;
+    U32 NumUnsoundCallees;
+    U32 NumUnsoundReasons;
+    U32 NumStrings;
+    U32 StringBytes;
+  };
+
+  /// NodeRecord::Flags bits.
+  static constexpr uint32_t Entry = 1;
+  static constexpr uint32_t Exit = 2;
+  static constexpr uint32_t LoopHeader = 4;
+  /// EdgeRecord::Flags bits.
+  static constexpr uint32_t BackEdge = 1;
+
+  /// Successors of node I are Edges[FirstEdge(I) .. FirstEdge(I + 1)).
+  struct NodeRecord {
+    U32 Id;
+    U32 Cost;
+    U32 UpperLoopBound;
+    U32 Flags;
+    U32 FirstEdge;
+    U32 Name;     ///< String index of the block name.
+    U32 Function; ///< String index of the function name, or None.
+  };
+  struct EdgeRecord {
+    U32 To;
+    U32 Flags;
+  };
+  /// Entry/returns of the callee instance this site enters; Entry is None
+  /// when the callee was not part of the graph. Returns are
+  /// ReturnIds[FirstReturn .. FirstReturn + NumReturns).
+  struct CallSiteRecord {
+    U32 CallNode;
+    U32 LandingNode;
+    U32 Entry;
+    U32 FirstReturn;
+    U32 NumReturns;
+    U32 Callee; ///< String index of the callee name.
+  };
+  struct FunctionRecord {
+    U32 Name; ///< String index.
+    U32 Entry;
+    U32 FirstReturn;
+    U32 NumReturns;
+  };
+
+  /// Write \p ASG and the unsoundness sets to \p OS in the format above.
+  static void write(raw_ostream &OS, const AbstractStateGraph &ASG,
+                    const std::set<std::string> &UnsoundReasons,
+                    const std::set<std::string> &UnsoundCallees);
+  static Error write(StringRef Path, const AbstractStateGraph &ASG,
+                     const std::set<std::string> &UnsoundReasons,
+                     const std::set<std::string> &UnsoundCallees);
+
+  /// Map \p Path (read-only) and validate the header and section sizes.
+  static Expected<GraphFile> load(StringRef Path);
+  static Expected<GraphFile> load(std::unique_ptr<MemoryBuffer> Buffer);
+
+  const Header &getHeader() const { return *Hdr; }
+  ArrayRef<NodeRecord> nodes() const { return Nodes; }
+  ArrayRef<EdgeRecord> edges() const { return Edges; }
+  ArrayRef<EdgeRecord> successors(unsigned Node) const;
+  ArrayRef<CallSiteRecord> callSites() const { return CallSites; }
+  ArrayRef<FunctionRecord> functions() const { return Functions; }
+  ArrayRef<U32> returnIds() const { return ReturnIds; }
+  ArrayRef<U32> unsoundCallees() const { return UnsoundCallees; }
+  ArrayRef<U32> unsoundReasons() const { return UnsoundReasons; }
+  StringRef getString(uint32_t Index) const;
+
+  /**
+   * Rebuild the graph for the solver. Node I of the file becomes node I of
+   * \p PG, with its block name, function, cost, loop bound and edges, and \p PG
+   * is frozen; \p ASG becomes a view of it with the per-node solver data, the
+   * call sites (carrying their callee instance explicitly) and the function
+   * entry/return maps. Both must be empty.
+   *
+   * There are no IR Functions behind a loaded graph, so every function named
+   * in the file is declared in \p M (as void()) to key the function maps and
+   * call sites. \p M must outlive both graphs.
+   */
+  void buildAbstractStateGraph(AbstractStateGraph &ASG, ProgramGraph &PG,
+                               Module &M) const;
+
+  /// The unsoundness sets, as std::sets for reporting.
+  std::set<std::string> getUnsoundCallees() const;
+  std::set<std::string> getUnsoundReasons() const;
+
+private:
+  explicit GraphFile(std::unique_ptr<MemoryBuffer> Buffer)
+      : Buffer(std::move(Buffer)) {}
+
+  std::unique_ptr<MemoryBuffer> Buffer;
+  const Header *Hdr = nullptr;
+  ArrayRef<NodeRecord> Nodes;
+  ArrayRef<EdgeRecord> Edges;
+  ArrayRef<CallSiteRecord> CallSites;
+  ArrayRef<FunctionRecord> Functions;
+  ArrayRef<U32> ReturnIds;
+  ArrayRef<U32> UnsoundCallees;
+  ArrayRef<U32> UnsoundReasons;
+  ArrayRef<U32> StringOffsets;
+  StringRef StringData;
+};
+
+} // namespace llvm
+
+#endif // GRAPH_FILE_H
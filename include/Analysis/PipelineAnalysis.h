@@ -37,6 +37,8 @@ public:
   std::unique_ptr<AbstractState> clone() const override;
   bool equals(const AbstractState *Other) const override;
   bool join(const AbstractState *Other) override;
+  /// The sum of the sub-states' sizes.
+  unsigned getSize() const override;
   std::string toString() const override;
 };
 
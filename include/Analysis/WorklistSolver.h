@@ -3,13 +3,20 @@
 
 #include "AbstractAnalysable.h"
 #include "AbstractStateGraph.h"
+#include "FixpointStats.h"
 #include "Graph/ProgramGraph.h"
 #include "TimingAnalysisResults.h"
 #include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/CodeGen/MachineLoopInfo.h"
+#include <chrono>
 #include <deque>
+#include <functional>
 #include <map>
+#include <queue>
 #include <set>
+#include <vector>
 
 namespace llvm {
 
@@ -24,9 +31,52 @@ class MachineBasicBlock;
  */
 class WorklistSolver {
 public:
+  /// How pending nodes are scheduled.
+  enum class Order {
+    /// First in, first out (the default).
+    FIFO,
+    /// Smallest position in the weak topological order first: a loop, and
+    /// every loop nested in it, stabilises before its exits are visited.
+    WTO,
+  };
+
   WorklistSolver(AbstractAnalysable &Analysis, AbstractStateGraph &Graph)
       : Analysis(Analysis), Graph(Graph) {}
 
+  void setOrder(Order O) { Schedule = O; }
+  Order getOrder() const { return Schedule; }
+
+  /// Parse a -worklist-order value ("fifo" or "wto"). Anything else warns on
+  /// errs() and gives FIFO.
+  static Order parseOrder(StringRef Name);
+  /// "fifo" or "wto".
+  static StringRef getOrderName(Order O) {
+    return O == Order::WTO ? "wto" : "fifo";
+  }
+
+  /**
+   * Bourdoncle's weak topological order of \p G: every strongly connected
+   * component is contiguous, starts with its head (the node the depth-first
+   * search enters it by) and orders the rest of it the same way, recursively.
+   * Components come in topological order, the graph's entries are searched
+   * from first, and unreachable nodes are included.
+   */
+  static std::vector<unsigned>
+  getWeakTopologicalOrder(const AbstractStateGraph &G);
+
+  /// Nodes processed by the last run, and how many of those changed state.
+  unsigned getNumVisits() const { return NumVisits; }
+  unsigned getNumUpdates() const { return NumUpdates; }
+  /// Joins, block transfers and state clones of the last run.
+  unsigned getNumJoins() const { return NumJoins; }
+  unsigned getNumTransfers() const { return NumTransfers; }
+  unsigned getNumClones() const { return NumClones; }
+
+  /// Record every following run in \p S (nullptr: stop recording). The run
+  /// overwrites everything in \p S but Analysis, Function and NodeNames,
+  /// which run(PG) and run(MF) fill in when empty.
+  void setStats(FixpointStats *S) { Stats = S; }
+
   /**
    * Run the analysis on all functions in the module.
    */
@@ -45,9 +95,26 @@ public:
 private:
   AbstractAnalysable &Analysis;
   AbstractStateGraph &Graph;
+  Order Schedule = Order::FIFO;
   std::deque<unsigned> Worklist;
-  std::set<unsigned> InWorklist;
+  /// WTO: pending positions, smallest first, and the node at each position.
+  std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>>
+      Pending;
+  std::vector<unsigned> Position, NodeAt;
+  BitVector InWorklist;
+  unsigned NumVisits = 0;
+  unsigned NumUpdates = 0;
+  unsigned NumJoins = 0;
+  unsigned NumTransfers = 0;
+  unsigned NumClones = 0;
+  FixpointStats *Stats = nullptr;
+  std::chrono::steady_clock::time_point StartTime;
 
+  /// Size the membership bits for the graph and, for WTO, compute the order.
+  void startSchedule();
+  /// Report the run to the -stats counters and, if attached, to Stats.
+  void finishRun();
+  bool isWorklistEmpty() const { return Worklist.empty() && Pending.empty(); }
   void addToWorklist(unsigned NodeId);
   unsigned takeFromWorklist();
   void initializeGraph(const ProgramGraph &PG);
@@ -1,10 +1,15 @@
 #ifndef PROGRAM_GRAPH_H
 #define PROGRAM_GRAPH_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
 #include <cassert>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <set>
 #include <string>
@@ -25,9 +30,11 @@ class MachineLoopInfo;
 struct MuArchState {
   unsigned MinCycles;
   unsigned MaxCycles;
-  std::string DebugInfo;
+  /// Free-form annotation for the dot dump. States created through
+  /// ProgramGraph::addNode point into the graph's interned string pool.
+  StringRef DebugInfo;
 
-  MuArchState(unsigned Min, unsigned Max, std::string Info = "")
+  MuArchState(unsigned Min, unsigned Max, StringRef Info = "")
       : MinCycles(Min), MaxCycles(Max), DebugInfo(Info) {}
   virtual ~MuArchState() = default;
 
@@ -35,11 +42,18 @@ struct MuArchState {
   unsigned getLowerBoundCycles() const { return MinCycles; }
 };
 
+/**
+ * A vertex of the ProgramGraph. Nodes are move-only: the MuArchState they
+ * point to and their Name are owned by the graph's arena, not by the Node.
+ */
 class Node {
 public:
-  explicit Node(unsigned NewId, std::unique_ptr<MuArchState> State);
+  explicit Node(unsigned NewId, MuArchState *State);
 
-  Node(const Node &Node);
+  Node(const Node &) = delete;
+  Node &operator=(const Node &) = delete;
+  Node(Node &&) = default;
+  Node &operator=(Node &&) = default;
 
   ~Node();
 
@@ -47,9 +61,9 @@ public:
 
   unsigned getId() const;
 
-  const std::set<unsigned> getPredecessors() const;
+  const std::set<unsigned> &getPredecessors() const;
 
-  const std::set<unsigned> getSuccessors() const;
+  const std::set<unsigned> &getSuccessors() const;
 
   void addSuccessor(unsigned SuccessorId);
 
@@ -65,9 +79,14 @@ public:
 
   bool isFree() const;
 
+  /// \p NewName must outlive the graph; use ProgramGraph::setNodeName to
+  /// intern names whose storage may be freed (e.g. MachineBasicBlock names).
   void setName(StringRef NewName) { Name = NewName; }
 
   std::string getNodeDescr() const;
+  /// The description of this node as node \p AsId (a context instance of it,
+  /// see ProgramGraph::ContextInstance).
+  std::string getNodeDescr(unsigned AsId) const;
 
   MuArchState &getState() const;
 
@@ -75,13 +94,13 @@ public:
 
   bool IsNestedLoop = false;
 
-  unsigned int LowerLoopBound;
+  unsigned int LowerLoopBound = 0;
 
-  unsigned int UpperLoopBound;
+  unsigned int UpperLoopBound = 0;
 
-  Node *NestedLoopHeader;
+  Node *NestedLoopHeader = nullptr;
 
-  friend std::ostream &operator<<(std::ostream &Stream, Node Node) {
+  friend std::ostream &operator<<(std::ostream &Stream, const Node &Node) {
     Stream << "Node ID: " << Node.Id;
     return Stream;
   }
@@ -93,7 +112,7 @@ public:
 
   /**
    * Stores the name of this Node, e.g. the name of the MachineBasicBlock
-   * it represents.
+   * it represents. Points into the owning graph's string pool.
    */
   StringRef Name;
 
@@ -113,9 +132,10 @@ public:
   std::set<unsigned> BackEdgePredecessors;
 
   /**
-   * Stores the architectural state associated with this Node.
+   * Stores the architectural state associated with this Node. The state is
+   * allocated in (and owned by) the arena of the ProgramGraph holding it.
    */
-  std::unique_ptr<MuArchState> State;
+  MuArchState *State;
 };
 
 class ProgramGraph {
@@ -126,14 +146,40 @@ public:
 
   ProgramGraph();
 
-  ProgramGraph(ProgramGraph &G2);
+  /// Graphs own their node states and names, so they can be move-constructed
+  /// but not copied (a copy would alias the arena).
+  ProgramGraph(const ProgramGraph &) = delete;
+  ProgramGraph &operator=(const ProgramGraph &) = delete;
+  ProgramGraph(ProgramGraph &&);
 
   ~ProgramGraph();
 
+  /**
+   * Adds a node whose MuArchState is bump-allocated in the graph's arena.
+   * \p NodeName and \p DebugInfo are interned, so the caller's storage may be
+   * freed afterwards. Adding a node performs no per-node heap allocation
+   * beyond the map entry itself.
+   */
+  unsigned addNode(unsigned MinCycles, unsigned MaxCycles,
+                   MachineBasicBlock *MBB, StringRef NodeName = "",
+                   StringRef DebugInfo = "");
+
+  /// Convenience overloads; \p State is copied into the arena and released.
   unsigned addNode(std::unique_ptr<MuArchState> State, MachineBasicBlock *MBB);
   unsigned addNode(std::unique_ptr<MuArchState> State, MachineBasicBlock *MBB,
                    StringRef NodeName);
 
+  /// Interns \p Str in the graph's string pool. Equal strings share storage
+  /// and stay valid for the lifetime of the graph.
+  StringRef intern(StringRef Str);
+
+  /// Sets the name of node \p NodeId to an interned copy of \p Name.
+  void setNodeName(unsigned NodeId, StringRef Name);
+
+  /// Interned name of \p F recorded by fillGraphWithFunction (empty if \p F
+  /// was never added). Safe to use after the Function is gone.
+  StringRef getFunctionName(const Function *F) const;
+
   /**
    * Adds an edge to the graph from the Node with id start to the Node with
    * id end.
@@ -160,26 +206,112 @@ public:
    */
   void removeEdge(unsigned FromNode, unsigned ToNode);
 
-  const std::set<unsigned> getPredecessors(unsigned NodeId) const;
+  const std::set<unsigned> &getPredecessors(unsigned NodeId) const;
 
-  const std::set<unsigned> getSuccessors(unsigned NodeId) const;
+  const std::set<unsigned> &getSuccessors(unsigned NodeId) const;
 
   const std::map<unsigned, Node> &getNodes() const;
 
+  /// Dense index returned for node ids that are not part of the frozen graph.
+  static constexpr unsigned InvalidIndex = ~0u;
+
+  /**
+   * Freeze the graph into a contiguous compressed-sparse-row (CSR) layout.
+   * Nodes get dense indices 0..N-1 in ascending node-id order and edges get
+   * dense indices 0..E-1 grouped by source node (so the out-edges of dense node
+   * I are [getSuccessorEdgeBegin(I), getSuccessorEdgeBegin(I + 1))). Every edge
+   * carries a back-edge flag taken from its target's BackEdgePredecessors.
+   * The nodes of context instances (see ContextInstance) are part of the view
+   * like any other node.
+   *
+   * finalize() freezes the graph once its shape is final. Any later call to the
+   * builder API (addNode/addEdge/removeEdge/removeNode) thaws it again; direct
+   * writes to Nodes or BackEdgePredecessors require an explicit re-freeze().
+   */
+  void freeze();
+
+  /// Whether the CSR view is valid (freeze() ran after the last mutation).
+  bool isFrozen() const { return Frozen; }
+
+  /// CSR accessors; all require isFrozen(). Indices are dense, not node ids.
+  unsigned getNumDenseNodes() const { return DenseNodes.size(); }
+  unsigned getNumDenseEdges() const { return EdgeTargets.size(); }
+  unsigned getDenseIndex(unsigned NodeId) const {
+    assert(Frozen && "ProgramGraph is not frozen");
+    return NodeId < IdToDense.size() ? IdToDense[NodeId] : InvalidIndex;
+  }
+  /// The node at \p Idx; for a context instance node, the template node it
+  /// shares (whose Id is the template's: use getNodeIdAt() for the node's).
+  const Node &getDenseNode(unsigned Idx) const { return *DenseNodes[Idx]; }
+  unsigned getNodeIdAt(unsigned Idx) const { return DenseIds[Idx]; }
+  unsigned getSuccessorEdgeBegin(unsigned Idx) const {
+    return SuccOffsets[Idx];
+  }
+  ArrayRef<unsigned> getSuccessorIndices(unsigned Idx) const {
+    assert(Frozen && "ProgramGraph is not frozen");
+    return ArrayRef<unsigned>(EdgeTargets)
+        .slice(SuccOffsets[Idx], SuccOffsets[Idx + 1] - SuccOffsets[Idx]);
+  }
+  ArrayRef<unsigned> getPredecessorIndices(unsigned Idx) const {
+    assert(Frozen && "ProgramGraph is not frozen");
+    return ArrayRef<unsigned>(PredSources)
+        .slice(PredOffsets[Idx], PredOffsets[Idx + 1] - PredOffsets[Idx]);
+  }
+  /// Dense edge indices of the in-edges of \p Idx, parallel to
+  /// getPredecessorIndices(Idx).
+  ArrayRef<unsigned> getPredecessorEdges(unsigned Idx) const {
+    assert(Frozen && "ProgramGraph is not frozen");
+    return ArrayRef<unsigned>(PredEdges)
+        .slice(PredOffsets[Idx], PredOffsets[Idx + 1] - PredOffsets[Idx]);
+  }
+  unsigned getEdgeSource(unsigned Edge) const { return EdgeSources[Edge]; }
+  unsigned getEdgeTarget(unsigned Edge) const { return EdgeTargets[Edge]; }
+  bool isBackEdge(unsigned Edge) const { return EdgeIsBackEdge[Edge] != 0; }
+  /// Back-edge flags of the out-edges of \p Idx, parallel to
+  /// getSuccessorIndices(Idx).
+  ArrayRef<uint8_t> getSuccessorBackEdgeFlags(unsigned Idx) const {
+    assert(Frozen && "ProgramGraph is not frozen");
+    return ArrayRef<uint8_t>(EdgeIsBackEdge)
+        .slice(SuccOffsets[Idx], SuccOffsets[Idx + 1] - SuccOffsets[Idx]);
+  }
+
   bool isFree(unsigned Node) const;
 
   bool hasEdge(unsigned FromNode, unsigned ToNode) const;
 
   void dump() const;
 
-  friend std::ostream &operator<<(std::ostream &Stream, ProgramGraph Graph) {
+  friend std::ostream &operator<<(std::ostream &Stream,
+                                  const ProgramGraph &Graph) {
     for (const auto &Nd : Graph.getNodes()) {
       Stream << Nd.second;
     }
     return Stream;
   }
 
-  bool dump2Dot(StringRef FileName);
+  /// Graph export formats (see exportGraph()).
+  enum class ExportFormat { DOT, GraphML, JSONL };
+
+  /// The format implied by \p Path's extension (.graphml, .jsonl, anything
+  /// else DOT), ignoring a trailing ".zst".
+  static ExportFormat getExportFormatForPath(StringRef Path);
+
+  /**
+   * Stream the frozen graph to \p OS node by node: nodes grouped into one
+   * cluster per function (contiguous runs of getNodeFunction(), since a
+   * function's nodes have consecutive ids), then the edges with their
+   * back-edge flags. Nothing is collected into temporary containers.
+   */
+  void exportGraph(raw_ostream &OS, ExportFormat Format) const;
+
+  /// Write the graph to \p Path. A ".zst" suffix compresses the output as a
+  /// sequence of zstd frames (requires LLVM built with zstd). Returns false
+  /// and prints the reason if the file cannot be written.
+  bool exportGraph(StringRef Path, ExportFormat Format) const;
+
+  bool dump2Dot(StringRef FileName) const {
+    return exportGraph(FileName, ExportFormat::DOT);
+  }
 
   /**
    * Get a list of node IDs that exist in the graph but are not mapped to any
@@ -216,10 +348,19 @@ public:
    * supplies costs for body-less external calls
    * (RTTarget::getExternalCallCost); calls it cannot cost are recorded in
    * UnsoundExternalCallees.
+   *
+   * With \p ContextDepth > 0 every non-recursive callee is instantiated once
+   * per call string of up to that many call sites (longer strings keep their
+   * most recent sites), so costs and abstract states can differ per calling
+   * context. Functions in a recursive cycle keep a single shared instance.
+   * The instances are ContextInstances over the function's own body, which
+   * leaves the graph as their template, and the resulting call edges are
+   * listed in ContextCallSites.
    */
   bool finalize(MachineFunction &MF, MachineModuleInfo *MMI,
                 const llta::RTTarget *Target,
-                const std::map<std::string, unsigned> &RecursionBounds = {});
+                const std::map<std::string, unsigned> &RecursionBounds = {},
+                unsigned ContextDepth = 0);
 
   /// Names of self-recursive functions that were given a `recursion_bound` and
   /// thereby bounded (the callee entry was turned into a bounded loop header).
@@ -260,6 +401,16 @@ public:
    */
   std::map<const MachineBasicBlock *, unsigned> MBBToNodeMap;
 
+  /**
+   * The template node context instance node \p Id shares (\p Id itself for
+   * every other node).
+   */
+  unsigned getTemplateId(unsigned Id) const;
+
+  /// The function node \p Id belongs to, context instance nodes included;
+  /// null for the synthetic Entry/Exit nodes.
+  const Function *getNodeFunction(unsigned Id) const;
+
   /**
    * Map from Node id to its parent IR Function. Captured at insertion time
    * because the corresponding MachineBasicBlock may be freed before dump2Dot
@@ -268,6 +419,12 @@ public:
    */
   std::map<unsigned, const Function *> NodeToFunctionMap;
 
+  /**
+   * Interned names of the functions added to the graph, keyed like
+   * NodeToFunctionMap so dumps and diagnostics never touch freed MIR.
+   */
+  std::map<const Function *, StringRef> FunctionNames;
+
   /**
    * Whether a synthetic Entry node has been created (i.e. a start function was
    * seen). Used as the root for reachability pruning in finalize().
@@ -316,6 +473,50 @@ public:
    */
   std::vector<CallSite> CallSites;
 
+  /**
+   * Body node ids of each function added by fillGraphWithFunction:
+   * [first, end). A function's blocks get consecutive ids, so the range is
+   * the template that context instances are cloned from.
+   */
+  std::map<const Function *, std::pair<unsigned, unsigned>> FunctionNodeRanges;
+
+  /**
+   * One call edge of the context-expanded graph: the call node, the entry and
+   * return nodes of the callee instance it enters, and the landing it returns
+   * to. Filled by finalize() when ContextDepth > 0 (only for calls with a
+   * landing); consumers use it instead of resolving callees by Function.
+   */
+  struct ContextCallSite {
+    unsigned CallNode;
+    unsigned EntryNode;
+    std::vector<unsigned> ReturnNodes;
+    unsigned LandingNode;
+    const Function *Callee;
+  };
+  std::vector<ContextCallSite> ContextCallSites;
+
+  /**
+   * A function instance created by context expansion: the template body
+   * [First, End) of FunctionNodeRanges[F], shifted to the ids
+   * [Base, Base + End - First). Instance nodes have no Node record of their
+   * own. Their state, name, loop bounds and intra-function edges are the
+   * template's, stored once however many contexts use them; only the call
+   * and return edges of each instance are added. The frozen view lists
+   * instance nodes like any other node.
+   */
+  struct ContextInstance {
+    const Function *F;
+    unsigned First;
+    unsigned End;
+    unsigned Base;
+  };
+  /// Instances by ascending Base (the context-free instances are not listed).
+  std::vector<ContextInstance> ContextInstances;
+
+  /// Number of function instances created by context expansion (including
+  /// the original, context-free ones that were used).
+  unsigned NumContextInstances = 0;
+
   /**
    * Call sites to backend-synthesized libcalls (MO_ExternalSymbol, e.g.
    * __mspabi_*): caller node -> callee symbol name. These have no IR Function,
@@ -340,6 +541,69 @@ private:
    * A counter to give unique identifiers to each Node.
    */
   unsigned NextNodeId;
+
+  /**
+   * Call and return edges with a context instance node at either end, sorted
+   * (edges between two nodes with records are Node edges).
+   */
+  std::vector<std::pair<unsigned, unsigned>> ContextEdges;
+
+  /// Context instance nodes removed by reachability pruning.
+  std::set<unsigned> PrunedInstanceNodes;
+
+  /**
+   * The body nodes of context-expanded functions. Every use of such a
+   * function is an instance, so its own nodes leave the graph in finalize()
+   * and are kept here only as the instances' shared template.
+   */
+  std::map<unsigned, Node> TemplateNodes;
+
+  /// The instance \p Id belongs to, or null if \p Id has a Node record.
+  const ContextInstance *findInstance(unsigned Id) const;
+
+  /// The Node record of \p Id, or of the template node it shares.
+  const Node &getNodeOrTemplate(unsigned Id) const;
+
+  /// Append the successors of \p Id (instance nodes included) to \p Succs.
+  void appendSuccessors(unsigned Id, std::vector<unsigned> &Succs) const;
+
+  /// Reserve a context instance of \p F and return its base id.
+  unsigned addContextInstance(const Function *F);
+
+  /// Add a call or return edge wired by context expansion.
+  void addContextEdge(unsigned FromNode, unsigned ToNode);
+
+  /// Wire all call edges over call-string contexts of length <= \p Depth,
+  /// starting from the start function (see finalize()).
+  void expandCallContexts(unsigned Depth,
+                          const std::set<const Function *> &Recursive);
+
+  /**
+   * Owns every MuArchState and interned string of the graph. Held through a
+   * pointer so that moving a ProgramGraph keeps all StringRefs and state
+   * pointers valid (UniqueStringSaver refers to its allocator by address).
+   */
+  struct Arena {
+    SpecificBumpPtrAllocator<MuArchState> States;
+    BumpPtrAllocator StringAlloc;
+    UniqueStringSaver Strings{StringAlloc};
+  };
+  std::unique_ptr<Arena> Storage;
+
+  /// CSR snapshot built by freeze(). Node pointers stay valid because
+  /// std::map never relocates its elements; any builder mutation clears
+  /// Frozen so a stale snapshot is never read.
+  bool Frozen = false;
+  std::vector<const Node *> DenseNodes;
+  std::vector<unsigned> DenseIds;
+  std::vector<unsigned> IdToDense;
+  std::vector<unsigned> SuccOffsets;
+  std::vector<unsigned> PredOffsets;
+  std::vector<unsigned> EdgeSources;
+  std::vector<unsigned> EdgeTargets;
+  std::vector<uint8_t> EdgeIsBackEdge;
+  std::vector<unsigned> PredSources;
+  std::vector<unsigned> PredEdges;
 };
 
 } // end namespace llvm
@@ -2,15 +2,183 @@
 #define ABSTRACT_HIGHS_SOLVER_H
 
 #include "AbstractILPSolver.h"
+#include "IPETModel.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace llvm {
 
+class raw_ostream;
+
 class AbstractHighsSolver : public AbstractILPSolver {
 public:
-  AbstractHighsSolver();
+  /// How solveWCET() enforces integral execution counts.
+  enum class Mode {
+    /// Mark every column integer and run branch-and-bound directly.
+    MILP,
+    /// Write loop bounds in entry-edge form, solve the LP relaxation, and
+    /// return its optimum when it is integral; only fractional (or failed)
+    /// relaxations fall back to branch-and-bound.
+    LPFirst,
+  };
+
+  /// Largest distance from an integer at which an LP value still counts as
+  /// integral.
+  static constexpr double IntegralityTolerance = 1e-6;
+
+  /// Number of distinct portfolio configurations.
+  static constexpr unsigned MaxPortfolioSize = 6;
+
+  /**
+   * With \p PortfolioSize > 1, every solve runs that many differently
+   * configured HiGHS instances (presolve, simplex strategy, heuristics,
+   * random seed) on the same model in parallel; the first to prove
+   * optimality wins and interrupts the others. \p Threads sets HiGHS's thread
+   * count (0 = its default).
+   */
+  explicit AbstractHighsSolver(Mode SolveMode = Mode::LPFirst,
+                               unsigned PortfolioSize = 1,
+                               unsigned Threads = 0);
   ~AbstractHighsSolver() override;
 
   AbstractILPResult solveWCET(const AbstractStateGraph &ASG) override;
+
+  /// How loop bounds are written in \p M, i.e. the exact IPETModel a solve
+  /// in that mode builds.
+  static IPETModel::LoopRowForm getLoopRowForm(Mode M);
+
+  /**
+   * Stop each solve after \p Seconds (0 = no limit). If the optimum is not
+   * proven by then, the result is LimitReached and its WCET the MIP dual
+   * bound (in LPFirst mode, or the LP relaxation's optimum if that is
+   * tighter), so a deadline still yields a sound WCET.
+   */
+  void setTimeLimit(double Seconds) { TimeLimit = Seconds; }
+  /// Stop branch-and-bound once the relative gap falls below \p Gap (0 =
+  /// HiGHS's default), reporting the dual bound as the WCET as above.
+  void setRelativeGap(double Gap) { RelativeGap = Gap; }
+
+  unsigned getPortfolioSize() const { return PortfolioSize; }
+  unsigned getThreads() const { return Threads; }
+  double getTimeLimit() const { return TimeLimit; }
+  double getRelativeGap() const { return RelativeGap; }
+  /// Name of portfolio configuration \p Idx (0 is HiGHS's defaults).
+  static const char *getPortfolioConfigName(unsigned Idx);
+
+private:
+  Mode SolveMode;
+  unsigned PortfolioSize;
+  unsigned Threads;
+  double TimeLimit = 0.0;
+  double RelativeGap = 0.0;
+};
+
+/**
+ * How a WCET depends on the loop bounds and block costs of its graph
+ * (HighsIPETSession::analyzeSensitivity()).
+ */
+struct IPETSensitivity {
+  struct LoopBound {
+    unsigned Header;
+    unsigned Bound;
+    /// Times the loop is entered on the worst-case path.
+    double Entries;
+    /// WCET cycles added per unit of Bound, i.e. by one more iteration on
+    /// each entry.
+    double CyclesPerBound;
+  };
+  struct BlockCost {
+    unsigned Node;
+    unsigned Cost;
+    /// Execution count on the worst-case path: the WCET cycles per unit of
+    /// Cost.
+    double Count;
+    /// The worst-case path stays optimal while the cost lies in
+    /// [CostLower, CostUpper] (bounds may be infinite). Only set if Exact.
+    double CostLower;
+    double CostUpper;
+  };
+
+  /// Bounded loops, by header id.
+  std::vector<LoopBound> Loops;
+  /// Every node, by id.
+  std::vector<BlockCost> Blocks;
+  /// The LP relaxation's optimum is the worst-case path, edge for edge, so
+  /// loop marginals are its duals and cost ranges its ranging. Otherwise each
+  /// marginal comes from re-solving with the bound raised by one, and there
+  /// are no ranges.
+  bool Exact = false;
+  /// Solver status if the analysis failed; empty on success.
+  std::string Status;
+
+  /**
+   * Print the report on a WCET of \p WCET cycles: the loops by cycles per
+   * unit of bound, then the \p MaxBlocks blocks with the largest share of the
+   * WCET and, if Exact, their cost ranges. \p Label names a node.
+   */
+  void print(raw_ostream &OS, double WCET, unsigned MaxBlocks,
+             function_ref<std::string(unsigned)> Label) const;
+};
+
+/**
+ * A WCET ILP kept alive across solves, for what-if queries on one graph:
+ * change a block's cost or a loop bound, force the flow on an edge, or
+ * exclude a path found before to get the next-worst one. The HiGHS model is
+ * built once and the mutators edit it in place; each solve() is warm-started
+ * from the previous solve's basis (LP) and solution (MILP).
+ *
+ * Node ids are those of the graph the session was built from; the graph need
+ * not outlive the session.
+ */
+class HighsIPETSession {
+public:
+  explicit HighsIPETSession(
+      const AbstractStateGraph &ASG,
+      AbstractHighsSolver::Mode SolveMode = AbstractHighsSolver::Mode::LPFirst);
+  ~HighsIPETSession();
+
+  void setNodeCost(unsigned Node, unsigned Cost);
+  /// Change the bound of loop header \p Header (0 = unbounded). Returns false
+  /// if \p Header is not a loop header.
+  bool setLoopBound(unsigned Header, unsigned Bound);
+  /// Force the flow on edge (From, To) to \p Flow (0 removes the edge from
+  /// every path). Returns false if there is no such edge.
+  bool fixEdge(unsigned From, unsigned To, double Flow = 0.0);
+  /// Undo fixEdge().
+  bool releaseEdge(unsigned From, unsigned To);
+  /**
+   * Cut off \p Solved, a solution on this session's graph: every later one must
+   * put flow on at least one edge \p Solved leaves unused, i.e. take a path
+   * that differs from it in more than iteration counts. The next solve()
+   * then yields the next-worst such path. Cuts accumulate and cannot be
+   * undone. Returns false if \p Solved has no edge counts or uses every edge.
+   */
+  bool excludePath(const AbstractILPResult &Solved);
+
+  /**
+   * Loop-bound and block-cost sensitivity of \p Solved, the optimum on this
+   * session's graph. The LP relaxation is re-solved with the current bounds
+   * and costs; when its optimum is \p Solved itself (the same node and edge
+   * counts, not just the same WCET), a loop row's dual times the loop's
+   * entries gives the cycles per unit of bound, and cost ranging the interval
+   * each block cost can move in before another path becomes the worst. The
+   * dual is a first-order marginal: at a degenerate optimum it can lie
+   * anywhere between the cycles one iteration less saves and one more adds.
+   * When the relaxation is fractional or optimal at another path of equal
+   * WCET, each bound is raised by one and the model re-solved instead (then
+   * restored).
+   */
+  IPETSensitivity analyzeSensitivity(const AbstractILPResult &Solved);
+
+  AbstractILPResult solve();
+  unsigned getNumSolves() const { return NumSolves; }
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> P;
+  unsigned NumSolves = 0;
 };
 
 } // namespace llvm
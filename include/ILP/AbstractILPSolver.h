@@ -4,19 +4,41 @@
 #include "Analysis/AbstractStateGraph.h"
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace llvm {
 
 struct AbstractILPResult {
   double WCET;
-  std::vector<unsigned>
-      WorstCasePath; // Sequence of Node IDs (AbstractStateGraph Node IDs)
-  std::map<unsigned, double> ExecutionCounts;
+  // Execution count of every node, indexed by node id (0 for nodes that never
+  // execute). Empty when no solution was produced.
+  std::vector<double> ExecutionCounts;
+  // Flow on each edge (From, To) with a non-zero value; lets graph reductions
+  // recover the counts of nodes they replaced by an edge.
+  std::map<std::pair<unsigned, unsigned>, double> EdgeCounts;
   // Solver model status when no optimal solution was produced (e.g.
   // "Infeasible", "Unbounded"). Empty on success. Surfaced by PathAnalysisPass
   // to make a failed solve diagnosable instead of a silent WCET <= 0.
   std::string Status;
+  // The LP relaxation's optimum was already integral, so no branch-and-bound
+  // ran (AbstractHighsSolver::Mode::LPFirst).
+  bool LPRelaxationIntegral = false;
+  // Name of the portfolio configuration that produced the result
+  // (AbstractHighsSolver with a portfolio of more than one); empty otherwise.
+  std::string SolverConfig;
+  // A solver limit (time limit or relative gap) stopped the search before the
+  // optimum was proven. WCET is then the best dual bound rounded down to an
+  // integer: still a sound upper bound, only looser. Incumbent is the best
+  // path found (the reported counts are its counts; 0 and no counts if none)
+  // and Gap = (WCET - Incumbent) / WCET.
+  bool LimitReached = false;
+  double Incumbent = 0.0;
+  double Gap = 0.0;
+
+  double getExecutionCount(unsigned Id) const {
+    return Id < ExecutionCounts.size() ? ExecutionCounts[Id] : 0.0;
+  }
 };
 
 class AbstractILPSolver {
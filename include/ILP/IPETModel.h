@@ -0,0 +1,131 @@
+#ifndef IPET_MODEL_H
+#define IPET_MODEL_H
+
+#include "Analysis/AbstractStateGraph.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+class raw_ostream;
+
+/**
+ * The IPET integer program of an AbstractStateGraph, independent of the solver
+ * backend: maximize Sum(Cost_u * x_u) subject to flow conservation, x_entry =
+ * 1, one loop-bound row per bounded loop header and one call/return matching
+ * row per call site.
+ *
+ * Column U is node U's execution count. Edge flows follow, numbered in
+ * successor order, so node U's out-edges are the contiguous columns
+ * [getEdgeBegin(U), getEdgeEnd(U)), sorted by target. The constraint matrix is
+ * stored row-wise (CSR) in RowStart/RowIndex/RowValue.
+ */
+class IPETModel {
+public:
+  static constexpr unsigned None = ~0u;
+  static constexpr double Infinity = std::numeric_limits<double>::infinity();
+
+  /// How loop bounds are written.
+  enum class LoopRowForm {
+    /// (Bound - 1) * x_h - Bound * Sum(BackEdges) >= 0
+    HeaderCount,
+    /// Sum(BackEdges) - (Bound - 1) * Sum(EntryEdges) <= 0. Given flow
+    /// conservation it admits exactly the flows of HeaderCount but only
+    /// touches edge columns, so the LP relaxation is integral far more often.
+    /// A header that is also the graph entry has no entry edges and keeps the
+    /// HeaderCount row.
+    EntryEdge,
+  };
+
+  /// With \p KeepUnboundedLoopRows, loop headers without a bound (0) also get
+  /// a loop row, left free, so setting a bound later only edits that row.
+  IPETModel(const AbstractStateGraph &ASG, LoopRowForm Form,
+            bool KeepUnboundedLoopRows = false);
+
+  unsigned getNumNodes() const { return NumNodes; }
+  unsigned getNumCols() const { return ColCost.size(); }
+  unsigned getNumRows() const { return RowLower.size(); }
+  unsigned getNumNonzeros() const { return RowIndex.size(); }
+
+  unsigned getEdgeBegin(unsigned U) const { return EdgeBegin[U]; }
+  unsigned getEdgeEnd(unsigned U) const { return EdgeBegin[U + 1]; }
+  unsigned getEdgeTarget(unsigned Col) const {
+    return EdgeTarget[Col - NumNodes];
+  }
+  bool isBackEdge(unsigned Col) const { return EdgeIsBack[Col - NumNodes]; }
+  /// Column of edge (From, To), or None if the graph has no such edge.
+  unsigned getEdgeColumn(unsigned From, unsigned To) const;
+  /// Columns of the edges entering \p U, ordered by source.
+  ArrayRef<unsigned> getInEdgeColumns(unsigned U) const {
+    return ArrayRef<unsigned>(InEdges).slice(InBegin[U],
+                                             InBegin[U + 1] - InBegin[U]);
+  }
+
+  /// Row holding \p Header's loop bound, or None.
+  unsigned getLoopRow(unsigned Header) const { return LoopRow[Header]; }
+  /// The (column, coefficient) entries and the bounds of \p Header's loop row
+  /// for \p Bound (0 = unbounded: a free row).
+  void buildLoopRow(unsigned Header, unsigned Bound,
+                    SmallVectorImpl<std::pair<unsigned, double>> &Entries,
+                    double &Lower, double &Upper) const;
+  /// Rewrite \p Header's loop row in place for \p Bound: the row keeps its
+  /// entries, only their coefficients and the row bounds change. Returns
+  /// false if \p Header has no loop row.
+  bool setLoopBound(unsigned Header, unsigned Bound);
+
+  /// Append a row Lower <= Sum(Coef * x_Col) <= Upper over \p Entries
+  /// (column, coefficient) and return its index.
+  unsigned addRow(ArrayRef<std::pair<unsigned, double>> Entries, double Lower,
+                  double Upper);
+
+  /// Model file formats (see exportModel()).
+  enum class ExportFormat { MPS, LP };
+
+  /// The format implied by \p Path's extension (.lp, anything else MPS).
+  static ExportFormat getExportFormatForPath(StringRef Path);
+
+  /**
+   * Write the model as the integer program it stands for (every column
+   * integer), maximizing. Columns are named after the graph: n<U> for node
+   * U's count, f<U>_<V> for the flow on edge (U, V); rows are r<R>. Free rows
+   * are left out of the LP format and written as extra N rows in MPS, which
+   * readers ignore.
+   */
+  void exportModel(raw_ostream &OS, ExportFormat Format) const;
+
+  /// Write the model to \p Path. Returns false (after reporting to errs())
+  /// if the file cannot be written.
+  bool exportModel(StringRef Path, ExportFormat Format) const;
+
+  /// Objective and column bounds.
+  std::vector<double> ColCost, ColLower, ColUpper;
+  /// Row bounds and the row-wise matrix: row R's entries are
+  /// RowIndex/RowValue[RowStart[R] .. RowStart[R + 1]).
+  std::vector<double> RowLower, RowUpper;
+  std::vector<unsigned> RowStart, RowIndex;
+  std::vector<double> RowValue;
+
+private:
+  std::string getColumnName(unsigned Col) const;
+  void exportMPS(raw_ostream &OS) const;
+  void exportLP(raw_ostream &OS) const;
+
+  LoopRowForm Form;
+  unsigned NumNodes;
+  std::vector<unsigned> EdgeBegin;
+  std::vector<unsigned> EdgeTarget;
+  std::vector<uint8_t> EdgeIsBack;
+  std::vector<unsigned> InBegin;
+  std::vector<unsigned> InEdges;
+  std::vector<uint8_t> IsEntry;
+  std::vector<unsigned> LoopRow;
+};
+
+} // namespace llvm
+
+#endif // IPET_MODEL_H
@@ -0,0 +1,88 @@
+#ifndef IPET_REDUCTION_H
+#define IPET_REDUCTION_H
+
+#include "AbstractILPSolver.h"
+#include "Analysis/AbstractStateGraph.h"
+#include <vector>
+
+namespace llvm {
+
+/**
+ * Shrinks an AbstractStateGraph before it is handed to an IPET solver, without
+ * changing the optimum:
+ *
+ *  - Chain collapsing: an edge u->v where u has v as its only successor and v
+ *    has u as its only predecessor forces x_u == x_v, so v is merged into u and
+ *    the merged node carries the summed cost.
+ *  - Zero-cost elimination: a node with cost 0 and exactly one in- and one
+ *    out-edge (p->v->s) contributes nothing to the objective; it is replaced by
+ *    a bypass edge p->s whose flow equals x_v.
+ *
+ * Loop headers, back edges, entry/exit nodes and every edge referenced by the
+ * call/return matching rows (call edges and return edges) are kept intact, so
+ * the reduced model has the same constraints on what remains. expand() maps a
+ * solution of the reduced graph back to the original node and edge ids.
+ */
+class IPETReduction {
+public:
+  explicit IPETReduction(const AbstractStateGraph &ASG);
+
+  /// The graph to solve. Its node ids are unrelated to the original ids.
+  const AbstractStateGraph &getReducedGraph() const { return Reduced; }
+
+  /// Maps a result computed on getReducedGraph() back to the original graph:
+  /// ExecutionCounts is indexed and EdgeCounts keyed by original ids. WCET,
+  /// Status and LPRelaxationIntegral are copied unchanged.
+  AbstractILPResult expand(const AbstractILPResult &ReducedResult) const;
+
+  unsigned getNumOriginalNodes() const { return NumOriginalNodes; }
+  unsigned getNumOriginalEdges() const { return NumOriginalEdges; }
+  unsigned getNumReducedNodes() const { return Reduced.getNodes().size(); }
+  unsigned getNumReducedEdges() const { return NumReducedEdges; }
+
+private:
+  static constexpr unsigned None = ~0u;
+
+  /// Where a removed node's count or a removed edge's flow can be read from.
+  enum class SourceKind { Self, NodeCount, EdgeFlow };
+  struct Source {
+    SourceKind Kind = SourceKind::Self;
+    unsigned Ref = None;
+  };
+
+  /// Working edge; OrigFrom/OrigTo are None for the bypass edges created by
+  /// zero-cost elimination.
+  struct WorkEdge {
+    unsigned OrigFrom;
+    unsigned OrigTo;
+    unsigned From;
+    unsigned To;
+    bool IsBackEdge;
+    bool Pinned;
+    bool Alive = true;
+    Source Flow;
+  };
+
+  /// Original node id -> dense slot and back.
+  std::vector<unsigned> OrigIds;
+  std::vector<unsigned> SlotOfOrig;
+  unsigned slotOf(unsigned OrigId) const {
+    return OrigId < SlotOfOrig.size() ? SlotOfOrig[OrigId] : None;
+  }
+
+  std::vector<WorkEdge> Edges;
+  /// Per slot: how the node's count is recovered once it is no longer a node
+  /// of its own.
+  std::vector<Source> NodeFlow;
+  /// Alive slot -> node id in Reduced.
+  std::vector<unsigned> SlotToReduced;
+
+  AbstractStateGraph Reduced;
+  unsigned NumOriginalNodes = 0;
+  unsigned NumOriginalEdges = 0;
+  unsigned NumReducedEdges = 0;
+};
+
+} // namespace llvm
+
+#endif // IPET_REDUCTION_H
@@ -0,0 +1,108 @@
+#ifndef LOOP_REGION_IPET_H
+#define LOOP_REGION_IPET_H
+
+#include "AbstractILPSolver.h"
+#include "Analysis/AbstractStateGraph.h"
+#include "ILP/ModularIPET.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <vector>
+
+namespace llvm {
+
+/**
+ * Hierarchical contraction of loop regions ahead of the global IPET solve.
+ *
+ * An innermost loop that is a single-entry/single-exit region of the graph
+ * (entered only at its header, left only towards one node, no calls, returns
+ * or callee entries inside, a positive bound) is solved on its own: from a
+ * synthetic entry into the header to a synthetic exit behind its exit edges,
+ * with its own loop bound. Its WCET per entry is then charged to one summary
+ * node that replaces the whole loop. The loop rows bound back-edge flow per
+ * entry, so the loop's counts scale with its entries and the WCET equals the
+ * monolithic optimum.
+ *
+ * Contraction repeats on the contracted graph: once its inner loops are
+ * summary nodes, an outer loop becomes innermost. Every round is a level;
+ * the regions of one level are disjoint and are solved in parallel. Whatever
+ * is left (the program around the outermost contracted loops, and every loop
+ * that does not qualify) is the top-level graph.
+ */
+class LoopRegionIPET {
+public:
+  using SolveFn = ModularIPET::SolveFn;
+
+  explicit LoopRegionIPET(const AbstractStateGraph &ASG);
+
+  /// Number of loops solved as separate sub-ILPs.
+  unsigned getNumRegions() const { return NumRegions; }
+  /// Number of contraction rounds (innermost loops are level 0).
+  unsigned getNumLevels() const { return Levels.size() - 1; }
+  /// Nodes of the top-level graph, summary nodes included.
+  unsigned getNumTopNodes() const {
+    return Levels.back().Graph.getNumNodes();
+  }
+
+  /**
+   * Solve every region level by level with \p Solve, on up to \p Threads
+   * threads (0 = all hardware threads), then the top-level graph. Execution
+   * and edge counts are mapped back to the original graph. Failures and
+   * solver limits are reported as by ModularIPET::solve().
+   */
+  AbstractILPResult solve(const SolveFn &Solve, unsigned Threads = 0) const;
+
+private:
+  static constexpr unsigned None = ~0u;
+
+  struct Region {
+    unsigned Header;
+    /// Member nodes in ascending id order (header included).
+    std::vector<unsigned> Body;
+    /// The one node outside the loop that its exit edges lead to.
+    unsigned Target;
+    /// The summary node in the next level's graph.
+    unsigned Summary = None;
+  };
+
+  struct Level {
+    /// Structure only: summary nodes cost 0 until solve() knows their WCET.
+    AbstractStateGraph Graph;
+    std::vector<Region> Regions;
+    /// Number of regions on the levels below: Regions[R] is region
+    /// FirstRegion + R of the whole hierarchy.
+    unsigned FirstRegion = 0;
+    /// Per node: the region it belongs to, or None.
+    std::vector<unsigned> RegionOf;
+    /// Per node: its id in the next level's graph (its summary's for region
+    /// members).
+    std::vector<unsigned> NextId;
+    /// Per node: the region (hierarchy-wide index) it summarises, or None.
+    /// A summary no region of its level contains is carried up unchanged.
+    std::vector<unsigned> SummaryOf;
+    /// Per node: its id in the previous level's graph (the header for a
+    /// summary node).
+    std::vector<unsigned> PrevId;
+  };
+
+  const AbstractStateGraph &ASG;
+  /// Levels[0] is a copy of the input graph, the last level the top-level
+  /// graph (without regions).
+  std::vector<Level> Levels;
+  unsigned NumRegions = 0;
+
+  static void findRegions(Level &Lv);
+  /// The graph of the next level: every region of \p Lv replaced by its
+  /// summary node. Fills in \p Lv's NextId and the regions' Summary.
+  static Level contract(Level &Lv);
+  /// Copy node \p V of \p Lv into \p G without its edges or entry/exit
+  /// flags; a summary node costs its region's WCET from \p SummaryWCET,
+  /// indexed hierarchy-wide.
+  static unsigned copyNode(AbstractStateGraph &G, const Level &Lv, unsigned V,
+                           ArrayRef<double> SummaryWCET);
+  AbstractStateGraph buildRegion(unsigned L, unsigned R,
+                                 ArrayRef<double> SummaryWCET) const;
+  AbstractStateGraph buildTop(ArrayRef<double> SummaryWCET) const;
+};
+
+} // namespace llvm
+
+#endif // LOOP_REGION_IPET_H
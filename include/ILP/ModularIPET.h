@@ -0,0 +1,119 @@
+#ifndef MODULAR_IPET_H
+#define MODULAR_IPET_H
+
+#include "AbstractILPSolver.h"
+#include "Analysis/AbstractStateGraph.h"
+#include "llvm/ADT/DenseMap.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace llvm {
+
+/**
+ * Bottom-up compositional IPET. Every callee instance (a function, or one of
+ * its contexts under -context-depth) that forms a closed single-entry region
+ * of the graph is solved once as its own ILP: from a synthetic entry into its
+ * entry node to a synthetic exit behind its return nodes, with its own loop
+ * bounds. Its WCET is then charged to the call node of every call site that
+ * enters it, and the call/return edges are replaced by the call node's
+ * existing edge to its landing block. Callees on the same call-graph level
+ * are independent and are solved in parallel.
+ *
+ * What cannot be composed stays in one residual graph that is solved
+ * monolithically: the start function and the synthetic Entry/Exit, recursive
+ * SCCs (a cycle in the instance call graph), callers of those, and any region
+ * that is entered or left other than through its call sites (e.g. a callee
+ * with an exit sink or no return). The WCET equals the monolithic optimum,
+ * since each call of a summarised callee contributes exactly its per-call
+ * optimum.
+ */
+class ModularIPET {
+public:
+  /// Solves one (sub-)graph. Called concurrently from several threads.
+  using SolveFn = std::function<AbstractILPResult(const AbstractStateGraph &)>;
+
+  /// Status when a solver limit stopped a (sub-)ILP before it found a path:
+  /// its bound alone cannot be mapped back onto the graph.
+  static constexpr const char *NoIncumbent = "Limit reached without a solution";
+
+  explicit ModularIPET(const AbstractStateGraph &ASG);
+
+  /// Number of callee instances solved as separate sub-ILPs.
+  unsigned getNumModules() const { return NumModules; }
+  /// Number of call-graph levels among them (leaves are level 0).
+  unsigned getNumLevels() const { return NumLevels; }
+  /// Nodes left in the monolithically solved residual graph.
+  unsigned getNumResidualNodes() const { return NumResidualNodes; }
+  /// Call sites left in the residual graph (not replaced by a summary).
+  unsigned getNumResidualCallSites() const { return NumResidualCallSites; }
+
+  /**
+   * Solve every module level by level with \p Solve, on up to \p Threads
+   * threads (0 = all hardware threads), then the residual graph. Execution
+   * and edge counts are mapped back to the original graph. If any sub-ILP
+   * fails, its Status is returned with no WCET. If any hit a solver limit,
+   * the result is LimitReached: the WCET sums dual bounds, the incumbent is
+   * the cost of the mapped-back path.
+   */
+  AbstractILPResult solve(const SolveFn &Solve, unsigned Threads = 0) const;
+
+private:
+  static constexpr unsigned None = ~0u;
+  static constexpr unsigned Several = ~1u;
+
+  struct Instance {
+    unsigned Entry;
+    std::vector<unsigned> Returns;
+    /// Member nodes in ascending id order (entry and returns included).
+    std::vector<unsigned> Body;
+    /// Call sites (indices into ASG.CallSites) whose call node is in Body.
+    std::vector<unsigned> InnerSites;
+    /// Call sites entering this instance.
+    std::vector<unsigned> Callers;
+    bool Composable = true;
+    unsigned Level = None;
+  };
+
+  const AbstractStateGraph &ASG;
+  std::vector<Instance> Instances;
+  DenseMap<unsigned, unsigned> InstanceOfEntry;
+  /// Per node: the composable instance it belongs to, or None (residual).
+  std::vector<unsigned> Owner;
+  /// Per call site: its callee instance, or None if unresolved.
+  std::vector<unsigned> SiteInstance;
+  /// Per call site: whether its call/return edges can be replaced by the
+  /// call node's edge to the landing (one site on the call node, no other
+  /// successors, the callee returns).
+  std::vector<bool> SiteContractible;
+  /// Per node: the call site it makes, None, or Several.
+  std::vector<unsigned> SiteAtNode;
+  /// Composable instances per level.
+  std::vector<std::vector<unsigned>> Levels;
+  unsigned NumModules = 0;
+  unsigned NumLevels = 0;
+  unsigned NumResidualNodes = 0;
+  unsigned NumResidualCallSites = 0;
+
+  void collectInstances();
+  bool collectBody(unsigned Idx, std::vector<unsigned> &Mark);
+  void assignLevels();
+  bool isContracted(unsigned Site) const {
+    return SiteContractible[Site] && SiteInstance[Site] != None &&
+           Instances[SiteInstance[Site]].Composable;
+  }
+  bool isReturnOf(const Instance &I, unsigned Id) const {
+    return std::binary_search(I.Returns.begin(), I.Returns.end(), Id);
+  }
+  /// Copy node \p Id into \p G without its state, flags or edges; a
+  /// contracted call node additionally costs its callee's WCET.
+  unsigned copyNode(AbstractStateGraph &G, unsigned Id,
+                    ArrayRef<double> WCET) const;
+  AbstractStateGraph buildModule(unsigned Idx, ArrayRef<double> WCET) const;
+  /// Edge \p From -> \p To of the original graph, if present.
+  bool hasEdge(unsigned From, unsigned To, bool *IsBack = nullptr) const;
+};
+
+} // namespace llvm
+
+#endif // MODULAR_IPET_H
@@ -0,0 +1,66 @@
+#ifndef TIMING_SCHEMA_SOLVER_H
+#define TIMING_SCHEMA_SOLVER_H
+
+#include "AbstractILPSolver.h"
+#include <atomic>
+#include <memory>
+
+namespace llvm {
+
+/**
+ * Tree-based WCET engine for structured graphs: no ILP, linear in the graph
+ * size for a fixed loop depth. Over the loop-nesting forest, innermost loops
+ * first, each loop body is a DAG (back edges removed, inner loops collapsed to
+ * their header) whose longest paths give one iteration (header to a back
+ * edge) and one final pass per loop exit; a loop of bound B costs (B - 1)
+ * iterations plus its final pass to the chosen exit. This is the IPET optimum
+ * whenever the graph qualifies:
+ *  - a single entry, exit nodes without successors;
+ *  - every back edge enters a bounded loop header that is not the entry, and
+ *    the graph without back edges is acyclic;
+ *  - natural loops are entered only through their header (reducible);
+ *  - call sites are all summarised by ModularIPET (no recursion, callees are
+ *    closed regions), each callee then solved the same way.
+ *
+ * Any other graph is handed to the fallback solver, if one was given.
+ */
+class TimingSchemaSolver : public AbstractILPSolver {
+public:
+  /// AbstractILPResult::SolverConfig of results computed by the schema.
+  static constexpr const char *ConfigName = "timing-schema";
+  /// AbstractILPResult::Status when the graph does not qualify and there is
+  /// no fallback.
+  static constexpr const char *NotStructured = "Not structured";
+
+  /**
+   * \p Fallback (may be null) solves graphs the schema does not apply to.
+   * With \p CrossCheck, every schema result is also solved by \p Fallback;
+   * on a mismatch a warning is printed and the fallback's result returned.
+   */
+  explicit TimingSchemaSolver(std::unique_ptr<AbstractILPSolver> Fallback,
+                              bool CrossCheck = false);
+  ~TimingSchemaSolver() override;
+
+  AbstractILPResult solveWCET(const AbstractStateGraph &ASG) override;
+
+  /// The schema alone on a graph without call sites. Returns false (leaving
+  /// \p Result unspecified) if the graph does not qualify.
+  static bool solveStructured(const AbstractStateGraph &ASG,
+                              AbstractILPResult &Result);
+
+  unsigned getNumFallbacks() const { return NumFallbacks; }
+  unsigned getNumCrossChecks() const { return NumCrossChecks; }
+  unsigned getNumMismatches() const { return NumMismatches; }
+
+private:
+  std::unique_ptr<AbstractILPSolver> Fallback;
+  bool CrossCheck;
+  // solveWCET may run concurrently (ModularIPET).
+  std::atomic<unsigned> NumFallbacks{0};
+  std::atomic<unsigned> NumCrossChecks{0};
+  std::atomic<unsigned> NumMismatches{0};
+};
+
+} // namespace llvm
+
+#endif // TIMING_SCHEMA_SOLVER_H
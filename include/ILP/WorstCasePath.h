@@ -0,0 +1,93 @@
+#ifndef WORST_CASE_PATH_H
+#define WORST_CASE_PATH_H
+
+#include "AbstractILPSolver.h"
+#include "Analysis/AbstractStateGraph.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class raw_ostream;
+
+/**
+ * The worst-case path behind an IPET solution, as an ordered node sequence.
+ *
+ * A solution only fixes how often each edge is taken. With x_entry = 1 the
+ * edge flows form one entry-to-exit walk plus the cycles (loop iterations)
+ * hanging off it, so an Euler trail of the flow multigraph (Hierholzer) is a
+ * path through the program that takes every edge exactly as often as the
+ * solution does. Where the trail has a choice, it follows the program's
+ * structure:
+ *
+ *  - a loop's iterations are spread evenly over its entries (back-edge flow
+ *    divided by entry-edge flow), and the loop is left once they are used
+ *    up, so an inner loop runs per outer iteration rather than all at once;
+ *  - a return edge goes back to the call site the walk came from, as long as
+ *    that edge still has flow.
+ *
+ * The path is kept as counted segments, never spelled out: when the walk
+ * closes a loop iteration, it takes the same iteration again as often as the
+ * loop's share and the edge flows allow, in one step, and records that as a
+ * counted segment. Walking a loop thus costs one pass per distinct iteration
+ * shape, not one per iteration. What repeats beyond that is folded as by
+ * compress().
+ */
+class WorstCasePath {
+public:
+  /// One step of a compressed path: a node, or (Body non-empty) a sub-path
+  /// taken Repeat times in a row.
+  struct Segment {
+    unsigned Node = ~0u;
+    std::vector<Segment> Body;
+    unsigned long long Repeat = 1;
+  };
+
+  /// Rebuild the path from \p Result's EdgeCounts; ids are \p ASG's, which
+  /// must be the graph the counts refer to and outlive this object. The path
+  /// is empty if \p Result has no solution (or \p ASG no entry).
+  WorstCasePath(const AbstractStateGraph &ASG, const AbstractILPResult &Result);
+
+  /// The path from the entry to an exit node, loop iterations folded.
+  ArrayRef<Segment> getSegments() const { return Segments; }
+  /// Blocks on the path, repetitions included.
+  unsigned long long getLength() const { return Length; }
+  /// The path as node ids, every repetition spelled out (getLength() ids):
+  /// only for paths known to be short.
+  std::vector<unsigned> expand() const;
+  /// Edge flow the trail could not reach from the entry (cycles disconnected
+  /// from the path, which a solution with all loop bounds in place has not);
+  /// 0 if the path accounts for every count.
+  unsigned long long getUncoveredFlow() const { return UncoveredFlow; }
+
+  /// \p Path with every run of two or more consecutive copies of a
+  /// sub-sequence folded into one Segment, innermost first, so nested loops
+  /// come out as nested segments.
+  static std::vector<Segment> compress(ArrayRef<unsigned> Path);
+
+  /// Sum of the node costs along \p S, repetitions included.
+  unsigned long long getCost(const Segment &S) const;
+
+  /**
+   * Print the compressed path, one node per line with its cost, loop
+   * iterations as "<N> x (<C> cycles each)" followed by their body, indented
+   * by two more spaces per nesting level. \p Label names a node.
+   */
+  void print(raw_ostream &OS, function_ref<std::string(unsigned)> Label,
+             unsigned Indent = 2) const;
+
+private:
+  void print(raw_ostream &OS, ArrayRef<Segment> Segments,
+             function_ref<std::string(unsigned)> Label, unsigned Indent) const;
+
+  const AbstractStateGraph &ASG;
+  std::vector<Segment> Segments;
+  unsigned long long Length = 0;
+  unsigned long long UncoveredFlow = 0;
+};
+
+} // namespace llvm
+
+#endif // WORST_CASE_PATH_H
@@ -3,6 +3,7 @@
 
 #include "Graph/ProgramGraph.h"
 #include "TimingAnalysisResults.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 
@@ -16,11 +17,28 @@ public:
   Function *StartingFunction = nullptr;
   CallGraph *CG = nullptr;
 
+  /// Functions reachable from the start function over direct calls, computed
+  /// once on the first runOnMachineFunction. Functions outside it are never
+  /// added to the ProgramGraph (finalize() would prune them anyway). Empty
+  /// with ReachableComputed set means no start function was found and every
+  /// function is built, as before.
+  DenseSet<const Function *> ReachableFunctions;
+  bool ReachableComputed = false;
+
+  /// Last function with a body in module order; finalize() runs after it.
+  const Function *LastDefinedFunction = nullptr;
+
   FillMuGraphPass(TimingAnalysisResults &TAR);
 
   bool runOnMachineFunction(MachineFunction &F) override;
   void getAnalysisUsage(AnalysisUsage &AU) const override;
   Function *getStartingFunction(CallGraph &CG);
+
+private:
+  void computeReachableFunctions(const Module &M);
+  void fillFunction(MachineFunction &F);
+  /// Export the finalized graph as requested by -dump-graph.
+  void dumpGraph() const;
 };
 
 MachineFunctionPass *createFillMuGraphPass(TimingAnalysisResults &TAR);
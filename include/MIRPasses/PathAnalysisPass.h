@@ -12,7 +12,6 @@
 #include "llvm/Target/TargetMachine.h"
 
 #include "Analysis/AbstractStateGraph.h"
-#include "Analysis/GraphAdapter.h"
 #include "Analysis/WorklistSolver.h"
 #include "ILP/AbstractILPSolver.h"
 
@@ -61,4 +60,12 @@ public:
 
 namespace llvm {
 MachineFunctionPass *createPathAnalysisPass(TimingAnalysisResults &TAR);
+
+/// Solve the WCET ILP on \p Graph and print the WCET (or the failure) plus the
+/// reasons the bound may be unsound. Used by PathAnalysisPass and by the
+/// `-load-graph` path, which has no module to analyze. Returns true if a WCET
+/// was computed.
+bool solveAndReportWCET(const AbstractStateGraph &Graph,
+                        const std::set<std::string> &Reasons,
+                        const std::set<std::string> &Callees);
 } // namespace llvm
@@ -1,31 +1,258 @@
 #ifndef LLTA_SOLVER_WORKLISTSOLVER_H
 #define LLTA_SOLVER_WORKLISTSOLVER_H
 
+#include "Analysis/AbstractStateGraph.h"
+#include "Analysis/FixpointStats.h"
+#include "Analysis/WorklistSolver.h"
+
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/CodeGen/MachineFunction.h"
+
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
 
 namespace llta {
 
-template <typename AnalysisDomain> class WorklistSolver {
-  AnalysisDomain &Domain;
-  using StateType = typename AnalysisDomain::StateType; // Expected from Domain
+/**
+ * Statically dispatched worklist fixpoint engine.
+ *
+ * The counterpart of llvm::WorklistSolver for analyses written against a
+ * compile-time domain instead of AbstractAnalysable/AbstractState: states are
+ * plain values stored per block, and join, equals and the block transfer are
+ * direct calls the compiler can inline. AnalysisDomain provides
+ *
+ *   using StateType = ...;                        // a copyable value
+ *   StateType getInitialState();                  // the cold state
+ *   bool join(StateType &Into, const StateType &Other); // true if changed
+ *   bool equals(const StateType &A, const StateType &B);
+ *   unsigned transfer(StateType &S, BlockRef B);  // whole block; its cost
+ *
+ * and optionally unsigned size(const StateType &S) for the state sizes of
+ * FixpointStats (see AbstractState::getSize()),
+ * where BlockRef is GraphTraits<GraphT>::NodeRef (const MachineBasicBlock *
+ * for machine functions). The iteration is the one llvm::WorklistSolver::run
+ * does on a machine function: every block starts from the initial state, a
+ * block's in-state is the join of its predecessors' out-states (the initial
+ * state without predecessors), and only the entry is seeded, so both engines
+ * reach the same states and block costs.
+ */
+template <typename AnalysisDomain,
+          typename GraphT = const llvm::MachineFunction *>
+class WorklistSolver {
+  template <typename D>
+  using HasSize = decltype(std::declval<D &>().size(
+      std::declval<const typename D::StateType &>()));
 
-  llvm::DenseMap<const llvm::MachineBasicBlock *, StateType> BlockStates;
-  llvm::SmallVector<llvm::MachineBasicBlock *, 32> Worklist;
+  using GT = llvm::GraphTraits<GraphT>;
 
 public:
-  WorklistSolver(AnalysisDomain &D) : Domain(D) {}
+  using StateType = typename AnalysisDomain::StateType;
+  using BlockRef = typename GT::NodeRef;
+  using Order = llvm::WorklistSolver::Order;
+
+  explicit WorklistSolver(AnalysisDomain &D) : Domain(D) {}
+
+  void setOrder(Order O) { Schedule = O; }
+  Order getOrder() const { return Schedule; }
+
+  /// Compute the fixpoint over \p G, replacing the results of an earlier run.
+  void solve(GraphT G);
+
+  unsigned getNumBlocks() const { return Blocks.size(); }
+  /// The converged out-state of \p B.
+  const StateType &getState(BlockRef B) const { return States[indexOf(B)]; }
+  /// The converged in-state of \p B: its predecessors' out-states joined.
+  StateType getInState(BlockRef B) const {
+    return joinPredecessors(indexOf(B));
+  }
+  /// The cost of \p B's last transfer (0 if it was never reached).
+  unsigned getCost(BlockRef B) const { return Costs[indexOf(B)]; }
+
+  /// Blocks processed by the last run, and how many of those changed state.
+  unsigned getNumVisits() const { return NumVisits; }
+  unsigned getNumUpdates() const { return NumUpdates; }
+  /// Joins, block transfers and state copies of the last run.
+  unsigned getNumJoins() const { return NumJoins; }
+  unsigned getNumTransfers() const { return NumTransfers; }
+  unsigned getNumClones() const { return NumClones; }
+
+  /// Record every following run in \p S (nullptr: stop recording). Node ids
+  /// in \p S are positions in the graph's node order; the caller names them.
+  void setStats(llvm::FixpointStats *S) { Stats = S; }
+
+private:
+  AnalysisDomain &Domain;
+  Order Schedule = Order::FIFO;
+  /// Blocks in graph order; everything below is indexed by position here.
+  std::vector<BlockRef> Blocks;
+  llvm::DenseMap<BlockRef, unsigned> Index;
+  std::vector<llvm::SmallVector<unsigned, 2>> Preds, Succs;
+  std::vector<StateType> States;
+  std::vector<unsigned> Costs;
+  std::deque<unsigned> Worklist;
+  std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>>
+      Pending;
+  std::vector<unsigned> Position, BlockAt;
+  llvm::BitVector InWorklist;
+  unsigned NumVisits = 0;
+  unsigned NumUpdates = 0;
+  unsigned NumJoins = 0;
+  unsigned NumTransfers = 0;
+  unsigned NumClones = 0;
+  llvm::FixpointStats *Stats = nullptr;
 
-  void solve(llvm::MachineFunction &MF);
+  unsigned indexOf(BlockRef B) const {
+    auto It = Index.find(B);
+    assert(It != Index.end() && "block not in the solved graph");
+    return It->second;
+  }
+  void build(GraphT G);
+  StateType joinPredecessors(unsigned V) const;
+  void push(unsigned V);
+  unsigned pop();
 };
 
-// Implementation included in header for templates
-template <typename AnalysisDomain>
-void WorklistSolver<AnalysisDomain>::solve(llvm::MachineFunction &MF) {
-  // ... (Standard worklist algorithm as discussed previously) ...
+template <typename AnalysisDomain, typename GraphT>
+void WorklistSolver<AnalysisDomain, GraphT>::build(GraphT G) {
+  Blocks.clear();
+  Index.clear();
+  for (auto It = GT::nodes_begin(G), E = GT::nodes_end(G); It != E; ++It) {
+    Index[*It] = Blocks.size();
+    Blocks.push_back(*It);
+  }
+  const unsigned N = Blocks.size();
+  Preds.assign(N, {});
+  Succs.assign(N, {});
+  for (unsigned V = 0; V < N; ++V)
+    for (auto It = GT::child_begin(Blocks[V]), E = GT::child_end(Blocks[V]);
+         It != E; ++It) {
+      unsigned W = Index.lookup(*It);
+      if (llvm::is_contained(Succs[V], W))
+        continue;
+      Succs[V].push_back(W);
+      Preds[W].push_back(V);
+    }
+
+  if (Schedule != Order::WTO)
+    return;
+  // The same weak topological order llvm::WorklistSolver uses, computed on a
+  // bare copy of the block graph.
+  llvm::AbstractStateGraph Shape;
+  for (unsigned V = 0; V < N; ++V)
+    Shape.addNode(nullptr);
+  if (N)
+    Shape.getNode(Index.lookup(GT::getEntryNode(G)))->IsEntry = true;
+  for (unsigned V = 0; V < N; ++V)
+    for (unsigned W : Succs[V])
+      Shape.addEdge(V, W);
+  BlockAt = llvm::WorklistSolver::getWeakTopologicalOrder(Shape);
+  Position.assign(N, 0);
+  for (unsigned P = 0; P < N; ++P)
+    Position[BlockAt[P]] = P;
+}
+
+template <typename AnalysisDomain, typename GraphT>
+typename WorklistSolver<AnalysisDomain, GraphT>::StateType
+WorklistSolver<AnalysisDomain, GraphT>::joinPredecessors(unsigned V) const {
+  if (Preds[V].empty())
+    return Domain.getInitialState();
+  StateType In = States[Preds[V].front()];
+  for (unsigned P : llvm::drop_begin(Preds[V]))
+    Domain.join(In, States[P]);
+  return In;
+}
+
+template <typename AnalysisDomain, typename GraphT>
+void WorklistSolver<AnalysisDomain, GraphT>::push(unsigned V) {
+  if (InWorklist.test(V))
+    return;
+  InWorklist.set(V);
+  if (Schedule == Order::WTO)
+    Pending.push(Position[V]);
+  else
+    Worklist.push_back(V);
+}
+
+template <typename AnalysisDomain, typename GraphT>
+unsigned WorklistSolver<AnalysisDomain, GraphT>::pop() {
+  unsigned V;
+  if (Schedule == Order::WTO) {
+    V = BlockAt[Pending.top()];
+    Pending.pop();
+  } else {
+    V = Worklist.front();
+    Worklist.pop_front();
+  }
+  InWorklist.reset(V);
+  return V;
+}
+
+template <typename AnalysisDomain, typename GraphT>
+void WorklistSolver<AnalysisDomain, GraphT>::solve(GraphT G) {
+  build(G);
+  const unsigned N = Blocks.size();
+  States.assign(N, Domain.getInitialState());
+  Costs.assign(N, 0);
+  Worklist.clear();
+  Pending = {};
+  InWorklist.clear();
+  InWorklist.resize(N);
+  NumVisits = NumUpdates = NumJoins = NumTransfers = NumClones = 0;
+  std::chrono::steady_clock::time_point Start;
+  if (Stats) {
+    Stats->reset(llvm::WorklistSolver::getOrderName(Schedule), N);
+    Start = std::chrono::steady_clock::now();
+  }
+
+  if (N)
+    push(Index.lookup(GT::getEntryNode(G)));
+  while (!Worklist.empty() || !Pending.empty()) {
+    const unsigned V = pop();
+    ++NumVisits;
+    ++NumTransfers;
+    if (!Preds[V].empty()) {
+      ++NumClones;
+      NumJoins += Preds[V].size() - 1;
+    }
+    StateType In = joinPredecessors(V);
+    Costs[V] = Domain.transfer(In, Blocks[V]);
+    if (Stats)
+      ++Stats->NodeVisits[V];
+    if (Domain.equals(States[V], In))
+      continue;
+    ++NumUpdates;
+    if constexpr (llvm::is_detected<HasSize, AnalysisDomain>::value)
+      if (Stats)
+        Stats->addStateSize(Domain.size(In));
+    States[V] = std::move(In);
+    for (unsigned W : Succs[V])
+      push(W);
+  }
+
+  llvm::addFixpointStatistics(NumVisits, NumUpdates, NumJoins, NumTransfers,
+                              NumClones);
+  if (!Stats)
+    return;
+  Stats->Visits = NumVisits;
+  Stats->Updates = NumUpdates;
+  Stats->Joins = NumJoins;
+  Stats->Transfers = NumTransfers;
+  Stats->Clones = NumClones;
+  Stats->Seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - Start)
+                       .count();
 }
 
 } // namespace llta
 
-#endif
+#endif // LLTA_SOLVER_WORKLISTSOLVER_H
@@ -1,11 +1,16 @@
 #ifndef LLVM_LLTA_MIRPASSES_FRAMCACHEANALYSISPASS_H
 #define LLVM_LLTA_MIRPASSES_FRAMCACHEANALYSISPASS_H
 
+#include "Analysis/Cache/CacheGeometry.h"
 #include "TimingAnalysisResults.h"
-#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Pass.h"
 
 namespace llvm {
 
+class MachineFunction;
+class raw_ostream;
+
 /**
  * FRAMCacheAnalysisPass — MSP430 FRAM read-cache must-analysis.
  *
@@ -17,21 +22,30 @@ namespace llvm {
  *
  * It is built entirely from the modular cache components in include/Analysis/
  * Cache/ (CacheGeometry + ReplacementPolicy + CacheAccessMapper, driven by the
- * generic CacheAnalysis engine) and executed through the existing abstract-
- * interpretation framework's WorklistSolver, which performs the cross-block CFG
- * fixpoint. The per-block must-analysis penalty is added into MBBLatencyMap, so
- * it flows into the WCET exactly like the FRAMWaitStatePass penalty it replaces.
+ * generic CacheDomain) and executed through the statically dispatched
+ * llta::WorklistSolver, which performs the cross-block CFG fixpoint.
+ * -fram-cache-bench repeats the must-analysis on the virtual WorklistSolver
+ * (through the CacheAnalysis adapter) and compares the two.
+ *
+ * The per-block must-analysis penalty is added into MBBLatencyMap, so it
+ * flows into the WCET exactly like the FRAMWaitStatePass penalty it replaces.
  *
  * Under -fram-cache-verbose it also runs a sound may-analysis and reports
  * accesses proven never cached ("always-miss"); that is diagnostic only and
  * does not change the WCET.
  *
+ * The per-function fixpoints are independent, so this is a module pass: it
+ * runs once every function has been through the passes before it, analyses
+ * all machine functions as parallel jobs (-fram-cache-threads), and merges
+ * their penalties and verbose output in module order. The WCET is the same
+ * for every thread count.
+ *
  * Must run after InstructionLatencyPass (which populates MBBLatencyMap) and
  * after AdressResolverPass (addresses + FRAMStart). No-op unless -fram-cache is
  * set, -fram-wait-states > 0, and -fram-start was supplied. When enabled it
  * supersedes FRAMWaitStatePass (which then skips itself to avoid double-count).
  */
-class FRAMCacheAnalysisPass : public MachineFunctionPass {
+class FRAMCacheAnalysisPass : public ModulePass {
 public:
   static char ID;
   const bool DebugPrints = false;
@@ -39,19 +53,27 @@ public:
 
   FRAMCacheAnalysisPass(TimingAnalysisResults &TAR);
 
-  void getAnalysisUsage(AnalysisUsage &AU) const override {
-    AU.setPreservesAll();
-    MachineFunctionPass::getAnalysisUsage(AU);
-  };
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+
+  bool runOnModule(Module &M) override;
 
-  bool runOnMachineFunction(MachineFunction &F) override;
+  /**
+   * The analysis behind runOnModule(): run the jobs of \p MFs on \p Threads
+   * threads (0: all hardware threads), then add their penalties into TAR's
+   * MBBLatencyMap and write their \p Verbose output to \p OS, both in the
+   * order of \p MFs. The result does not depend on \p Threads.
+   */
+  static void analyzeFunctions(ArrayRef<MachineFunction *> MFs,
+                               TimingAnalysisResults &TAR,
+                               const CacheGeometry &Geo, unsigned Threads,
+                               bool Verbose, raw_ostream &OS);
 
   virtual llvm::StringRef getPassName() const override {
     return "MSP430 FRAM Cache Must-Analysis Pass";
   }
 };
 
-MachineFunctionPass *createFRAMCacheAnalysisPass(TimingAnalysisResults &TAR);
+ModulePass *createFRAMCacheAnalysisPass(TimingAnalysisResults &TAR);
 } // namespace llvm
 
 #endif // LLVM_LLTA_MIRPASSES_FRAMCACHEANALYSISPASS_H
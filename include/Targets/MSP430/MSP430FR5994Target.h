@@ -17,7 +17,7 @@ public:
   /// Contributes the FRAM instruction-fetch model: the wait-state pass and the
   /// FR5xx read-cache must-analysis pass. Both are no-ops unless the relevant
   /// -fram-* options are set, so default runs are unaffected.
-  std::vector<llvm::MachineFunctionPass *>
+  std::vector<llvm::Pass *>
   getMemoryModelPasses(llvm::TimingAnalysisResults &TAR) const override;
 };
 
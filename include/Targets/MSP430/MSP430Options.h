@@ -33,6 +33,15 @@ extern llvm::cl::opt<std::string> FRAMCachePolicy;
 /// may-analysis and report accesses proven never cached. Does not change WCET.
 extern llvm::cl::opt<bool> FRAMCacheVerbose;
 
+/// Threads for the per-function FRAM cache analyses (-fram-cache-threads).
+/// 0 (default) uses all hardware threads; the WCET does not depend on it.
+extern llvm::cl::opt<unsigned> FRAMCacheThreads;
+
+/// Benchmark the FRAM cache must-analysis (-fram-cache-bench): also run it on
+/// the virtual WorklistSolver, check both engines charge the same penalties
+/// and print their fixpoint times to stderr. Does not change the WCET.
+extern llvm::cl::opt<bool> FRAMCacheBench;
+
 /// Number of FRAM cache sets (-fram-cache-sets). FR5994 default: 2.
 extern llvm::cl::opt<unsigned> FRAMCacheSets;
 
@@ -12,7 +12,7 @@ namespace llvm {
 class MachineInstr;
 class MCInst;
 class MachineLoop;
-class MachineFunctionPass;
+class Pass;
 class TimingAnalysisResults;
 class AbstractAnalysable;
 } // namespace llvm
@@ -117,12 +117,14 @@ public:
 
   //===--- Memory model ---------------------------------------------------===//
 
-  /// Machine-function passes this target contributes to model its memory
-  /// subsystem (e.g. MSP430FR's FRAM wait-state / read-cache passes). They are
-  /// spliced into the pipeline right after InstructionLatencyPass so their
-  /// penalties land in MBBLatencyMap. Default: none (no extra memory model).
-  /// Returned passes are owned by the caller (the pass pipeline).
-  virtual std::vector<llvm::MachineFunctionPass *>
+  /// Passes this target contributes to model its memory subsystem (e.g.
+  /// MSP430FR's FRAM wait-state / read-cache passes). They are spliced into
+  /// the pipeline right after InstructionLatencyPass so their penalties land in
+  /// MBBLatencyMap. Machine-function passes run interleaved with the rest of
+  /// the pipeline; a module pass runs once all functions are through the
+  /// passes before it. Default: none (no extra memory model). Returned passes
+  /// are owned by the caller (the pass pipeline).
+  virtual std::vector<llvm::Pass *>
   getMemoryModelPasses(llvm::TimingAnalysisResults &TAR) const {
     return {};
   }
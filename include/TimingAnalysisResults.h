@@ -1,6 +1,7 @@
 #ifndef TIMING_ANALYSIS_RESULTS_H
 #define TIMING_ANALYSIS_RESULTS_H
 
+#include "Analysis/FixpointStats.h"
 #include "Graph/ProgramGraph.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
@@ -53,8 +54,8 @@ public:
   setMBBLatencyMap(std::unordered_map<const MachineBasicBlock *, unsigned int>
                        MBBLatencyMap);
 
-  std::unordered_map<const MachineBasicBlock *, unsigned int>
-  getMBBLatencyMap();
+  const std::unordered_map<const MachineBasicBlock *, unsigned int> &
+  getMBBLatencyMap() const;
   // END: Instruction Latency Pass Containers
 
   // START: Machine Loop Bound Agregator Pass Containers
@@ -64,7 +65,8 @@ public:
   void setLoopBoundMap(
       std::unordered_map<const MachineBasicBlock *, unsigned int> LoopBoundMap);
 
-  std::unordered_map<const MachineBasicBlock *, unsigned int> getLoopBoundMap();
+  const std::unordered_map<const MachineBasicBlock *, unsigned int> &
+  getLoopBoundMap() const;
 
   // Recursion bounds supplied via `#pragma recursion_bound(N)` (emitted by the
   // LoopBoundPlugin into the same JSON, under a "recursion_bounds" array).
@@ -160,6 +162,15 @@ public:
   const std::set<std::string> &getUnsoundReasons() const;
   bool isUnsound() const;
   // END: Unsoundness tracking
+
+  // START: Fixpoint statistics
+  // One record per abstract-interpretation fixpoint run with -fixpoint-stats,
+  // in the order the passes report them. PathAnalysisPass writes them out.
+  std::vector<FixpointStats> FixpointRuns;
+
+  void addFixpointStats(FixpointStats Stats);
+  const std::vector<FixpointStats> &getFixpointStats() const;
+  // END: Fixpoint statistics
 };
 
 } // namespace llvm
@@ -27,6 +27,46 @@ extern llvm::cl::opt<bool> LLCMode;
  */
 extern llvm::cl::opt<bool> AddressResolverVerbose;
 
+/**
+ * Shrink the IPET graph (chain collapsing, zero-cost node elimination) before
+ * the WCET ILP is built (-ilp-reduce, on by default).
+ */
+extern llvm::cl::opt<bool> ILPReduceGraph;
+extern llvm::cl::opt<bool> ILPLPFirst;
+/// Time limit (seconds) and relative gap that stop each WCET ILP solve early
+/// with a sound dual-bound WCET.
+extern llvm::cl::opt<double> ILPTimeLimit;
+extern llvm::cl::opt<double> ILPGap;
+/// Print the worst-case path, and the next K worst distinct paths.
+extern llvm::cl::opt<bool> ILPPrintPath;
+extern llvm::cl::opt<unsigned> ILPTopPaths;
+/// Loop-bound and block-cost sensitivity report (number of blocks listed).
+extern llvm::cl::opt<unsigned> ILPSensitivity;
+/// Bottom-up modular IPET: closed callees as parallel sub-ILPs.
+extern llvm::cl::opt<bool> ILPModular;
+/// Contract single-entry/single-exit loops into summary nodes, innermost
+/// first, before the global ILP.
+extern llvm::cl::opt<bool> ILPRegions;
+/// HiGHS portfolio size and thread count for the WCET ILP.
+extern llvm::cl::opt<unsigned> ILPPortfolio;
+extern llvm::cl::opt<unsigned> ILPThreads;
+/// Structural WCET (TimingSchemaSolver) and its ILP cross-check.
+extern llvm::cl::opt<bool> TimingSchema;
+extern llvm::cl::opt<bool> TimingSchemaCheck;
+/// Write the WCET ILP to an MPS or LP file.
+extern llvm::cl::opt<std::string> ILPExportFile;
+extern llvm::cl::opt<unsigned> ContextDepth;
+extern llvm::cl::opt<std::string> SaveGraphFile;
+extern llvm::cl::opt<std::string> LoadGraphFile;
+extern llvm::cl::opt<std::string> DumpGraphFile;
+extern llvm::cl::opt<std::string> DumpGraphFormat;
+/// Worklist scheduling of the abstract-interpretation fixpoints ("fifo" or
+/// "wto"), see WorklistSolver::parseOrder().
+extern llvm::cl::opt<std::string> WorklistOrder;
+/// Write per-run fixpoint statistics (visits, joins, state sizes, time, the
+/// most revisited nodes) as JSON to this file.
+extern llvm::cl::opt<std::string> FixpointStatsFile;
+
 // NOTE: MSP430(FR)-specific options (-fram-*) are owned by the MSP430 target;
 // see include/Targets/MSP430/MSP430Options.h.
 
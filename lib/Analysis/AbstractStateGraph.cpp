@@ -1,68 +1,105 @@
 #include "Analysis/AbstractStateGraph.h"
+#include "Graph/ProgramGraph.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
 namespace llvm {
 
+void AbstractStateGraph::attachTo(
+    const ProgramGraph &PG,
+    function_ref<std::unique_ptr<AbstractState>()> MakeState) {
+  assert(PG.isFrozen() && "ProgramGraph must be frozen to be viewed");
+  *this = AbstractStateGraph();
+  Base = &PG;
+  unsigned NumNodes = PG.getNumDenseNodes();
+  Nodes.reserve(NumNodes);
+  for (unsigned I = 0; I < NumNodes; ++I)
+    Nodes.emplace_back(I, MakeState());
+}
+
 unsigned AbstractStateGraph::addNode(std::unique_ptr<AbstractState> State,
                                      const MachineBasicBlock *MBB) {
-  unsigned Id = NextNodeId++;
-  Nodes[Id] = std::make_unique<Node>(Id, std::move(State), MBB);
+  assert(!Base && "cannot add nodes to a ProgramGraph view");
+  unsigned Id = Nodes.size();
+  Nodes.emplace_back(Id, std::move(State), MBB);
+  SuccTargets.emplace_back();
+  SuccBackEdge.emplace_back();
+  Preds.emplace_back();
   return Id;
 }
 
 void AbstractStateGraph::addEdge(unsigned From, unsigned To, bool IsBackEdge) {
-  AdjacencyList[From].insert({To, IsBackEdge});
-  Predecessors[To].insert(From);
+  assert(!Base && "cannot add edges to a ProgramGraph view");
+  assert(From < Nodes.size() && To < Nodes.size() && "edge to unknown node");
+  std::vector<unsigned> &Targets = SuccTargets[From];
+  auto It = llvm::lower_bound(Targets, To);
+  if (It != Targets.end() && *It == To)
+    return;
+  SuccBackEdge[From].insert(SuccBackEdge[From].begin() +
+                                (It - Targets.begin()),
+                            IsBackEdge ? 1 : 0);
+  Targets.insert(It, To);
+  std::vector<unsigned> &In = Preds[To];
+  In.insert(llvm::lower_bound(In, From), From);
 }
 
 void AbstractStateGraph::removeEdge(unsigned From, unsigned To) {
-  // Need to find edge with To
-  auto &Edges = AdjacencyList[From];
-  for (auto It = Edges.begin(); It != Edges.end();) {
-    if (It->To == To) {
-      It = Edges.erase(It);
-    } else {
-      ++It;
-    }
-  }
-  Predecessors[To].erase(From);
+  assert(!Base && "cannot remove edges from a ProgramGraph view");
+  std::vector<unsigned> &Targets = SuccTargets[From];
+  auto It = llvm::lower_bound(Targets, To);
+  if (It == Targets.end() || *It != To)
+    return;
+  SuccBackEdge[From].erase(SuccBackEdge[From].begin() +
+                           (It - Targets.begin()));
+  Targets.erase(It);
+  std::vector<unsigned> &In = Preds[To];
+  In.erase(llvm::lower_bound(In, From));
 }
 
-AbstractStateGraph::Node *AbstractStateGraph::getNode(unsigned Id) {
-  auto It = Nodes.find(Id);
-  if (It != Nodes.end()) {
-    return It->second.get();
-  }
-  return nullptr;
+AbstractStateGraph::EdgeRange
+AbstractStateGraph::getSuccessors(unsigned Id) const {
+  if (Id >= Nodes.size())
+    return EdgeRange({}, {});
+  if (Base)
+    return EdgeRange(Base->getSuccessorIndices(Id),
+                     Base->getSuccessorBackEdgeFlags(Id));
+  return EdgeRange(SuccTargets[Id], SuccBackEdge[Id]);
 }
 
-const std::set<AbstractStateGraph::Edge> &
-AbstractStateGraph::getSuccessors(unsigned Id) const {
-  static const std::set<AbstractStateGraph::Edge> EmptySet;
-  auto It = AdjacencyList.find(Id);
-  if (It != AdjacencyList.end()) {
-    return It->second;
-  }
-  return EmptySet;
+ArrayRef<unsigned> AbstractStateGraph::getPredecessors(unsigned Id) const {
+  if (Id >= Nodes.size())
+    return {};
+  if (Base)
+    return Base->getPredecessorIndices(Id);
+  return Preds[Id];
 }
 
-const std::set<unsigned> &
-AbstractStateGraph::getPredecessors(unsigned Id) const {
-  static const std::set<unsigned> EmptySet;
-  auto It = Predecessors.find(Id);
-  if (It != Predecessors.end()) {
-    return It->second;
+std::string AbstractStateGraph::getNodeLabel(unsigned Id) const {
+  if (Base) {
+    StringRef Name = Base->getDenseNode(Id).Name;
+    std::string Label = Name.empty() ? "n" + std::to_string(Id) : Name.str();
+    if (const Function *F = Base->getNodeFunction(Base->getNodeIdAt(Id)))
+      Label = (Base->getFunctionName(F) + ":" + Label).str();
+    return Label;
   }
-  return EmptySet;
+  const MachineBasicBlock *MBB = Nodes[Id].MBB;
+  if (!MBB)
+    return "n" + std::to_string(Id);
+  std::string Label =
+      (MBB->getParent()->getName() + ":bb." + Twine(MBB->getNumber())).str();
+  if (const BasicBlock *BB = MBB->getBasicBlock())
+    if (BB->hasName())
+      Label += "." + BB->getName().str();
+  return Label;
 }
 
 void AbstractStateGraph::dump() const {
   dbgs() << "AbstractStateGraph:\n";
-  for (const auto &Pair : Nodes) {
-    dbgs() << "Node " << Pair.first << ": " << Pair.second->State->toString()
-           << "\n";
-    for (const auto &Edge : getSuccessors(Pair.first)) {
+  for (const Node &N : Nodes) {
+    dbgs() << "Node " << N.Id << ": " << N.State->toString() << "\n";
+    for (const auto &Edge : getSuccessors(N.Id)) {
       dbgs() << "  -> " << Edge.To << (Edge.IsBackEdge ? " (BackEdge)" : "")
              << "\n";
     }
@@ -6,15 +6,7 @@
 
 namespace llvm {
 
-std::unique_ptr<AbstractState> CacheAnalysis::getInitialState() {
-  // Cold cache: every set empty. Sound for both directions (must: nothing
-  // guaranteed; may: nothing possibly-cached yet).
-  return std::make_unique<CacheState>(Geo, Policy, Kind);
-}
-
-unsigned CacheAnalysis::process(AbstractState *State, const MachineInstr *MI) {
-  auto *CState = static_cast<CacheState *>(State);
-
+unsigned CacheDomain::transfer(CacheState &S, const MachineInstr *MI) const {
   SmallVector<CacheEvent, 4> Events;
   Mapper->mapEvents(MI, Events);
 
@@ -22,7 +14,7 @@ unsigned CacheAnalysis::process(AbstractState *State, const MachineInstr *MI) {
   for (const CacheEvent &E : Events) {
     switch (E.Kind) {
     case CacheEvent::Access: {
-      bool Present = CState->access(E.LineId);
+      bool Present = S.access(E.LineId);
       if (Kind == AnalysisKind::Must) {
         if (!Present)
           Cost += MissPenalty; // not provably a hit ⇒ charge the miss
@@ -33,7 +25,7 @@ unsigned CacheAnalysis::process(AbstractState *State, const MachineInstr *MI) {
       break;
     }
     case CacheEvent::Barrier:
-      CState->barrier();
+      S.barrier();
       if (Kind == AnalysisKind::Must)
         Cost += E.Cost; // FRAM data-access wait state(s); May cost stays 0
       break;
@@ -0,0 +1,101 @@
+#include "Analysis/FixpointStats.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+#define DEBUG_TYPE "llta-fixpoint"
+
+STATISTIC(NumFixpointRuns, "Fixpoint runs");
+STATISTIC(NumFixpointVisits, "Fixpoint node visits");
+STATISTIC(NumFixpointUpdates, "Fixpoint visits that changed a state");
+STATISTIC(NumFixpointJoins, "Fixpoint state joins");
+STATISTIC(NumFixpointTransfers, "Fixpoint block transfers");
+STATISTIC(NumFixpointClones, "Fixpoint state clones");
+
+namespace llvm {
+
+void FixpointStats::reset(StringRef Order, unsigned NumNodes) {
+  this->Order = Order.str();
+  Nodes = NumNodes;
+  Visits = Updates = Joins = Transfers = Clones = 0;
+  PeakStateSize = 0;
+  TotalStateSize = 0;
+  Seconds = 0;
+  NodeVisits.assign(NumNodes, 0);
+}
+
+std::vector<std::pair<unsigned, unsigned>>
+FixpointStats::getMostVisited(unsigned N) const {
+  std::vector<std::pair<unsigned, unsigned>> Result;
+  for (unsigned Id = 0; Id < NodeVisits.size(); ++Id)
+    if (NodeVisits[Id] > 1)
+      Result.push_back({Id, NodeVisits[Id]});
+  llvm::stable_sort(Result, [](const auto &A, const auto &B) {
+    return A.second > B.second;
+  });
+  if (Result.size() > N)
+    Result.resize(N);
+  return Result;
+}
+
+void FixpointStats::writeJSON(json::OStream &J) const {
+  J.object([&] {
+    J.attribute("analysis", Analysis);
+    J.attribute("function", Function);
+    J.attribute("order", Order);
+    J.attribute("nodes", Nodes);
+    J.attribute("visits", Visits);
+    J.attribute("updates", Updates);
+    J.attribute("joins", Joins);
+    J.attribute("transfers", Transfers);
+    J.attribute("clones", Clones);
+    J.attribute("peak_state_size", PeakStateSize);
+    J.attribute("average_state_size", getAverageStateSize());
+    J.attribute("seconds", Seconds);
+    J.attributeArray("most_visited", [&] {
+      for (const auto &[Id, Count] : getMostVisited())
+        J.object([&] {
+          J.attribute("node", Id);
+          if (Id < NodeNames.size())
+            J.attribute("name", NodeNames[Id]);
+          J.attribute("visits", Count);
+        });
+    });
+  });
+}
+
+void addFixpointStatistics(unsigned Visits, unsigned Updates, unsigned Joins,
+                           unsigned Transfers, unsigned Clones) {
+  ++NumFixpointRuns;
+  NumFixpointVisits += Visits;
+  NumFixpointUpdates += Updates;
+  NumFixpointJoins += Joins;
+  NumFixpointTransfers += Transfers;
+  NumFixpointClones += Clones;
+}
+
+Error writeFixpointStats(StringRef Path, ArrayRef<FixpointStats> Runs) {
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::OF_Text);
+  if (EC)
+    return createFileError(Path, EC);
+  {
+    json::OStream J(OS, /*IndentSize=*/2);
+    J.object([&] {
+      J.attribute("version", 1);
+      J.attributeArray("runs", [&] {
+        for (const FixpointStats &Run : Runs)
+          Run.writeJSON(J);
+      });
+    });
+  }
+  OS << "\n";
+  OS.close();
+  if (OS.has_error())
+    return createFileError(Path, OS.error());
+  return Error::success();
+}
+
+} // namespace llvm
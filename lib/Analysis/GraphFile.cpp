@@ -0,0 +1,411 @@
+#include "Analysis/GraphFile.h"
+#include "Graph/ProgramGraph.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace llvm {
+
+constexpr char GraphFile::Magic[8];
+
+namespace {
+
+constexpr uint64_t SectionAlign = 8;
+
+/// String table of a file under construction; each distinct string is stored
+/// once and referenced by index.
+struct StringTable {
+  StringMap<uint32_t> Index;
+  std::vector<StringRef> Strings;
+
+  uint32_t get(StringRef S) {
+    auto [It, Inserted] = Index.try_emplace(S, Strings.size());
+    if (Inserted)
+      Strings.push_back(It->getKey());
+    return It->second;
+  }
+};
+
+void pad(raw_ostream &OS, uint64_t &Offset) {
+  while (Offset % SectionAlign) {
+    OS << '\0';
+    ++Offset;
+  }
+}
+
+template <typename T>
+void writeSection(raw_ostream &OS, uint64_t &Offset, ArrayRef<T> Records) {
+  OS.write(reinterpret_cast<const char *>(Records.data()),
+           Records.size() * sizeof(T));
+  Offset += Records.size() * sizeof(T);
+  pad(OS, Offset);
+}
+
+/// Reads fixed-size sections off a buffer in file order, failing if one runs
+/// past the end.
+class SectionReader {
+public:
+  explicit SectionReader(StringRef Data) : Data(Data) {}
+
+  template <typename T> bool read(uint64_t Count, ArrayRef<T> &Out) {
+    uint64_t Bytes = Count * sizeof(T);
+    if (Offset + Bytes > Data.size())
+      return false;
+    Out = ArrayRef<T>(reinterpret_cast<const T *>(Data.data() + Offset),
+                      Count);
+    Offset = alignTo(Offset + Bytes, SectionAlign);
+    return true;
+  }
+  bool readBytes(uint64_t Count, StringRef &Out) {
+    if (Offset + Count > Data.size())
+      return false;
+    Out = Data.substr(Offset, Count);
+    Offset += Count;
+    return true;
+  }
+
+private:
+  StringRef Data;
+  uint64_t Offset = 0;
+};
+
+Error malformed(const Twine &Why) {
+  return createStringError(inconvertibleErrorCode(),
+                           "malformed graph file: " + Why);
+}
+
+} // namespace
+
+void GraphFile::write(raw_ostream &OS, const AbstractStateGraph &ASG,
+                      const std::set<std::string> &UnsoundReasons,
+                      const std::set<std::string> &UnsoundCallees) {
+  // Dense node indices, in node id order.
+  DenseMap<unsigned, uint32_t> Dense;
+  uint32_t NextIndex = 0;
+  for (const auto &N : ASG.getNodes())
+    Dense[N.Id] = NextIndex++;
+  auto dense = [&](unsigned Id) {
+    auto It = Dense.find(Id);
+    return It == Dense.end() ? None : It->second;
+  };
+
+  // Block and function name of a node, from the viewed ProgramGraph. A graph
+  // that owns its edges has none: its MachineBasicBlocks may be gone by now.
+  auto names = [&](unsigned Id) -> std::pair<StringRef, StringRef> {
+    const ProgramGraph *PG = ASG.getBase();
+    if (!PG)
+      return {};
+    const Function *F = PG->getNodeFunction(PG->getNodeIdAt(Id));
+    return {PG->getDenseNode(Id).Name,
+            F ? PG->getFunctionName(F) : StringRef()};
+  };
+
+  StringTable Strings;
+  std::vector<NodeRecord> Nodes;
+  std::vector<EdgeRecord> Edges;
+  Nodes.reserve(ASG.getNodes().size());
+  for (const auto &N : ASG.getNodes()) {
+    NodeRecord R;
+    R.Id = N.Id;
+    R.Cost = N.Cost;
+    R.UpperLoopBound = N.UpperLoopBound;
+    R.Flags = (N.IsEntry ? Entry : 0) | (N.IsExit ? Exit : 0) |
+              (N.IsLoopHeader ? LoopHeader : 0);
+    R.FirstEdge = Edges.size();
+    auto [Name, Fn] = names(N.Id);
+    R.Name = Strings.get(Name);
+    R.Function = Fn.empty() ? None : Strings.get(Fn);
+    Nodes.push_back(R);
+    for (const auto &E : ASG.getSuccessors(N.Id)) {
+      EdgeRecord ER;
+      ER.To = dense(E.To);
+      ER.Flags = E.IsBackEdge ? BackEdge : 0;
+      Edges.push_back(ER);
+    }
+  }
+
+  std::vector<U32> ReturnIds;
+  auto appendReturns = [&](ArrayRef<unsigned> Returns, U32 &First, U32 &Num) {
+    First = ReturnIds.size();
+    for (unsigned R : Returns)
+      ReturnIds.push_back(U32(dense(R)));
+    Num = Returns.size();
+  };
+
+  // Resolve every call site's callee instance now, so a loaded graph needs no
+  // Function objects to match calls with returns.
+  std::vector<CallSiteRecord> CallSites;
+  for (const auto &CS : ASG.CallSites) {
+    CallSiteRecord R;
+    R.CallNode = dense(CS.CallNodeId);
+    R.LandingNode = dense(CS.ReturnNodeId);
+    unsigned Entry = ASG.getCalleeEntry(CS);
+    R.Entry = Entry == ~0u ? None : dense(Entry);
+    appendReturns(Entry == ~0u ? ArrayRef<unsigned>()
+                               : ASG.getCalleeReturns(CS),
+                  R.FirstReturn, R.NumReturns);
+    R.Callee = Strings.get(CS.Callee ? CS.Callee->getName() : StringRef());
+    CallSites.push_back(R);
+  }
+
+  // Functions sorted by name, so the same graph always gives the same bytes.
+  std::vector<std::pair<StringRef, const Function *>> Fns;
+  for (const auto &[F, Entry] : ASG.FunctionEntries)
+    Fns.push_back({F->getName(), F});
+  for (const auto &[F, Returns] : ASG.FunctionReturns)
+    if (!ASG.FunctionEntries.count(F))
+      Fns.push_back({F->getName(), F});
+  llvm::sort(Fns);
+  std::vector<FunctionRecord> Functions;
+  for (const auto &[Name, F] : Fns) {
+    FunctionRecord R;
+    R.Name = Strings.get(Name);
+    auto EntryIt = ASG.FunctionEntries.find(F);
+    R.Entry =
+        EntryIt == ASG.FunctionEntries.end() ? None : dense(EntryIt->second);
+    auto RetIt = ASG.FunctionReturns.find(F);
+    appendReturns(RetIt == ASG.FunctionReturns.end()
+                      ? ArrayRef<unsigned>()
+                      : ArrayRef<unsigned>(RetIt->second),
+                  R.FirstReturn, R.NumReturns);
+    Functions.push_back(R);
+  }
+
+  std::vector<U32> Callees, Reasons;
+  for (const auto &C : UnsoundCallees)
+    Callees.push_back(U32(Strings.get(C)));
+  for (const auto &R : UnsoundReasons)
+    Reasons.push_back(U32(Strings.get(R)));
+
+  std::vector<U32> StringOffsets;
+  uint32_t StringBytes = 0;
+  for (StringRef S : Strings.Strings) {
+    StringOffsets.push_back(U32(StringBytes));
+    StringBytes += S.size();
+  }
+  StringOffsets.push_back(U32(StringBytes));
+
+  Header H;
+  std::memcpy(H.Magic, Magic, sizeof(Magic));
+  H.Version = Version;
+  H.NumNodes = Nodes.size();
+  H.NumEdges = Edges.size();
+  H.NumCallSites = CallSites.size();
+  H.NumFunctions = Functions.size();
+  H.NumReturnIds = ReturnIds.size();
+  H.NumUnsoundCallees = Callees.size();
+  H.NumUnsoundReasons = Reasons.size();
+  H.NumStrings = Strings.Strings.size();
+  H.StringBytes = StringBytes;
+
+  uint64_t Offset = 0;
+  writeSection(OS, Offset, ArrayRef<Header>(H));
+  writeSection(OS, Offset, ArrayRef<NodeRecord>(Nodes));
+  writeSection(OS, Offset, ArrayRef<EdgeRecord>(Edges));
+  writeSection(OS, Offset, ArrayRef<CallSiteRecord>(CallSites));
+  writeSection(OS, Offset, ArrayRef<FunctionRecord>(Functions));
+  writeSection(OS, Offset, ArrayRef<U32>(ReturnIds));
+  writeSection(OS, Offset, ArrayRef<U32>(Callees));
+  writeSection(OS, Offset, ArrayRef<U32>(Reasons));
+  writeSection(OS, Offset, ArrayRef<U32>(StringOffsets));
+  for (StringRef S : Strings.Strings)
+    OS << S;
+}
+
+Error GraphFile::write(StringRef Path, const AbstractStateGraph &ASG,
+                       const std::set<std::string> &UnsoundReasons,
+                       const std::set<std::string> &UnsoundCallees) {
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::OF_None);
+  if (EC)
+    return createFileError(Path, EC);
+  write(OS, ASG, UnsoundReasons, UnsoundCallees);
+  OS.close();
+  if (OS.has_error())
+    return createFileError(Path, OS.error());
+  return Error::success();
+}
+
+Expected<GraphFile> GraphFile::load(StringRef Path) {
+  // MemoryBuffer maps the file when it is large enough to be worth it.
+  auto BufferOrErr = MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                           /*RequiresNullTerminator=*/false);
+  if (!BufferOrErr)
+    return createFileError(Path, BufferOrErr.getError());
+  Expected<GraphFile> File = load(std::move(*BufferOrErr));
+  if (!File)
+    return createFileError(Path, File.takeError());
+  return File;
+}
+
+Expected<GraphFile> GraphFile::load(std::unique_ptr<MemoryBuffer> Buffer) {
+  GraphFile File(std::move(Buffer));
+  SectionReader Reader(File.Buffer->getBuffer());
+
+  ArrayRef<Header> Hdr;
+  if (!Reader.read(1, Hdr) ||
+      std::memcmp(Hdr[0].Magic, Magic, sizeof(Magic)) != 0)
+    return malformed("not an LLTA graph file");
+  const Header &H = Hdr[0];
+  if (H.Version != Version)
+    return malformed("unsupported version " + Twine(uint32_t(H.Version)) +
+                     " (expected " + Twine(Version) + ")");
+  File.Hdr = &H;
+
+  if (!Reader.read(H.NumNodes, File.Nodes) ||
+      !Reader.read(H.NumEdges, File.Edges) ||
+      !Reader.read(H.NumCallSites, File.CallSites) ||
+      !Reader.read(H.NumFunctions, File.Functions) ||
+      !Reader.read(H.NumReturnIds, File.ReturnIds) ||
+      !Reader.read(H.NumUnsoundCallees, File.UnsoundCallees) ||
+      !Reader.read(H.NumUnsoundReasons, File.UnsoundReasons) ||
+      !Reader.read(uint64_t(H.NumStrings) + 1, File.StringOffsets) ||
+      !Reader.readBytes(H.StringBytes, File.StringData))
+    return malformed("truncated");
+
+  // Bounds-check every index once so the accessors can trust them.
+  uint32_t NumNodes = H.NumNodes;
+  auto isNode = [&](uint32_t N) { return N < NumNodes; };
+  auto isNodeOrNone = [&](uint32_t N) { return N == None || N < NumNodes; };
+  auto isRange = [&](uint32_t First, uint32_t Num, uint64_t Size) {
+    return uint64_t(First) + Num <= Size;
+  };
+  uint32_t PrevEdge = 0;
+  for (const NodeRecord &N : File.Nodes) {
+    if (N.FirstEdge < PrevEdge || N.FirstEdge > H.NumEdges)
+      return malformed("edge ranges out of order");
+    PrevEdge = N.FirstEdge;
+    if (N.Name >= H.NumStrings ||
+        (N.Function != None && N.Function >= H.NumStrings))
+      return malformed("node name out of range");
+  }
+  for (const EdgeRecord &E : File.Edges)
+    if (!isNode(E.To))
+      return malformed("edge target out of range");
+  for (U32 R : File.ReturnIds)
+    if (!isNode(R))
+      return malformed("return node out of range");
+  for (const CallSiteRecord &CS : File.CallSites)
+    if (!isNode(CS.CallNode) || !isNode(CS.LandingNode) ||
+        !isNodeOrNone(CS.Entry) ||
+        !isRange(CS.FirstReturn, CS.NumReturns, H.NumReturnIds) ||
+        CS.Callee >= H.NumStrings)
+      return malformed("call site out of range");
+  for (const FunctionRecord &F : File.Functions)
+    if (F.Name >= H.NumStrings || !isNodeOrNone(F.Entry) ||
+        !isRange(F.FirstReturn, F.NumReturns, H.NumReturnIds))
+      return malformed("function out of range");
+  for (ArrayRef<U32> Names : {File.UnsoundCallees, File.UnsoundReasons})
+    for (U32 S : Names)
+      if (S >= H.NumStrings)
+        return malformed("string index out of range");
+  for (unsigned I = 0, E = H.NumStrings; I != E; ++I)
+    if (File.StringOffsets[I] > File.StringOffsets[I + 1])
+      return malformed("string table out of order");
+  if (File.StringOffsets.back() != H.StringBytes)
+    return malformed("string table size mismatch");
+
+  return std::move(File);
+}
+
+ArrayRef<GraphFile::EdgeRecord> GraphFile::successors(unsigned Node) const {
+  uint32_t First = Nodes[Node].FirstEdge;
+  uint32_t End =
+      Node + 1 < Nodes.size() ? uint32_t(Nodes[Node + 1].FirstEdge)
+                              : uint32_t(Edges.size());
+  return Edges.slice(First, End - First);
+}
+
+StringRef GraphFile::getString(uint32_t Index) const {
+  uint32_t Begin = StringOffsets[Index];
+  return StringData.substr(Begin, StringOffsets[Index + 1] - Begin);
+}
+
+void GraphFile::buildAbstractStateGraph(AbstractStateGraph &ASG,
+                                        ProgramGraph &PG, Module &M) const {
+  assert(ASG.getNodes().empty() && PG.getNodes().empty() &&
+         "expected empty graphs");
+  auto *FnTy = FunctionType::get(Type::getVoidTy(M.getContext()), false);
+  auto declare = [&](uint32_t Name) -> const Function * {
+    StringRef S = getString(Name);
+    if (S.empty())
+      return nullptr;
+    Function *F = M.getFunction(S);
+    if (!F)
+      F = Function::Create(FnTy, GlobalValue::ExternalLinkage, S, &M);
+    PG.FunctionNames.try_emplace(F, PG.intern(S));
+    return F;
+  };
+  auto returns = [&](uint32_t First, uint32_t Num) {
+    std::vector<unsigned> Ids;
+    for (U32 Ret : ReturnIds.slice(First, Num))
+      Ids.push_back(Ret);
+    return Ids;
+  };
+
+  // The program graph: node I is node I of the file, so dense index and id
+  // coincide.
+  for (const NodeRecord &R : Nodes) {
+    unsigned Id = PG.addNode(R.Cost, R.Cost, nullptr, getString(R.Name));
+    Node &N = PG.Nodes.at(Id);
+    N.IsLoop = R.Flags & LoopHeader;
+    N.UpperLoopBound = R.UpperLoopBound;
+    if (R.Function != None)
+      PG.NodeToFunctionMap[Id] = declare(R.Function);
+  }
+  for (unsigned I = 0, E = Nodes.size(); I != E; ++I)
+    for (const EdgeRecord &Edge : successors(I)) {
+      PG.addEdge(I, Edge.To);
+      if (Edge.Flags & BackEdge)
+        PG.Nodes.at(Edge.To).BackEdgePredecessors.insert(I);
+    }
+  for (const FunctionRecord &R : Functions) {
+    const Function *F = declare(R.Name);
+    if (R.Entry != None)
+      PG.FunctionToEntryNodeMap[F] = R.Entry;
+    PG.FunctionToReturnNodesMap[F] = returns(R.FirstReturn, R.NumReturns);
+  }
+  PG.freeze();
+
+  // The solver's view of it.
+  ASG.attachTo(PG, [] { return std::unique_ptr<AbstractState>(); });
+  for (unsigned I = 0, E = Nodes.size(); I != E; ++I) {
+    const NodeRecord &R = Nodes[I];
+    auto *N = ASG.getNode(I);
+    N->Cost = R.Cost;
+    N->UpperLoopBound = R.UpperLoopBound;
+    N->IsEntry = R.Flags & Entry;
+    N->IsExit = R.Flags & Exit;
+    N->IsLoopHeader = R.Flags & LoopHeader;
+  }
+  for (const CallSiteRecord &R : CallSites)
+    ASG.CallSites.push_back({R.CallNode, R.LandingNode, declare(R.Callee),
+                             R.Entry, returns(R.FirstReturn, R.NumReturns)});
+  for (const FunctionRecord &R : Functions) {
+    const Function *F = declare(R.Name);
+    if (R.Entry != None)
+      ASG.FunctionEntries[F] = R.Entry;
+    ASG.FunctionReturns[F] = returns(R.FirstReturn, R.NumReturns);
+  }
+}
+
+std::set<std::string> GraphFile::getUnsoundCallees() const {
+  std::set<std::string> Result;
+  for (U32 S : UnsoundCallees)
+    Result.insert(getString(S).str());
+  return Result;
+}
+
+std::set<std::string> GraphFile::getUnsoundReasons() const {
+  std::set<std::string> Result;
+  for (U32 S : UnsoundReasons)
+    Result.insert(getString(S).str());
+  return Result;
+}
+
+} // namespace llvm
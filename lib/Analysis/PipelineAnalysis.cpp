@@ -73,6 +73,13 @@ bool PipelineState::join(const AbstractState *Other) {
   return Changed;
 }
 
+unsigned PipelineState::getSize() const {
+  unsigned Size = 0;
+  for (const auto &S : SubStates)
+    Size += S->getSize();
+  return Size;
+}
+
 std::string PipelineState::toString() const {
   std::string Res = "Pipeline(";
   for (size_t i = 0; i < SubStates.size(); ++i) {
@@ -1,24 +1,210 @@
 #include "Analysis/WorklistSolver.h"
 #include "Graph/ProgramGraph.h" // For access to ProgramGraph utilities if needed, but we used AbstractStateGraph
+#include "llvm/ADT/Twine.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineInstr.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <map>
+#include <vector>
 
 namespace llvm {
 
+namespace {
+
+/// Builds Bourdoncle's weak topological order by recursive SCC decomposition:
+/// the strongly connected components of a region in topological order, each
+/// non-trivial one as its head followed by the order of the component without
+/// the head. The SCC search itself is iterative (Tarjan), so the recursion is
+/// only as deep as the loop nest.
+class WTOBuilder {
+public:
+  explicit WTOBuilder(const AbstractStateGraph &G)
+      : G(G), N(G.getNumNodes()), Region(N, 0), Index(N, 0), Low(N, 0),
+        OnStack(N) {}
+
+  std::vector<unsigned> build() {
+    std::vector<unsigned> Members(N), Starts;
+    for (unsigned V = 0; V < N; ++V) {
+      Members[V] = V;
+      if (G.getNodes()[V].IsEntry)
+        Starts.push_back(V);
+    }
+    Starts.insert(Starts.end(), Members.begin(), Members.end());
+    order(Members, Starts);
+    return std::move(Order);
+  }
+
+private:
+  const AbstractStateGraph &G;
+  const unsigned N;
+  /// Per node: the region (recursion step) it currently belongs to.
+  std::vector<unsigned> Region;
+  std::vector<unsigned> Index, Low;
+  BitVector OnStack;
+  unsigned NumRegions = 0;
+  std::vector<unsigned> Order;
+
+  void order(ArrayRef<unsigned> Members, ArrayRef<unsigned> Starts);
+  /// SCCs of the region \p R, sinks first; each starts with its root.
+  std::vector<std::vector<unsigned>> findSCCs(unsigned R,
+                                              ArrayRef<unsigned> Starts);
+};
+
+std::vector<std::vector<unsigned>>
+WTOBuilder::findSCCs(unsigned R, ArrayRef<unsigned> Starts) {
+  struct Frame {
+    unsigned V;
+    /// V's position on Stack: where its SCC starts if V is the root.
+    size_t StackPos;
+    AbstractStateGraph::EdgeRange::iterator It, End;
+  };
+  std::vector<std::vector<unsigned>> SCCs;
+  std::vector<unsigned> Stack;
+  std::vector<Frame> Calls;
+  unsigned Counter = 0;
+  auto enter = [&](unsigned V) {
+    Index[V] = Low[V] = ++Counter;
+    Stack.push_back(V);
+    OnStack.set(V);
+    auto Succs = G.getSuccessors(V);
+    Calls.push_back({V, Stack.size() - 1, Succs.begin(), Succs.end()});
+  };
+
+  for (unsigned S : Starts) {
+    if (Region[S] != R || Index[S])
+      continue;
+    enter(S);
+    while (!Calls.empty()) {
+      Frame &F = Calls.back();
+      if (F.It != F.End) {
+        const unsigned V = F.V, W = (*F.It).To;
+        ++F.It;
+        if (Region[W] != R)
+          continue;
+        if (!Index[W])
+          enter(W);
+        else if (OnStack.test(W))
+          Low[V] = std::min(Low[V], Index[W]);
+        continue;
+      }
+      const unsigned V = F.V;
+      const size_t StackPos = F.StackPos;
+      Calls.pop_back();
+      if (!Calls.empty())
+        Low[Calls.back().V] = std::min(Low[Calls.back().V], Low[V]);
+      if (Low[V] != Index[V])
+        continue;
+      // V is the root; the rest of its SCC follows in search order.
+      auto Begin = Stack.begin() + StackPos;
+      std::vector<unsigned> SCC(Begin, Stack.end());
+      Stack.erase(Begin, Stack.end());
+      for (unsigned W : SCC)
+        OnStack.reset(W);
+      SCCs.push_back(std::move(SCC));
+    }
+  }
+  return SCCs;
+}
+
+void WTOBuilder::order(ArrayRef<unsigned> Members, ArrayRef<unsigned> Starts) {
+  const unsigned R = ++NumRegions;
+  for (unsigned V : Members) {
+    Region[V] = R;
+    Index[V] = 0;
+  }
+  auto SCCs = findSCCs(R, Starts);
+  for (auto &SCC : llvm::reverse(SCCs)) {
+    const unsigned Head = SCC.front();
+    Order.push_back(Head);
+    if (SCC.size() == 1)
+      continue;
+    // The component without its head, searched from the head's successors
+    // first, as Bourdoncle's algorithm does.
+    ArrayRef<unsigned> Rest = ArrayRef<unsigned>(SCC).drop_front();
+    std::vector<unsigned> RestStarts;
+    for (const auto &E : G.getSuccessors(Head))
+      if (E.To != Head && Region[E.To] == R)
+        RestStarts.push_back(E.To);
+    RestStarts.insert(RestStarts.end(), Rest.begin(), Rest.end());
+    order(Rest, RestStarts);
+  }
+}
+
+} // namespace
+
+WorklistSolver::Order WorklistSolver::parseOrder(StringRef Name) {
+  if (Name == "wto")
+    return Order::WTO;
+  if (Name != "fifo")
+    errs() << "warning: unknown -worklist-order '" << Name
+           << "' (expected 'fifo' or 'wto'); using fifo\n";
+  return Order::FIFO;
+}
+
+std::vector<unsigned>
+WorklistSolver::getWeakTopologicalOrder(const AbstractStateGraph &G) {
+  return WTOBuilder(G).build();
+}
+
+void WorklistSolver::startSchedule() {
+  const unsigned N = Graph.getNumNodes();
+  Worklist.clear();
+  Pending = {};
+  InWorklist.clear();
+  InWorklist.resize(N);
+  NumVisits = NumUpdates = NumJoins = NumTransfers = NumClones = 0;
+  if (Stats) {
+    Stats->reset(getOrderName(Schedule), N);
+    StartTime = std::chrono::steady_clock::now();
+  }
+  if (Schedule != Order::WTO)
+    return;
+  NodeAt = getWeakTopologicalOrder(Graph);
+  Position.assign(N, 0);
+  for (unsigned P = 0; P < N; ++P)
+    Position[NodeAt[P]] = P;
+}
+
+void WorklistSolver::finishRun() {
+  addFixpointStatistics(NumVisits, NumUpdates, NumJoins, NumTransfers,
+                        NumClones);
+  if (!Stats)
+    return;
+  Stats->Visits = NumVisits;
+  Stats->Updates = NumUpdates;
+  Stats->Joins = NumJoins;
+  Stats->Transfers = NumTransfers;
+  Stats->Clones = NumClones;
+  Stats->Seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - StartTime)
+                       .count();
+}
+
 void WorklistSolver::addToWorklist(unsigned NodeId) {
-  if (InWorklist.find(NodeId) == InWorklist.end()) {
+  if (InWorklist.test(NodeId))
+    return;
+  InWorklist.set(NodeId);
+  if (Schedule == Order::WTO)
+    Pending.push(Position[NodeId]);
+  else
     Worklist.push_back(NodeId);
-    InWorklist.insert(NodeId);
-  }
 }
 
 unsigned WorklistSolver::takeFromWorklist() {
-  unsigned NodeId = Worklist.front();
-  Worklist.pop_front();
-  InWorklist.erase(NodeId);
+  unsigned NodeId;
+  if (Schedule == Order::WTO) {
+    NodeId = NodeAt[Pending.top()];
+    Pending.pop();
+  } else {
+    NodeId = Worklist.front();
+    Worklist.pop_front();
+  }
+  InWorklist.reset(NodeId);
   return NodeId;
 }
 
@@ -81,10 +267,9 @@ void WorklistSolver::initializeGraph(
     }
   }
 
-  // Initialize worklist with entry block
+  // Mark the entry block; run() seeds the worklist with it.
   if (!MF.empty()) {
     unsigned EntryId = MBBToNodeMap[&MF.front()];
-    addToWorklist(EntryId);
     if (auto *N = Graph.getNode(EntryId)) {
       N->IsEntry = true;
     }
@@ -122,119 +307,79 @@ void WorklistSolver::initializeGraph(
 }
 
 void WorklistSolver::initializeGraph(const ProgramGraph &PG) {
-  // Map PG Node ID -> ASG Node ID
-  std::map<unsigned, unsigned> PGToASGMap;
-
-  // Build ID -> MBB map for PG
-  std::map<unsigned, const MachineBasicBlock *> NodeToMBBMap;
-  for (const auto &Pair : PG.MBBToNodeMap) {
-    NodeToMBBMap[Pair.second] = Pair.first;
-  }
-
-  // 1. Create Nodes
-  for (const auto &Pair : PG.getNodes()) {
-    const auto &PGNode = Pair.second;
-
-    auto InitialState = Analysis.getInitialState();
-    // Use const_cast because AbstractStateGraph currently stores non-const
-    // MBB*? Check definition: Node stores MachineBasicBlock *MBB.
-
-    // CRITICAL FIX: The MBB pointers in ProgramGraph might be dangling (if
-    // functions are deleted). The ProgramGraph nodes already contain the
-    // computed Latency/Cost in their State. We should use that Cost and NOT
-    // attempt to re-process instructions (which would segfault). We pass
-    // nullptr for MBB to signal "No instructions available / Summarized Node".
-    unsigned ASGNodeId =
-        Graph.addNode(std::move(InitialState),
-                      nullptr /* const_cast<MachineBasicBlock *>(MBB) */);
-    PGToASGMap[PGNode.Id] = ASGNodeId;
-
-    if (auto *N = Graph.getNode(ASGNodeId)) {
-      // N->Name does not exist.
-      // Copy Cost from ProgramGraph Node State
-      N->Cost = PGNode.getState().getUpperBoundCycles();
-
-      if (!PGNode.BackEdgePredecessors.empty()) {
-        N->IsLoopHeader = true;
-        N->UpperLoopBound = PGNode.UpperLoopBound;
-      }
-      if (PGNode.Name == "Entry")
-        N->IsEntry = true;
-      if (PGNode.Name == "Exit")
-        N->IsExit = true;
-    }
-  }
-
-  // 2. Add Edges
-  for (const auto &Pair : PG.getNodes()) {
-    const auto &PGNode = Pair.second;
-    unsigned FromASG = PGToASGMap[PGNode.Id];
-
-    for (unsigned SuccId : PGNode.getSuccessors()) {
-      if (PGToASGMap.count(SuccId)) {
-        unsigned ToASG = PGToASGMap[SuccId];
-
-        bool IsBackEdge = false;
-        // Check if Succ considers THIS node a BackEdgePredecessor
-        if (PG.getNodes().count(SuccId)) {
-          const auto &SuccNode = PG.getNodes().at(SuccId);
-          if (SuccNode.BackEdgePredecessors.count(PGNode.Id)) {
-            IsBackEdge = true;
-          }
-        }
-        Graph.addEdge(FromASG, ToASG, IsBackEdge);
-      }
-    }
-  }
-
-  // 3. Set Entry/Exit
-  for (const auto &Pair : PG.getNodes()) {
-    const auto &PGNode = Pair.second;
-    unsigned ASGNodeId = PGToASGMap[PGNode.Id];
-    if (auto *N = Graph.getNode(ASGNodeId)) {
-      if (PGNode.getPredecessors().empty())
-        N->IsEntry = true;
-      if (PGNode.getSuccessors().empty())
-        N->IsExit = true;
+  // View the frozen CSR arrays finalize() produced instead of copying them:
+  // node I of the ASG is PG's dense node I, and only the analysis data (state,
+  // cost, loop and entry/exit flags) is stored per node.
+  assert(PG.isFrozen() && "ProgramGraph must be finalized (frozen) first");
+  // The MBB pointers in ProgramGraph may dangle (MachineFunctions are freed
+  // after their pass chain), so nodes carry no MBB: the cost already computed
+  // into each PG node's state is used and no instructions are re-processed.
+  Graph.attachTo(PG, [&] { return Analysis.getInitialState(); });
+  unsigned NumNodes = PG.getNumDenseNodes();
+
+  for (unsigned I = 0; I < NumNodes; ++I) {
+    const auto &PGNode = PG.getDenseNode(I);
+    auto *N = Graph.getNode(I);
+    N->Cost = PGNode.getState().getUpperBoundCycles();
+
+    if (!PGNode.BackEdgePredecessors.empty()) {
+      N->IsLoopHeader = true;
+      N->UpperLoopBound = PGNode.UpperLoopBound;
     }
+    // Sources are entries and sinks are exits (this covers the synthetic
+    // Entry/Exit nodes as well).
+    if (PGNode.Name == "Entry" || PG.getPredecessorIndices(I).empty())
+      N->IsEntry = true;
+    if (PGNode.Name == "Exit" || PG.getSuccessorIndices(I).empty())
+      N->IsExit = true;
   }
 
-  // 4. IP Info
+  // IP info, translated from PG node ids to dense indices.
+  auto toASG = [&](unsigned PGNodeId, unsigned &ASGNodeId) {
+    ASGNodeId = PG.getDenseIndex(PGNodeId);
+    return ASGNodeId != ProgramGraph::InvalidIndex;
+  };
   for (const auto &Pair : PG.FunctionToEntryNodeMap) {
-    if (PGToASGMap.count(Pair.second)) {
-      Graph.FunctionEntries[Pair.first] = PGToASGMap[Pair.second];
-    }
+    unsigned ASGId;
+    if (toASG(Pair.second, ASGId))
+      Graph.FunctionEntries[Pair.first] = ASGId;
   }
   for (const auto &Pair : PG.FunctionToReturnNodesMap) {
     for (unsigned RetID : Pair.second) {
-      if (PGToASGMap.count(RetID)) {
-        Graph.FunctionReturns[Pair.first].push_back(PGToASGMap[RetID]);
-      }
+      unsigned ASGId;
+      if (toASG(RetID, ASGId))
+        Graph.FunctionReturns[Pair.first].push_back(ASGId);
     }
   }
   // Carry call sites into the ASG so the ILP can add context-sensitive
   // call/return matching constraints. Only sites with a wired return landing
   // whose endpoints survived reachability pruning are kept; the ASG stores the
   // landing as ReturnNodeId (the block control returns to after the call).
-  for (const auto &CS : PG.CallSites) {
-    if (!CS.HasLanding)
-      continue;
-    if (!PGToASGMap.count(CS.CallNode) || !PGToASGMap.count(CS.LandingNode))
-      continue;
-    Graph.CallSites.push_back(
-        {PGToASGMap[CS.CallNode], PGToASGMap[CS.LandingNode], CS.Callee});
-  }
-
-  // Worklist: Add all entries
-  for (const auto &Pair : Graph.getNodes()) {
-    if (Pair.second->IsEntry) {
-      addToWorklist(Pair.first);
+  // With context expansion every call site names its own callee instance.
+  if (!PG.ContextCallSites.empty()) {
+    for (const auto &CS : PG.ContextCallSites) {
+      unsigned CallASG, LandingASG, EntryASG;
+      if (!toASG(CS.CallNode, CallASG) || !toASG(CS.LandingNode, LandingASG) ||
+          !toASG(CS.EntryNode, EntryASG))
+        continue;
+      Graph.CallSites.push_back({CallASG, LandingASG, CS.Callee, EntryASG});
+      for (unsigned RetID : CS.ReturnNodes) {
+        unsigned ASGId;
+        if (toASG(RetID, ASGId))
+          Graph.CallSites.back().ReturnNodeIds.push_back(ASGId);
+      }
+    }
+  } else {
+    for (const auto &CS : PG.CallSites) {
+      if (!CS.HasLanding)
+        continue;
+      unsigned CallASG, LandingASG;
+      if (!toASG(CS.CallNode, CallASG) || !toASG(CS.LandingNode, LandingASG))
+        continue;
+      Graph.CallSites.push_back({CallASG, LandingASG, CS.Callee});
     }
   }
 
-  // Identifiy Entry/Exit for ASG (if needed) from PG names
-  // ...
-
   llvm::errs() << "Initialized ASG from PG: " << Graph.getNodes().size()
                << " nodes.\n";
 }
@@ -245,32 +390,34 @@ void WorklistSolver::run(const ProgramGraph &PG) {
   // Initialize worklist with Entry node (assumed 0 or find it)
   // PG Entry is usually 0? Check PG.
   // We need to find the node corresponding to PG Entry.
-  // In initializeGraph we iterated PG.getNodes(). The mapping is PGToASGMap.
-  // We should find the entry node.
-
-  // For now, assume simple iteration adds them.
-  // Graph.getNodes() is a map.
+  // Graph node ids are PG dense indices (see initializeGraph).
 
   if (Graph.getNodes().empty())
     return;
 
-  // Add all nodes to worklist initially? Or just entry?
-  // Standard worklist: Add Entry.
-  // Since we rely on PGToASGMap which is local to initializeGraph,
-  // we might need to expose it or iterate keys.
-
-  // Let's add ALL nodes to worklist to be safe, or find Entry.
-  for (auto &Pair : Graph.getNodes()) {
-    addToWorklist(Pair.first);
+  // Entries first, then every node. Under WTO only the order matters, so
+  // this is one sweep in that order.
+  startSchedule();
+  if (Stats && Stats->NodeNames.empty())
+    for (unsigned I = 0; I < PG.getNumDenseNodes(); ++I)
+      Stats->NodeNames.push_back(PG.getDenseNode(I).Name.str());
+  for (const auto &N : Graph.getNodes())
+    if (N.IsEntry)
+      addToWorklist(N.Id);
+  for (const auto &N : Graph.getNodes()) {
+    addToWorklist(N.Id);
   }
 
   llvm::errs() << "Starting Worklist Algorithm...\n";
 
-  while (!Worklist.empty()) {
+  while (!isWorklistEmpty()) {
     unsigned NodeId = takeFromWorklist();
     auto *Node = Graph.getNode(NodeId);
     if (!Node)
       continue;
+    ++NumVisits;
+    if (Stats)
+      ++Stats->NodeVisits[NodeId];
 
     // 1. Join predecessors
     std::unique_ptr<AbstractState> InState = Analysis.getInitialState();
@@ -280,9 +427,11 @@ void WorklistSolver::run(const ProgramGraph &PG) {
       if (PredNode) {
         if (FirstPred) {
           InState = PredNode->State->clone();
+          ++NumClones;
           FirstPred = false;
         } else {
           InState->join(PredNode->State.get());
+          ++NumJoins;
         }
       }
     }
@@ -290,6 +439,7 @@ void WorklistSolver::run(const ProgramGraph &PG) {
     // 2. Process
     unsigned BlockCost = 0;
     if (Node->MBB) {
+      ++NumTransfers;
       // llvm::errs() << "Processing Node " << NodeId << " with MBB " <<
       // Node->MBB->getName() << "\n";
       for (const auto &MI : *Node->MBB) {
@@ -307,6 +457,9 @@ void WorklistSolver::run(const ProgramGraph &PG) {
 
     // 3. Update
     if (!Node->State->equals(InState.get())) {
+      ++NumUpdates;
+      if (Stats)
+        Stats->addStateSize(InState->getSize());
       Node->State = std::move(InState);
       for (const auto &Edge : Graph.getSuccessors(NodeId)) {
         addToWorklist(Edge.To);
@@ -314,19 +467,35 @@ void WorklistSolver::run(const ProgramGraph &PG) {
     }
   }
 
-  llvm::errs() << "Worklist Analysis Complete.\n";
+  finishRun();
+  llvm::errs() << "Worklist Analysis Complete: " << NumVisits << " visits, "
+               << NumUpdates << " updates over " << Graph.getNumNodes()
+               << " nodes (" << getOrderName(Schedule) << " order).\n";
 }
 
 void WorklistSolver::run(
     MachineFunction &MF, MachineLoopInfo *MLI,
     const std::map<const MachineBasicBlock *, unsigned> *LoopBounds) {
+  // initializeGraph() adds one node per block in layout order, so the entry
+  // block's node is the first one it adds.
+  const unsigned EntryId = Graph.getNumNodes();
   initializeGraph(MF, MLI, LoopBounds);
+  startSchedule();
+  if (Stats && Stats->NodeNames.empty())
+    for (const auto &N : Graph.getNodes())
+      Stats->NodeNames.push_back(
+          N.MBB ? ("bb." + Twine(N.MBB->getNumber())).str() : "");
+  if (!MF.empty())
+    addToWorklist(EntryId);
 
-  while (!Worklist.empty()) {
+  while (!isWorklistEmpty()) {
     unsigned NodeId = takeFromWorklist();
     auto *Node = Graph.getNode(NodeId);
     if (!Node)
       continue;
+    ++NumVisits;
+    if (Stats)
+      ++Stats->NodeVisits[NodeId];
 
     // 1. Join predecessors (meet operator)
     std::unique_ptr<AbstractState> InState =
@@ -340,9 +509,11 @@ void WorklistSolver::run(
       if (PredNode) {
         if (FirstPred) {
           InState = PredNode->State->clone();
+          ++NumClones;
           FirstPred = false;
         } else {
           InState->join(PredNode->State.get());
+          ++NumJoins;
         }
       }
     }
@@ -358,6 +529,7 @@ void WorklistSolver::run(
     // We modify InState in place
     unsigned BlockCost = 0;
     if (Node->MBB) {
+      ++NumTransfers;
       for (const auto &MI : *Node->MBB) {
         BlockCost += Analysis.process(InState.get(), &MI);
       }
@@ -369,6 +541,9 @@ void WorklistSolver::run(
 
     // 3. Check for change and update
     if (!Node->State->equals(InState.get())) {
+      ++NumUpdates;
+      if (Stats)
+        Stats->addStateSize(InState->getSize());
       Node->State = std::move(InState);
       // Add successors to worklist
       for (const auto &Edge : Graph.getSuccessors(NodeId)) {
@@ -376,6 +551,7 @@ void WorklistSolver::run(
       }
     }
   }
+  finishRun();
 }
 
 } // namespace llvm
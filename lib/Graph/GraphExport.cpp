@@ -0,0 +1,258 @@
+//===- GraphExport.cpp - DOT / GraphML / JSON Lines export of ProgramGraph ===//
+//
+// Streaming writers behind ProgramGraph::exportGraph(). Each writer walks the
+// frozen view (nodes in id order, context instance nodes included, and their
+// out-edges) and writes as it goes; the per-function clusters come from
+// getNodeFunction(), whose runs are contiguous because a function's nodes are
+// allocated consecutively.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Graph/ProgramGraph.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace llvm {
+
+namespace {
+
+/**
+ * Buffers output and writes it as a sequence of independent zstd frames.
+ * Concatenated frames are a valid .zst file, so memory stays bounded by the
+ * chunk size however large the graph is.
+ */
+class ZstdFrameOStream : public raw_ostream {
+public:
+  explicit ZstdFrameOStream(raw_ostream &Out) : Out(Out) {}
+  ~ZstdFrameOStream() override {
+    flush();
+    flushChunk();
+  }
+
+private:
+  static constexpr size_t ChunkSize = 1 << 20;
+
+  raw_ostream &Out;
+  SmallVector<uint8_t, 0> Chunk;
+  SmallVector<uint8_t, 0> Compressed;
+  uint64_t Pos = 0;
+
+  void write_impl(const char *Ptr, size_t Size) override {
+    Chunk.append(Ptr, Ptr + Size);
+    Pos += Size;
+    if (Chunk.size() >= ChunkSize)
+      flushChunk();
+  }
+  uint64_t current_pos() const override { return Pos; }
+
+  void flushChunk() {
+    if (Chunk.empty())
+      return;
+    Compressed.clear();
+    compression::zstd::compress(Chunk, Compressed);
+    Out.write(reinterpret_cast<const char *>(Compressed.data()),
+              Compressed.size());
+    Chunk.clear();
+  }
+};
+
+void writeXMLEscaped(raw_ostream &OS, StringRef S) {
+  for (char C : S) {
+    switch (C) {
+    case '&':
+      OS << "&amp;";
+      break;
+    case '<':
+      OS << "&lt;";
+      break;
+    case '>':
+      OS << "&gt;";
+      break;
+    case '"':
+      OS << "&quot;";
+      break;
+    default:
+      OS << C;
+    }
+  }
+}
+
+} // namespace
+
+ProgramGraph::ExportFormat ProgramGraph::getExportFormatForPath(StringRef Path) {
+  Path.consume_back(".zst");
+  if (Path.ends_with(".graphml"))
+    return ExportFormat::GraphML;
+  if (Path.ends_with(".jsonl"))
+    return ExportFormat::JSONL;
+  return ExportFormat::DOT;
+}
+
+void ProgramGraph::exportGraph(raw_ostream &OS, ExportFormat Format) const {
+  assert(Frozen && "ProgramGraph must be frozen to be exported");
+  const unsigned NumNodes = getNumDenseNodes();
+  // Out-edges of dense node I as (target id, back edge) pairs.
+  auto forEachEdge = [&](unsigned I, auto Fn) {
+    for (unsigned E = SuccOffsets[I]; E != SuccOffsets[I + 1]; ++E)
+      Fn(DenseIds[EdgeTargets[E]], isBackEdge(E));
+  };
+
+  switch (Format) {
+  case ExportFormat::DOT: {
+    OS << "digraph MuArchStateGraph {\n";
+    OS << "  compound=true;\n"; // Allow edges between clusters
+    // Nodes, one cluster per run of same-function nodes. Nodes without a
+    // parent function (the synthetic Entry/Exit) are written outside.
+    const Function *Open = nullptr;
+    unsigned ClusterId = 0;
+    for (unsigned I = 0; I < NumNodes; ++I) {
+      const unsigned Id = DenseIds[I];
+      const Node &N = *DenseNodes[I];
+      const Function *F = getNodeFunction(Id);
+      if (F != Open) {
+        if (Open)
+          OS << "  }\n";
+        if (F) {
+          OS << "  subgraph cluster_" << ClusterId++ << " {\n";
+          OS << "    label=\"" << getFunctionName(F) << "\";\n";
+          OS << "    style=filled;\n";
+          OS << "    color=lightgrey;\n";
+          OS << "    node [style=filled,color=white];\n";
+        }
+        Open = F;
+      }
+      if (F)
+        OS << "    " << Id << " [label=\"" << N.getNodeDescr(Id)
+           << "\",color=" << (N.IsLoop ? "lightblue" : "white") << "];\n";
+      else
+        OS << "  " << Id << " [label=\"" << N.getNodeDescr(Id)
+           << " (no function)\",style=filled,color=yellow];\n";
+    }
+    if (Open)
+      OS << "  }\n";
+
+    // Edges after all clusters are defined, so no node is pulled into the
+    // wrong cluster by its first mention.
+    OS << "\n  // Edges\n";
+    for (unsigned I = 0; I < NumNodes; ++I)
+      forEachEdge(I, [&](unsigned Succ, bool) {
+        OS << "  " << DenseIds[I] << " -> " << Succ << ";\n";
+      });
+    OS << "}\n";
+    return;
+  }
+
+  case ExportFormat::GraphML: {
+    OS << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+          "  <key id=\"name\" for=\"node\" attr.name=\"name\" "
+          "attr.type=\"string\"/>\n"
+          "  <key id=\"function\" for=\"node\" attr.name=\"function\" "
+          "attr.type=\"string\"/>\n"
+          "  <key id=\"min\" for=\"node\" attr.name=\"min_cycles\" "
+          "attr.type=\"int\"/>\n"
+          "  <key id=\"max\" for=\"node\" attr.name=\"max_cycles\" "
+          "attr.type=\"int\"/>\n"
+          "  <key id=\"bound\" for=\"node\" attr.name=\"loop_bound\" "
+          "attr.type=\"int\"/>\n"
+          "  <key id=\"back\" for=\"edge\" attr.name=\"back_edge\" "
+          "attr.type=\"boolean\"/>\n"
+          "  <graph id=\"ProgramGraph\" edgedefault=\"directed\">\n";
+    for (unsigned I = 0; I < NumNodes; ++I) {
+      const unsigned Id = DenseIds[I];
+      const Node &N = *DenseNodes[I];
+      OS << "    <node id=\"n" << Id << "\">";
+      OS << "<data key=\"name\">";
+      writeXMLEscaped(OS, N.Name);
+      OS << "</data>";
+      if (const Function *F = getNodeFunction(Id)) {
+        OS << "<data key=\"function\">";
+        writeXMLEscaped(OS, getFunctionName(F));
+        OS << "</data>";
+      }
+      OS << "<data key=\"min\">" << N.getState().MinCycles << "</data>";
+      OS << "<data key=\"max\">" << N.getState().MaxCycles << "</data>";
+      if (N.IsLoop)
+        OS << "<data key=\"bound\">" << N.UpperLoopBound << "</data>";
+      OS << "</node>\n";
+    }
+    for (unsigned I = 0; I < NumNodes; ++I)
+      forEachEdge(I, [&](unsigned Succ, bool IsBack) {
+        OS << "    <edge source=\"n" << DenseIds[I] << "\" target=\"n" << Succ
+           << "\"><data key=\"back\">" << (IsBack ? "true" : "false")
+           << "</data></edge>\n";
+      });
+    OS << "  </graph>\n</graphml>\n";
+    return;
+  }
+
+  case ExportFormat::JSONL: {
+    // One self-contained JSON object per line: nodes first, then edges.
+    for (unsigned I = 0; I < NumNodes; ++I) {
+      const unsigned Id = DenseIds[I];
+      const Node &N = *DenseNodes[I];
+      json::OStream J(OS);
+      J.object([&] {
+        J.attribute("type", "node");
+        J.attribute("id", Id);
+        J.attribute("name", N.Name);
+        if (const Function *F = getNodeFunction(Id))
+          J.attribute("function", getFunctionName(F));
+        J.attribute("min_cycles", N.getState().MinCycles);
+        J.attribute("max_cycles", N.getState().MaxCycles);
+        if (N.IsLoop)
+          J.attribute("loop_bound", N.UpperLoopBound);
+      });
+      OS << "\n";
+    }
+    for (unsigned I = 0; I < NumNodes; ++I)
+      forEachEdge(I, [&](unsigned Succ, bool IsBack) {
+        json::OStream J(OS);
+        J.object([&] {
+          J.attribute("type", "edge");
+          J.attribute("from", DenseIds[I]);
+          J.attribute("to", Succ);
+          J.attribute("back_edge", IsBack);
+        });
+        OS << "\n";
+      });
+    return;
+  }
+  }
+}
+
+bool ProgramGraph::exportGraph(StringRef Path, ExportFormat Format) const {
+  bool Compress = Path.ends_with(".zst");
+  if (Compress && !compression::zstd::isAvailable()) {
+    errs() << "Error: cannot write " << Path
+           << ": LLVM was built without zstd support\n";
+    return false;
+  }
+
+  std::error_code EC;
+  raw_fd_ostream File(Path, EC, Compress ? sys::fs::OF_None : sys::fs::OF_Text);
+  if (EC) {
+    errs() << "Error opening file: " << EC.message() << "\n";
+    return false;
+  }
+  if (Compress) {
+    ZstdFrameOStream Zstd(File);
+    exportGraph(Zstd, Format);
+  } else {
+    exportGraph(File, Format);
+  }
+  File.close();
+  if (File.has_error()) {
+    errs() << "Error writing " << Path << ": " << File.error().message()
+           << "\n";
+    File.clear_error();
+    return false;
+  }
+  return true;
+}
+
+} // namespace llvm
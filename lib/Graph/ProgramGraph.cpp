@@ -1,5 +1,7 @@
 #include "Graph/ProgramGraph.h"
 #include "Targets/RTTarget.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineFunction.h"
@@ -12,10 +14,9 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Debug.h"
-#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cassert>
-#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -25,13 +26,7 @@
 namespace llvm {
 
 // Constructor
-Node::Node(unsigned NewId, std::unique_ptr<MuArchState> State)
-    : Id(NewId), State(std::move(State)) {}
-
-// Copy Constructor
-Node::Node(const Node &Node)
-    : Id(Node.Id), Successors(Node.Successors), Predecessors(Node.Predecessors),
-      State(std::make_unique<MuArchState>(*Node.State)) {}
+Node::Node(unsigned NewId, MuArchState *State) : Id(NewId), State(State) {}
 
 // Destructor
 Node::~Node() {}
@@ -43,10 +38,10 @@ bool Node::operator<(const Node &Other) const { return Id < Other.Id; }
 unsigned Node::getId() const { return Id; }
 
 // Get the predecessors of the Node
-const std::set<unsigned> Node::getPredecessors() const { return Predecessors; }
+const std::set<unsigned> &Node::getPredecessors() const { return Predecessors; }
 
 // Get the successors of the Node
-const std::set<unsigned> Node::getSuccessors() const { return Successors; }
+const std::set<unsigned> &Node::getSuccessors() const { return Successors; }
 
 // Add a successor to the Node
 void Node::addSuccessor(unsigned SuccessorId) {
@@ -82,15 +77,18 @@ bool Node::isSuccessor(unsigned SuccessorId) const {
 bool Node::isFree() const { return Successors.empty() && Predecessors.empty(); }
 
 // Get a description of the Node
-std::string Node::getNodeDescr() const {
-  std::string Descr = "ID: " + std::to_string(Id) + ", Name: " + Name.str() +
+std::string Node::getNodeDescr() const { return getNodeDescr(Id); }
+
+std::string Node::getNodeDescr(unsigned AsId) const {
+  std::string Descr = "ID: " + std::to_string(AsId) + ", Name: " + Name.str() +
                       ", Cycle:" + std::to_string(State->getUpperBoundCycles());
   if (IsLoop) {
     Descr += "\\nLoop: [" + std::to_string(LowerLoopBound) + ", " +
              std::to_string(UpperLoopBound) + "]";
   }
   if (!State->DebugInfo.empty()) {
-    Descr += "\\n" + State->DebugInfo;
+    Descr += "\\n";
+    Descr += State->DebugInfo.str();
   }
   return Descr;
 }
@@ -98,46 +96,64 @@ std::string Node::getNodeDescr() const {
 // Get the architectural state of the Node
 MuArchState &Node::getState() const { return *State; }
 
-ProgramGraph::ProgramGraph() : Nodes(), NextNodeId(0) {}
+ProgramGraph::ProgramGraph()
+    : Nodes(), NextNodeId(0), Storage(std::make_unique<Arena>()) {}
 
-ProgramGraph::ProgramGraph(ProgramGraph &G2)
-    : Nodes(G2.Nodes), NextNodeId(G2.NextNodeId) {}
+ProgramGraph::ProgramGraph(ProgramGraph &&) = default;
 
 ProgramGraph::~ProgramGraph() {}
 
-unsigned ProgramGraph::addNode(std::unique_ptr<MuArchState> State,
-                               MachineBasicBlock *MBB) {
+StringRef ProgramGraph::intern(StringRef Str) {
+  if (Str.empty())
+    return StringRef();
+  return Storage->Strings.save(Str);
+}
+
+void ProgramGraph::setNodeName(unsigned NodeId, StringRef Name) {
+  Nodes.at(NodeId).setName(intern(Name));
+}
+
+StringRef ProgramGraph::getFunctionName(const Function *F) const {
+  auto It = FunctionNames.find(F);
+  return It != FunctionNames.end() ? It->second : StringRef();
+}
+
+unsigned ProgramGraph::addNode(unsigned MinCycles, unsigned MaxCycles,
+                               MachineBasicBlock *MBB, StringRef NodeName,
+                               StringRef DebugInfo) {
   unsigned CurrentId = NextNodeId;
   NextNodeId++;
   assert(NextNodeId > 0 &&
          "We used all Node ids for the state graph. Unsigned is not enough!");
-  Node Nd(CurrentId, std::move(State));
-  // Nd.setName(MBB->getName());
-  Nodes.insert(std::make_pair(CurrentId, Nd));
+  Frozen = false;
+  MuArchState *State = new (Storage->States.Allocate())
+      MuArchState(MinCycles, MaxCycles, intern(DebugInfo));
+  auto [It, Inserted] = Nodes.try_emplace(CurrentId, CurrentId, State);
+  assert(Inserted && "Node id reused");
+  (void)Inserted;
+  It->second.setName(intern(NodeName));
   DEBUG_WITH_TYPE("ilp", dbgs() << "Adding Node with id " << CurrentId << "\n");
   if (MBB)
     MBBToNodeMap[MBB] = CurrentId;
   return CurrentId;
 }
 
+unsigned ProgramGraph::addNode(std::unique_ptr<MuArchState> State,
+                               MachineBasicBlock *MBB) {
+  return addNode(State->MinCycles, State->MaxCycles, MBB, "",
+                 State->DebugInfo);
+}
+
 unsigned ProgramGraph::addNode(std::unique_ptr<MuArchState> State,
                                MachineBasicBlock *MBB, StringRef NodeName) {
-  unsigned CurrentId = NextNodeId;
-  NextNodeId++;
-  assert(NextNodeId > 0 &&
-         "We used all Node ids for the state graph. Unsigned is not enough!");
-  Node Nd(CurrentId, std::move(State));
-  // Nd.setName(NodeName);
-  Nodes.insert(std::make_pair(CurrentId, Nd));
-  DEBUG_WITH_TYPE("ilp", dbgs() << "Adding Node with id " << CurrentId << "\n");
-  if (MBB)
-    MBBToNodeMap[MBB] = CurrentId;
-  return CurrentId;
+  return addNode(State->MinCycles, State->MaxCycles, MBB, NodeName,
+                 State->DebugInfo);
 }
 
 void ProgramGraph::addEdge(unsigned FromNode, unsigned ToNode) {
   assert(Nodes.count(FromNode) == 1 && Nodes.count(ToNode) == 1 &&
          "Tried adding an edge between non-existent Nodes.");
+  Frozen = false;
   Nodes.at(FromNode).addSuccessor(ToNode);
   Nodes.at(ToNode).addPredecessor(FromNode);
 }
@@ -145,117 +161,161 @@ void ProgramGraph::addEdge(unsigned FromNode, unsigned ToNode) {
 void ProgramGraph::removeNode(unsigned Node) {
   assert(Nodes.at(Node).isFree() &&
          "Tried to remove a Node which has an edge connected!");
+  Frozen = false;
   Nodes.erase(Node);
 }
 
 void ProgramGraph::removeEdge(unsigned FromNode, unsigned ToNode) {
+  Frozen = false;
   Nodes.at(FromNode).deleteSuccessor(ToNode);
   Nodes.at(ToNode).deletePredecessor(FromNode);
 }
 
-const std::set<unsigned> ProgramGraph::getPredecessors(unsigned NodeId) const {
+const std::set<unsigned> &
+ProgramGraph::getPredecessors(unsigned NodeId) const {
   return Nodes.at(NodeId).getPredecessors();
 }
 
-const std::set<unsigned> ProgramGraph::getSuccessors(unsigned NodeId) const {
+const std::set<unsigned> &ProgramGraph::getSuccessors(unsigned NodeId) const {
   return Nodes.at(NodeId).getSuccessors();
 }
 
 const std::map<unsigned, Node> &ProgramGraph::getNodes() const { return Nodes; }
 
-bool ProgramGraph::isFree(unsigned Node) const {
-  return Nodes.at(Node).isFree();
-}
+void ProgramGraph::freeze() {
+  // Dense order is id order: the nodes with records, merged with the nodes of
+  // the context instances (whose ids usually all follow them).
+  std::vector<std::pair<unsigned, const Node *>> Order;
+  Order.reserve(Nodes.size());
+  for (const auto &[Id, Nd] : Nodes)
+    Order.push_back({Id, &Nd});
+  const size_t NumRecords = Order.size();
+  for (const ContextInstance &I : ContextInstances)
+    for (unsigned T = I.First; T != I.End; ++T) {
+      unsigned Id = I.Base + (T - I.First);
+      if (!PrunedInstanceNodes.count(Id))
+        Order.push_back({Id, &getNodeOrTemplate(T)});
+    }
+  std::inplace_merge(Order.begin(), Order.begin() + NumRecords, Order.end(),
+                     llvm::less_first());
+
+  unsigned NumNodes = Order.size();
+  DenseNodes.clear();
+  DenseNodes.reserve(NumNodes);
+  DenseIds.clear();
+  DenseIds.reserve(NumNodes);
+  IdToDense.assign(NextNodeId, InvalidIndex);
+  for (const auto &[Id, Nd] : Order) {
+    IdToDense[Id] = DenseNodes.size();
+    DenseNodes.push_back(Nd);
+    DenseIds.push_back(Id);
+  }
 
-bool ProgramGraph::hasEdge(unsigned FromNode, unsigned ToNode) const {
-  return Nodes.at(FromNode).isSuccessor(ToNode);
+  // Out-edges: one pass in dense order, so each node's edges are contiguous
+  // and sorted by target.
+  SuccOffsets.assign(NumNodes + 1, 0);
+  EdgeSources.clear();
+  EdgeTargets.clear();
+  EdgeIsBackEdge.clear();
+  PredOffsets.assign(NumNodes + 1, 0);
+  std::vector<unsigned> Succs;
+  for (unsigned I = 0; I < NumNodes; ++I) {
+    const unsigned Id = DenseIds[I];
+    SuccOffsets[I] = EdgeTargets.size();
+    Succs.clear();
+    appendSuccessors(Id, Succs);
+    for (unsigned &Succ : Succs) {
+      Succ = IdToDense[Succ];
+      assert(Succ != InvalidIndex && "edge to a node missing from the graph");
+    }
+    llvm::sort(Succs);
+    Succs.erase(std::unique(Succs.begin(), Succs.end()), Succs.end());
+    // Back edges are intra-function, so an instance's are its template's.
+    const unsigned TemplateId = getTemplateId(Id);
+    for (unsigned T : Succs) {
+      EdgeSources.push_back(I);
+      EdgeTargets.push_back(T);
+      EdgeIsBackEdge.push_back(
+          DenseNodes[T]->BackEdgePredecessors.count(TemplateId) ? 1 : 0);
+      ++PredOffsets[T + 1];
+    }
+  }
+  SuccOffsets[NumNodes] = EdgeTargets.size();
+
+  // In-edges: counting sort of the edge list by target. Edges are visited in
+  // ascending source order, so each node's predecessors stay sorted as well.
+  for (unsigned I = 0; I < NumNodes; ++I)
+    PredOffsets[I + 1] += PredOffsets[I];
+  PredSources.resize(EdgeTargets.size());
+  PredEdges.resize(EdgeTargets.size());
+  std::vector<unsigned> Fill(PredOffsets.begin(), PredOffsets.end() - 1);
+  for (unsigned E = 0; E < EdgeTargets.size(); ++E) {
+    unsigned Slot = Fill[EdgeTargets[E]]++;
+    PredSources[Slot] = EdgeSources[E];
+    PredEdges[Slot] = E;
+  }
+
+  Frozen = true;
 }
 
-void ProgramGraph::dump() const {
-  for (const auto &Nd : Nodes) {
-    errs() << Nd.second.getNodeDescr();
-  }
+const ProgramGraph::ContextInstance *
+ProgramGraph::findInstance(unsigned Id) const {
+  auto It = llvm::upper_bound(ContextInstances, Id,
+                              [](unsigned Id, const ContextInstance &I) {
+                                return Id < I.Base;
+                              });
+  if (It == ContextInstances.begin())
+    return nullptr;
+  --It;
+  return Id - It->Base < It->End - It->First ? &*It : nullptr;
 }
 
-bool ProgramGraph::dump2Dot(StringRef FileName) {
-  std::error_code EC;
-  raw_fd_ostream File(FileName, EC, sys::fs::OF_Text);
-  if (EC) {
-    errs() << "Error opening file: " << EC.message() << "\n";
-    return false;
-  }
+unsigned ProgramGraph::getTemplateId(unsigned Id) const {
+  const ContextInstance *I = findInstance(Id);
+  return I ? I->First + (Id - I->Base) : Id;
+}
 
-  // Group nodes by function
-  std::map<const Function *, std::vector<unsigned>> FunctionToNodes;
-  std::vector<unsigned int> NodesWithoutFunction =
-      getNodesNotInMBBMap(); // Nodes without a parent function
-
-  // Use NodeToFunctionMap (populated at insertion time) instead of walking
-  // MBBToNodeMap. The MBB pointers may dangle here because per-function
-  // MachineFunctions are released after their pass chain runs, but the IR
-  // Function pointers we captured remain valid for the module's lifetime.
-  for (const auto &[NodeId, F] : NodeToFunctionMap) {
-    if (F) {
-      FunctionToNodes[F].push_back(NodeId);
-      if (DebugPrints)
-        outs() << "Mapping Node ID " << NodeId << " in Function "
-               << F->getName() << "\n";
-    } else {
-      NodesWithoutFunction.push_back(NodeId);
-    }
-  }
+const Function *ProgramGraph::getNodeFunction(unsigned Id) const {
+  if (const ContextInstance *I = findInstance(Id))
+    return I->F;
+  auto It = NodeToFunctionMap.find(Id);
+  return It == NodeToFunctionMap.end() ? nullptr : It->second;
+}
 
-  // Write the header
-  File << "digraph MuArchStateGraph {\n";
-  File << "  compound=true;\n"; // Allow edges between clusters
-
-  unsigned ClusterId = 0;
-
-  // Write clusters (subgraphs) for each function
-  for (const auto &[MF, NodeIds] : FunctionToNodes) {
-    File << "  subgraph cluster_" << ClusterId++ << " {\n";
-    File << "    label=\"" << MF->getName().str() << "\";\n";
-    File << "    style=filled;\n";
-    File << "    color=lightgrey;\n";
-    File << "    node [style=filled,color=white];\n";
-
-    // Write nodes in this cluster
-    for (unsigned NodeId : NodeIds) {
-      const auto &Node = Nodes.at(NodeId);
-      std::string Color = Node.IsLoop ? "lightblue" : "white";
-      File << "    " << Node.getId() << " [label=\"" << Node.getNodeDescr()
-           << "\",color=" << Color << "];\n";
-    }
+const Node &ProgramGraph::getNodeOrTemplate(unsigned Id) const {
+  auto It = Nodes.find(Id);
+  return It != Nodes.end() ? It->second : TemplateNodes.at(Id);
+}
 
-    File << "  }\n";
+void ProgramGraph::appendSuccessors(unsigned Id,
+                                   std::vector<unsigned> &Succs) const {
+  if (const ContextInstance *I = findInstance(Id)) {
+    for (unsigned Succ :
+         getNodeOrTemplate(I->First + (Id - I->Base)).Successors)
+      if (Succ >= I->First && Succ < I->End)
+        Succs.push_back(I->Base + (Succ - I->First));
+  } else {
+    const Node &Nd = Nodes.at(Id);
+    Succs.insert(Succs.end(), Nd.Successors.begin(), Nd.Successors.end());
   }
+  auto Range = std::equal_range(ContextEdges.begin(), ContextEdges.end(),
+                                std::make_pair(Id, 0u), llvm::less_first());
+  for (auto It = Range.first; It != Range.second; ++It)
+    Succs.push_back(It->second);
+}
 
-  // Write nodes without a parent function (outside clusters)
-  if (!NodesWithoutFunction.empty()) {
-    File << "\n  // Nodes without parent function\n";
-    File << "  node [style=filled,color=yellow];\n"; // Different style for
-                                                     // orphan nodes
+bool ProgramGraph::isFree(unsigned Node) const {
+  return Nodes.at(Node).isFree();
+}
 
-    for (unsigned NodeId : NodesWithoutFunction) {
-      const auto &Node = Nodes.at(NodeId);
-      File << "  " << Node.getId() << " [label=\"" << Node.getNodeDescr()
-           << " (no function)\"];\n";
-    }
-  }
+bool ProgramGraph::hasEdge(unsigned FromNode, unsigned ToNode) const {
+  return Nodes.at(FromNode).isSuccessor(ToNode);
+}
 
-  // Write edges (after all clusters are defined)
-  File << "\n  // Edges\n";
-  for (const auto &NodePair : Nodes) {
-    const auto &Node = NodePair.second;
-    for (unsigned Succ : Node.getSuccessors()) {
-      File << "  " << Node.getId() << " -> " << Succ << ";\n";
-    }
+void ProgramGraph::dump() const {
+  for (const auto &Nd : Nodes) {
+    errs() << Nd.second.getNodeDescr();
   }
-
-  // Write the footer
-  File << "}\n";
-  File.close();
-  return true;
 }
 
 std::vector<unsigned> ProgramGraph::getNodesNotInMBBMap() const {
@@ -329,10 +389,8 @@ bool ProgramGraph::fillGraphWithFunction(
   unsigned int EntryNode = 0;
 
   if (IsEntry) {
-    EntryNode = addNode(std::make_unique<MuArchState>(0, 0), nullptr);
-    ExitNode = addNode(std::make_unique<MuArchState>(0, 0), nullptr);
-    Nodes.at(EntryNode).setName(StringRef("Entry"));
-    Nodes.at(ExitNode).setName(StringRef("Exit"));
+    EntryNode = addNode(0, 0, nullptr, "Entry");
+    ExitNode = addNode(0, 0, nullptr, "Exit");
     EntryNodeId = EntryNode;
     HasEntryNode = true;
     StartFunction = &MF.getFunction();
@@ -342,6 +400,8 @@ bool ProgramGraph::fillGraphWithFunction(
   // the subset that are return blocks; the synthetic Entry/Exit edges are then
   // wired by wireEntryExit() (a pure helper, so the empty-function and
   // no-return-block cases are unit-testable without a MachineFunction).
+  FunctionNames[&MF.getFunction()] = intern(MF.getName());
+  unsigned FirstBodyId = NextNodeId;
   std::vector<unsigned> BodyNodeIds;
   std::vector<unsigned> ReturnNodeIds;
   for (auto &MBB : MF) {
@@ -350,8 +410,9 @@ bool ProgramGraph::fillGraphWithFunction(
     //  add ti the graph as unique ptr
     auto It = MBBLatencyMap.find(&MBB);
     unsigned Latency = (It != MBBLatencyMap.end()) ? It->second : 0;
-    addNode(std::make_unique<MuArchState>(Latency, Latency), &MBB);
-    unsigned CurrentNode = MBBToNodeMap[&MBB];
+    // The MBB name is interned: the MachineFunction may be freed before the
+    // graph is dumped.
+    unsigned CurrentNode = addNode(Latency, Latency, &MBB, MBB.getName());
     NodeToFunctionMap[CurrentNode] = &MF.getFunction();
     BodyNodeIds.push_back(CurrentNode);
 
@@ -367,11 +428,10 @@ bool ProgramGraph::fillGraphWithFunction(
       }
     }
 
-    // Add name for the node + Function name
-    Nodes.at(CurrentNode).setName(MBB.getName());
     if (MBB.isReturnBlock())
       ReturnNodeIds.push_back(CurrentNode);
   }
+  FunctionNodeRanges[&MF.getFunction()] = {FirstBodyId, NextNodeId};
   if (IsEntry)
     wireEntryExit(BodyNodeIds, ReturnNodeIds, EntryNode, ExitNode);
 
@@ -478,46 +538,245 @@ void ProgramGraph::fillGraph(
 }
 
 namespace {
-// DFS over the SCC-internal call edges starting from the given entry functions;
-// a call edge f->g where g is currently on the DFS stack (gray) is a
-// cycle-closing back edge. Returns the (caller, callee) back-edge pairs. This
-// is the call-graph lift of the retreating-edge scan used to bound irreducible
-// machine loops: the back edge's target becomes the cycle "header".
-std::set<std::pair<const Function *, const Function *>> findSCCBackEdges(
-    const std::set<const Function *> &SCC,
-    const std::set<const Function *> &Entries,
-    const std::map<const Function *, std::set<const Function *>> &CallAdj) {
-  std::set<std::pair<const Function *, const Function *>> BackEdges;
-  std::map<const Function *, int> Color; // 0 white, 1 gray, 2 black
-  std::function<void(const Function *)> Dfs = [&](const Function *F) {
-    Color[F] = 1;
-    auto It = CallAdj.find(F);
-    if (It != CallAdj.end())
-      for (const Function *G : It->second) {
-        if (!SCC.count(G))
-          continue; // stay inside the SCC
-        if (Color[G] == 1)
-          BackEdges.insert({F, G});
-        else if (Color[G] == 0)
-          Dfs(G);
+/// Function-level call graph over dense indices, built once from the captured
+/// call sites. Functions are numbered in first-appearance order and every
+/// adjacency list is deduplicated, so all walks below are O(V+E) and
+/// independent of pointer values.
+struct CallGraphIndex {
+  std::vector<const Function *> Functions;
+  DenseMap<const Function *, unsigned> Index;
+  std::vector<std::vector<unsigned>> Callees;
+  /// Callee index -> positions in ProgramGraph::CallSites calling it, used to
+  /// find the call nodes of a (caller, callee) back edge without rescanning.
+  std::vector<std::vector<unsigned>> CallSitesByCallee;
+
+  unsigned getOrAdd(const Function *F) {
+    auto [It, Inserted] = Index.try_emplace(F, Functions.size());
+    if (Inserted) {
+      Functions.push_back(F);
+      Callees.emplace_back();
+      CallSitesByCallee.emplace_back();
+    }
+    return It->second;
+  }
+};
+
+/// Tarjan's SCC algorithm (iterative, so deep call chains cannot overflow the
+/// native stack). Returns the component id of every function; ids are
+/// assigned in reverse topological order of the condensation.
+std::vector<unsigned> computeCallSCCs(const CallGraphIndex &CG,
+                                      unsigned &NumSCCs) {
+  const unsigned N = CG.Functions.size();
+  constexpr unsigned Unvisited = ~0u;
+  std::vector<unsigned> DFSNum(N, Unvisited), LowLink(N), Component(N);
+  std::vector<bool> OnStack(N, false);
+  std::vector<unsigned> Stack;
+  // (vertex, next adjacency position) frames of the explicit DFS.
+  std::vector<std::pair<unsigned, unsigned>> Frames;
+  unsigned NextNum = 0;
+  NumSCCs = 0;
+  for (unsigned Root = 0; Root < N; ++Root) {
+    if (DFSNum[Root] != Unvisited)
+      continue;
+    Frames.push_back({Root, 0});
+    DFSNum[Root] = LowLink[Root] = NextNum++;
+    Stack.push_back(Root);
+    OnStack[Root] = true;
+    while (!Frames.empty()) {
+      auto &[V, Pos] = Frames.back();
+      if (Pos < CG.Callees[V].size()) {
+        unsigned W = CG.Callees[V][Pos++];
+        if (DFSNum[W] == Unvisited) {
+          DFSNum[W] = LowLink[W] = NextNum++;
+          Stack.push_back(W);
+          OnStack[W] = true;
+          Frames.push_back({W, 0});
+        } else if (OnStack[W]) {
+          LowLink[V] = std::min(LowLink[V], DFSNum[W]);
+        }
+        continue;
+      }
+      unsigned Done = V;
+      Frames.pop_back();
+      if (!Frames.empty())
+        LowLink[Frames.back().first] =
+            std::min(LowLink[Frames.back().first], LowLink[Done]);
+      if (LowLink[Done] != DFSNum[Done])
+        continue;
+      unsigned W;
+      do {
+        W = Stack.back();
+        Stack.pop_back();
+        OnStack[W] = false;
+        Component[W] = NumSCCs;
+      } while (W != Done);
+      ++NumSCCs;
+    }
+  }
+  return Component;
+}
+
+/// DFS over the SCC-internal call edges starting from the SCC's external
+/// entries; a call edge f->g where g is currently on the DFS stack (gray) is a
+/// cycle-closing back edge. Appends the (caller, callee) back-edge pairs. This
+/// is the call-graph lift of the retreating-edge scan used to bound irreducible
+/// machine loops: the back edge's target becomes the cycle "header". \p Color
+/// is shared across SCCs (0 white, 1 gray, 2 black); each function is visited
+/// once overall.
+void findSCCBackEdges(const CallGraphIndex &CG,
+                      const std::vector<unsigned> &Component, unsigned SCC,
+                      const std::vector<unsigned> &Members,
+                      const std::vector<unsigned> &Entries,
+                      std::vector<uint8_t> &Color,
+                      std::vector<std::pair<unsigned, unsigned>> &BackEdges) {
+  std::vector<std::pair<unsigned, unsigned>> Frames;
+  auto Dfs = [&](unsigned Root) {
+    if (Color[Root] != 0)
+      return;
+    Color[Root] = 1;
+    Frames.push_back({Root, 0});
+    while (!Frames.empty()) {
+      auto &[F, Pos] = Frames.back();
+      if (Pos == CG.Callees[F].size()) {
+        Color[F] = 2;
+        Frames.pop_back();
+        continue;
+      }
+      unsigned G = CG.Callees[F][Pos++];
+      if (Component[G] != SCC)
+        continue; // stay inside the SCC
+      if (Color[G] == 1) {
+        BackEdges.push_back({F, G});
+      } else if (Color[G] == 0) {
+        Color[G] = 1;
+        Frames.push_back({G, 0});
       }
-    Color[F] = 2;
+    }
   };
-  for (const Function *E : Entries)
-    if (Color[E] == 0)
-      Dfs(E);
+  for (unsigned E : Entries)
+    Dfs(E);
   // Members not reached from an external entry (should not happen for a
   // reachable SCC) are still scanned so no cycle is missed.
-  for (const Function *M : SCC)
-    if (Color[M] == 0)
-      Dfs(M);
-  return BackEdges;
+  for (unsigned M : Members)
+    Dfs(M);
 }
 } // namespace
 
+unsigned ProgramGraph::addContextInstance(const Function *F) {
+  auto [First, End] = FunctionNodeRanges.at(F);
+  unsigned Base = NextNodeId;
+  NextNodeId += End - First;
+  assert(NextNodeId >= Base &&
+         "We used all Node ids for the state graph. Unsigned is not enough!");
+  Frozen = false;
+  ContextInstances.push_back({F, First, End, Base});
+  return Base;
+}
+
+void ProgramGraph::addContextEdge(unsigned FromNode, unsigned ToNode) {
+  if (Nodes.count(FromNode) && Nodes.count(ToNode)) {
+    addEdge(FromNode, ToNode);
+    return;
+  }
+  Frozen = false;
+  ContextEdges.push_back({FromNode, ToNode});
+}
+
+void ProgramGraph::expandCallContexts(
+    unsigned Depth, const std::set<const Function *> &Recursive) {
+  if (!StartFunction || !FunctionNodeRanges.count(StartFunction))
+    return;
+
+  // Call sites grouped by calling function (template ids).
+  std::map<const Function *, std::vector<unsigned>> SitesByCaller;
+  for (unsigned I = 0, E = CallSites.size(); I != E; ++I) {
+    auto It = NodeToFunctionMap.find(CallSites[I].CallNode);
+    if (It != NodeToFunctionMap.end() && It->second)
+      SitesByCaller[It->second].push_back(I);
+  }
+
+  // An instance is a function under a call string (of CallSites indices).
+  // The empty context is the original, context-free node range; every other
+  // instance is a ContextInstance at a per-instance id offset.
+  struct Instance {
+    const Function *F;
+    std::vector<unsigned> Context;
+    unsigned Base;
+  };
+  std::vector<Instance> Instances;
+  std::map<std::pair<const Function *, std::vector<unsigned>>, unsigned>
+      InstanceIndex;
+  std::vector<unsigned> Worklist;
+  auto getInstance = [&](const Function *F, std::vector<unsigned> Context) {
+    auto [It, Inserted] =
+        InstanceIndex.try_emplace({F, Context}, Instances.size());
+    if (Inserted) {
+      unsigned Base = Context.empty() ? FunctionNodeRanges.at(F).first
+                                      : addContextInstance(F);
+      Instances.push_back({F, std::move(Context), Base});
+      Worklist.push_back(It->second);
+    }
+    return It->second;
+  };
+  auto map = [&](unsigned Inst, unsigned TemplateId) {
+    const Instance &I = Instances[Inst];
+    return I.Base + (TemplateId - FunctionNodeRanges.at(I.F).first);
+  };
+
+  getInstance(StartFunction, {});
+  while (!Worklist.empty()) {
+    unsigned Caller = Worklist.back();
+    Worklist.pop_back();
+    auto SitesIt = SitesByCaller.find(Instances[Caller].F);
+    if (SitesIt == SitesByCaller.end())
+      continue;
+    for (unsigned Site : SitesIt->second) {
+      const CallSite &CS = CallSites[Site];
+      // Calls into the start function are never wired (see finalize()), and
+      // body-less callees were costed on the call node.
+      if (CS.Callee == StartFunction || !FunctionNodeRanges.count(CS.Callee))
+        continue;
+      std::vector<unsigned> Context;
+      if (!Recursive.count(CS.Callee)) {
+        Context = Instances[Caller].Context;
+        Context.push_back(Site);
+        if (Context.size() > Depth)
+          Context.erase(Context.begin(), Context.end() - Depth);
+      }
+      unsigned Callee = getInstance(CS.Callee, std::move(Context));
+
+      unsigned CallNode = map(Caller, CS.CallNode);
+      unsigned EntryNode = map(Callee, FunctionToEntryNodeMap.at(CS.Callee));
+      addContextEdge(CallNode, EntryNode);
+      if (!CS.HasLanding)
+        continue;
+      unsigned Landing = map(Caller, CS.LandingNode);
+      std::vector<unsigned> Returns;
+      auto RetIt = FunctionToReturnNodesMap.find(CS.Callee);
+      if (RetIt != FunctionToReturnNodesMap.end())
+        for (unsigned R : RetIt->second) {
+          Returns.push_back(map(Callee, R));
+          addContextEdge(Returns.back(), Landing);
+        }
+      ContextCallSites.push_back(
+          {CallNode, EntryNode, std::move(Returns), Landing, CS.Callee});
+    }
+  }
+  NumContextInstances = Instances.size();
+  llvm::sort(ContextEdges);
+  ContextEdges.erase(std::unique(ContextEdges.begin(), ContextEdges.end()),
+                     ContextEdges.end());
+
+  if (Verbose)
+    outs() << "Context expansion (depth " << Depth << "): "
+           << NumContextInstances << " function instance(s), "
+           << ContextCallSites.size() << " call site(s).\n";
+}
+
 bool ProgramGraph::finalize(
     MachineFunction &MF, MachineModuleInfo *MMI, const llta::RTTarget *Target,
-    const std::map<std::string, unsigned> &RecursionBounds) {
+    const std::map<std::string, unsigned> &RecursionBounds,
+    unsigned ContextDepth) {
   // Body-less external calls (declared-but-undefined IR functions like libm
   // sin/cos, and backend MO_ExternalSymbol libcalls like __mspabi_*) have no
   // node in the graph. Charge the target's cost for them if it has one, else
@@ -558,16 +817,21 @@ bool ProgramGraph::finalize(
     // Use the maps to find entry and return nodes
     if (FunctionToEntryNodeMap.find(Callee) != FunctionToEntryNodeMap.end()) {
       unsigned CaleeNode = FunctionToEntryNodeMap[Callee];
-      addEdge(CallNode, CaleeNode);
-
-      // Wire each of the callee's return blocks back to this call site's
-      // return-landing block (captured at call detection). A call with no
-      // continuation successor (HasLanding == false, e.g. a noreturn call) gets
-      // no return edge.
-      if (HasLanding && FunctionToReturnNodesMap.find(Callee) !=
-                            FunctionToReturnNodesMap.end()) {
-        for (unsigned ReturnNode : FunctionToReturnNodesMap[Callee])
-          addEdge(ReturnNode, LandingNode);
+      // With context expansion the call edges are wired per instance by
+      // expandCallContexts() below; recursion is still detected here, on the
+      // context-free nodes recursive functions keep.
+      if (ContextDepth == 0) {
+        addEdge(CallNode, CaleeNode);
+
+        // Wire each of the callee's return blocks back to this call site's
+        // return-landing block (captured at call detection). A call with no
+        // continuation successor (HasLanding == false, e.g. a noreturn call)
+        // gets no return edge.
+        if (HasLanding && FunctionToReturnNodesMap.find(Callee) !=
+                              FunctionToReturnNodesMap.end()) {
+          for (unsigned ReturnNode : FunctionToReturnNodesMap[Callee])
+            addEdge(ReturnNode, LandingNode);
+        }
       }
 
       // Self-recursion: the call edge closes a cycle back into the callee's own
@@ -604,78 +868,68 @@ bool ProgramGraph::finalize(
     }
   }
 
-  // Mutual recursion (multi-function call-graph cycles). Build the
-  // function-level call adjacency from the captured call sites, group cyclic
-  // members into SCCs, and bound each SCC like an irreducible loop: a DFS over
-  // the SCC's call edges from its external entry finds the cycle-closing back
+  // Mutual recursion (multi-function call-graph cycles). Index the
+  // function-level call graph once, split it into SCCs with a single Tarjan
+  // pass, and bound each multi-function SCC like an irreducible loop: a DFS over
+  // the SCC's call edges from its external entries finds the cycle-closing back
   // edges, and each back edge's target entry is marked as a loop header with
   // that function's recursion_bound. The IPET loop-bound row then caps the
   // header at B per external entry, and the other SCC members are bounded
-  // transitively by flow conservation.
-  std::map<const Function *, std::set<const Function *>> CallAdj;
-  for (const auto &CS : CallSites) {
+  // transitively by flow conservation. Everything here is O(V+E) in the call
+  // graph.
+  CallGraphIndex CG;
+  std::vector<unsigned> CallerOfSite(CallSites.size());
+  DenseSet<std::pair<unsigned, unsigned>> SeenCalls;
+  for (unsigned I = 0, E = CallSites.size(); I != E; ++I) {
+    const CallSite &CS = CallSites[I];
     auto It = NodeToFunctionMap.find(CS.CallNode);
     const Function *Caller =
         It != NodeToFunctionMap.end() ? It->second : nullptr;
-    if (Caller && CS.Callee)
-      CallAdj[Caller].insert(CS.Callee);
+    if (!Caller || !CS.Callee)
+      continue;
+    unsigned From = CG.getOrAdd(Caller);
+    unsigned To = CG.getOrAdd(CS.Callee);
+    CallerOfSite[I] = From;
+    CG.CallSitesByCallee[To].push_back(I);
+    if (SeenCalls.insert({From, To}).second)
+      CG.Callees[From].push_back(To);
   }
-  auto reaches = [&](const Function *Src, const Function *Dst) {
-    std::set<const Function *> Visited;
-    std::vector<const Function *> WL{Src};
-    while (!WL.empty()) {
-      const Function *Cur = WL.back();
-      WL.pop_back();
-      if (Cur == Dst)
-        return true;
-      auto AdjIt = CallAdj.find(Cur);
-      if (AdjIt == CallAdj.end())
-        continue;
-      for (const Function *N : AdjIt->second)
-        if (Visited.insert(N).second)
-          WL.push_back(N);
-    }
-    return false;
-  };
-
-  // Functions that participate in a multi-function cycle.
-  std::set<const Function *> InCycle;
-  for (const auto &[Caller, Callees] : CallAdj)
-    for (const Function *Callee : Callees)
-      if (Caller != Callee && reaches(Callee, Caller)) {
-        InCycle.insert(Caller);
-        InCycle.insert(Callee);
-      }
 
-  // Group cyclic functions into SCCs (f,g share an SCC iff each reaches the
-  // other), then bound each SCC.
-  std::set<const Function *> Assigned;
-  for (const Function *F : InCycle) {
-    if (Assigned.count(F))
+  unsigned NumSCCs = 0;
+  std::vector<unsigned> Component = computeCallSCCs(CG, NumSCCs);
+  std::vector<std::vector<unsigned>> Members(NumSCCs), Entries(NumSCCs);
+  std::vector<bool> IsEntry(CG.Functions.size(), false);
+  for (unsigned F = 0, E = CG.Functions.size(); F != E; ++F) {
+    Members[Component[F]].push_back(F);
+    // External entries: SCC members called from outside the SCC, plus the
+    // start function (entered via the synthetic Entry node).
+    if (CG.Functions[F] == StartFunction)
+      IsEntry[F] = true;
+    for (unsigned G : CG.Callees[F])
+      if (Component[G] != Component[F])
+        IsEntry[G] = true;
+  }
+  for (unsigned F = 0, E = CG.Functions.size(); F != E; ++F)
+    if (IsEntry[F])
+      Entries[Component[F]].push_back(F);
+
+  std::vector<uint8_t> Color(CG.Functions.size(), 0);
+  std::vector<std::pair<unsigned, unsigned>> BackEdges;
+  for (unsigned SCC = 0; SCC != NumSCCs; ++SCC) {
+    // Single functions are either acyclic or self-recursive; the latter was
+    // handled while wiring above.
+    if (Members[SCC].size() < 2)
       continue;
-    std::set<const Function *> SCC{F};
-    for (const Function *G : InCycle)
-      if (G != F && reaches(F, G) && reaches(G, F))
-        SCC.insert(G);
-    Assigned.insert(SCC.begin(), SCC.end());
-
-    // External entries: SCC members called from outside the SCC, plus the start
-    // function if it is in the SCC (entered via the synthetic Entry node).
-    std::set<const Function *> Entries;
-    for (const auto &[Caller, Callees] : CallAdj)
-      for (const Function *Callee : Callees)
-        if (SCC.count(Callee) && !SCC.count(Caller))
-          Entries.insert(Callee);
-    if (SCC.count(StartFunction))
-      Entries.insert(StartFunction);
-
-    auto BackEdges = findSCCBackEdges(SCC, Entries, CallAdj);
+    BackEdges.clear();
+    findSCCBackEdges(CG, Component, SCC, Members[SCC], Entries[SCC], Color,
+                     BackEdges);
 
     // Every back edge's target is a cycle header; mark all call sites along it
     // as backedges into the header entry. The SCC is bounded only if every
     // header carries a recursion_bound.
     bool AllHeadersBounded = !BackEdges.empty();
-    for (const auto &[FromFn, HeaderFn] : BackEdges) {
+    for (const auto &[From, Header] : BackEdges) {
+      const Function *HeaderFn = CG.Functions[Header];
       auto RB = RecursionBounds.find(HeaderFn->getName().str());
       auto HEntry = FunctionToEntryNodeMap.find(HeaderFn);
       if (RB == RecursionBounds.end() || RB->second == 0 ||
@@ -683,23 +937,28 @@ bool ProgramGraph::finalize(
         AllHeadersBounded = false;
         continue;
       }
-      for (const auto &CS : CallSites) {
-        if (CS.Callee != HeaderFn)
-          continue;
-        auto CIt = NodeToFunctionMap.find(CS.CallNode);
-        if (CIt == NodeToFunctionMap.end() || CIt->second != FromFn)
+      Node &H = Nodes.at(HEntry->second);
+      for (unsigned Site : CG.CallSitesByCallee[Header]) {
+        if (CallerOfSite[Site] != From)
           continue;
-        Node &H = Nodes.at(HEntry->second);
         H.IsLoop = true;
         H.UpperLoopBound = RB->second;
-        H.BackEdgePredecessors.insert(CS.CallNode);
+        H.BackEdgePredecessors.insert(CallSites[Site].CallNode);
       }
     }
 
-    if (AllHeadersBounded)
-      BoundedMutual.insert(SCC.begin(), SCC.end());
-    else
-      UnboundedMutual.insert(SCC.begin(), SCC.end());
+    std::set<const Function *> &Verdict =
+        AllHeadersBounded ? BoundedMutual : UnboundedMutual;
+    for (unsigned F : Members[SCC])
+      Verdict.insert(CG.Functions[F]);
+  }
+
+  if (ContextDepth > 0) {
+    std::set<const Function *> Recursive;
+    for (const auto *S : {&BoundedSelfRec, &UnboundedSelfRec, &BoundedMutual,
+                          &UnboundedMutual})
+      Recursive.insert(S->begin(), S->end());
+    expandCallContexts(ContextDepth, Recursive);
   }
 
   // Backend-synthesized libcalls (no IR Function): cost by symbol name.
@@ -711,16 +970,18 @@ bool ProgramGraph::finalize(
   // their possibly unbounded loops) would otherwise remain as disconnected
   // components and make the WCET ILP unbounded.
   if (HasEntryNode) {
-    // Forward BFS from the Entry node over successor edges.
+    // Forward BFS from the Entry node over successor edges (context instance
+    // nodes included).
     std::set<unsigned> Reachable;
-    std::vector<unsigned> Worklist;
+    std::vector<unsigned> Worklist, Succs;
     Reachable.insert(EntryNodeId);
     Worklist.push_back(EntryNodeId);
     while (!Worklist.empty()) {
       unsigned Cur = Worklist.back();
       Worklist.pop_back();
-      // getSuccessors() returns a copy, so it is safe to traverse here.
-      for (unsigned Succ : Nodes.at(Cur).getSuccessors()) {
+      Succs.clear();
+      appendSuccessors(Cur, Succs);
+      for (unsigned Succ : Succs) {
         if (Reachable.insert(Succ).second)
           Worklist.push_back(Succ);
       }
@@ -733,30 +994,62 @@ bool ProgramGraph::finalize(
       if (Reachable.find(Id) == Reachable.end())
         ToRemove.push_back(Id);
     }
+    unsigned NumInstanceNodes = 0;
+    std::set<const Function *> Instantiated;
+    for (const ContextInstance &I : ContextInstances) {
+      Instantiated.insert(I.F);
+      for (unsigned Id = I.Base, E = I.Base + (I.End - I.First); Id != E;
+           ++Id)
+        if (!Reachable.count(Id))
+          PrunedInstanceNodes.insert(Id);
+      NumInstanceNodes += I.End - I.First;
+    }
 
     for (unsigned Id : ToRemove) {
+      // The body of a context-expanded function is reached only through its
+      // instances; keep it as their template. It has no call or return edges
+      // (those are wired per instance), so it leaves the graph whole.
+      auto FnIt = NodeToFunctionMap.find(Id);
+      if (FnIt != NodeToFunctionMap.end() && Instantiated.count(FnIt->second)) {
+        NodeToFunctionMap.erase(FnIt);
+        TemplateNodes.insert(Nodes.extract(Id));
+        continue;
+      }
       // Detach all edges so removeNode()'s isFree() assertion holds. Iterate
-      // over copies (getSuccessors/getPredecessors return by value) because
-      // removeEdge mutates the underlying sets. A reachable node can never
-      // point to an unreachable one, so only this node's own edges exist.
-      for (unsigned Succ : Nodes.at(Id).getSuccessors())
+      // over copies because removeEdge mutates the underlying sets. A reachable
+      // node can never point to an unreachable one, so only this node's own
+      // edges exist.
+      std::set<unsigned> Succs = Nodes.at(Id).getSuccessors();
+      for (unsigned Succ : Succs)
         removeEdge(Id, Succ);
-      for (unsigned Pred : Nodes.at(Id).getPredecessors())
+      std::set<unsigned> Preds = Nodes.at(Id).getPredecessors();
+      for (unsigned Pred : Preds)
         removeEdge(Pred, Id);
       NodeToFunctionMap.erase(Id);
       removeNode(Id);
     }
 
     if (Verbose)
-      outs() << "Pruned " << ToRemove.size()
-             << " node(s) unreachable from the start function; " << Nodes.size()
+      outs() << "Pruned " << ToRemove.size() + PrunedInstanceNodes.size()
+             << " node(s) unreachable from the start function; "
+             << Nodes.size() + NumInstanceNodes - PrunedInstanceNodes.size()
              << " node(s) remain.\n";
   }
 
   // Keep only un-costed external calls that survived pruning (i.e. lie on a
   // reachable path); those are the ones that make the reported WCET unsound.
+  // With context expansion a call node may only survive through an instance.
+  auto isLive = [&](unsigned CallNode) {
+    if (Nodes.count(CallNode))
+      return true;
+    for (const ContextInstance &I : ContextInstances)
+      if (CallNode >= I.First && CallNode < I.End &&
+          !PrunedInstanceNodes.count(I.Base + (CallNode - I.First)))
+        return true;
+    return false;
+  };
   for (const auto &[CallNode, Name] : PendingUnsound)
-    if (Nodes.find(CallNode) != Nodes.end())
+    if (isLive(CallNode))
       UnsoundExternalCallees.insert(Name);
 
   // Surface recursion findings, but only for functions that survived pruning
@@ -812,8 +1105,9 @@ bool ProgramGraph::finalize(
               "Add #pragma recursion_bound(N) to the cycle's entry function.\n";
   }
 
-  // outs() << "Printing Dot file \n";
-  dump2Dot(StringRef("ProgramGraph.dot"));
+  // The graph shape is final: hand consumers the dense CSR view. Exporting it
+  // is up to the caller (-dump-graph).
+  freeze();
   return false;
 }
 
@@ -1,6 +1,17 @@
 #include "ILP/AbstractHighsSolver.h"
+#include "ILP/IPETModel.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iterator>
 
 #ifdef ENABLE_HIGHS
 #include "Highs.h"
@@ -10,213 +21,635 @@
 
 namespace llvm {
 
-AbstractHighsSolver::AbstractHighsSolver() {}
+IPETModel::LoopRowForm AbstractHighsSolver::getLoopRowForm(Mode M) {
+  return M == Mode::LPFirst ? IPETModel::LoopRowForm::EntryEdge
+                            : IPETModel::LoopRowForm::HeaderCount;
+}
+
+namespace {
+
+/// One portfolio member: a HiGHS option override (value as a string) on top
+/// of the defaults.
+struct PortfolioConfig {
+  const char *Name;
+  const char *Option;
+  const char *Value;
+};
+
+const PortfolioConfig PortfolioConfigs[] = {
+    {"default", nullptr, nullptr},
+    {"no-presolve", "presolve", "off"},
+    {"primal-simplex", "simplex_strategy", "4"},
+    {"heuristics", "mip_heuristic_effort", "0.3"},
+    {"seed-1", "random_seed", "1"},
+    {"seed-2", "random_seed", "2"},
+};
+static_assert(std::size(PortfolioConfigs) ==
+                  AbstractHighsSolver::MaxPortfolioSize,
+              "portfolio size out of sync");
+
+} // namespace
+
+#ifdef ENABLE_HIGHS
+
+namespace {
+
+/// Last basis (LP) and solution (MILP) of a model, offered to the next solve.
+struct WarmStart {
+  HighsBasis Basis;
+  HighsSolution Solution;
+};
+
+/// \p M as a HighsLp, with the matrix transposed to the column-wise (CSC)
+/// layout HighsLp stores.
+HighsLp toHighsLp(const IPETModel &M, bool Integer) {
+  HighsLp Lp;
+  Lp.sense_ = ObjSense::kMaximize;
+  const HighsInt NumCols = M.getNumCols();
+  const HighsInt NumRows = M.getNumRows();
+  Lp.num_col_ = NumCols;
+  Lp.num_row_ = NumRows;
+  Lp.col_cost_ = M.ColCost;
+  Lp.col_lower_ = M.ColLower;
+  Lp.col_upper_ = M.ColUpper;
+  Lp.row_lower_ = M.RowLower;
+  Lp.row_upper_ = M.RowUpper;
+  if (Integer)
+    Lp.integrality_.assign(NumCols, HighsVarType::kInteger);
+
+  HighsSparseMatrix &A = Lp.a_matrix_;
+  A.format_ = MatrixFormat::kColwise;
+  A.num_col_ = NumCols;
+  A.num_row_ = NumRows;
+  A.start_.assign(NumCols + 1, 0);
+  for (unsigned Col : M.RowIndex)
+    ++A.start_[Col + 1];
+  for (HighsInt Col = 0; Col < NumCols; ++Col)
+    A.start_[Col + 1] += A.start_[Col];
+  A.index_.resize(M.getNumNonzeros());
+  A.value_.resize(M.getNumNonzeros());
+  std::vector<HighsInt> Fill(A.start_.begin(), A.start_.end() - 1);
+  for (HighsInt Row = 0; Row < NumRows; ++Row)
+    for (unsigned K = M.RowStart[Row]; K < M.RowStart[Row + 1]; ++K) {
+      HighsInt Pos = Fill[M.RowIndex[K]]++;
+      A.index_[Pos] = Row;
+      A.value_[Pos] = M.RowValue[K];
+    }
+  return Lp;
+}
+
+void setIntegrality(Highs &H, const IPETModel &M, HighsVarType Type) {
+  std::vector<HighsVarType> Types(M.getNumCols(), Type);
+  H.changeColsIntegrality(0, M.getNumCols() - 1, Types.data());
+}
+
+/// Stopping criteria of one solve; 0 = none.
+struct Limits {
+  double TimeLimit = 0.0;
+  double RelativeGap = 0.0;
+};
+
+/**
+ * Solve the model loaded into \p H. In LPFirst mode the relaxation is solved
+ * first and accepted if integral; otherwise (fractional, or no optimum, whose
+ * status the MILP must confirm) integrality is imposed and the model solved
+ * again. \p ModelIsInteger tracks the columns' current integrality. With
+ * \p Warm, its basis/solution seed the LP/MILP and are updated afterwards.
+ *
+ * \p L's time limit covers both runs. Whenever branch-and-bound ends short
+ * of a proof (a limit, or a gap tolerance), the result carries the best dual
+ * bound (an IPET optimum is integral, so rounded down) as a LimitReached
+ * WCET.
+ */
+AbstractILPResult runIPET(Highs &H, const IPETModel &M,
+                          AbstractHighsSolver::Mode SolveMode,
+                          bool &ModelIsInteger, WarmStart *Warm,
+                          const Limits &L = {}) {
+  AbstractILPResult Result;
+  Result.WCET = 0.0;
+  const unsigned NumNodes = M.getNumNodes();
+  const size_t NumCols = M.getNumCols();
+  const auto Start = std::chrono::steady_clock::now();
+  // Sound upper bound from the LP relaxation, if it was solved.
+  double LPBound = kHighsInf;
+
+  HighsModelStatus ModelStatus = HighsModelStatus::kNotset;
+  if (SolveMode == AbstractHighsSolver::Mode::LPFirst) {
+    if (ModelIsInteger) {
+      setIntegrality(H, M, HighsVarType::kContinuous);
+      ModelIsInteger = false;
+    }
+    if (Warm && Warm->Basis.valid)
+      H.setBasis(Warm->Basis);
+    H.run();
+    ModelStatus = H.getModelStatus();
+    if (Warm)
+      Warm->Basis = H.getBasis();
+    if (ModelStatus == HighsModelStatus::kOptimal)
+      LPBound = H.getObjectiveValue();
+    // An integral optimum of the relaxation is the ILP optimum: return it
+    // without branch-and-bound.
+    const std::vector<double> &LPValue = H.getSolution().col_value;
+    Result.LPRelaxationIntegral =
+        ModelStatus == HighsModelStatus::kOptimal &&
+        LPValue.size() >= NumCols && llvm::all_of(LPValue, [](double V) {
+          return std::abs(V - std::round(V)) <=
+                 AbstractHighsSolver::IntegralityTolerance;
+        });
+    if (!Result.LPRelaxationIntegral)
+      LLVM_DEBUG(dbgs() << "IPET LP relaxation not integral ("
+                        << H.modelStatusToString(ModelStatus)
+                        << "); running branch-and-bound\n");
+  }
+
+  bool RanMILP = false;
+  if (!Result.LPRelaxationIntegral) {
+    // The MILP gets what is left of the time limit.
+    double Remaining = L.TimeLimit;
+    if (L.TimeLimit > 0) {
+      std::chrono::duration<double> Elapsed =
+          std::chrono::steady_clock::now() - Start;
+      Remaining = L.TimeLimit - Elapsed.count();
+    }
+    if (L.TimeLimit > 0 && Remaining <= 0) {
+      ModelStatus = HighsModelStatus::kTimeLimit;
+    } else {
+      if (!ModelIsInteger) {
+        setIntegrality(H, M, HighsVarType::kInteger);
+        ModelIsInteger = true;
+      }
+      if (Warm && Warm->Solution.value_valid)
+        H.setSolution(Warm->Solution);
+      if (L.TimeLimit > 0)
+        H.setOptionValue("time_limit", Remaining);
+      H.run();
+      if (L.TimeLimit > 0)
+        H.setOptionValue("time_limit", L.TimeLimit);
+      ModelStatus = H.getModelStatus();
+      RanMILP = true;
+    }
+  }
+  if (Warm && ModelStatus == HighsModelStatus::kOptimal)
+    Warm->Solution = H.getSolution();
+
+  // Stopped by a limit: the dual bound (or the LP's) is still a sound WCET.
+  // An "optimal" MILP may stop short of its bound too (a relative gap, or
+  // HiGHS's absolute gap tolerance), so its bound is always checked.
+  bool Limited = ModelStatus == HighsModelStatus::kTimeLimit ||
+                 (ModelStatus == HighsModelStatus::kOptimal && RanMILP);
+  if (Limited) {
+    const HighsInfo &Info = H.getInfo();
+    double Bound = LPBound;
+    if (RanMILP && std::isfinite(Info.mip_dual_bound) &&
+        Info.mip_dual_bound < kHighsInf)
+      Bound = std::min(Bound, Info.mip_dual_bound);
+    bool HasIncumbent =
+        RanMILP && Info.primal_solution_status == kSolutionStatusFeasible;
+    double Incumbent =
+        HasIncumbent ? std::round(Info.objective_function_value) : 0.0;
+    Bound = std::floor(Bound + AbstractHighsSolver::IntegralityTolerance);
+    if (Bound >= kHighsInf) {
+      Result.Status = H.modelStatusToString(ModelStatus);
+      return Result;
+    }
+    if (ModelStatus == HighsModelStatus::kOptimal && Bound <= Incumbent) {
+      // The gap closed: a proven optimum after all.
+      Limited = false;
+    } else {
+      LLVM_DEBUG(dbgs() << "IPET stopped by a limit ("
+                        << H.modelStatusToString(ModelStatus)
+                        << "): bound " << Bound << ", incumbent "
+                        << Incumbent << "\n");
+      Result.LimitReached = true;
+      Result.WCET = Bound;
+      Result.Incumbent = Incumbent;
+      Result.Gap = Bound > 0 ? (Bound - Incumbent) / Bound : 0.0;
+      if (!HasIncumbent)
+        return Result;
+    }
+  }
+
+  if (!Limited && ModelStatus != HighsModelStatus::kOptimal) {
+    // Record why no WCET was produced (e.g. kInfeasible / kUnbounded) so the
+    // failure is diagnosable rather than a silent WCET <= 0.
+    Result.Status = H.modelStatusToString(ModelStatus);
+    return Result;
+  }
+
+  if (!Limited)
+    Result.WCET = H.getObjectiveValue();
+  // Record per-node execution counts so the solution can be inspected.
+  std::vector<double> ColValue = H.getSolution().col_value;
+  if (ColValue.size() < NumCols)
+    return Result;
+  if (Result.LPRelaxationIntegral) {
+    // Snap the certified-integral LP values so counts and WCET are exact.
+    for (double &V : ColValue)
+      V = std::round(V);
+    Result.WCET = 0.0;
+    for (unsigned U = 0; U < NumNodes; ++U)
+      Result.WCET += M.ColCost[U] * ColValue[U];
+  }
+  Result.ExecutionCounts.assign(ColValue.begin(), ColValue.begin() + NumNodes);
+  for (unsigned U = 0; U < NumNodes; ++U)
+    for (unsigned Col = M.getEdgeBegin(U); Col < M.getEdgeEnd(U); ++Col)
+      if (ColValue[Col] > 0.0001)
+        Result.EdgeCounts[{U, M.getEdgeTarget(Col)}] = ColValue[Col];
+  return Result;
+}
+
+void configure(Highs &H, unsigned Config, unsigned Threads, const Limits &L) {
+  H.setOptionValue("output_flag", false);
+  if (Threads)
+    H.setOptionValue("threads", static_cast<HighsInt>(Threads));
+  if (L.TimeLimit > 0)
+    H.setOptionValue("time_limit", L.TimeLimit);
+  // Without -ilp-gap, "optimal" must mean proven: HiGHS's own default gap
+  // (1e-4) would stop branch-and-bound with the incumbent below the bound.
+  H.setOptionValue("mip_rel_gap", L.RelativeGap);
+  if (const char *Option = PortfolioConfigs[Config].Option)
+    H.setOptionValue(Option, std::string(PortfolioConfigs[Config].Value));
+}
+
+/**
+ * Solve \p Lp with \p Size portfolio configurations in parallel. The first
+ * run to end optimal wins; its flag makes the others' interrupt callbacks stop
+ * them. If none ends optimal, the tightest limit-stopped bound is returned,
+ * else configuration 0's result (and status).
+ */
+AbstractILPResult solvePortfolio(const HighsLp &Lp, const IPETModel &M,
+                                 AbstractHighsSolver::Mode SolveMode,
+                                 unsigned Size, unsigned Threads,
+                                 const Limits &L) {
+  std::atomic<bool> Solved{false};
+  unsigned Winner = 0;
+  std::vector<AbstractILPResult> Results(Size);
+  {
+    DefaultThreadPool Pool(hardware_concurrency(Size));
+    for (unsigned Config = 0; Config < Size; ++Config)
+      Pool.async([&, Config] {
+        Highs H;
+        configure(H, Config, Threads, L);
+        H.setCallback([&Solved](int, const std::string &, const auto *,
+                                auto *In, void *) {
+          if (Solved.load(std::memory_order_relaxed))
+            In->user_interrupt = 1;
+        });
+        H.startCallback(kCallbackSimplexInterrupt);
+        H.startCallback(kCallbackIpmInterrupt);
+        H.startCallback(kCallbackMipInterrupt);
+        H.passModel(Lp);
+        bool ModelIsInteger = SolveMode == AbstractHighsSolver::Mode::MILP;
+        AbstractILPResult R =
+            runIPET(H, M, SolveMode, ModelIsInteger, nullptr, L);
+        bool Expected = false;
+        if (R.Status.empty() && !R.LimitReached &&
+            Solved.compare_exchange_strong(Expected, true))
+          Winner = Config;
+        Results[Config] = std::move(R);
+      });
+    Pool.wait();
+  }
+  if (!Solved)
+    for (unsigned Config = 0; Config < Size; ++Config)
+      if (Results[Config].LimitReached &&
+          (!Results[Winner].LimitReached ||
+           Results[Config].WCET < Results[Winner].WCET))
+        Winner = Config;
+  AbstractILPResult Result = std::move(Results[Winner]);
+  if (Solved || Result.LimitReached)
+    Result.SolverConfig = PortfolioConfigs[Winner].Name;
+  LLVM_DEBUG(dbgs() << "IPET portfolio of " << Size << ": "
+                    << (Solved ? Result.SolverConfig : std::string("no"))
+                    << " configuration solved it first\n");
+  return Result;
+}
+
+} // namespace
+
+#endif // ENABLE_HIGHS
+
+AbstractHighsSolver::AbstractHighsSolver(Mode SolveMode,
+                                         unsigned PortfolioSize,
+                                         unsigned Threads)
+    : SolveMode(SolveMode),
+      PortfolioSize(std::clamp(PortfolioSize, 1u, MaxPortfolioSize)),
+      Threads(Threads) {}
+
+const char *AbstractHighsSolver::getPortfolioConfigName(unsigned Idx) {
+  assert(Idx < MaxPortfolioSize && "no such portfolio configuration");
+  return PortfolioConfigs[Idx].Name;
+}
 
 AbstractHighsSolver::~AbstractHighsSolver() {}
 
 AbstractILPResult
 AbstractHighsSolver::solveWCET(const AbstractStateGraph &ASG) {
+#ifdef ENABLE_HIGHS
+  // Execution counts and edge flows are integral (IPET). The loop-bound rows
+  // are not unimodular, so the LP relaxation can have fractional optima (which
+  // surface as float objectives and numerically unstable results). In MILP
+  // mode every column is integer from the start; in LPFirst mode the
+  // relaxation is solved first and integrality is only imposed if its optimum
+  // turns out fractional.
+  IPETModel Model(ASG, getLoopRowForm(SolveMode));
+  bool ModelIsInteger = SolveMode == Mode::MILP;
+  LLVM_DEBUG(dbgs() << "IPET model: " << Model.getNumCols() << " columns, "
+                    << Model.getNumRows() << " rows, "
+                    << Model.getNumNonzeros() << " nonzeros\n");
+  if (PortfolioSize > 1)
+    return solvePortfolio(toHighsLp(Model, ModelIsInteger), Model, SolveMode,
+                          PortfolioSize, Threads, {TimeLimit, RelativeGap});
+  Highs highs;
+  const Limits L{TimeLimit, RelativeGap};
+  configure(highs, 0, Threads, L);
+  highs.passModel(toHighsLp(Model, ModelIsInteger));
+  return runIPET(highs, Model, SolveMode, ModelIsInteger, nullptr, L);
+#else
+  errs() << "HiGHS not enabled. Please reconfigure with -DENABLE_HIGHS=ON\n";
   AbstractILPResult Result;
   Result.WCET = 0.0;
+  return Result;
+#endif
+}
 
+struct HighsIPETSession::Impl {
+  IPETModel Model;
+  AbstractHighsSolver::Mode SolveMode;
+  /// Current loop bound per node (0: not a loop header, or unbounded).
+  std::vector<unsigned> Bounds;
 #ifdef ENABLE_HIGHS
-  Highs highs;
-  highs.setOptionValue("output_flag", false);
-
-  HighsModel model;
-  model.lp_.sense_ = ObjSense::kMaximize;
-
-  // Map NodeID -> ColIndex (Execution Count)
-  std::map<unsigned, int> NodeCols;
-
-  // Map Edge (From, To) -> ColIndex (Edge Flow)
-  std::map<std::pair<unsigned, unsigned>, int> EdgeCols;
-
-  // 1. Create Variables (Columns) and Objective
-  // In HiGHS, it's often easier to define columns first.
-
-  // Node Variables
-  for (const auto &NodePair : ASG.getNodes()) {
-    unsigned U = NodePair.first;
-    const auto &Node = NodePair.second;
-
-    int colIdx = model.lp_.num_col_;
-    model.lp_.col_cost_.push_back(Node->Cost);
-    model.lp_.col_lower_.push_back(0.0);
-    model.lp_.col_upper_.push_back(kHighsInf);
-    NodeCols[U] = colIdx;
-    model.lp_.num_col_++;
-  }
-
-  // Edge Variables
-  for (const auto &NodePair : ASG.getNodes()) {
-    unsigned U = NodePair.first;
-    for (const auto &Edge : ASG.getSuccessors(U)) {
-      unsigned V = Edge.To;
-      int colIdx = model.lp_.num_col_;
-      model.lp_.col_cost_.push_back(0.0);
-      model.lp_.col_lower_.push_back(0.0);
-      model.lp_.col_upper_.push_back(kHighsInf);
-      EdgeCols[{U, V}] = colIdx;
-      model.lp_.num_col_++;
-    }
+  Highs H;
+  bool ModelIsInteger;
+  WarmStart Warm;
+#endif
+
+  Impl(const AbstractStateGraph &ASG, AbstractHighsSolver::Mode SolveMode)
+      : Model(ASG, AbstractHighsSolver::getLoopRowForm(SolveMode),
+              /*KeepUnboundedLoopRows=*/true),
+        SolveMode(SolveMode) {
+    for (const auto &Node : ASG.getNodes())
+      Bounds.push_back(Node.IsLoopHeader ? Node.UpperLoopBound : 0);
+#ifdef ENABLE_HIGHS
+    configure(H, /*Config=*/0, /*Threads=*/0, {});
+    ModelIsInteger = SolveMode == AbstractHighsSolver::Mode::MILP;
+    H.passModel(toHighsLp(Model, ModelIsInteger));
+#endif
   }
+};
 
-  // 2. Constraints (Rows)
-  // We use HighsLp::a_matrix_ which is Compressed Sparse Column (CSC) format.
-  // But constructing it manually IS PAINFUL.
-  // Easier way: Build std::vector<HighsInt> index, ... and pass to addRow?
-  // But we are building `model.lp_` directly.
-  // Actually, let's use `highs.addVar` and `highs.addRow` interface if
-  // possible? But standard usage in LLVM project usually builds the model.
-  // Let's assume we can build the matrix row-by-row but that requires CSR
-  // (Compressed Sparse Row). HighsLp uses CSC by default (`a_matrix_.format_`
-  // is `MatrixFormat::kColwise`). BUT we can use `highs.passModel(model)`
-  // later. If we want to add rows easily, maybe we should use `highs.addRow`.
-  // Let's pass the columns first, then add rows.
-
-  // Execution counts and edge flows are integral (IPET). Solve a MILP, not the
-  // LP relaxation: the loop-bound rows (Bound-1)*x_h - Bound*backedge >= 0 are
-  // not unimodular, so the relaxation can have fractional optima (which surface
-  // as float objectives and numerically unstable results).
-  model.lp_.integrality_.assign(model.lp_.num_col_, HighsVarType::kInteger);
-
-  highs.passModel(model);
-
-  // Flow Conservation
-  for (const auto &NodePair : ASG.getNodes()) {
-    unsigned U = NodePair.first;
-    const auto &Node = NodePair.second;
-
-    // x_u = Sum(InEdges) => x_u - Sum(InEdges) = 0
-    if (!Node->IsEntry) {
-      std::vector<int> inds;
-      std::vector<double> vals;
-
-      inds.push_back(NodeCols[U]);
-      vals.push_back(1.0);
-
-      for (unsigned Pred : ASG.getPredecessors(U)) {
-        // We need the edge variable index from Pred to U
-        if (EdgeCols.count({Pred, U})) {
-          inds.push_back(EdgeCols[{Pred, U}]);
-          vals.push_back(-1.0);
-        }
-      }
-      highs.addRow(0.0, 0.0, inds.size(), inds.data(), vals.data());
-    }
+HighsIPETSession::HighsIPETSession(const AbstractStateGraph &ASG,
+                                   AbstractHighsSolver::Mode SolveMode)
+    : P(std::make_unique<Impl>(ASG, SolveMode)) {}
 
-    // x_u = Sum(OutEdges) => x_u - Sum(OutEdges) = 0
-    if (!Node->IsExit) {
-      std::vector<int> inds;
-      std::vector<double> vals;
+HighsIPETSession::~HighsIPETSession() = default;
 
-      inds.push_back(NodeCols[U]);
-      vals.push_back(1.0);
+void HighsIPETSession::setNodeCost(unsigned Node, unsigned Cost) {
+  assert(Node < P->Model.getNumNodes() && "unknown node");
+  P->Model.ColCost[Node] = Cost;
+#ifdef ENABLE_HIGHS
+  P->H.changeColCost(Node, Cost);
+#endif
+}
 
-      for (const auto &Edge : ASG.getSuccessors(U)) {
-        unsigned Succ = Edge.To;
-        if (EdgeCols.count({U, Succ})) {
-          inds.push_back(EdgeCols[{U, Succ}]);
-          vals.push_back(-1.0);
-        }
-      }
-      highs.addRow(0.0, 0.0, inds.size(), inds.data(), vals.data());
-    }
+bool HighsIPETSession::setLoopBound(unsigned Header, unsigned Bound) {
+  if (!P->Model.setLoopBound(Header, Bound))
+    return false;
+  P->Bounds[Header] = Bound;
+#ifdef ENABLE_HIGHS
+  const IPETModel &M = P->Model;
+  unsigned Row = M.getLoopRow(Header);
+  for (unsigned K = M.RowStart[Row]; K < M.RowStart[Row + 1]; ++K)
+    P->H.changeCoeff(Row, M.RowIndex[K], M.RowValue[K]);
+  P->H.changeRowBounds(Row, M.RowLower[Row], M.RowUpper[Row]);
+#endif
+  return true;
+}
 
-    // Entry Constraint: x_entry = 1
-    if (Node->IsEntry) {
-      int idx = NodeCols[U];
-      double val = 1.0;
-      highs.addRow(1.0, 1.0, 1, &idx, &val);
-    }
+bool HighsIPETSession::fixEdge(unsigned From, unsigned To, double Flow) {
+  unsigned Col = P->Model.getEdgeColumn(From, To);
+  if (Col == IPETModel::None)
+    return false;
+  P->Model.ColLower[Col] = P->Model.ColUpper[Col] = Flow;
+#ifdef ENABLE_HIGHS
+  P->H.changeColBounds(Col, Flow, Flow);
+#endif
+  return true;
+}
 
-    // Loop Constraints
-    if (Node->IsLoopHeader && Node->UpperLoopBound > 0) {
-      // (Bound - 1) * x_h - Bound * Sum(BackEdges) >= 0
-      std::vector<int> inds;
-      std::vector<double> vals;
-
-      inds.push_back(NodeCols[U]);
-      vals.push_back(static_cast<double>(Node->UpperLoopBound - 1));
-
-      for (unsigned Pred : ASG.getPredecessors(U)) {
-        bool IsBack = false;
-        for (const auto &Edge : ASG.getSuccessors(Pred)) {
-          if (Edge.To == U && Edge.IsBackEdge) {
-            IsBack = true;
-            break;
-          }
-        }
-        if (IsBack && EdgeCols.count({Pred, U})) {
-          inds.push_back(EdgeCols[{Pred, U}]);
-          vals.push_back(-static_cast<double>(Node->UpperLoopBound));
-        }
-      }
-      highs.addRow(0.0, kHighsInf, inds.size(), inds.data(), vals.data());
+bool HighsIPETSession::releaseEdge(unsigned From, unsigned To) {
+  unsigned Col = P->Model.getEdgeColumn(From, To);
+  if (Col == IPETModel::None)
+    return false;
+  P->Model.ColLower[Col] = 0.0;
+  P->Model.ColUpper[Col] = IPETModel::Infinity;
+#ifdef ENABLE_HIGHS
+  P->H.changeColBounds(Col, 0.0, kHighsInf);
+#endif
+  return true;
+}
+
+bool HighsIPETSession::excludePath(const AbstractILPResult &Solved) {
+  if (Solved.EdgeCounts.empty())
+    return false;
+  IPETModel &M = P->Model;
+  // Sum(unused edges) >= 1
+  SmallVector<std::pair<unsigned, double>, 64> Unused;
+  for (unsigned U = 0; U < M.getNumNodes(); ++U)
+    for (unsigned Col = M.getEdgeBegin(U); Col < M.getEdgeEnd(U); ++Col)
+      if (!Solved.EdgeCounts.count({U, M.getEdgeTarget(Col)}))
+        Unused.push_back({Col, 1.0});
+  if (Unused.empty())
+    return false;
+  M.addRow(Unused, 1.0, IPETModel::Infinity);
+#ifdef ENABLE_HIGHS
+  std::vector<HighsInt> Index;
+  std::vector<double> Value;
+  for (const auto &[Col, Val] : Unused) {
+    Index.push_back(Col);
+    Value.push_back(Val);
+  }
+  P->H.addRow(1.0, kHighsInf, Index.size(), Index.data(), Value.data());
+  // The kept basis gains the new row with its slack basic; the kept solution
+  // is the one just cut off.
+  if (P->Warm.Basis.valid)
+    P->Warm.Basis.row_status.push_back(HighsBasisStatus::kBasic);
+  P->Warm.Solution.value_valid = false;
+#endif
+  return true;
+}
+
+IPETSensitivity
+HighsIPETSession::analyzeSensitivity(const AbstractILPResult &Solved) {
+  IPETSensitivity S;
+  const IPETModel &M = P->Model;
+  const unsigned NumNodes = M.getNumNodes();
+  for (unsigned U = 0; U < NumNodes; ++U)
+    S.Blocks.push_back({U, static_cast<unsigned>(M.ColCost[U]),
+                        Solved.getExecutionCount(U), -IPETModel::Infinity,
+                        IPETModel::Infinity});
+#ifdef ENABLE_HIGHS
+  Highs &H = P->H;
+  ++NumSolves;
+  if (P->ModelIsInteger) {
+    setIntegrality(H, M, HighsVarType::kContinuous);
+    P->ModelIsInteger = false;
+  }
+  if (P->Warm.Basis.valid)
+    H.setBasis(P->Warm.Basis);
+  H.run();
+  if (H.getModelStatus() != HighsModelStatus::kOptimal) {
+    S.Status = H.modelStatusToString(H.getModelStatus());
+    return S;
+  }
+  P->Warm.Basis = H.getBasis();
+
+  // The duals and ranging describe the LP's vertex; they are Solved's only if
+  // that vertex is Solved itself. An integral vertex of the same length can
+  // still be another path of equal WCET.
+  const HighsSolution &Sol = H.getSolution();
+  auto MatchesSolved = [&](unsigned Col, double Count) {
+    double V = Sol.col_value[Col];
+    return std::abs(V - std::round(V)) <=
+               AbstractHighsSolver::IntegralityTolerance &&
+           std::round(V) == std::round(Count);
+  };
+  S.Exact = std::abs(H.getObjectiveValue() - Solved.WCET) < 0.5;
+  for (unsigned U = 0; U < NumNodes && S.Exact; ++U) {
+    S.Exact = MatchesSolved(U, Solved.getExecutionCount(U));
+    for (unsigned Col = M.getEdgeBegin(U); Col < M.getEdgeEnd(U) && S.Exact;
+         ++Col) {
+      auto It = Solved.EdgeCounts.find({U, M.getEdgeTarget(Col)});
+      S.Exact = MatchesSolved(
+          Col, It == Solved.EdgeCounts.end() ? 0.0 : It->second);
     }
   }
+  HighsRanging Ranging;
+  if (S.Exact && H.getRanging(Ranging) == HighsStatus::kOk) {
+    for (unsigned U = 0; U < NumNodes; ++U) {
+      double Down = Ranging.col_cost_dn.value_[U];
+      double Up = Ranging.col_cost_up.value_[U];
+      S.Blocks[U].Count = std::round(Sol.col_value[U]);
+      S.Blocks[U].CostLower =
+          std::min(Down, Up) <= -kHighsInf ? -IPETModel::Infinity
+                                           : std::min(Down, Up);
+      S.Blocks[U].CostUpper =
+          std::max(Down, Up) >= kHighsInf ? IPETModel::Infinity
+                                          : std::max(Down, Up);
+    }
+  } else {
+    S.Exact = false;
+  }
 
-  // Context-sensitive call/return matching. Flow entering a callee from call
-  // site i must return to call site i's landing block:
-  //   flow(CallNode -> entry) - Sum_r flow(return_r -> landing) == 0
-  // Without it, a callee called from N sites has its return edges merged to
-  // every landing, forming spurious inter-procedural cycles that no loop bound
-  // constrains, which makes the maximize objective unbounded.
-  for (const auto &CS : ASG.CallSites) {
-    auto EntryIt = ASG.FunctionEntries.find(CS.Callee);
-    if (EntryIt == ASG.FunctionEntries.end())
-      continue;
-    auto CallEdge = EdgeCols.find({CS.CallNodeId, EntryIt->second});
-    if (CallEdge == EdgeCols.end())
+  // Entries = x_h - Sum(BackEdges), the derivative of either loop row form
+  // with respect to the bound; counted on the path the marginals refer to.
+  std::vector<double> Entries(NumNodes, 0.0);
+  if (S.Exact) {
+    for (unsigned U = 0; U < NumNodes; ++U) {
+      Entries[U] += Sol.col_value[U];
+      for (unsigned Col = M.getEdgeBegin(U); Col < M.getEdgeEnd(U); ++Col)
+        if (M.isBackEdge(Col))
+          Entries[M.getEdgeTarget(Col)] -= Sol.col_value[Col];
+    }
+  } else {
+    for (unsigned U = 0; U < NumNodes; ++U)
+      Entries[U] = Solved.getExecutionCount(U);
+    for (const auto &[Edge, Flow] : Solved.EdgeCounts) {
+      unsigned Col = M.getEdgeColumn(Edge.first, Edge.second);
+      if (Col != IPETModel::None && M.isBackEdge(Col))
+        Entries[Edge.second] -= Flow;
+    }
+  }
+  for (unsigned U = 0; U < NumNodes; ++U) {
+    unsigned Row = M.getLoopRow(U);
+    if (Row == IPETModel::None || P->Bounds[U] == 0)
       continue;
-
-    std::vector<int> inds;
-    std::vector<double> vals;
-    inds.push_back(CallEdge->second);
-    vals.push_back(1.0);
-
-    auto RetIt = ASG.FunctionReturns.find(CS.Callee);
-    if (RetIt != ASG.FunctionReturns.end()) {
-      for (unsigned R : RetIt->second) {
-        auto RetEdge = EdgeCols.find({R, CS.ReturnNodeId});
-        if (RetEdge != EdgeCols.end()) {
-          inds.push_back(RetEdge->second);
-          vals.push_back(-1.0);
-        }
-      }
+    double E = std::round(Entries[U]);
+    S.Loops.push_back({U, P->Bounds[U], E,
+                       S.Exact ? std::abs(Sol.row_dual[Row]) * E : 0.0});
+  }
+  if (S.Exact)
+    return S;
+
+  // Fractional relaxation, or another path: raise each bound by one and
+  // re-solve.
+  for (IPETSensitivity::LoopBound &L : S.Loops) {
+    setLoopBound(L.Header, L.Bound + 1);
+    AbstractILPResult Raised = solve();
+    setLoopBound(L.Header, L.Bound);
+    if (!Raised.Status.empty() || Raised.LimitReached) {
+      S.Status = Raised.Status.empty() ? "Limit reached" : Raised.Status;
+      return S;
     }
-
-    // Only emit when at least one return edge exists; otherwise the row would
-    // wrongly force the call edge to zero.
-    if (inds.size() > 1)
-      highs.addRow(0.0, 0.0, inds.size(), inds.data(), vals.data());
+    L.CyclesPerBound = std::round(Raised.WCET - Solved.WCET);
   }
+#else
+  S.Status = "HiGHS not enabled";
+#endif
+  return S;
+}
 
-  // Solve
-  highs.run();
-
-  HighsModelStatus ModelStatus = highs.getModelStatus();
-  if (ModelStatus == HighsModelStatus::kOptimal) {
-    Result.WCET = highs.getObjectiveValue();
-    // Record per-node execution counts so the solution can be inspected.
-    const std::vector<double> &ColValue = highs.getSolution().col_value;
-    for (const auto &Pair : NodeCols) {
-      if (Pair.second >= 0 && Pair.second < (int)ColValue.size() &&
-          ColValue[Pair.second] > 0.0001)
-        Result.ExecutionCounts[Pair.first] = ColValue[Pair.second];
+void IPETSensitivity::print(raw_ostream &OS, double WCET, unsigned MaxBlocks,
+                            function_ref<std::string(unsigned)> Label) const {
+  OS << "\nSensitivity ("
+     << (Exact ? "LP duals and cost ranging"
+               : "fractional LP relaxation: bounds raised one at a time, no "
+                 "cost ranges")
+     << "):\n";
+
+  std::vector<LoopBound> ByMarginal = Loops;
+  llvm::stable_sort(ByMarginal, [](const auto &A, const auto &B) {
+    return A.CyclesPerBound > B.CyclesPerBound;
+  });
+  OS << "  Loop bounds (WCET cycles per unit of bound):\n";
+  for (const LoopBound &L : ByMarginal)
+    OS << "    " << Label(L.Header) << ": bound " << L.Bound << ", entered "
+       << std::llround(L.Entries) << "x, " << std::llround(L.CyclesPerBound)
+       << " cycles\n";
+
+  // Blocks on the path, by their share of the WCET.
+  std::vector<BlockCost> ByShare;
+  for (const BlockCost &B : Blocks)
+    if (B.Count > 0 && B.Cost > 0)
+      ByShare.push_back(B);
+  llvm::stable_sort(ByShare, [](const auto &A, const auto &B) {
+    return A.Cost * A.Count > B.Cost * B.Count;
+  });
+  if (ByShare.size() > MaxBlocks)
+    ByShare.resize(MaxBlocks);
+  auto printBound = [&](double V) {
+    if (std::isinf(V))
+      OS << (V < 0 ? "-inf" : "inf");
+    else
+      OS << format("%.0f", V);
+  };
+  OS << "  Blocks (cost x count, share of the WCET"
+     << (Exact ? ", cost range keeping the path" : "") << "):\n";
+  for (const BlockCost &B : ByShare) {
+    OS << "    " << Label(B.Node) << ": " << B.Cost << " x "
+       << std::llround(B.Count) << ", "
+       << format("%.1f", 100.0 * B.Cost * B.Count / WCET) << "%";
+    if (Exact) {
+      OS << ", [";
+      printBound(B.CostLower);
+      OS << ", ";
+      printBound(B.CostUpper);
+      OS << "]";
     }
-  } else {
-    // Record why no WCET was produced (e.g. kInfeasible / kUnbounded) so the
-    // failure is diagnosable rather than a silent WCET <= 0.
-    Result.Status = highs.modelStatusToString(ModelStatus);
+    OS << "\n";
   }
+}
 
+AbstractILPResult HighsIPETSession::solve() {
+  ++NumSolves;
+#ifdef ENABLE_HIGHS
+  return runIPET(P->H, P->Model, P->SolveMode, P->ModelIsInteger, &P->Warm);
 #else
   errs() << "HiGHS not enabled. Please reconfigure with -DENABLE_HIGHS=ON\n";
-#endif
-
+  AbstractILPResult Result;
+  Result.WCET = 0.0;
   return Result;
+#endif
 }
 
 } // namespace llvm
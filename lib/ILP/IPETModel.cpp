@@ -0,0 +1,182 @@
+#include "ILP/IPETModel.h"
+#include <algorithm>
+
+namespace llvm {
+
+IPETModel::IPETModel(const AbstractStateGraph &ASG, LoopRowForm Form,
+                     bool KeepUnboundedLoopRows)
+    : Form(Form), NumNodes(ASG.getNumNodes()) {
+  // Edge columns in successor order; in-edges grouped by target with a
+  // counting sort.
+  EdgeBegin.assign(NumNodes + 1, NumNodes);
+  std::vector<unsigned> InDegree(NumNodes, 0);
+  for (unsigned U = 0; U < NumNodes; ++U) {
+    for (const auto &Edge : ASG.getSuccessors(U)) {
+      EdgeTarget.push_back(Edge.To);
+      EdgeIsBack.push_back(Edge.IsBackEdge);
+      ++InDegree[Edge.To];
+    }
+    EdgeBegin[U + 1] = NumNodes + EdgeTarget.size();
+  }
+  const unsigned NumCols = NumNodes + EdgeTarget.size();
+
+  InBegin.assign(NumNodes + 1, 0);
+  for (unsigned U = 0; U < NumNodes; ++U)
+    InBegin[U + 1] = InBegin[U] + InDegree[U];
+  InEdges.resize(EdgeTarget.size());
+  std::vector<unsigned> Fill(InBegin.begin(), InBegin.end() - 1);
+  for (unsigned Col = NumNodes; Col < NumCols; ++Col)
+    InEdges[Fill[getEdgeTarget(Col)]++] = Col;
+
+  ColCost.assign(NumCols, 0.0);
+  ColLower.assign(NumCols, 0.0);
+  ColUpper.assign(NumCols, Infinity);
+  IsEntry.resize(NumNodes);
+  for (unsigned U = 0; U < NumNodes; ++U) {
+    ColCost[U] = ASG.getNodes()[U].Cost;
+    IsEntry[U] = ASG.getNodes()[U].IsEntry;
+  }
+
+  RowStart.push_back(0);
+  auto addEntry = [&](unsigned Col, double Val) {
+    RowIndex.push_back(Col);
+    RowValue.push_back(Val);
+  };
+  auto endRow = [&](double Lower, double Upper) {
+    RowLower.push_back(Lower);
+    RowUpper.push_back(Upper);
+    RowStart.push_back(RowIndex.size());
+  };
+
+  LoopRow.assign(NumNodes, None);
+  SmallVector<std::pair<unsigned, double>, 8> Loop;
+  for (unsigned U = 0; U < NumNodes; ++U) {
+    const auto &Node = ASG.getNodes()[U];
+
+    // x_u = Sum(InEdges) => x_u - Sum(InEdges) = 0
+    if (!Node.IsEntry) {
+      addEntry(U, 1.0);
+      for (unsigned Col : getInEdgeColumns(U))
+        addEntry(Col, -1.0);
+      endRow(0.0, 0.0);
+    }
+
+    // x_u = Sum(OutEdges) => x_u - Sum(OutEdges) = 0
+    if (!Node.IsExit) {
+      addEntry(U, 1.0);
+      for (unsigned Col = getEdgeBegin(U); Col < getEdgeEnd(U); ++Col)
+        addEntry(Col, -1.0);
+      endRow(0.0, 0.0);
+    }
+
+    // Entry Constraint: x_entry = 1
+    if (Node.IsEntry) {
+      addEntry(U, 1.0);
+      endRow(1.0, 1.0);
+    }
+
+    // Loop Constraints
+    if (Node.IsLoopHeader &&
+        (Node.UpperLoopBound > 0 || KeepUnboundedLoopRows)) {
+      double Lower, Upper;
+      Loop.clear();
+      buildLoopRow(U, Node.UpperLoopBound, Loop, Lower, Upper);
+      LoopRow[U] = getNumRows();
+      for (const auto &[Col, Val] : Loop)
+        addEntry(Col, Val);
+      endRow(Lower, Upper);
+    }
+  }
+
+  // Context-sensitive call/return matching. Flow entering a callee from call
+  // site i must return to call site i's landing block:
+  //   flow(CallNode -> entry) - Sum_r flow(return_r -> landing) == 0
+  // Without it, a callee called from N sites has its return edges merged to
+  // every landing, forming spurious inter-procedural cycles that no loop bound
+  // constrains, which makes the maximize objective unbounded.
+  for (const auto &CS : ASG.CallSites) {
+    unsigned Entry = ASG.getCalleeEntry(CS);
+    if (Entry == ~0u)
+      continue;
+    unsigned CallEdge = getEdgeColumn(CS.CallNodeId, Entry);
+    if (CallEdge == None)
+      continue;
+
+    size_t RowBegin = RowIndex.size();
+    addEntry(CallEdge, 1.0);
+    for (unsigned R : ASG.getCalleeReturns(CS)) {
+      unsigned RetEdge = getEdgeColumn(R, CS.ReturnNodeId);
+      if (RetEdge != None)
+        addEntry(RetEdge, -1.0);
+    }
+
+    // Only emit when at least one return edge exists; otherwise the row would
+    // wrongly force the call edge to zero.
+    if (RowIndex.size() - RowBegin > 1) {
+      endRow(0.0, 0.0);
+    } else {
+      RowIndex.resize(RowBegin);
+      RowValue.resize(RowBegin);
+    }
+  }
+}
+
+unsigned IPETModel::getEdgeColumn(unsigned From, unsigned To) const {
+  if (From >= NumNodes)
+    return None;
+  auto Begin = EdgeTarget.begin() + (getEdgeBegin(From) - NumNodes);
+  auto End = EdgeTarget.begin() + (getEdgeEnd(From) - NumNodes);
+  auto It = std::lower_bound(Begin, End, To);
+  if (It == End || *It != To)
+    return None;
+  return NumNodes + (It - EdgeTarget.begin());
+}
+
+unsigned IPETModel::addRow(ArrayRef<std::pair<unsigned, double>> Entries,
+                           double Lower, double Upper) {
+  for (const auto &[Col, Val] : Entries) {
+    RowIndex.push_back(Col);
+    RowValue.push_back(Val);
+  }
+  RowLower.push_back(Lower);
+  RowUpper.push_back(Upper);
+  RowStart.push_back(RowIndex.size());
+  return getNumRows() - 1;
+}
+
+bool IPETModel::setLoopBound(unsigned Header, unsigned Bound) {
+  unsigned Row = Header < NumNodes ? LoopRow[Header] : None;
+  if (Row == None)
+    return false;
+  SmallVector<std::pair<unsigned, double>, 8> Entries;
+  buildLoopRow(Header, Bound, Entries, RowLower[Row], RowUpper[Row]);
+  assert(Entries.size() == RowStart[Row + 1] - RowStart[Row] &&
+         "loop row changed shape");
+  for (unsigned I = 0, E = Entries.size(); I != E; ++I)
+    RowValue[RowStart[Row] + I] = Entries[I].second;
+  return true;
+}
+
+void IPETModel::buildLoopRow(
+    unsigned Header, unsigned Bound,
+    SmallVectorImpl<std::pair<unsigned, double>> &Entries, double &Lower,
+    double &Upper) const {
+  double B = Bound;
+  if (Form == LoopRowForm::EntryEdge && !IsEntry[Header]) {
+    // Sum(BackEdges) - (Bound - 1) * Sum(EntryEdges) <= 0
+    for (unsigned Col : getInEdgeColumns(Header))
+      Entries.push_back({Col, isBackEdge(Col) ? 1.0 : -(B - 1)});
+    Lower = -Infinity;
+    Upper = Bound ? 0.0 : Infinity;
+    return;
+  }
+  // (Bound - 1) * x_h - Bound * Sum(BackEdges) >= 0
+  Entries.push_back({Header, B - 1});
+  for (unsigned Col : getInEdgeColumns(Header))
+    if (isBackEdge(Col))
+      Entries.push_back({Col, -B});
+  Lower = Bound ? 0.0 : -Infinity;
+  Upper = Infinity;
+}
+
+} // namespace llvm
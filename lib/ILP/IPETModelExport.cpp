@@ -0,0 +1,265 @@
+//===- IPETModelExport.cpp - MPS / CPLEX LP export of the IPET model ------===//
+//
+// Writers behind IPETModel::exportModel(), so the exact integer program LLTA
+// hands to its solver can be replayed by any other one (llta-ilp-bench reads
+// them back into HiGHS). MPS is written in free format, with the integer
+// columns between INTORG/INTEND markers and an explicit upper bound on each,
+// since some readers default integer columns to [0, 1].
+//
+//===----------------------------------------------------------------------===//
+
+#include "ILP/IPETModel.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cmath>
+
+namespace llvm {
+
+namespace {
+
+/// Shortest decimal that reads back as \p V (the models' coefficients are
+/// integers in practice).
+void printNumber(raw_ostream &OS, double V) { OS << format("%.17g", V); }
+
+enum class RowKind { Equal, Greater, Less, Ranged, Free };
+
+RowKind getRowKind(double Lower, double Upper) {
+  if (Lower == Upper)
+    return RowKind::Equal;
+  if (std::isinf(Lower) && std::isinf(Upper))
+    return RowKind::Free;
+  if (std::isinf(Upper))
+    return RowKind::Greater;
+  if (std::isinf(Lower))
+    return RowKind::Less;
+  return RowKind::Ranged;
+}
+
+} // namespace
+
+IPETModel::ExportFormat IPETModel::getExportFormatForPath(StringRef Path) {
+  return Path.ends_with(".lp") ? ExportFormat::LP : ExportFormat::MPS;
+}
+
+std::string IPETModel::getColumnName(unsigned Col) const {
+  if (Col < NumNodes)
+    return "n" + std::to_string(Col);
+  // EdgeBegin is non-decreasing; the source is the last node whose edge range
+  // starts at or before Col. (Not "e...": LP readers take e<digit> for an
+  // exponent.)
+  unsigned From = std::upper_bound(EdgeBegin.begin(), EdgeBegin.end(), Col) -
+                  EdgeBegin.begin() - 1;
+  return "f" + std::to_string(From) + "_" + std::to_string(getEdgeTarget(Col));
+}
+
+void IPETModel::exportModel(raw_ostream &OS, ExportFormat Format) const {
+  if (Format == ExportFormat::LP)
+    exportLP(OS);
+  else
+    exportMPS(OS);
+}
+
+bool IPETModel::exportModel(StringRef Path, ExportFormat Format) const {
+  std::error_code EC;
+  raw_fd_ostream File(Path, EC, sys::fs::OF_Text);
+  if (EC) {
+    errs() << "Error opening file: " << EC.message() << "\n";
+    return false;
+  }
+  exportModel(File, Format);
+  File.close();
+  if (File.has_error()) {
+    errs() << "Error writing " << Path << ": " << File.error().message()
+           << "\n";
+    File.clear_error();
+    return false;
+  }
+  return true;
+}
+
+void IPETModel::exportMPS(raw_ostream &OS) const {
+  const unsigned NumCols = getNumCols();
+  const unsigned NumRows = getNumRows();
+  std::vector<std::string> Names(NumCols);
+  for (unsigned Col = 0; Col < NumCols; ++Col)
+    Names[Col] = getColumnName(Col);
+
+  OS << "NAME          llta-ipet\n";
+  OS << "OBJSENSE\n    MAX\n";
+  OS << "ROWS\n N  obj\n";
+  for (unsigned R = 0; R < NumRows; ++R) {
+    static const char *const Type[] = {"E", "G", "L", "G", "N"};
+    OS << ' ' << Type[static_cast<int>(getRowKind(RowLower[R], RowUpper[R]))]
+       << "  r" << R << '\n';
+  }
+
+  // MPS is column-major: transpose the CSR rows.
+  std::vector<unsigned> ColStart(NumCols + 1, 0);
+  for (unsigned Col : RowIndex)
+    ++ColStart[Col + 1];
+  for (unsigned Col = 0; Col < NumCols; ++Col)
+    ColStart[Col + 1] += ColStart[Col];
+  std::vector<unsigned> EntryRow(RowIndex.size());
+  std::vector<double> EntryValue(RowIndex.size());
+  std::vector<unsigned> Fill(ColStart.begin(), ColStart.end() - 1);
+  for (unsigned R = 0; R < NumRows; ++R)
+    for (unsigned K = RowStart[R]; K < RowStart[R + 1]; ++K) {
+      unsigned Slot = Fill[RowIndex[K]]++;
+      EntryRow[Slot] = R;
+      EntryValue[Slot] = RowValue[K];
+    }
+
+  OS << "COLUMNS\n";
+  OS << "    MARKER  'MARKER'  'INTORG'\n";
+  for (unsigned Col = 0; Col < NumCols; ++Col) {
+    if (ColCost[Col] != 0.0) {
+      OS << "    " << Names[Col] << "  obj  ";
+      printNumber(OS, ColCost[Col]);
+      OS << '\n';
+    }
+    for (unsigned K = ColStart[Col]; K < ColStart[Col + 1]; ++K) {
+      OS << "    " << Names[Col] << "  r" << EntryRow[K] << "  ";
+      printNumber(OS, EntryValue[K]);
+      OS << '\n';
+    }
+  }
+  OS << "    MARKER  'MARKER'  'INTEND'\n";
+
+  OS << "RHS\n";
+  for (unsigned R = 0; R < NumRows; ++R) {
+    RowKind Kind = getRowKind(RowLower[R], RowUpper[R]);
+    if (Kind == RowKind::Free)
+      continue;
+    double Rhs = Kind == RowKind::Less ? RowUpper[R] : RowLower[R];
+    if (Rhs == 0.0)
+      continue;
+    OS << "    rhs  r" << R << "  ";
+    printNumber(OS, Rhs);
+    OS << '\n';
+  }
+
+  bool HasRanges = false;
+  for (unsigned R = 0; R < NumRows; ++R) {
+    if (getRowKind(RowLower[R], RowUpper[R]) != RowKind::Ranged)
+      continue;
+    if (!HasRanges)
+      OS << "RANGES\n";
+    HasRanges = true;
+    OS << "    rng  r" << R << "  ";
+    printNumber(OS, RowUpper[R] - RowLower[R]);
+    OS << '\n';
+  }
+
+  OS << "BOUNDS\n";
+  for (unsigned Col = 0; Col < NumCols; ++Col) {
+    if (ColLower[Col] == ColUpper[Col]) {
+      OS << " FX BND  " << Names[Col] << "  ";
+      printNumber(OS, ColLower[Col]);
+      OS << '\n';
+      continue;
+    }
+    if (ColLower[Col] != 0.0) {
+      OS << " LO BND  " << Names[Col] << "  ";
+      printNumber(OS, ColLower[Col]);
+      OS << '\n';
+    }
+    if (std::isinf(ColUpper[Col])) {
+      OS << " PL BND  " << Names[Col] << '\n';
+    } else {
+      OS << " UP BND  " << Names[Col] << "  ";
+      printNumber(OS, ColUpper[Col]);
+      OS << '\n';
+    }
+  }
+  OS << "ENDATA\n";
+}
+
+void IPETModel::exportLP(raw_ostream &OS) const {
+  const unsigned NumCols = getNumCols();
+  const unsigned NumRows = getNumRows();
+
+  // Long sums are wrapped, as some LP readers limit the line length.
+  unsigned Terms = 0;
+  auto printTerm = [&](double Coef, unsigned Col) {
+    if (Terms && Terms % 8 == 0)
+      OS << "\n   ";
+    OS << (Coef < 0 ? " - " : (Terms ? " + " : " "));
+    if (std::fabs(Coef) != 1.0) {
+      printNumber(OS, std::fabs(Coef));
+      OS << ' ';
+    }
+    OS << getColumnName(Col);
+    ++Terms;
+  };
+
+  OS << "\\ LLTA IPET model: " << NumCols << " columns, " << NumRows
+     << " rows\n";
+  OS << "Maximize\n obj:";
+  Terms = 0;
+  for (unsigned Col = 0; Col < NumCols; ++Col)
+    if (ColCost[Col] != 0.0)
+      printTerm(ColCost[Col], Col);
+  if (!Terms && NumCols)
+    OS << " 0 " << getColumnName(0);
+  OS << "\nSubject To\n";
+
+  auto printRow = [&](unsigned R, StringRef Suffix, StringRef Op, double Rhs) {
+    OS << " r" << R << Suffix << ':';
+    Terms = 0;
+    for (unsigned K = RowStart[R]; K < RowStart[R + 1]; ++K)
+      printTerm(RowValue[K], RowIndex[K]);
+    OS << ' ' << Op << ' ';
+    printNumber(OS, Rhs);
+    OS << '\n';
+  };
+  for (unsigned R = 0; R < NumRows; ++R) {
+    switch (getRowKind(RowLower[R], RowUpper[R])) {
+    case RowKind::Equal:
+      printRow(R, "", "=", RowLower[R]);
+      break;
+    case RowKind::Greater:
+      printRow(R, "", ">=", RowLower[R]);
+      break;
+    case RowKind::Less:
+      printRow(R, "", "<=", RowUpper[R]);
+      break;
+    case RowKind::Ranged:
+      printRow(R, "_lo", ">=", RowLower[R]);
+      printRow(R, "_hi", "<=", RowUpper[R]);
+      break;
+    case RowKind::Free:
+      break;
+    }
+  }
+
+  // Columns default to [0, +inf); only the others need a bound.
+  OS << "Bounds\n";
+  for (unsigned Col = 0; Col < NumCols; ++Col) {
+    if (ColLower[Col] == 0.0 && std::isinf(ColUpper[Col]))
+      continue;
+    OS << ' ' << getColumnName(Col);
+    if (ColLower[Col] == ColUpper[Col]) {
+      OS << " = ";
+      printNumber(OS, ColLower[Col]);
+      OS << '\n';
+      continue;
+    }
+    OS << " >= ";
+    printNumber(OS, ColLower[Col]);
+    OS << '\n';
+    if (!std::isinf(ColUpper[Col])) {
+      OS << ' ' << getColumnName(Col) << " <= ";
+      printNumber(OS, ColUpper[Col]);
+      OS << '\n';
+    }
+  }
+
+  OS << "General\n";
+  for (unsigned Col = 0; Col < NumCols; ++Col)
+    OS << (Col % 8 ? " " : (Col ? "\n " : " ")) << getColumnName(Col);
+  OS << "\nEnd\n";
+}
+
+} // namespace llvm
@@ -0,0 +1,287 @@
+#include "ILP/IPETReduction.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <functional>
+#include <map>
+
+#define DEBUG_TYPE "ipet-reduction"
+
+namespace llvm {
+
+IPETReduction::IPETReduction(const AbstractStateGraph &ASG) {
+  // Dense slots in ascending original-id order keep the reduction (and the
+  // reduced node numbering) deterministic.
+  for (const auto &Nd : ASG.getNodes()) {
+    if (Nd.Id >= SlotOfOrig.size())
+      SlotOfOrig.resize(Nd.Id + 1, None);
+    SlotOfOrig[Nd.Id] = OrigIds.size();
+    OrigIds.push_back(Nd.Id);
+  }
+  const unsigned N = OrigIds.size();
+  NumOriginalNodes = N;
+
+  std::vector<unsigned> Cost(N);
+  std::vector<bool> IsEntry(N), IsExit(N), IsLoopHeader(N), Alive(N, true);
+  std::vector<bool> Protected(N, false);
+  std::vector<unsigned> LoopBound(N);
+  // Per slot: neighbour slot -> working edge.
+  std::vector<std::map<unsigned, unsigned>> Out(N), In(N);
+  NodeFlow.resize(N);
+
+  for (unsigned S = 0; S < N; ++S) {
+    const auto &Nd = *ASG.getNode(OrigIds[S]);
+    Cost[S] = Nd.Cost;
+    IsEntry[S] = Nd.IsEntry;
+    IsExit[S] = Nd.IsExit;
+    IsLoopHeader[S] = Nd.IsLoopHeader;
+    LoopBound[S] = Nd.UpperLoopBound;
+  }
+  for (unsigned S = 0; S < N; ++S) {
+    for (const auto &E : ASG.getSuccessors(OrigIds[S])) {
+      unsigned T = slotOf(E.To);
+      if (T == None)
+        continue;
+      unsigned Id = Edges.size();
+      Edges.push_back({OrigIds[S], E.To, S, T, E.IsBackEdge, false});
+      Out[S][T] = Id;
+      In[T][S] = Id;
+    }
+  }
+  NumOriginalEdges = Edges.size();
+
+  // Edges read by the call/return matching rows must survive as edges, and
+  // the nodes those rows name must keep a node of their own.
+  auto pin = [&](unsigned From, unsigned To) {
+    unsigned F = slotOf(From), T = slotOf(To);
+    if (F == None || T == None)
+      return;
+    auto It = Out[F].find(T);
+    if (It != Out[F].end())
+      Edges[It->second].Pinned = true;
+  };
+  auto protect = [&](unsigned OrigId) {
+    unsigned S = slotOf(OrigId);
+    if (S != None)
+      Protected[S] = true;
+  };
+  for (const auto &[F, Entry] : ASG.FunctionEntries)
+    protect(Entry);
+  for (const auto &[F, Returns] : ASG.FunctionReturns)
+    for (unsigned R : Returns)
+      protect(R);
+  for (const auto &CS : ASG.CallSites) {
+    protect(CS.CallNodeId);
+    protect(CS.ReturnNodeId);
+    unsigned Entry = ASG.getCalleeEntry(CS);
+    if (Entry != None) {
+      protect(Entry);
+      pin(CS.CallNodeId, Entry);
+    }
+    for (unsigned R : ASG.getCalleeReturns(CS)) {
+      protect(R);
+      pin(R, CS.ReturnNodeId);
+    }
+  }
+
+  // Merge the single successor of U into U while U->V is a plain chain edge.
+  auto tryMerge = [&](unsigned U) {
+    if (!Alive[U] || IsExit[U] || Out[U].size() != 1)
+      return false;
+    auto [V, E] = *Out[U].begin();
+    const WorkEdge &WE = Edges[E];
+    if (V == U || WE.Pinned || WE.IsBackEdge || In[V].size() != 1 ||
+        IsEntry[V] || IsLoopHeader[V])
+      return false;
+
+    Cost[U] += Cost[V];
+    IsExit[U] = IsExit[V];
+    Protected[U] = Protected[U] || Protected[V];
+    NodeFlow[V] = {SourceKind::NodeCount, U};
+    Edges[E].Alive = false;
+    Edges[E].Flow = {SourceKind::NodeCount, U};
+    Alive[V] = false;
+    Out[U].clear();
+    In[V].clear();
+    for (const auto &[Succ, E2] : Out[V]) {
+      unsigned W = Succ == V ? U : Succ; // V's self-loop becomes U's.
+      Edges[E2].From = U;
+      Edges[E2].To = W;
+      In[W].erase(V);
+      In[W][U] = E2;
+      Out[U][W] = E2;
+    }
+    Out[V].clear();
+    return true;
+  };
+
+  // Replace a zero-cost pass-through node P->V->S by a bypass edge P->S.
+  auto tryBypass = [&](unsigned V) {
+    if (!Alive[V] || Cost[V] != 0 || IsEntry[V] || IsExit[V] ||
+        IsLoopHeader[V] || Protected[V] || In[V].size() != 1 ||
+        Out[V].size() != 1)
+      return false;
+    auto [P, EIn] = *In[V].begin();
+    auto [S, EOut] = *Out[V].begin();
+    if (P == V || S == V || P == S || Out[P].count(S))
+      return false;
+    for (unsigned E : {EIn, EOut})
+      if (Edges[E].Pinned || Edges[E].IsBackEdge)
+        return false;
+
+    unsigned Id = Edges.size();
+    Edges.push_back({None, None, P, S, false, false});
+    for (unsigned E : {EIn, EOut}) {
+      Edges[E].Alive = false;
+      Edges[E].Flow = {SourceKind::EdgeFlow, Id};
+    }
+    NodeFlow[V] = {SourceKind::EdgeFlow, Id};
+    Alive[V] = false;
+    Out[P].erase(V);
+    In[S].erase(V);
+    In[V].clear();
+    Out[V].clear();
+    Out[P][S] = Id;
+    In[S][P] = Id;
+    return true;
+  };
+
+  // Each rule can enable the other (a bypass can leave a new chain behind), so
+  // iterate to a fixpoint. Every successful step removes a node.
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (unsigned S = 0; S < N; ++S)
+      while (tryMerge(S))
+        Changed = true;
+    for (unsigned S = 0; S < N; ++S)
+      if (tryBypass(S))
+        Changed = true;
+  }
+
+  // Materialize the reduced graph.
+  SlotToReduced.assign(N, None);
+  for (unsigned S = 0; S < N; ++S) {
+    if (!Alive[S])
+      continue;
+    const auto &Orig = *ASG.getNode(OrigIds[S]);
+    unsigned Id = Reduced.addNode(Orig.State ? Orig.State->clone() : nullptr,
+                                  Orig.MBB);
+    auto *Nd = Reduced.getNode(Id);
+    Nd->Cost = Cost[S];
+    Nd->IsEntry = IsEntry[S];
+    Nd->IsExit = IsExit[S];
+    Nd->IsLoopHeader = IsLoopHeader[S];
+    Nd->UpperLoopBound = LoopBound[S];
+    SlotToReduced[S] = Id;
+  }
+  for (unsigned E = 0, NumEdges = Edges.size(); E < NumEdges; ++E) {
+    const WorkEdge &WE = Edges[E];
+    if (!WE.Alive)
+      continue;
+    unsigned From = SlotToReduced[WE.From], To = SlotToReduced[WE.To];
+    Reduced.addEdge(From, To, WE.IsBackEdge);
+    ++NumReducedEdges;
+  }
+
+  // Call/return bookkeeping follows each node to the chain it was merged
+  // into; protected nodes are never bypassed, so a representative exists.
+  auto toReduced = [&](unsigned OrigId) {
+    unsigned S = slotOf(OrigId);
+    while (S != None && !Alive[S] && NodeFlow[S].Kind == SourceKind::NodeCount)
+      S = NodeFlow[S].Ref;
+    return (S != None && Alive[S]) ? SlotToReduced[S] : None;
+  };
+  for (const auto &[F, Entry] : ASG.FunctionEntries) {
+    unsigned R = toReduced(Entry);
+    if (R != None)
+      Reduced.FunctionEntries[F] = R;
+  }
+  for (const auto &[F, Returns] : ASG.FunctionReturns) {
+    for (unsigned Ret : Returns) {
+      unsigned R = toReduced(Ret);
+      if (R != None && !is_contained(Reduced.FunctionReturns[F], R))
+        Reduced.FunctionReturns[F].push_back(R);
+    }
+  }
+  for (const auto &CS : ASG.CallSites) {
+    unsigned Call = toReduced(CS.CallNodeId);
+    unsigned Ret = toReduced(CS.ReturnNodeId);
+    if (Call == None || Ret == None)
+      continue;
+    Reduced.CallSites.push_back({Call, Ret, CS.Callee});
+    if (CS.EntryNodeId == None)
+      continue;
+    AbstractStateGraph::CallSite &RCS = Reduced.CallSites.back();
+    RCS.EntryNodeId = toReduced(CS.EntryNodeId);
+    for (unsigned R : CS.ReturnNodeIds)
+      if (unsigned RR = toReduced(R); RR != None)
+        RCS.ReturnNodeIds.push_back(RR);
+  }
+
+  LLVM_DEBUG(dbgs() << "IPET reduction: " << NumOriginalNodes << " -> "
+                    << getNumReducedNodes() << " nodes, " << NumOriginalEdges
+                    << " -> " << NumReducedEdges << " edges\n");
+}
+
+AbstractILPResult
+IPETReduction::expand(const AbstractILPResult &ReducedResult) const {
+  AbstractILPResult Result;
+  Result.WCET = ReducedResult.WCET;
+  Result.Status = ReducedResult.Status;
+  Result.LPRelaxationIntegral = ReducedResult.LPRelaxationIntegral;
+  Result.SolverConfig = ReducedResult.SolverConfig;
+  Result.LimitReached = ReducedResult.LimitReached;
+  Result.Incumbent = ReducedResult.Incumbent;
+  Result.Gap = ReducedResult.Gap;
+
+  std::vector<double> NodeMemo(NodeFlow.size(), -1.0);
+  std::vector<double> EdgeMemo(Edges.size(), -1.0);
+  std::function<double(unsigned)> nodeCount, edgeFlow;
+  auto resolve = [&](const Source &Src, double Own) {
+    switch (Src.Kind) {
+    case SourceKind::NodeCount:
+      return nodeCount(Src.Ref);
+    case SourceKind::EdgeFlow:
+      return edgeFlow(Src.Ref);
+    case SourceKind::Self:
+      break;
+    }
+    return Own;
+  };
+  nodeCount = [&](unsigned S) {
+    if (NodeMemo[S] >= 0.0)
+      return NodeMemo[S];
+    double Own = 0.0;
+    if (NodeFlow[S].Kind == SourceKind::Self)
+      Own = ReducedResult.getExecutionCount(SlotToReduced[S]);
+    return NodeMemo[S] = resolve(NodeFlow[S], Own);
+  };
+  edgeFlow = [&](unsigned E) {
+    if (EdgeMemo[E] >= 0.0)
+      return EdgeMemo[E];
+    const WorkEdge &WE = Edges[E];
+    double Own = 0.0;
+    if (WE.Flow.Kind == SourceKind::Self) {
+      auto It = ReducedResult.EdgeCounts.find(
+          {SlotToReduced[WE.From], SlotToReduced[WE.To]});
+      if (It != ReducedResult.EdgeCounts.end())
+        Own = It->second;
+    }
+    return EdgeMemo[E] = resolve(WE.Flow, Own);
+  };
+
+  if (!ReducedResult.ExecutionCounts.empty()) {
+    Result.ExecutionCounts.assign(SlotOfOrig.size(), 0.0);
+    for (unsigned S = 0, E = OrigIds.size(); S < E; ++S)
+      Result.ExecutionCounts[OrigIds[S]] = nodeCount(S);
+  }
+  for (unsigned E = 0; E < NumOriginalEdges; ++E) {
+    double Flow = edgeFlow(E);
+    if (Flow > 0.0001)
+      Result.EdgeCounts[{Edges[E].OrigFrom, Edges[E].OrigTo}] = Flow;
+  }
+  return Result;
+}
+
+} // namespace llvm
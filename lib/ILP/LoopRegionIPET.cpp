@@ -0,0 +1,376 @@
+#include "ILP/LoopRegionIPET.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cmath>
+
+#define DEBUG_TYPE "loop-region-ipet"
+
+namespace llvm {
+
+namespace {
+
+/// Copy \p Orig into \p G: cost, MBB and loop bound, no state, flags or edges.
+unsigned cloneNode(AbstractStateGraph &G,
+                   const AbstractStateGraph::Node &Orig) {
+  unsigned Copy = G.addNode(nullptr, Orig.MBB);
+  auto *Nd = G.getNode(Copy);
+  Nd->Cost = Orig.Cost;
+  Nd->IsLoopHeader = Orig.IsLoopHeader;
+  Nd->UpperLoopBound = Orig.UpperLoopBound;
+  return Copy;
+}
+
+} // namespace
+
+LoopRegionIPET::LoopRegionIPET(const AbstractStateGraph &ASG) : ASG(ASG) {
+  // Level 0 is the input graph under the same ids, with every call site's
+  // callee instance spelled out.
+  const unsigned N = ASG.getNumNodes();
+  Levels.emplace_back();
+  Level &Base = Levels.back();
+  for (unsigned V = 0; V < N; ++V) {
+    cloneNode(Base.Graph, ASG.getNodes()[V]);
+    Base.Graph.getNode(V)->IsEntry = ASG.getNodes()[V].IsEntry;
+    Base.Graph.getNode(V)->IsExit = ASG.getNodes()[V].IsExit;
+  }
+  for (unsigned V = 0; V < N; ++V)
+    for (const auto &E : ASG.getSuccessors(V))
+      Base.Graph.addEdge(V, E.To, E.IsBackEdge);
+  for (const auto &CS : ASG.CallSites) {
+    AbstractStateGraph::CallSite Copy{CS.CallNodeId, CS.ReturnNodeId,
+                                      CS.Callee, ASG.getCalleeEntry(CS)};
+    auto Returns = ASG.getCalleeReturns(CS);
+    Copy.ReturnNodeIds.assign(Returns.begin(), Returns.end());
+    Base.Graph.CallSites.push_back(std::move(Copy));
+  }
+  Base.SummaryOf.assign(N, None);
+
+  // Contract until no loop qualifies; every round may expose the loops
+  // around the ones it summarised.
+  while (true) {
+    Levels.back().FirstRegion = NumRegions;
+    findRegions(Levels.back());
+    if (Levels.back().Regions.empty())
+      break;
+    NumRegions += Levels.back().Regions.size();
+    Level Next = contract(Levels.back());
+    Levels.push_back(std::move(Next));
+  }
+  LLVM_DEBUG(dbgs() << "Loop regions: " << NumRegions << " loops in "
+                    << getNumLevels() << " levels, " << N << " -> "
+                    << getNumTopNodes() << " top-level nodes\n");
+}
+
+void LoopRegionIPET::findRegions(Level &Lv) {
+  const AbstractStateGraph &G = Lv.Graph;
+  const unsigned N = G.getNumNodes();
+  const auto Nodes = G.getNodes();
+
+  std::vector<std::vector<unsigned>> Latches(N);
+  for (unsigned U = 0; U < N; ++U)
+    for (const auto &E : G.getSuccessors(U))
+      if (E.IsBackEdge)
+        Latches[E.To].push_back(U);
+
+  // Call/return matching rows refer to these nodes, so they stay in the
+  // top-level graph.
+  std::vector<bool> InCall(N, false);
+  auto markCall = [&](unsigned V) {
+    if (V < N)
+      InCall[V] = true;
+  };
+  for (const auto &CS : G.CallSites) {
+    markCall(CS.CallNodeId);
+    markCall(CS.ReturnNodeId);
+    markCall(G.getCalleeEntry(CS));
+    for (unsigned R : G.getCalleeReturns(CS))
+      markCall(R);
+  }
+
+  Lv.RegionOf.assign(N, None);
+  std::vector<unsigned> Stamp(N, None);
+  for (unsigned H = 0; H < N; ++H) {
+    if (Latches[H].empty() || !Nodes[H].IsLoopHeader ||
+        !Nodes[H].UpperLoopBound)
+      continue;
+
+    // Natural loop: everything that reaches a latch backwards without
+    // passing the header. Running into the graph entry means the loop is
+    // entered elsewhere as well.
+    Region R{H, {H}, None};
+    Stamp[H] = H;
+    std::vector<unsigned> Worklist(Latches[H]);
+    bool Qualifies = true;
+    while (Qualifies && !Worklist.empty()) {
+      unsigned V = Worklist.back();
+      Worklist.pop_back();
+      if (Stamp[V] == H)
+        continue;
+      Stamp[V] = H;
+      Qualifies = !Nodes[V].IsEntry;
+      R.Body.push_back(V);
+      for (unsigned P : G.getPredecessors(V))
+        Worklist.push_back(P);
+    }
+    if (!Qualifies)
+      continue;
+    llvm::sort(R.Body);
+
+    // Innermost (no other header or back edge inside), no calls, and all
+    // exit edges alike towards one target.
+    bool ExitIsBack = false;
+    for (unsigned V : R.Body) {
+      const auto &Nd = Nodes[V];
+      if (Nd.IsEntry || Nd.IsExit || InCall[V] || Lv.RegionOf[V] != None ||
+          (V != H && Nd.IsLoopHeader)) {
+        Qualifies = false;
+        break;
+      }
+      for (const auto &E : G.getSuccessors(V)) {
+        if (Stamp[E.To] == H) {
+          Qualifies &= !E.IsBackEdge || E.To == H;
+          continue;
+        }
+        if (R.Target == None) {
+          R.Target = E.To;
+          ExitIsBack = E.IsBackEdge;
+        }
+        Qualifies &= R.Target == E.To && ExitIsBack == E.IsBackEdge;
+      }
+      if (!Qualifies)
+        break;
+    }
+    if (!Qualifies || R.Target == None)
+      continue;
+
+    for (unsigned V : R.Body)
+      Lv.RegionOf[V] = Lv.Regions.size();
+    Lv.Regions.push_back(std::move(R));
+  }
+}
+
+LoopRegionIPET::Level LoopRegionIPET::contract(Level &Lv) {
+  const AbstractStateGraph &G = Lv.Graph;
+  const unsigned N = G.getNumNodes();
+  Level Next;
+
+  // A region's summary takes its header's place in the node order.
+  Lv.NextId.assign(N, None);
+  for (unsigned V = 0; V < N; ++V) {
+    const unsigned R = Lv.RegionOf[V];
+    if (R == None) {
+      unsigned Id = cloneNode(Next.Graph, G.getNodes()[V]);
+      Next.Graph.getNode(Id)->IsEntry = G.getNodes()[V].IsEntry;
+      Next.Graph.getNode(Id)->IsExit = G.getNodes()[V].IsExit;
+      Lv.NextId[V] = Id;
+      Next.SummaryOf.push_back(Lv.SummaryOf[V]);
+      Next.PrevId.push_back(V);
+      continue;
+    }
+    Region &Reg = Lv.Regions[R];
+    if (V != Reg.Header)
+      continue;
+    Reg.Summary = Next.Graph.addNode(nullptr, G.getNodes()[V].MBB);
+    for (unsigned W : Reg.Body)
+      Lv.NextId[W] = Reg.Summary;
+    Next.SummaryOf.push_back(Lv.FirstRegion + R);
+    Next.PrevId.push_back(V);
+  }
+
+  // Edges inside a region disappear; its entry edges now end, and its exit
+  // edges start, at the summary.
+  for (unsigned U = 0; U < N; ++U)
+    for (const auto &E : G.getSuccessors(U))
+      if (Lv.RegionOf[U] == None || Lv.RegionOf[U] != Lv.RegionOf[E.To])
+        Next.Graph.addEdge(Lv.NextId[U], Lv.NextId[E.To], E.IsBackEdge);
+
+  // No region contains a node a call site refers to.
+  auto remap = [&](unsigned V) { return V < N ? Lv.NextId[V] : None; };
+  for (const auto &CS : G.CallSites) {
+    AbstractStateGraph::CallSite Copy{remap(CS.CallNodeId),
+                                      remap(CS.ReturnNodeId), CS.Callee,
+                                      remap(G.getCalleeEntry(CS))};
+    for (unsigned R : G.getCalleeReturns(CS))
+      Copy.ReturnNodeIds.push_back(remap(R));
+    Next.Graph.CallSites.push_back(std::move(Copy));
+  }
+  return Next;
+}
+
+unsigned LoopRegionIPET::copyNode(AbstractStateGraph &G, const Level &Lv,
+                                  unsigned V, ArrayRef<double> SummaryWCET) {
+  unsigned Copy = cloneNode(G, Lv.Graph.getNodes()[V]);
+  if (unsigned R = Lv.SummaryOf[V]; R != None)
+    G.getNode(Copy)->Cost +=
+        static_cast<unsigned>(std::llround(SummaryWCET[R]));
+  return Copy;
+}
+
+AbstractStateGraph
+LoopRegionIPET::buildRegion(unsigned L, unsigned R,
+                            ArrayRef<double> SummaryWCET) const {
+  // Node 0 is a synthetic entry, Body[K] is node K + 1, and the last node a
+  // synthetic exit behind every exit edge.
+  const Level &Lv = Levels[L];
+  const Region &Reg = Lv.Regions[R];
+  auto local = [&](unsigned V) {
+    return llvm::lower_bound(Reg.Body, V) - Reg.Body.begin() + 1;
+  };
+  AbstractStateGraph G;
+  unsigned Entry = G.addNode(nullptr);
+  G.getNode(Entry)->IsEntry = true;
+  for (unsigned V : Reg.Body)
+    copyNode(G, Lv, V, SummaryWCET);
+  unsigned Exit = G.addNode(nullptr);
+  G.getNode(Exit)->IsExit = true;
+
+  G.addEdge(Entry, local(Reg.Header));
+  for (unsigned V : Reg.Body)
+    for (const auto &E : Lv.Graph.getSuccessors(V)) {
+      if (Lv.RegionOf[E.To] == R)
+        G.addEdge(local(V), local(E.To), E.IsBackEdge);
+      else
+        G.addEdge(local(V), Exit);
+    }
+  return G;
+}
+
+AbstractStateGraph
+LoopRegionIPET::buildTop(ArrayRef<double> SummaryWCET) const {
+  const Level &Lv = Levels.back();
+  const unsigned N = Lv.Graph.getNumNodes();
+  AbstractStateGraph G;
+  for (unsigned V = 0; V < N; ++V) {
+    copyNode(G, Lv, V, SummaryWCET);
+    G.getNode(V)->IsEntry = Lv.Graph.getNodes()[V].IsEntry;
+    G.getNode(V)->IsExit = Lv.Graph.getNodes()[V].IsExit;
+  }
+  for (unsigned V = 0; V < N; ++V)
+    for (const auto &E : Lv.Graph.getSuccessors(V))
+      G.addEdge(V, E.To, E.IsBackEdge);
+  G.CallSites = Lv.Graph.CallSites;
+  return G;
+}
+
+AbstractILPResult LoopRegionIPET::solve(const SolveFn &Solve,
+                                        unsigned Threads) const {
+  if (Levels.size() == 1)
+    return Solve(ASG);
+
+  AbstractILPResult Result;
+  Result.WCET = 0.0;
+  Result.LPRelaxationIntegral = true;
+
+  // Per-entry WCET and solution of every region, innermost level first. A
+  // level only reads the WCETs of the levels below it (its summary nodes), so
+  // its regions run concurrently.
+  const unsigned NumLevels = getNumLevels();
+  std::vector<double> WCET(NumRegions, 0.0);
+  std::vector<AbstractILPResult> PerEntry(NumRegions);
+  {
+    DefaultThreadPool Pool(hardware_concurrency(Threads));
+    for (unsigned L = 0; L < NumLevels; ++L) {
+      const unsigned First = Levels[L].FirstRegion;
+      const unsigned NumLevelRegions = Levels[L].Regions.size();
+      for (unsigned R = 0; R < NumLevelRegions; ++R)
+        Pool.async([this, L, R, First, &Solve, &WCET, &PerEntry] {
+          PerEntry[First + R] = Solve(buildRegion(L, R, WCET));
+        });
+      Pool.wait();
+      for (unsigned R = 0; R < NumLevelRegions; ++R) {
+        const AbstractILPResult &Sub = PerEntry[First + R];
+        if (!Sub.Status.empty() || Sub.ExecutionCounts.empty()) {
+          Result.Status = Sub.Status.empty() ? ModularIPET::NoIncumbent
+                                             : Sub.Status;
+          Result.LPRelaxationIntegral = false;
+          return Result;
+        }
+        // A limited region's WCET is its dual bound, which keeps the total
+        // a sound bound.
+        WCET[First + R] = Sub.WCET;
+        Result.LPRelaxationIntegral &= Sub.LPRelaxationIntegral;
+        Result.LimitReached |= Sub.LimitReached;
+      }
+    }
+  }
+
+  AbstractILPResult Top = Solve(buildTop(WCET));
+  Result.Status = Top.Status;
+  Result.WCET = Top.WCET;
+  Result.LPRelaxationIntegral &= Top.LPRelaxationIntegral;
+  Result.SolverConfig = Top.SolverConfig;
+  Result.LimitReached |= Top.LimitReached;
+  if (!Top.Status.empty() || Top.ExecutionCounts.empty()) {
+    if (Top.Status.empty() && Top.LimitReached)
+      Result.Status = ModularIPET::NoIncumbent;
+    Result.LPRelaxationIntegral = false;
+    return Result;
+  }
+
+  // Map the counts back one level at a time. A region runs its per-entry
+  // solution once per execution of its summary; flow leaving the summary
+  // leaves through the region's exit edges in the same proportions.
+  std::vector<double> Counts(getNumTopNodes());
+  for (unsigned V = 0; V < Counts.size(); ++V)
+    Counts[V] = Top.getExecutionCount(V);
+  auto Edges = Top.EdgeCounts;
+  for (unsigned L = NumLevels; L-- > 0;) {
+    const Level &Lv = Levels[L], &Next = Levels[L + 1];
+    std::vector<double> LvCounts(Lv.Graph.getNumNodes(), 0.0);
+    decltype(Edges) LvEdges;
+    auto addEdgeCount = [&](unsigned From, unsigned To, double Count) {
+      if (Count > 0.0001)
+        LvEdges[{From, To}] += Count;
+    };
+
+    for (unsigned V = 0; V < LvCounts.size(); ++V)
+      if (Lv.RegionOf[V] == None)
+        LvCounts[V] = Counts[Lv.NextId[V]];
+    for (unsigned R = 0; R < Lv.Regions.size(); ++R) {
+      const Region &Reg = Lv.Regions[R];
+      const AbstractILPResult &Sub = PerEntry[Lv.FirstRegion + R];
+      const double Entries = Counts[Reg.Summary];
+      const unsigned Exit = Reg.Body.size() + 1;
+      for (unsigned K = 0; K < Reg.Body.size(); ++K)
+        LvCounts[Reg.Body[K]] = Entries * Sub.getExecutionCount(K + 1);
+      for (const auto &[Edge, Count] : Sub.EdgeCounts)
+        if (Edge.first != 0 && Edge.second != Exit)
+          addEdgeCount(Reg.Body[Edge.first - 1], Reg.Body[Edge.second - 1],
+                       Entries * Count);
+    }
+
+    for (const auto &[Edge, Count] : Edges) {
+      // An edge into a summary enters its region's header.
+      const unsigned To = Next.PrevId[Edge.second];
+      const unsigned R = Next.SummaryOf[Edge.first];
+      if (R == None || R < Lv.FirstRegion) {
+        addEdgeCount(Next.PrevId[Edge.first], To, Count);
+        continue;
+      }
+      const Region &Reg = Lv.Regions[R - Lv.FirstRegion];
+      const unsigned Exit = Reg.Body.size() + 1;
+      for (const auto &[SubEdge, Share] : PerEntry[R].EdgeCounts)
+        if (SubEdge.second == Exit)
+          addEdgeCount(Reg.Body[SubEdge.first - 1], To, Count * Share);
+    }
+    Counts = std::move(LvCounts);
+    Edges = std::move(LvEdges);
+  }
+  Result.ExecutionCounts = std::move(Counts);
+  Result.EdgeCounts = std::move(Edges);
+
+  // As in ModularIPET: the mapped-back counts are one feasible path, whose
+  // cost is the incumbent.
+  if (Result.LimitReached) {
+    Result.Incumbent = 0.0;
+    for (unsigned V = 0; V < ASG.getNumNodes(); ++V)
+      Result.Incumbent += ASG.getNodes()[V].Cost * Result.ExecutionCounts[V];
+    Result.Gap =
+        Result.WCET > 0 ? (Result.WCET - Result.Incumbent) / Result.WCET : 0.0;
+  }
+  return Result;
+}
+
+} // namespace llvm
@@ -0,0 +1,448 @@
+#include "ILP/ModularIPET.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cmath>
+
+#define DEBUG_TYPE "modular-ipet"
+
+namespace llvm {
+
+ModularIPET::ModularIPET(const AbstractStateGraph &ASG) : ASG(ASG) {
+  const unsigned N = ASG.getNumNodes();
+  collectInstances();
+
+  // Bodies are collected with one shared marker array; an instance marks its
+  // nodes with its own index.
+  std::vector<unsigned> Mark(N, None);
+  for (unsigned Idx = 0; Idx < Instances.size(); ++Idx)
+    if (Instances[Idx].Composable && !collectBody(Idx, Mark))
+      Instances[Idx].Composable = false;
+
+  // Closed regions with distinct entries should not share nodes; if they do,
+  // neither is summarised.
+  std::vector<unsigned> Claim(N, None);
+  for (unsigned Idx = 0; Idx < Instances.size(); ++Idx) {
+    if (!Instances[Idx].Composable)
+      continue;
+    for (unsigned V : Instances[Idx].Body) {
+      if (Claim[V] != None) {
+        Instances[Idx].Composable = false;
+        Instances[Claim[V]].Composable = false;
+      }
+      Claim[V] = Idx;
+    }
+  }
+
+  assignLevels();
+
+  Owner.assign(N, None);
+  for (unsigned Idx = 0; Idx < Instances.size(); ++Idx) {
+    const Instance &I = Instances[Idx];
+    if (!I.Composable)
+      continue;
+    ++NumModules;
+    for (unsigned V : I.Body)
+      Owner[V] = Idx;
+  }
+  NumLevels = Levels.size();
+  NumResidualNodes = llvm::count(Owner, None);
+  for (unsigned S = 0; S < ASG.CallSites.size(); ++S) {
+    unsigned C = ASG.CallSites[S].CallNodeId;
+    NumResidualCallSites += C < N && Owner[C] == None && !isContracted(S);
+  }
+  LLVM_DEBUG(dbgs() << "Modular IPET: " << NumModules << " of "
+                    << Instances.size() << " callee instances in " << NumLevels
+                    << " levels, " << NumResidualNodes
+                    << " residual nodes\n");
+}
+
+bool ModularIPET::hasEdge(unsigned From, unsigned To, bool *IsBack) const {
+  for (const auto &E : ASG.getSuccessors(From))
+    if (E.To == To) {
+      if (IsBack)
+        *IsBack = E.IsBackEdge;
+      return true;
+    }
+  return false;
+}
+
+void ModularIPET::collectInstances() {
+  const unsigned N = ASG.getNumNodes();
+  const unsigned NumSites = ASG.CallSites.size();
+  SiteInstance.assign(NumSites, None);
+  SiteContractible.assign(NumSites, false);
+  SiteAtNode.assign(N, None);
+  for (unsigned S = 0; S < NumSites; ++S) {
+    unsigned C = ASG.CallSites[S].CallNodeId;
+    if (C < N)
+      SiteAtNode[C] = SiteAtNode[C] == None ? S : Several;
+  }
+
+  for (unsigned S = 0; S < NumSites; ++S) {
+    const auto &CS = ASG.CallSites[S];
+    unsigned Entry = ASG.getCalleeEntry(CS);
+    if (Entry >= N || CS.CallNodeId >= N)
+      continue;
+    auto [It, Inserted] = InstanceOfEntry.try_emplace(Entry, Instances.size());
+    if (Inserted) {
+      Instances.emplace_back();
+      Instances.back().Entry = Entry;
+      for (unsigned R : ASG.getCalleeReturns(CS))
+        if (R < N)
+          Instances.back().Returns.push_back(R);
+      llvm::sort(Instances.back().Returns);
+    }
+    Instance &I = Instances[It->second];
+    SiteInstance[S] = It->second;
+    I.Callers.push_back(S);
+
+    // The call node may only lead into the callee or to its landing, and
+    // control must come back from the callee over a return edge.
+    const unsigned C = CS.CallNodeId, L = CS.ReturnNodeId;
+    bool Contractible = SiteAtNode[C] == S && L < N && !I.Returns.empty();
+    for (const auto &E : ASG.getSuccessors(C))
+      Contractible &= E.To == Entry || E.To == L;
+    Contractible &= llvm::any_of(I.Returns,
+                                 [&](unsigned R) { return hasEdge(R, L); });
+    SiteContractible[S] = Contractible;
+    if (!Contractible)
+      I.Composable = false;
+  }
+}
+
+bool ModularIPET::collectBody(unsigned Idx, std::vector<unsigned> &Mark) {
+  Instance &I = Instances[Idx];
+  const auto Nodes = ASG.getNodes();
+
+  SmallVector<unsigned, 4> CallerLandings;
+  for (unsigned S : I.Callers)
+    CallerLandings.push_back(ASG.CallSites[S].ReturnNodeId);
+
+  // Forward closure from the entry: stop at returns, step over calls to their
+  // landing. Reaching another instance's entry or a graph entry/exit means the
+  // region is not closed.
+  std::vector<unsigned> Worklist{I.Entry};
+  Mark[I.Entry] = Idx;
+  auto visit = [&](unsigned V) {
+    if (Mark[V] == Idx)
+      return true;
+    if (InstanceOfEntry.count(V))
+      return false;
+    Mark[V] = Idx;
+    Worklist.push_back(V);
+    return true;
+  };
+  while (!Worklist.empty()) {
+    unsigned U = Worklist.back();
+    Worklist.pop_back();
+    I.Body.push_back(U);
+    if (Nodes[U].IsEntry)
+      return false;
+    unsigned S = SiteAtNode[U];
+    if (isReturnOf(I, U)) {
+      if (S != None)
+        return false;
+      for (const auto &E : ASG.getSuccessors(U))
+        if (!llvm::is_contained(CallerLandings, E.To))
+          return false;
+      continue;
+    }
+    if (Nodes[U].IsExit)
+      return false;
+    if (S == Several || (S != None && !SiteContractible[S]))
+      return false;
+    if (S != None) {
+      I.InnerSites.push_back(S);
+      if (!visit(ASG.CallSites[S].ReturnNodeId))
+        return false;
+      continue;
+    }
+    for (const auto &E : ASG.getSuccessors(U))
+      if (!visit(E.To))
+        return false;
+  }
+  llvm::sort(I.Body);
+
+  // Backward closure: nothing outside may enter the region, except the
+  // callers' call edges into the entry and the returns of inner callees into
+  // their landings.
+  for (unsigned V : I.Body)
+    for (unsigned P : ASG.getPredecessors(V)) {
+      if (Mark[P] == Idx)
+        continue;
+      unsigned S = SiteAtNode[P];
+      if (V == I.Entry && S < Several && SiteInstance[S] == Idx)
+        continue;
+      bool FromInnerCallee = llvm::any_of(I.InnerSites, [&](unsigned Inner) {
+        return ASG.CallSites[Inner].ReturnNodeId == V &&
+               isReturnOf(Instances[SiteInstance[Inner]], P);
+      });
+      if (!FromInnerCallee)
+        return false;
+    }
+  return true;
+}
+
+void ModularIPET::assignLevels() {
+  // A composable instance is levelled once all of its callees are; one level
+  // above the highest. What never gets levelled calls itself (directly or
+  // through a cycle) or a callee that is not composable.
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (Instance &I : Instances) {
+      if (!I.Composable || I.Level != None)
+        continue;
+      unsigned Level = 0;
+      bool Ready = true;
+      for (unsigned S : I.InnerSites) {
+        const Instance &Callee = Instances[SiteInstance[S]];
+        if (!Callee.Composable) {
+          I.Composable = false;
+          Changed = true;
+        }
+        if (!Callee.Composable || Callee.Level == None) {
+          Ready = false;
+          break;
+        }
+        Level = std::max(Level, Callee.Level + 1);
+      }
+      if (Ready) {
+        I.Level = Level;
+        Changed = true;
+      }
+    }
+  }
+
+  for (unsigned Idx = 0; Idx < Instances.size(); ++Idx) {
+    Instance &I = Instances[Idx];
+    if (I.Composable && I.Level == None)
+      I.Composable = false;
+    if (!I.Composable)
+      continue;
+    if (I.Level >= Levels.size())
+      Levels.resize(I.Level + 1);
+    Levels[I.Level].push_back(Idx);
+  }
+}
+
+unsigned ModularIPET::copyNode(AbstractStateGraph &G, unsigned Id,
+                               ArrayRef<double> WCET) const {
+  const auto &Orig = ASG.getNodes()[Id];
+  unsigned Copy = G.addNode(nullptr, Orig.MBB);
+  auto *Nd = G.getNode(Copy);
+  Nd->Cost = Orig.Cost;
+  Nd->IsLoopHeader = Orig.IsLoopHeader;
+  Nd->UpperLoopBound = Orig.UpperLoopBound;
+  unsigned S = SiteAtNode[Id];
+  if (S < Several && isContracted(S))
+    Nd->Cost += static_cast<unsigned>(std::llround(WCET[SiteInstance[S]]));
+  return Copy;
+}
+
+AbstractStateGraph ModularIPET::buildModule(unsigned Idx,
+                                            ArrayRef<double> WCET) const {
+  // Node 0 is a synthetic entry, Body[K] is node K + 1, and the last node a
+  // synthetic exit behind every return.
+  const Instance &I = Instances[Idx];
+  auto local = [&](unsigned V) {
+    return llvm::lower_bound(I.Body, V) - I.Body.begin() + 1;
+  };
+  AbstractStateGraph G;
+  unsigned Entry = G.addNode(nullptr);
+  G.getNode(Entry)->IsEntry = true;
+  for (unsigned V : I.Body)
+    copyNode(G, V, WCET);
+  unsigned Exit = G.addNode(nullptr);
+  G.getNode(Exit)->IsExit = true;
+
+  G.addEdge(Entry, local(I.Entry));
+  for (unsigned V : I.Body) {
+    if (isReturnOf(I, V)) {
+      G.addEdge(local(V), Exit);
+      continue;
+    }
+    unsigned S = SiteAtNode[V];
+    if (S != None) {
+      unsigned L = ASG.CallSites[S].ReturnNodeId;
+      bool IsBack = false;
+      hasEdge(V, L, &IsBack);
+      G.addEdge(local(V), local(L), IsBack);
+      continue;
+    }
+    for (const auto &E : ASG.getSuccessors(V))
+      G.addEdge(local(V), local(E.To), E.IsBackEdge);
+  }
+  return G;
+}
+
+AbstractILPResult ModularIPET::solve(const SolveFn &Solve,
+                                     unsigned Threads) const {
+  AbstractILPResult Result;
+  Result.WCET = 0.0;
+  Result.LPRelaxationIntegral = true;
+
+  // Per-call WCET and solution of every module, bottom-up. A level only reads
+  // the WCETs of the levels below it, so its modules run concurrently.
+  std::vector<double> WCET(Instances.size(), 0.0);
+  std::vector<AbstractILPResult> PerCall(Instances.size());
+  {
+    DefaultThreadPool Pool(hardware_concurrency(Threads));
+    for (const auto &Level : Levels) {
+      for (unsigned Idx : Level)
+        Pool.async([this, Idx, &Solve, &WCET, &PerCall] {
+          PerCall[Idx] = Solve(buildModule(Idx, WCET));
+        });
+      Pool.wait();
+      for (unsigned Idx : Level) {
+        const AbstractILPResult &Sub = PerCall[Idx];
+        if (!Sub.Status.empty() || Sub.ExecutionCounts.empty()) {
+          // A limited solve without an incumbent has a bound but no counts
+          // to charge to the callers' paths.
+          Result.Status = Sub.Status.empty() ? NoIncumbent : Sub.Status;
+          Result.LPRelaxationIntegral = false;
+          return Result;
+        }
+        // A limited sub-ILP's WCET is its dual bound; charging that to the
+        // call nodes keeps the total a sound bound.
+        WCET[Idx] = Sub.WCET;
+        Result.LPRelaxationIntegral &= Sub.LPRelaxationIntegral;
+        Result.LimitReached |= Sub.LimitReached;
+      }
+    }
+  }
+
+  // The residual graph: every node no module owns, contracted calls carrying
+  // their callee's WCET. Call sites that were not contracted are kept.
+  const unsigned N = ASG.getNumNodes();
+  std::vector<unsigned> ResId(N, None), OrigId;
+  AbstractStateGraph Residual;
+  for (unsigned V = 0; V < N; ++V) {
+    if (Owner[V] != None)
+      continue;
+    ResId[V] = copyNode(Residual, V, WCET);
+    OrigId.push_back(V);
+    auto *Nd = Residual.getNode(ResId[V]);
+    Nd->IsEntry = ASG.getNodes()[V].IsEntry;
+    Nd->IsExit = ASG.getNodes()[V].IsExit;
+  }
+  for (unsigned V : OrigId) {
+    unsigned S = SiteAtNode[V];
+    if (S < Several && isContracted(S)) {
+      unsigned L = ASG.CallSites[S].ReturnNodeId;
+      bool IsBack = false;
+      hasEdge(V, L, &IsBack);
+      Residual.addEdge(ResId[V], ResId[L], IsBack);
+      continue;
+    }
+    for (const auto &E : ASG.getSuccessors(V)) {
+      assert(ResId[E.To] != None && "edge into a summarised callee");
+      Residual.addEdge(ResId[V], ResId[E.To], E.IsBackEdge);
+    }
+  }
+  for (unsigned S = 0; S < ASG.CallSites.size(); ++S) {
+    const auto &CS = ASG.CallSites[S];
+    if (CS.CallNodeId >= N || ResId[CS.CallNodeId] == None || isContracted(S))
+      continue;
+    auto remap = [&](unsigned V) { return V < N ? ResId[V] : None; };
+    AbstractStateGraph::CallSite Copy{remap(CS.CallNodeId),
+                                      remap(CS.ReturnNodeId), CS.Callee,
+                                      remap(ASG.getCalleeEntry(CS))};
+    for (unsigned R : ASG.getCalleeReturns(CS))
+      if (remap(R) != None)
+        Copy.ReturnNodeIds.push_back(remap(R));
+    if (Copy.ReturnNodeId != None)
+      Residual.CallSites.push_back(std::move(Copy));
+  }
+
+  AbstractILPResult Top = Solve(Residual);
+  Result.Status = Top.Status;
+  Result.WCET = Top.WCET;
+  Result.LPRelaxationIntegral &= Top.LPRelaxationIntegral;
+  Result.SolverConfig = Top.SolverConfig;
+  Result.LimitReached |= Top.LimitReached;
+  if (!Top.Status.empty() || Top.ExecutionCounts.empty()) {
+    if (Top.Status.empty() && Top.LimitReached)
+      Result.Status = NoIncumbent;
+    Result.LPRelaxationIntegral = false;
+    return Result;
+  }
+
+  // Map the counts back. A contracted call's count is the number of times it
+  // enters its callee; each module's per-call counts are then scaled by its
+  // total calls, callers before callees.
+  Result.ExecutionCounts.assign(N, 0.0);
+  std::vector<double> SiteCalls(ASG.CallSites.size(), 0.0);
+  auto addEdgeCount = [&](unsigned From, unsigned To, double Count) {
+    if (Count > 0.0001)
+      Result.EdgeCounts[{From, To}] += Count;
+  };
+  auto enterCallee = [&](unsigned V, double Count) {
+    unsigned S = SiteAtNode[V];
+    if (S >= Several || !isContracted(S))
+      return;
+    SiteCalls[S] += Count;
+    addEdgeCount(V, Instances[SiteInstance[S]].Entry, Count);
+  };
+  auto isContractedLanding = [&](unsigned From, unsigned To) {
+    unsigned S = SiteAtNode[From];
+    return S < Several && isContracted(S) &&
+           ASG.CallSites[S].ReturnNodeId == To;
+  };
+
+  for (unsigned V : OrigId) {
+    double Count = Top.getExecutionCount(ResId[V]);
+    Result.ExecutionCounts[V] = Count;
+    enterCallee(V, Count);
+  }
+  for (const auto &[Edge, Count] : Top.EdgeCounts) {
+    unsigned From = OrigId[Edge.first], To = OrigId[Edge.second];
+    if (!isContractedLanding(From, To))
+      addEdgeCount(From, To, Count);
+  }
+
+  for (unsigned L = Levels.size(); L-- > 0;)
+    for (unsigned Idx : Levels[L]) {
+      const Instance &I = Instances[Idx];
+      const AbstractILPResult &Sub = PerCall[Idx];
+      double Calls = 0.0;
+      for (unsigned S : I.Callers)
+        Calls += SiteCalls[S];
+      for (unsigned K = 0; K < I.Body.size(); ++K) {
+        double Count = Calls * Sub.getExecutionCount(K + 1);
+        Result.ExecutionCounts[I.Body[K]] = Count;
+        enterCallee(I.Body[K], Count);
+      }
+      const unsigned Exit = I.Body.size() + 1;
+      for (const auto &[Edge, Count] : Sub.EdgeCounts) {
+        if (Edge.first == 0)
+          continue;
+        unsigned From = I.Body[Edge.first - 1];
+        if (Edge.second == Exit) {
+          // Every caller returns along the same per-call path.
+          for (unsigned S : I.Callers)
+            addEdgeCount(From, ASG.CallSites[S].ReturnNodeId,
+                         SiteCalls[S] * Count);
+          continue;
+        }
+        unsigned To = I.Body[Edge.second - 1];
+        if (!isContractedLanding(From, To))
+          addEdgeCount(From, To, Calls * Count);
+      }
+    }
+
+  // The mapped-back counts form one feasible path through the whole graph
+  // (the incumbents where a limit was hit), whose cost is the incumbent.
+  if (Result.LimitReached) {
+    Result.Incumbent = 0.0;
+    for (unsigned V = 0; V < N; ++V)
+      Result.Incumbent += ASG.getNodes()[V].Cost * Result.ExecutionCounts[V];
+    Result.Gap =
+        Result.WCET > 0 ? (Result.WCET - Result.Incumbent) / Result.WCET : 0.0;
+  }
+  return Result;
+}
+
+} // namespace llvm
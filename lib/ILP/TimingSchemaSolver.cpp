@@ -0,0 +1,397 @@
+#include "ILP/TimingSchemaSolver.h"
+#include "ILP/ModularIPET.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cmath>
+
+#define DEBUG_TYPE "timing-schema"
+
+namespace llvm {
+
+namespace {
+
+constexpr unsigned None = ~0u;
+constexpr double Unreached = -1.0;
+
+/// Where the longest path to a point of a loop body comes from: a node of
+/// that body, or (Child set) an exit of a collapsed inner loop. Neither set
+/// marks the start of the body.
+struct Source {
+  unsigned Node = None;
+  unsigned Child = None;
+};
+
+/// A loop exit edge target with the longest final pass reaching it.
+struct LoopExit {
+  unsigned Target;
+  bool IsBackEdge;
+  double Cost;
+  Source From;
+};
+
+struct Loop {
+  unsigned Header;
+  unsigned Bound;
+  std::vector<unsigned> Members;
+  unsigned Parent = None;
+  /// Longest header-to-back-edge iteration.
+  double Cycle = Unreached;
+  Source CycleFrom;
+  SmallVector<LoopExit, 2> Exits;
+
+  double exitCost(const LoopExit &E) const {
+    return (Bound - 1) * std::max(Cycle, 0.0) + E.Cost;
+  }
+};
+
+/// One point of a loop body in topological order: a node of the body, or the
+/// header of a collapsed inner loop.
+struct BodyItem {
+  unsigned Node;
+  unsigned Child;
+};
+
+class Schema {
+public:
+  explicit Schema(const AbstractStateGraph &ASG)
+      : ASG(ASG), N(ASG.getNumNodes()) {}
+
+  bool run(AbstractILPResult &Result);
+
+private:
+  const AbstractStateGraph &ASG;
+  const unsigned N;
+  unsigned Entry = None;
+  std::vector<unsigned> Topo;
+  std::vector<std::vector<unsigned>> Latches;
+  std::vector<Loop> Loops;
+  /// Per node: innermost loop, and the loop it heads.
+  std::vector<unsigned> Inner, HeaderOf;
+  /// Body of every loop, then of the root (index Loops.size()).
+  std::vector<std::vector<BodyItem>> Bodies;
+  std::vector<double> Arrive;
+  std::vector<Source> ArriveFrom;
+
+  bool checkShape();
+  bool buildLoops();
+  bool inLoop(unsigned Node, unsigned L) const {
+    for (unsigned K = Inner[Node]; K != None; K = Loops[K].Parent)
+      if (K == L)
+        return true;
+    return false;
+  }
+  bool solveBody(unsigned L);
+  void relax(unsigned L, unsigned To, bool IsBackEdge, double Val, Source From);
+  void trace(unsigned Stop, Source From, unsigned To, double Count,
+             AbstractILPResult &Result) const;
+  void traceLoop(unsigned L, unsigned To, double Count,
+                 AbstractILPResult &Result) const;
+};
+
+bool Schema::checkShape() {
+  const auto Nodes = ASG.getNodes();
+  Latches.resize(N);
+  std::vector<unsigned> InDegree(N, 0);
+  for (unsigned U = 0; U < N; ++U) {
+    if (Nodes[U].IsEntry) {
+      if (Entry != None)
+        return false;
+      Entry = U;
+    }
+    if (Nodes[U].IsExit && !ASG.getSuccessors(U).empty())
+      return false;
+    for (const auto &E : ASG.getSuccessors(U)) {
+      if (!E.IsBackEdge) {
+        ++InDegree[E.To];
+        continue;
+      }
+      const auto &H = Nodes[E.To];
+      if (!H.IsLoopHeader || !H.UpperLoopBound || H.IsEntry)
+        return false;
+      Latches[E.To].push_back(U);
+    }
+  }
+  if (Entry == None)
+    return false;
+
+  // The graph without back edges must be acyclic.
+  for (unsigned U = 0; U < N; ++U)
+    if (!InDegree[U])
+      Topo.push_back(U);
+  for (unsigned K = 0; K < Topo.size(); ++K)
+    for (const auto &E : ASG.getSuccessors(Topo[K]))
+      if (!E.IsBackEdge && !--InDegree[E.To])
+        Topo.push_back(E.To);
+  return Topo.size() == N;
+}
+
+bool Schema::buildLoops() {
+  // Natural loop of every header: everything that reaches a latch backwards
+  // without passing the header. Nothing outside may enter it elsewhere.
+  std::vector<unsigned> Stamp(N, None);
+  for (unsigned H = 0; H < N; ++H) {
+    if (Latches[H].empty())
+      continue;
+    const unsigned L = Loops.size();
+    Loops.push_back({H, ASG.getNodes()[H].UpperLoopBound, {H}});
+    Stamp[H] = L;
+    std::vector<unsigned> Worklist(Latches[H]);
+    while (!Worklist.empty()) {
+      unsigned V = Worklist.back();
+      Worklist.pop_back();
+      if (Stamp[V] == L)
+        continue;
+      Stamp[V] = L;
+      Loops[L].Members.push_back(V);
+      for (unsigned P : ASG.getPredecessors(V))
+        Worklist.push_back(P);
+    }
+    for (unsigned V : Loops[L].Members) {
+      if (ASG.getNodes()[V].IsEntry)
+        return false;
+      if (V != H && llvm::any_of(ASG.getPredecessors(V),
+                                 [&](unsigned P) { return Stamp[P] != L; }))
+        return false;
+    }
+  }
+
+  // Nest the loops, innermost (smallest) first. A loop containing the header
+  // of an already nested one contains all of it; a header inside a smaller
+  // loop means the two overlap without nesting.
+  llvm::stable_sort(Loops, [](const Loop &A, const Loop &B) {
+    return A.Members.size() < B.Members.size();
+  });
+  Inner.assign(N, None);
+  HeaderOf.assign(N, None);
+  std::fill(Stamp.begin(), Stamp.end(), None);
+  for (unsigned L = 0; L < Loops.size(); ++L) {
+    const unsigned H = Loops[L].Header;
+    if (Inner[H] != None)
+      return false;
+    HeaderOf[H] = L;
+    for (unsigned V : Loops[L].Members)
+      Stamp[V] = L;
+    for (unsigned V : Loops[L].Members) {
+      if (Inner[V] == None) {
+        Inner[V] = L;
+        continue;
+      }
+      unsigned Top = Inner[V];
+      while (Loops[Top].Parent != None && Top != L)
+        Top = Loops[Top].Parent;
+      if (Top == L)
+        continue;
+      if (Stamp[Loops[Top].Header] != L)
+        return false;
+      Loops[Top].Parent = L;
+    }
+  }
+
+  // Loop bodies in topological order; an inner loop appears in its parent's
+  // body at its header's position.
+  const unsigned Root = Loops.size();
+  Bodies.resize(Root + 1);
+  for (unsigned V : Topo) {
+    Bodies[Inner[V] == None ? Root : Inner[V]].push_back({V, None});
+    if (unsigned C = HeaderOf[V]; C != None) {
+      unsigned P = Loops[C].Parent;
+      Bodies[P == None ? Root : P].push_back({V, C});
+    }
+  }
+  return true;
+}
+
+void Schema::relax(unsigned L, unsigned To, bool IsBackEdge, double Val,
+                   Source From) {
+  if (L != Loops.size()) {
+    Loop &Lp = Loops[L];
+    if (To == Lp.Header && IsBackEdge) {
+      if (Val > Lp.Cycle) {
+        Lp.Cycle = Val;
+        Lp.CycleFrom = From;
+      }
+      return;
+    }
+    if (!inLoop(To, L)) {
+      auto *It = llvm::find_if(
+          Lp.Exits, [&](const LoopExit &E) { return E.Target == To; });
+      if (It == Lp.Exits.end())
+        Lp.Exits.push_back({To, IsBackEdge, Val, From});
+      else if (Val > It->Cost)
+        *It = {To, IsBackEdge, Val, From};
+      return;
+    }
+  }
+  if (Val > Arrive[To]) {
+    Arrive[To] = Val;
+    ArriveFrom[To] = From;
+  }
+}
+
+bool Schema::solveBody(unsigned L) {
+  const bool IsRoot = L == Loops.size();
+  const unsigned Start = IsRoot ? Entry : Loops[L].Header;
+  Arrive[Start] = 0.0;
+  ArriveFrom[Start] = Source();
+  for (const BodyItem &Item : Bodies[L]) {
+    double In = Arrive[Item.Node];
+    if (In == Unreached)
+      continue;
+    if (Item.Child == None) {
+      double Val = In + ASG.getNodes()[Item.Node].Cost;
+      for (const auto &E : ASG.getSuccessors(Item.Node))
+        relax(L, E.To, E.IsBackEdge, Val, {Item.Node, None});
+      continue;
+    }
+    for (const LoopExit &E : Loops[Item.Child].Exits)
+      relax(L, E.Target, E.IsBackEdge, In + Loops[Item.Child].exitCost(E),
+            {Item.Node, Item.Child});
+  }
+  if (IsRoot)
+    return true;
+
+  // The header is entered afresh from the parent's body.
+  Arrive[Start] = Unreached;
+  ArriveFrom[Start] = Source();
+  const Loop &Lp = Loops[L];
+  return Lp.Cycle != Unreached && !Lp.Exits.empty();
+}
+
+/// Count the path ending in \p From (then the edge to \p To, if any) back to
+/// the start node \p Stop of its body, \p Count times.
+void Schema::trace(unsigned Stop, Source From, unsigned To, double Count,
+                   AbstractILPResult &Result) const {
+  while (From.Node != None) {
+    if (From.Child != None) {
+      traceLoop(From.Child, To, Count, Result);
+    } else {
+      if (To != None)
+        Result.EdgeCounts[{From.Node, To}] += Count;
+      Result.ExecutionCounts[From.Node] += Count;
+    }
+    if (From.Node == Stop)
+      return;
+    To = From.Node;
+    From = ArriveFrom[To];
+  }
+}
+
+/// Count \p Count entries of loop \p L that leave it towards \p To.
+void Schema::traceLoop(unsigned L, unsigned To, double Count,
+                       AbstractILPResult &Result) const {
+  const Loop &Lp = Loops[L];
+  for (const LoopExit &E : Lp.Exits)
+    if (E.Target == To)
+      trace(Lp.Header, E.From, To, Count, Result);
+  if (Lp.Bound > 1)
+    trace(Lp.Header, Lp.CycleFrom, Lp.Header, Count * (Lp.Bound - 1), Result);
+}
+
+bool Schema::run(AbstractILPResult &Result) {
+  if (!checkShape() || !buildLoops())
+    return false;
+  Arrive.assign(N, Unreached);
+  ArriveFrom.assign(N, Source());
+  for (unsigned L = 0; L <= Loops.size(); ++L)
+    if (!solveBody(L))
+      return false;
+
+  unsigned Best = None;
+  double BestCost = Unreached;
+  for (const BodyItem &Item : Bodies[Loops.size()]) {
+    const auto &Nd = ASG.getNodes()[Item.Node];
+    if (Item.Child != None || !Nd.IsExit || Arrive[Item.Node] == Unreached)
+      continue;
+    if (Arrive[Item.Node] + Nd.Cost > BestCost) {
+      BestCost = Arrive[Item.Node] + Nd.Cost;
+      Best = Item.Node;
+    }
+  }
+  if (Best == None)
+    return false;
+
+  Result.WCET = BestCost;
+  Result.Status.clear();
+  Result.ExecutionCounts.assign(N, 0.0);
+  Result.EdgeCounts.clear();
+  trace(Entry, {Best, None}, None, 1.0, Result);
+  return true;
+}
+
+} // namespace
+
+TimingSchemaSolver::TimingSchemaSolver(
+    std::unique_ptr<AbstractILPSolver> Fallback, bool CrossCheck)
+    : Fallback(std::move(Fallback)), CrossCheck(CrossCheck) {}
+
+TimingSchemaSolver::~TimingSchemaSolver() = default;
+
+bool TimingSchemaSolver::solveStructured(const AbstractStateGraph &ASG,
+                                         AbstractILPResult &Result) {
+  if (!ASG.CallSites.empty())
+    return false;
+  return Schema(ASG).run(Result);
+}
+
+AbstractILPResult
+TimingSchemaSolver::solveWCET(const AbstractStateGraph &ASG) {
+  AbstractILPResult Result;
+  Result.WCET = 0.0;
+  bool Solved = false;
+  if (ASG.CallSites.empty()) {
+    Solved = solveStructured(ASG, Result);
+  } else {
+    // Calls are summarised bottom-up first; the callees and the remaining
+    // top-level graph are then solved structurally one by one.
+    ModularIPET Modular(ASG);
+    if (Modular.getNumResidualCallSites() == 0) {
+      Result = Modular.solve(
+          [](const AbstractStateGraph &Sub) {
+            AbstractILPResult R;
+            R.WCET = 0.0;
+            if (!solveStructured(Sub, R))
+              R.Status = NotStructured;
+            return R;
+          },
+          /*Threads=*/1);
+      Solved = Result.Status.empty();
+    }
+  }
+
+  if (!Solved) {
+    LLVM_DEBUG(dbgs() << "Timing schema does not apply; "
+                      << (Fallback ? "solving the ILP\n" : "no fallback\n"));
+    ++NumFallbacks;
+    if (Fallback)
+      return Fallback->solveWCET(ASG);
+    Result = AbstractILPResult();
+    Result.WCET = 0.0;
+    Result.Status = NotStructured;
+    return Result;
+  }
+  Result.SolverConfig = ConfigName;
+
+  if (CrossCheck && Fallback) {
+    ++NumCrossChecks;
+    AbstractILPResult ILP = Fallback->solveWCET(ASG);
+    // A limit-stopped ILP only bounds the WCET from above.
+    bool Mismatch = ILP.LimitReached
+                        ? std::llround(Result.WCET) > std::llround(ILP.WCET)
+                        : std::llround(ILP.WCET) != std::llround(Result.WCET);
+    if (Mismatch) {
+      ++NumMismatches;
+      errs() << "Warning: timing schema WCET " << std::llround(Result.WCET)
+             << " differs from the ILP's " << std::llround(ILP.WCET);
+      if (!ILP.Status.empty())
+        errs() << " (solver status: " << ILP.Status << ")";
+      errs() << "; using the ILP result\n";
+      return ILP;
+    }
+  }
+  return Result;
+}
+
+} // namespace llvm
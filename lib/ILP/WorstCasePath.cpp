@@ -0,0 +1,520 @@
+#include "ILP/WorstCasePath.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <utility>
+
+namespace llvm {
+
+namespace {
+
+constexpr unsigned NoNode = ~0u;
+
+/// An out-edge and the flow the trail has not taken yet.
+struct FlowEdge {
+  unsigned To;
+  unsigned long long Flow;
+  bool IsBackEdge;
+  /// Call edge: landing block of its call site.
+  unsigned Landing = NoNode;
+  /// Edge from a callee's return node to a landing block.
+  bool IsReturn = false;
+};
+
+/// A folded run: Body (tokens) taken Repeat times.
+struct Run {
+  std::vector<unsigned> Body;
+  unsigned long long Repeat;
+};
+
+/// Folds token sequences into runs. Tokens below FirstRun are node ids, the
+/// others index Runs. Equal runs share a token, so an outer loop's iterations
+/// compare equal once their inner loops are folded.
+class RunFolder {
+public:
+  explicit RunFolder(unsigned FirstRun) : FirstRun(FirstRun) {}
+
+  /// The token of \p Body taken \p Repeat times.
+  unsigned getRun(std::vector<unsigned> Body, unsigned long long Repeat);
+
+  /// \p Seq with every run of two or more consecutive copies of a
+  /// sub-sequence folded, innermost first, and every run token merged with
+  /// the copies of its body that follow it.
+  std::vector<unsigned> fold(std::vector<unsigned> Seq);
+
+  std::vector<WorstCasePath::Segment>
+  toSegments(ArrayRef<unsigned> Tokens) const;
+
+private:
+  bool isRun(unsigned Token) const { return Token >= FirstRun; }
+
+  unsigned FirstRun;
+  std::vector<Run> Runs;
+  std::map<std::pair<std::vector<unsigned>, unsigned long long>, unsigned>
+      RunIds;
+};
+
+unsigned RunFolder::getRun(std::vector<unsigned> Body,
+                           unsigned long long Repeat) {
+  assert(!Body.empty() && "a run needs a body");
+  // A run of a single run is that run, taken more often.
+  if (Body.size() == 1 && isRun(Body.front())) {
+    const Run &Inner = Runs[Body.front() - FirstRun];
+    Repeat *= Inner.Repeat;
+    Body = Inner.Body;
+  }
+  auto [It, Inserted] =
+      RunIds.try_emplace({Body, Repeat}, FirstRun + Runs.size());
+  if (Inserted)
+    Runs.push_back({std::move(Body), Repeat});
+  return It->second;
+}
+
+std::vector<unsigned> RunFolder::fold(std::vector<unsigned> Seq) {
+  // Runs are folded by increasing period, so inner loops (shorter bodies)
+  // are folded before the outer iterations that contain them.
+  constexpr size_t MaxPeriod = 1024;
+  constexpr size_t NoNext = ~size_t(0);
+  std::vector<unsigned> Next;
+  std::vector<size_t> NextSame;
+  DenseMap<unsigned, size_t> LastSeen;
+  for (size_t Limit = 1; Limit <= MaxPeriod; Limit *= 2) {
+    for (bool Changed = true; Changed;) {
+      Changed = false;
+      Next.clear();
+      // A period starts where the first token recurs: index its next
+      // occurrence.
+      const size_t N = Seq.size();
+      NextSame.assign(N, NoNext);
+      LastSeen.clear();
+      for (size_t I = N; I-- > 0;) {
+        auto [It, Inserted] = LastSeen.try_emplace(Seq[I], I);
+        if (!Inserted) {
+          NextSame[I] = It->second;
+          It->second = I;
+        }
+      }
+      for (size_t I = 0; I < N;) {
+        auto At = Seq.begin() + I;
+        if (isRun(*At)) {
+          // The walk emits a repeated iteration as its run followed by the
+          // iteration itself: count the copies of the body that follow.
+          Run R = Runs[*At - FirstRun];
+          size_t J = I + 1;
+          for (;;) {
+            if (J + R.Body.size() <= N &&
+                std::equal(R.Body.begin(), R.Body.end(), Seq.begin() + J)) {
+              ++R.Repeat;
+              J += R.Body.size();
+            } else if (J < N && isRun(Seq[J]) &&
+                       Runs[Seq[J] - FirstRun].Body == R.Body) {
+              R.Repeat += Runs[Seq[J] - FirstRun].Repeat;
+              ++J;
+            } else {
+              break;
+            }
+          }
+          if (J > I + 1) {
+            Next.push_back(getRun(std::move(R.Body), R.Repeat));
+            I = J;
+            Changed = true;
+            continue;
+          }
+        }
+        size_t Period = 0;
+        for (size_t J = NextSame[I];
+             J != NoNext && J - I <= Limit && 2 * J - I <= N; J = NextSame[J])
+          if (std::equal(At, At + (J - I), Seq.begin() + J)) {
+            Period = J - I;
+            break;
+          }
+        if (!Period) {
+          Next.push_back(Seq[I++]);
+          continue;
+        }
+        unsigned long long Repeat = 2;
+        while (I + (Repeat + 1) * Period <= N &&
+               std::equal(At, At + Period, At + Repeat * Period))
+          ++Repeat;
+        Next.push_back(getRun(std::vector<unsigned>(At, At + Period), Repeat));
+        I += Repeat * Period;
+        Changed = true;
+      }
+      Seq.swap(Next);
+    }
+  }
+  return Seq;
+}
+
+std::vector<WorstCasePath::Segment>
+RunFolder::toSegments(ArrayRef<unsigned> Tokens) const {
+  std::vector<WorstCasePath::Segment> Segments(Tokens.size());
+  for (unsigned I = 0, E = Tokens.size(); I != E; ++I) {
+    if (!isRun(Tokens[I])) {
+      Segments[I].Node = Tokens[I];
+      continue;
+    }
+    const Run &R = Runs[Tokens[I] - FirstRun];
+    Segments[I].Body = toSegments(R.Body);
+    Segments[I].Repeat = R.Repeat;
+  }
+  return Segments;
+}
+
+unsigned long long countBlocks(ArrayRef<WorstCasePath::Segment> Segments) {
+  unsigned long long Count = 0;
+  for (const WorstCasePath::Segment &S : Segments)
+    Count += S.Body.empty() ? 1 : S.Repeat * countBlocks(S.Body);
+  return Count;
+}
+
+void appendBlocks(ArrayRef<WorstCasePath::Segment> Segments,
+                  std::vector<unsigned> &Path) {
+  for (const WorstCasePath::Segment &S : Segments) {
+    if (S.Body.empty()) {
+      Path.push_back(S.Node);
+      continue;
+    }
+    for (unsigned long long I = 0; I < S.Repeat; ++I)
+      appendBlocks(S.Body, Path);
+  }
+}
+
+} // namespace
+
+WorstCasePath::WorstCasePath(const AbstractStateGraph &ASG,
+                             const AbstractILPResult &Result)
+    : ASG(ASG) {
+  const unsigned NumNodes = ASG.getNumNodes();
+  unsigned Entry = NoNode;
+  for (unsigned U = 0; U < NumNodes && Entry == NoNode; ++U)
+    if (ASG.getNodes()[U].IsEntry)
+      Entry = U;
+  if (Entry == NoNode || Result.getExecutionCount(Entry) < 0.5)
+    return;
+
+  // Out-edges in successor order (sorted by target) with their flow.
+  std::vector<unsigned> EdgeBegin(NumNodes + 1, 0);
+  std::vector<FlowEdge> Edges;
+  for (unsigned U = 0; U < NumNodes; ++U) {
+    for (const auto &E : ASG.getSuccessors(U)) {
+      auto It = Result.EdgeCounts.find({U, E.To});
+      double Flow = It == Result.EdgeCounts.end() ? 0.0 : It->second;
+      Edges.push_back({E.To, static_cast<unsigned long long>(
+                                 std::llround(std::max(Flow, 0.0))),
+                       E.IsBackEdge});
+    }
+    EdgeBegin[U + 1] = Edges.size();
+  }
+  auto findEdge = [&](unsigned From, unsigned To) -> FlowEdge * {
+    if (From >= NumNodes)
+      return nullptr;
+    auto *Begin = Edges.data() + EdgeBegin[From];
+    auto *End = Edges.data() + EdgeBegin[From + 1];
+    auto *It = std::lower_bound(
+        Begin, End, To, [](const FlowEdge &E, unsigned V) { return E.To < V; });
+    return It != End && It->To == To ? It : nullptr;
+  };
+
+  std::vector<SmallVector<unsigned, 1>> CallersOf(NumNodes);
+  for (const auto &CS : ASG.CallSites) {
+    if (FlowEdge *Call = findEdge(CS.CallNodeId, ASG.getCalleeEntry(CS)))
+      Call->Landing = CS.ReturnNodeId;
+    for (unsigned R : ASG.getCalleeReturns(CS))
+      if (FlowEdge *Ret = findEdge(R, CS.ReturnNodeId))
+        Ret->IsReturn = true;
+    if (CS.ReturnNodeId < NumNodes)
+      CallersOf[CS.ReturnNodeId].push_back(CS.CallNodeId);
+  }
+
+  // One loop per back-edge target. Its body is found backwards from the
+  // back-edge sources up to the header; a call inside the body is stepped
+  // over (landing to call node), so callee bodies, shared by every caller,
+  // do not drag their other callers into the loop.
+  std::vector<unsigned> LoopOf(NumNodes, NoNode);
+  std::vector<unsigned> Headers;
+  for (const FlowEdge &E : Edges)
+    if (E.IsBackEdge && LoopOf[E.To] == NoNode) {
+      LoopOf[E.To] = Headers.size();
+      Headers.push_back(E.To);
+    }
+  const unsigned NumLoops = Headers.size();
+  std::vector<SmallVector<unsigned, 2>> LoopsOf(NumNodes);
+  std::vector<unsigned> Mark(NumNodes, NoNode);
+  std::vector<unsigned long long> RemBack(NumLoops, 0), RemEntry(NumLoops, 0);
+  SmallVector<unsigned, 32> Work;
+  for (unsigned L = 0; L < NumLoops; ++L) {
+    unsigned H = Headers[L];
+    Mark[H] = L;
+    LoopsOf[H].push_back(L);
+    for (unsigned P : ASG.getPredecessors(H)) {
+      const FlowEdge *E = findEdge(P, H);
+      if (!E)
+        continue;
+      (E->IsBackEdge ? RemBack : RemEntry)[L] += E->Flow;
+      if (E->IsBackEdge)
+        Work.push_back(P);
+    }
+    while (!Work.empty()) {
+      unsigned X = Work.pop_back_val();
+      if (Mark[X] == L)
+        continue;
+      Mark[X] = L;
+      LoopsOf[X].push_back(L);
+      for (unsigned P : ASG.getPredecessors(X)) {
+        const FlowEdge *E = findEdge(P, X);
+        if (E && !E->IsReturn && E->Landing == NoNode)
+          Work.push_back(P);
+      }
+      Work.append(CallersOf[X].begin(), CallersOf[X].end());
+    }
+  }
+
+  // Back-edge traversals left for the current entry of each loop.
+  std::vector<unsigned long long> Budget(NumLoops, 0);
+  if (LoopOf[Entry] != NoNode)
+    Budget[LoopOf[Entry]] = RemBack[LoopOf[Entry]];
+  SmallVector<unsigned, 16> CallStack;
+
+  // Preference among the out-edges of U that still carry flow; the highest
+  // wins, ties go to the first.
+  auto score = [&](unsigned U, const FlowEdge &E) {
+    int Score = 0;
+    if (E.IsReturn && !CallStack.empty())
+      Score += E.To == CallStack.back() ? 4 : -4;
+    if (E.IsBackEdge)
+      Score += Budget[LoopOf[E.To]] ? 2 : -2;
+    if (!E.IsReturn && E.Landing == NoNode)
+      for (unsigned L : LoopsOf[U])
+        if (!is_contained(LoopsOf[E.To], L))
+          Score += Budget[L] ? -1 : 1; // leaves loop L
+    return Score;
+  };
+
+  // Hierholzer: extend the walk while its last node has flow left; a node
+  // with none is final and is emitted, so the trail comes out reversed, with
+  // every cycle spliced in where the walk left it. Emitted tokens are node
+  // ids and, from NumNodes on, WalkRuns.
+  struct Frame {
+    unsigned Node;
+    /// The edge the walk took to Node (none for the entry).
+    FlowEdge *In = nullptr;
+    unsigned Pushed = NoNode;
+    unsigned Popped = NoNode;
+    /// Repetitions of the loop iteration starting here, emitted before Node.
+    unsigned RunBefore = NoNode;
+  };
+  /// Repetitions of one iteration, and the flow they take per edge.
+  struct WalkRun {
+    std::vector<unsigned> Body;
+    unsigned long long Repeat;
+    SmallVector<std::pair<FlowEdge *, unsigned long long>, 8> Uses;
+  };
+  SmallVector<Frame, 64> Stack;
+  std::vector<WalkRun> WalkRuns;
+  std::vector<unsigned> Tokens;
+
+  // The walk has just closed an iteration of loop L with back edge Back: the
+  // frames from the header's nearest frame to the top. Take the iteration
+  // again as often as L's budget and the flows allow; the repetitions are
+  // emitted as a run before the iteration itself, which still follows the
+  // trail (and takes any cycle spliced into it later).
+  auto repeatIteration = [&](unsigned L, FlowEdge *Back) {
+    if (!Budget[L])
+      return;
+    size_t A = Stack.size();
+    do {
+      if (A == 0)
+        return;
+      --A;
+    } while (Stack[A].Node != Headers[L]);
+    if (Stack[A].RunBefore != NoNode)
+      return;
+    // The flow per edge of one iteration, inner runs included. Calls must
+    // return within it.
+    SmallVector<std::pair<FlowEdge *, unsigned long long>, 16> Uses;
+    unsigned Depth = 0;
+    for (size_t K = A + 1; K < Stack.size(); ++K) {
+      const Frame &F = Stack[K];
+      if (F.RunBefore != NoNode) {
+        const WalkRun &R = WalkRuns[F.RunBefore - NumNodes];
+        Uses.append(R.Uses.begin(), R.Uses.end());
+      }
+      Uses.push_back({F.In, 1});
+      if (F.Pushed != NoNode)
+        ++Depth;
+      if (F.Popped != NoNode) {
+        if (!Depth)
+          return;
+        --Depth;
+      }
+    }
+    if (Depth)
+      return;
+    Uses.push_back({Back, 1});
+    llvm::sort(Uses, less_first());
+    size_t NumUses = 0;
+    for (const auto &U : Uses) {
+      if (NumUses && Uses[NumUses - 1].first == U.first)
+        Uses[NumUses - 1].second += U.second;
+      else
+        Uses[NumUses++] = U;
+    }
+    Uses.resize(NumUses);
+
+    unsigned long long Times = Budget[L];
+    for (const auto &[E, N] : Uses)
+      Times = std::min(Times, E->Flow / N);
+    if (!Times)
+      return;
+    for (auto &[E, N] : Uses) {
+      N *= Times;
+      E->Flow -= N;
+      unsigned Inner = LoopOf[E->To];
+      if (Inner == NoNode)
+        continue;
+      if (E->IsBackEdge) {
+        RemBack[Inner] -= std::min(RemBack[Inner], N);
+        Budget[Inner] -= std::min(Budget[Inner], N);
+      } else {
+        RemEntry[Inner] -= std::min(RemEntry[Inner], N);
+      }
+    }
+    std::vector<unsigned> Body;
+    for (size_t K = A; K < Stack.size(); ++K) {
+      if (Stack[K].RunBefore != NoNode)
+        Body.push_back(Stack[K].RunBefore);
+      Body.push_back(Stack[K].Node);
+    }
+    Stack[A].RunBefore = NumNodes + WalkRuns.size();
+    WalkRuns.push_back({std::move(Body), Times, std::move(Uses)});
+  };
+
+  Stack.push_back({Entry});
+  while (!Stack.empty()) {
+    unsigned U = Stack.back().Node;
+    FlowEdge *Best = nullptr;
+    int BestScore = 0;
+    for (unsigned K = EdgeBegin[U]; K < EdgeBegin[U + 1]; ++K) {
+      if (!Edges[K].Flow)
+        continue;
+      int Score = score(U, Edges[K]);
+      if (!Best || Score > BestScore) {
+        Best = &Edges[K];
+        BestScore = Score;
+      }
+    }
+
+    if (!Best) {
+      Tokens.push_back(U);
+      if (Stack.back().RunBefore != NoNode)
+        Tokens.push_back(Stack.back().RunBefore);
+      // Undo the frame's call-stack change for the walk it returns to.
+      if (Stack.back().Pushed != NoNode)
+        CallStack.pop_back();
+      if (Stack.back().Popped != NoNode)
+        CallStack.push_back(Stack.back().Popped);
+      Stack.pop_back();
+      continue;
+    }
+
+    --Best->Flow;
+    Frame F{Best->To, Best};
+    if (unsigned L = LoopOf[Best->To]; L != NoNode) {
+      if (Best->IsBackEdge) {
+        --RemBack[L];
+        if (Budget[L])
+          --Budget[L];
+        repeatIteration(L, Best);
+      } else {
+        // A new entry: an even share of the iterations left.
+        Budget[L] = RemEntry[L] ? divideCeil(RemBack[L], RemEntry[L])
+                                : RemBack[L];
+        if (RemEntry[L])
+          --RemEntry[L];
+      }
+    }
+    if (Best->Landing != NoNode) {
+      F.Pushed = Best->Landing;
+      CallStack.push_back(F.Pushed);
+    } else if (Best->IsReturn && !CallStack.empty()) {
+      F.Popped = CallStack.pop_back_val();
+    }
+    Stack.push_back(F);
+  }
+  std::reverse(Tokens.begin(), Tokens.end());
+
+  for (const FlowEdge &E : Edges)
+    UncoveredFlow += E.Flow;
+
+  // Fold the walk's runs (inner ones first, as they were created) and what
+  // repeats around them.
+  RunFolder Folder(NumNodes + WalkRuns.size());
+  std::vector<unsigned> Canonical(WalkRuns.size());
+  auto fold = [&](std::vector<unsigned> Seq) {
+    for (unsigned &Token : Seq)
+      if (Token >= NumNodes)
+        Token = Canonical[Token - NumNodes];
+    return Folder.fold(std::move(Seq));
+  };
+  for (unsigned K = 0, E = WalkRuns.size(); K != E; ++K)
+    Canonical[K] =
+        Folder.getRun(fold(std::move(WalkRuns[K].Body)), WalkRuns[K].Repeat);
+  Segments = Folder.toSegments(fold(std::move(Tokens)));
+  Length = countBlocks(Segments);
+}
+
+std::vector<unsigned> WorstCasePath::expand() const {
+  std::vector<unsigned> Path;
+  Path.reserve(Length);
+  appendBlocks(Segments, Path);
+  return Path;
+}
+
+std::vector<WorstCasePath::Segment>
+WorstCasePath::compress(ArrayRef<unsigned> Path) {
+  unsigned FirstRun = 0;
+  for (unsigned Node : Path)
+    FirstRun = std::max(FirstRun, Node + 1);
+  RunFolder Folder(FirstRun);
+  return Folder.toSegments(
+      Folder.fold(std::vector<unsigned>(Path.begin(), Path.end())));
+}
+
+unsigned long long WorstCasePath::getCost(const Segment &S) const {
+  if (S.Body.empty())
+    return ASG.getNodes()[S.Node].Cost;
+  unsigned long long Cost = 0;
+  for (const Segment &Inner : S.Body)
+    Cost += getCost(Inner);
+  return Cost * S.Repeat;
+}
+
+void WorstCasePath::print(raw_ostream &OS,
+                          function_ref<std::string(unsigned)> Label,
+                          unsigned Indent) const {
+  print(OS, Segments, Label, Indent);
+}
+
+void WorstCasePath::print(raw_ostream &OS, ArrayRef<Segment> Segments,
+                          function_ref<std::string(unsigned)> Label,
+                          unsigned Indent) const {
+  for (const Segment &S : Segments) {
+    OS.indent(Indent);
+    if (S.Body.empty()) {
+      OS << Label(S.Node) << " (" << ASG.getNodes()[S.Node].Cost
+         << " cycles)\n";
+      continue;
+    }
+    OS << S.Repeat << " x (" << getCost(S) / S.Repeat << " cycles each)\n";
+    print(OS, S.Body, Label, Indent + 2);
+  }
+}
+
+} // namespace llvm
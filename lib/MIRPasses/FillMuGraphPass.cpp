@@ -2,9 +2,11 @@
 #include "Graph/ProgramGraph.h"
 #include "MIRPasses/StartFunction.h"
 #include "Utility/Options.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/CodeGen/Passes.h"
+#include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
@@ -20,6 +22,52 @@ Function *FillMuGraphPass::getStartingFunction(CallGraph &CG) {
   return findStartFunction(CG);
 }
 
+void FillMuGraphPass::computeReachableFunctions(const Module &M) {
+  ReachableComputed = true;
+  for (const Function &Func : M)
+    if (!Func.isDeclaration())
+      LastDefinedFunction = &Func;
+
+  // An explicit -start-function that names no function keeps the old
+  // build-everything behaviour (there is then no Entry node to prune from).
+  Function *Start = getStartingFunction(*CG);
+  if (!Start ||
+      (!StartFunctionName.empty() && Start->getName() != StartFunctionName))
+    return;
+
+  // Walk the direct-call closure of the start function. Indirect calls are not
+  // wired into the ProgramGraph either, so this is exactly the set of
+  // functions finalize() would keep. A record without a callee node function
+  // is still followed when its call instruction names a Function behind a
+  // cast (a type-mismatched direct call), since the MIR call targets it.
+  SmallVector<const Function *, 32> Worklist{Start};
+  ReachableFunctions.insert(Start);
+  while (!Worklist.empty()) {
+    const Function *Cur = Worklist.pop_back_val();
+    const CallGraphNode *Node = (*CG)[Cur];
+    for (const auto &[Call, CalleeNode] : *Node) {
+      const Function *Callee = CalleeNode->getFunction();
+      if (!Callee && Call)
+        if (const auto *CB = dyn_cast_or_null<CallBase>((Value *)*Call))
+          Callee = dyn_cast<Function>(
+              CB->getCalledOperand()->stripPointerCasts());
+      if (Callee && ReachableFunctions.insert(Callee).second)
+        Worklist.push_back(Callee);
+    }
+  }
+
+  unsigned NumDefined = 0, NumReachable = 0;
+  for (const Function &Func : M) {
+    if (Func.isDeclaration())
+      continue;
+    ++NumDefined;
+    NumReachable += ReachableFunctions.contains(&Func);
+  }
+  outs() << "Building ProgramGraph for " << NumReachable << " of "
+         << NumDefined << " function(s) reachable from '" << Start->getName()
+         << "'.\n";
+}
+
 void FillMuGraphPass::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
   AU.addRequired<MachineModuleInfoWrapperPass>();
@@ -41,8 +89,31 @@ bool FillMuGraphPass::runOnMachineFunction(MachineFunction &F) {
   }
 
   auto *MMI = &getAnalysis<MachineModuleInfoWrapperPass>().getMMI();
-  auto MBBLatencyMap = TAR.getMBBLatencyMap();
-  auto LoopBoundMap = TAR.getLoopBoundMap();
+  if (!ReachableComputed)
+    computeReachableFunctions(*MMI->getModule());
+
+  // Functions outside the start function's call subgraph never reach the
+  // ProgramGraph: no nodes, no call-site capture, no latency lookups.
+  bool IsReachable = ReachableFunctions.empty() ||
+                     ReachableFunctions.contains(&F.getFunction());
+  if (IsReachable)
+    fillFunction(F);
+
+  // finalize() runs once, after the last function with a body (only those get
+  // MachineFunctions), whether or not that function itself was built.
+  if (LastDefinedFunction == &F.getFunction()) {
+    TAR.MASG.finalize(F, MMI, &TAR.getTarget(), TAR.getRecursionBoundMap(),
+                      ContextDepth);
+    if (!DumpGraphFile.empty())
+      dumpGraph();
+  }
+
+  return false;
+}
+
+void FillMuGraphPass::fillFunction(MachineFunction &F) {
+  const auto &MBBLatencyMap = TAR.getMBBLatencyMap();
+  const auto &LoopBoundMap = TAR.getLoopBoundMap();
   auto *MLI = &getAnalysis<MachineLoopInfoWrapperPass>().getLI();
 
   bool IsEntry = false;
@@ -56,27 +127,22 @@ bool FillMuGraphPass::runOnMachineFunction(MachineFunction &F) {
 
   TAR.MASG.fillGraphWithFunction(F, IsEntry, MBBLatencyMap, LoopBoundMap, MLI,
                                  TAR.getIrreducibleBackEdges());
+}
 
-  // Check if this is the last function to finalize
-  bool IsLast = false;
-  const Function *LastF = nullptr;
-  // Find the last function that is not a declaration (has a body)
-  // Because MachineFunctions are only created for functions with bodies.
-  for (auto &Func : MMI->getModule()->getFunctionList()) {
-    if (!Func.isDeclaration()) {
-      LastF = &Func;
-    }
-  }
-
-  if (LastF == &F.getFunction()) {
-    IsLast = true;
-  }
-
-  if (IsLast) {
-    TAR.MASG.finalize(F, MMI, &TAR.getTarget(), TAR.getRecursionBoundMap());
-  }
-
-  return false;
+void FillMuGraphPass::dumpGraph() const {
+  ProgramGraph::ExportFormat Format =
+      ProgramGraph::getExportFormatForPath(DumpGraphFile);
+  if (DumpGraphFormat == "dot")
+    Format = ProgramGraph::ExportFormat::DOT;
+  else if (DumpGraphFormat == "graphml")
+    Format = ProgramGraph::ExportFormat::GraphML;
+  else if (DumpGraphFormat == "jsonl")
+    Format = ProgramGraph::ExportFormat::JSONL;
+  else if (!DumpGraphFormat.empty())
+    errs() << "Warning: unknown -dump-graph-format '" << DumpGraphFormat
+           << "'; using the format implied by the file name.\n";
+  if (TAR.MASG.exportGraph(DumpGraphFile, Format))
+    outs() << "ProgramGraph written to " << DumpGraphFile << "\n";
 }
 
 MachineFunctionPass *createFillMuGraphPass(TimingAnalysisResults &TAR) {
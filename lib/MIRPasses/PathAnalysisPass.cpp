@@ -1,9 +1,19 @@
 #include "MIRPasses/PathAnalysisPass.h"
+#include "Analysis/FixpointStats.h"
+#include "Analysis/GraphFile.h"
 #include "ILP/AbstractHighsSolver.h"
 #include "ILP/AbstractILPSolver.h"
+#include "ILP/IPETModel.h"
+#include "ILP/IPETReduction.h"
+#include "ILP/LoopRegionIPET.h"
+#include "ILP/ModularIPET.h"
+#include "ILP/TimingSchemaSolver.h"
+#include "ILP/WorstCasePath.h"
 #include "MIRPasses/StartFunction.h"
 #include "Targets/RTTarget.h"
 #include "TimingAnalysisResults.h"
+#include "Utility/Options.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/ScalarEvolutionAliasAnalysis.h"
@@ -13,6 +23,7 @@
 #include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 #include <climits>
 #include <cmath>
@@ -49,14 +60,14 @@ Function *PathAnalysisPass::getStartingFunction(CallGraph &CG) {
 bool PathAnalysisPass::doFinalization(Module &M) {
   outs() << "\n=== Path Analysis: Computing WCET via ILP ===\n";
 
-  const auto &Nodes = TAR.MASG.getNodes();
-  outs() << "Total nodes: " << Nodes.size() << "\n";
+  const ProgramGraph &PG = TAR.MASG;
+  outs() << "Total nodes: " << PG.getNumDenseNodes() << "\n";
 
   if (DebugPrints) {
-    for (const auto &NodePair : Nodes) {
-      const Node &N = NodePair.second;
+    for (unsigned I = 0; I < PG.getNumDenseNodes(); ++I) {
+      const Node &N = PG.getDenseNode(I);
       if (N.IsLoop) {
-        outs() << "Loop node " << NodePair.first << " (" << N.Name
+        outs() << "Loop node " << PG.getNodeIdAt(I) << " (" << N.Name
                << ") has bound: " << N.UpperLoopBound;
         if (N.IsNestedLoop && N.NestedLoopHeader)
           outs() << " (nested in loop " << N.NestedLoopHeader->Id << ")";
@@ -67,17 +78,180 @@ bool PathAnalysisPass::doFinalization(Module &M) {
 
   // Build the AbstractStateGraph (abstract interpretation over MASG), then
   // solve the WCET ILP on it.
+  AnalysisWorker.setOrder(WorklistSolver::parseOrder(WorklistOrder));
+  FixpointStats Stats;
+  Stats.Analysis = "pipeline";
+  if (!FixpointStatsFile.empty())
+    AnalysisWorker.setStats(&Stats);
   AnalysisWorker.run(TAR.MASG);
+  AnalysisWorker.setStats(nullptr);
 
+  if (!FixpointStatsFile.empty()) {
+    TAR.addFixpointStats(std::move(Stats));
+    if (Error E = writeFixpointStats(FixpointStatsFile, TAR.getFixpointStats()))
+      errs() << "Warning: could not write the fixpoint statistics: "
+             << toString(std::move(E)) << "\n";
+    else
+      outs() << "Fixpoint statistics written to " << FixpointStatsFile << "\n";
+  }
+
+  if (!SaveGraphFile.empty()) {
+    if (Error E = GraphFile::write(SaveGraphFile, AnalysisWorker.getGraph(),
+                                   TAR.getUnsoundReasons(),
+                                   TAR.MASG.getUnsoundExternalCallees()))
+      errs() << "Warning: could not save the analysis graph: "
+             << toString(std::move(E)) << "\n";
+    else
+      outs() << "Analysis graph saved to " << SaveGraphFile << "\n";
+  }
+
+  solveAndReportWCET(AnalysisWorker.getGraph(), TAR.getUnsoundReasons(),
+                     TAR.MASG.getUnsoundExternalCallees());
+  return false;
+}
+
+/**
+ * @brief Write the IPET model of \p Graph to -ilp-export, in the loop-row
+ * form the HiGHS solver builds it with.
+ */
+static void exportILPModel(const AbstractStateGraph &Graph) {
+  IPETModel Model(Graph, AbstractHighsSolver::getLoopRowForm(
+                             ILPLPFirst ? AbstractHighsSolver::Mode::LPFirst
+                                        : AbstractHighsSolver::Mode::MILP));
+  if (Model.exportModel(ILPExportFile,
+                        IPETModel::getExportFormatForPath(ILPExportFile)))
+    outs() << "ILP model written to " << ILPExportFile << " ("
+           << Model.getNumCols() << " columns, " << Model.getNumRows()
+           << " rows, " << Model.getNumNonzeros() << " nonzeros)\n";
+}
+
+/**
+ * @brief Print the worst-case path of \p Result (-ilp-print-path) and the
+ * next -ilp-top-paths worst distinct paths.
+ *
+ * The next paths come from one HighsIPETSession on \p Graph: each solve cuts
+ * off the paths found so far, so the gap to the WCET is the headroom that
+ * removing the worse paths alone would buy. The session is a model of its
+ * own, warm across the cuts: the WCET may come from a reduced, modular,
+ * region or timing-schema solve, none of which holds a model of \p Graph.
+ */
+static void reportWorstCasePaths(const AbstractStateGraph &Graph,
+                                 const AbstractILPResult &Result) {
+  auto Label = [&](unsigned Id) { return Graph.getNodeLabel(Id); };
+  if (ILPPrintPath) {
+    WorstCasePath Path(Graph, Result);
+    if (Path.getSegments().empty()) {
+      outs() << "\nWorst-case path: not available (no solution counts)\n";
+    } else {
+      outs() << "\nWorst-case path (" << Path.getLength() << " blocks):\n";
+      Path.print(outs(), Label);
+      if (Path.getUncoveredFlow())
+        outs() << "  (" << Path.getUncoveredFlow()
+               << " edge executions are not reachable from the entry)\n";
+    }
+  }
+  if (!ILPTopPaths)
+    return;
+
+#ifdef ENABLE_HIGHS
+  HighsIPETSession Session(Graph, ILPLPFirst
+                                      ? AbstractHighsSolver::Mode::LPFirst
+                                      : AbstractHighsSolver::Mode::MILP);
+  const long long WCET = std::llround(Result.WCET);
+  outs() << "\nNext-worst distinct paths:\n";
+  AbstractILPResult Next;
+  const AbstractILPResult *Cut = &Result;
+  for (unsigned K = 1; K <= ILPTopPaths; ++K) {
+    if (!Session.excludePath(*Cut)) {
+      outs() << "  no further path\n";
+      break;
+    }
+    Next = Session.solve();
+    if (!Next.Status.empty() || Next.ExecutionCounts.empty()) {
+      outs() << "  no further path";
+      if (!Next.Status.empty())
+        outs() << " (solver status: " << Next.Status << ")";
+      outs() << "\n";
+      break;
+    }
+    const long long Cycles = std::llround(Next.WCET);
+    outs() << "  #" << K << ": " << Cycles << " cycles, " << WCET - Cycles
+           << " below the WCET ("
+           << format("%.2f", WCET ? 100.0 * (WCET - Cycles) / WCET : 0.0)
+           << "%)\n";
+    if (ILPPrintPath)
+      WorstCasePath(Graph, Next).print(outs(), Label, 4);
+    Cut = &Next;
+  }
+#else
+  outs() << "-ilp-top-paths needs the HiGHS backend\n";
+#endif
+}
+
+/**
+ * @brief Print the -ilp-sensitivity report for \p Result, the optimum on
+ * \p Graph: cycles per unit of every loop bound, then the blocks with the
+ * largest share of the WCET and the cost range keeping the path the worst.
+ */
+static void reportSensitivity(const AbstractStateGraph &Graph,
+                              const AbstractILPResult &Result) {
+#ifdef ENABLE_HIGHS
+  if (Result.LimitReached) {
+    outs() << "\nSensitivity: not available, the WCET is not a proven "
+              "optimum\n";
+    return;
+  }
+  HighsIPETSession Session(Graph, ILPLPFirst
+                                      ? AbstractHighsSolver::Mode::LPFirst
+                                      : AbstractHighsSolver::Mode::MILP);
+  IPETSensitivity S = Session.analyzeSensitivity(Result);
+  if (!S.Status.empty()) {
+    outs() << "\nSensitivity: not available (solver status: " << S.Status
+           << ")\n";
+    return;
+  }
+  S.print(outs(), Result.WCET, ILPSensitivity,
+          [&](unsigned Id) { return Graph.getNodeLabel(Id); });
+#else
+  outs() << "-ilp-sensitivity needs the HiGHS backend\n";
+#endif
+}
+
+/**
+ * @brief Solve the WCET ILP on \p Graph and print the result.
+ *
+ * Prints the WCET line the regression harness greps for, followed by an
+ * UNSOUND block when \p Reasons or \p Callees are non-empty.
+ *
+ * @return true if a WCET was computed
+ */
+bool solveAndReportWCET(const AbstractStateGraph &Graph,
+                        const std::set<std::string> &Reasons,
+                        const std::set<std::string> &Callees) {
   // Solve the WCET ILP with the HiGHS backend.
   std::unique_ptr<AbstractILPSolver> Solver;
   std::string SolverName;
 
 #ifdef ENABLE_HIGHS
-  Solver = std::make_unique<AbstractHighsSolver>();
+  auto HighsSolver = std::make_unique<AbstractHighsSolver>(
+      ILPLPFirst ? AbstractHighsSolver::Mode::LPFirst
+                 : AbstractHighsSolver::Mode::MILP,
+      ILPPortfolio, ILPThreads);
+  HighsSolver->setTimeLimit(ILPTimeLimit);
+  HighsSolver->setRelativeGap(ILPGap);
+  Solver = std::move(HighsSolver);
   SolverName = "HiGHS";
 #endif
 
+  if (TimingSchema) {
+    // Structured graphs are solved without an ILP; the others (and the
+    // -timing-schema-check cross-check) go to the ILP solver, if there is one.
+    SolverName = Solver ? "timing schema, " + SolverName + " fallback"
+                        : "timing schema";
+    Solver = std::make_unique<TimingSchemaSolver>(std::move(Solver),
+                                                  TimingSchemaCheck);
+  }
+
   if (!Solver) {
     outs() << "Error: No ILP solver available. Cannot compute WCET.\n";
     return false;
@@ -85,7 +259,75 @@ bool PathAnalysisPass::doFinalization(Module &M) {
 
   outs() << "Using ILP solver: " << SolverName << "\n";
   outs() << "\nSolving WCET ILP...\n";
-  auto Result = Solver->solveWCET(AnalysisWorker.getGraph());
+  AbstractILPResult Result;
+  // Every (sub-)ILP the modular and region solves hand out is reduced on its
+  // own.
+  auto SolveReduced = [&](const AbstractStateGraph &Sub) {
+    if (!ILPReduceGraph)
+      return Solver->solveWCET(Sub);
+    IPETReduction Reduction(Sub);
+    return Reduction.expand(Solver->solveWCET(Reduction.getReducedGraph()));
+  };
+  if (ILPModular) {
+    // Summarise every closed callee instance bottom-up (one sub-ILP each, a
+    // call-graph level at a time in parallel). With -ilp-regions each module
+    // has its loops contracted as well, on the module's own thread.
+    if (!ILPExportFile.empty())
+      exportILPModel(ILPReduceGraph ? IPETReduction(Graph).getReducedGraph()
+                                    : Graph);
+    ModularIPET Modular(Graph);
+    outs() << "Modular IPET: " << Modular.getNumModules() << " functions in "
+           << Modular.getNumLevels() << " levels, residual "
+           << Modular.getNumResidualNodes() << " nodes\n";
+    Result = Modular.solve(
+        [&](const AbstractStateGraph &Sub) {
+          if (!ILPRegions)
+            return SolveReduced(Sub);
+          return LoopRegionIPET(Sub).solve(SolveReduced, 1);
+        },
+        ILPThreads);
+  } else if (ILPRegions) {
+    // Contract the loop nests innermost first (one sub-ILP per loop, a
+    // nesting level at a time in parallel), then solve what is left.
+    if (!ILPExportFile.empty())
+      exportILPModel(ILPReduceGraph ? IPETReduction(Graph).getReducedGraph()
+                                    : Graph);
+    LoopRegionIPET Regions(Graph);
+    outs() << "Loop regions: " << Regions.getNumRegions() << " loops in "
+           << Regions.getNumLevels() << " levels, top level "
+           << Regions.getNumTopNodes() << " nodes\n";
+    Result = Regions.solve(SolveReduced, ILPThreads);
+  } else if (ILPReduceGraph) {
+    // Solve on the chain-collapsed graph and map the counts back, so callers
+    // still see per-node results for the full graph.
+    IPETReduction Reduction(Graph);
+    outs() << "IPET graph reduced: " << Reduction.getNumOriginalNodes()
+           << " -> " << Reduction.getNumReducedNodes() << " nodes, "
+           << Reduction.getNumOriginalEdges() << " -> "
+           << Reduction.getNumReducedEdges() << " edges\n";
+    if (!ILPExportFile.empty())
+      exportILPModel(Reduction.getReducedGraph());
+    Result = Reduction.expand(Solver->solveWCET(Reduction.getReducedGraph()));
+  } else {
+    if (!ILPExportFile.empty())
+      exportILPModel(Graph);
+    Result = Solver->solveWCET(Graph);
+  }
+  if (Result.LPRelaxationIntegral)
+    outs() << "LP relaxation integral: solved without branch-and-bound\n";
+  if (Result.SolverConfig == TimingSchemaSolver::ConfigName)
+    outs() << "Timing schema: WCET computed structurally, no ILP solved\n";
+  else if (!Result.SolverConfig.empty())
+    outs() << "ILP portfolio: configuration '" << Result.SolverConfig << "' "
+           << (Result.LimitReached ? "gave the tightest bound" : "solved first")
+           << "\n";
+  if (Result.LimitReached) {
+    // The WCET line below then reports the dual bound: sound, not tight.
+    outs() << "ILP limit reached: WCET is the solver's dual bound; best path "
+              "found: "
+           << std::llround(Result.Incumbent) << " cycles, gap "
+           << format("%.2f", 100.0 * Result.Gap) << "%\n";
+  }
 
   outs() << "\n=== WCET Analysis Results ===\n";
   if (Result.WCET > 0) {
@@ -99,8 +341,6 @@ bool PathAnalysisPass::doFinalization(Module &M) {
     // Surface any reason the bound may be an under-approximation rather than a
     // valid upper bound. The numeric WCET line above is kept verbatim (the
     // regression harness greps for it); this block is purely additive.
-    const auto &Reasons = TAR.getUnsoundReasons();
-    const auto &Callees = TAR.MASG.getUnsoundExternalCallees();
     if (!Reasons.empty() || !Callees.empty()) {
       outs()
           << "\n*** WARNING: this WCET is UNSOUND (under-approximation) ***\n";
@@ -113,6 +353,11 @@ bool PathAnalysisPass::doFinalization(Module &M) {
           outs() << "      " << C << "\n";
       }
     }
+
+    if (ILPPrintPath || ILPTopPaths)
+      reportWorstCasePaths(Graph, Result);
+    if (ILPSensitivity)
+      reportSensitivity(Graph, Result);
   } else {
     // Keep the literal "Failed to compute WCET." prefix (the regression harness
     // keys off the absence of the WCET line); append the solver's model status
@@ -124,7 +369,7 @@ bool PathAnalysisPass::doFinalization(Module &M) {
     return false;
   }
 
-  return false;
+  return true;
 }
 
 /**
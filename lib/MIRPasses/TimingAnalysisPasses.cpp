@@ -19,7 +19,7 @@ namespace llvm {
 // and makes them available to all timing analysis passes.
 static TimingAnalysisResults TAR = TimingAnalysisResults();
 
-std::list<MachineFunctionPass *> getTimingAnalysisPasses(const Triple &TT) {
+std::list<Pass *> getTimingAnalysisPasses(const Triple &TT) {
   // Resolve the timing-analysis target once, up front, and install it so every
   // pass can query it (instead of switching on the arch). The target also
   // contributes its own memory-model passes below.
@@ -29,7 +29,7 @@ std::list<MachineFunctionPass *> getTimingAnalysisPasses(const Triple &TT) {
   TAR.setTarget(std::move(Tgt));
   const llta::RTTarget &Target = TAR.getTarget();
 
-  std::list<MachineFunctionPass *> Passes;
+  std::list<Pass *> Passes;
   Passes.push_back(createCallSplitterPass(TAR));
   if (LLCMode)
     return Passes;
@@ -38,7 +38,7 @@ std::list<MachineFunctionPass *> getTimingAnalysisPasses(const Triple &TT) {
   Passes.push_back(createInstructionLatencyPass(TAR));
   // Target-specific memory model (e.g. MSP430FR FRAM passes). Spliced in right
   // after the base latencies so their penalties accumulate into MBBLatencyMap.
-  for (MachineFunctionPass *P : Target.getMemoryModelPasses(TAR))
+  for (Pass *P : Target.getMemoryModelPasses(TAR))
     Passes.push_back(P);
   Passes.push_back(createMachineLoopBoundAgregatorPass(TAR));
   Passes.push_back(createFillMuGraphPass(TAR));
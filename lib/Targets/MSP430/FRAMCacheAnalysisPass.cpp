@@ -4,29 +4,81 @@
 #include "Analysis/Cache/CacheGeometry.h"
 #include "Analysis/Cache/FRAMAccessMapper.h"
 #include "Analysis/Cache/ReplacementPolicy.h"
+#include "Analysis/FixpointStats.h"
 #include "Analysis/WorklistSolver.h"
+#include "Solver/WorklistSolver.h"
 #include "Targets/MSP430/MSP430Options.h"
 #include "TimingAnalysisResults.h"
 #include "Utility/InstructionWords.h"
 #include "Utility/Options.h"
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <chrono>
 #include <memory>
+#include <numeric>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace llvm {
 
 char FRAMCacheAnalysisPass::ID = 0;
 
 FRAMCacheAnalysisPass::FRAMCacheAnalysisPass(TimingAnalysisResults &TAR)
-    : MachineFunctionPass(ID), TAR(TAR) {}
+    : ModulePass(ID), TAR(TAR) {}
+
+void FRAMCacheAnalysisPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<MachineModuleInfoWrapperPass>();
+  AU.setPreservesAll();
+}
+
+namespace {
+
+/// The cache analyses of one machine function. A job only reads TAR; what it
+/// produces is merged into MBBLatencyMap (and printed) by runOnModule().
+struct FunctionJob {
+  MachineFunction *MF;
+  /// Instructions in MF; the largest jobs are started first.
+  unsigned Size;
+  /// Must-analysis penalty per block with one, in block layout order.
+  std::vector<std::pair<const MachineBasicBlock *, unsigned>> Penalties;
+  /// Verbose output: the summary line and the always-miss reports.
+  std::string Log;
+  /// -fram-cache-bench: seconds the must-analysis fixpoint took on the
+  /// statically dispatched and on the virtual engine, and whether the two
+  /// disagreed on a block's penalty.
+  double StaticSeconds = 0;
+  double VirtualSeconds = 0;
+  bool Mismatch = false;
+  /// -fixpoint-stats: the must- and (verbose) may-analysis runs.
+  std::vector<FixpointStats> Stats;
+};
+
+} // namespace
+
+/// A -fixpoint-stats record for \p Analysis on \p F, its nodes named after
+/// the blocks in layout order (llta::WorklistSolver's node order).
+static FixpointStats makeStats(StringRef Analysis, const MachineFunction &F) {
+  FixpointStats Stats;
+  Stats.Analysis = Analysis.str();
+  Stats.Function = F.getName().str();
+  for (const MachineBasicBlock &MBB : F)
+    Stats.NodeNames.push_back(("bb." + Twine(MBB.getNumber())).str());
+  return Stats;
+}
 
 /// Build the must-analysis replacement policy selected by -fram-cache-policy.
 static std::unique_ptr<ReplacementPolicy> makeMustPolicy(const CacheGeometry &Geo) {
@@ -42,70 +94,73 @@ static std::unique_ptr<ReplacementPolicy> makeMustPolicy(const CacheGeometry &Ge
 /// policy, so the reports are sound even on the undocumented FR5994) and, after
 /// the fixpoint, replay each block from its converged entry state to report the
 /// accesses proven never cached.
-static void reportAlwaysMiss(MachineFunction &F, const TimingAnalysisResults &TAR,
-                             CacheGeometry Geo,
+static void reportAlwaysMiss(MachineFunction &F,
+                             const TimingAnalysisResults &TAR,
+                             CacheGeometry Geo, WorklistSolver::Order Order,
                              const std::unordered_map<const MachineInstr *,
                                                       unsigned> &Words,
                              const std::unordered_map<const MachineInstr *,
-                                                      unsigned> &DataWords) {
+                                                      unsigned> &DataWords,
+                             raw_ostream &OS, FixpointStats *Stats) {
   LRUPolicy MayPolicy(Geo.Ways);
   FRAMAccessMapper Mapper(TAR, Geo, Words, DataWords,
                           /*DataAccessCost=*/FRAMWaitStates);
-  CacheAnalysis May(Geo, FRAMLineFillCycles, MayPolicy, Mapper,
-                    AnalysisKind::May);
+  CacheDomain May(Geo, FRAMLineFillCycles, MayPolicy, Mapper,
+                  AnalysisKind::May);
 
-  AbstractStateGraph ASG;
-  WorklistSolver Solver(May, ASG);
-  Solver.run(F, /*MLI=*/nullptr, /*LoopBounds=*/nullptr); // sink off ⇒ no output
+  llta::WorklistSolver<CacheDomain> Solver(May);
+  Solver.setOrder(Order);
+  Solver.setStats(Stats);
+  Solver.solve(&F); // sink off ⇒ no output
 
-  // Map each node to its MBB for predecessor lookups during replay.
   // Replay from the converged entry state so the classification is final.
   std::set<std::string> Reported; // dedupe "block@line"
   May.setDefiniteMissSink([&](const MachineInstr *MI, uint64_t LineId) {
     std::string Key = std::string(MI->getParent()->getName()) + "@" +
                       Twine::utohexstr(LineId).str();
     if (Reported.insert(Key).second)
-      outs() << "[fram-cache] always-miss: line 0x" << Twine::utohexstr(LineId)
+      OS << "[fram-cache] always-miss: line 0x" << Twine::utohexstr(LineId)
              << " in " << F.getName() << ":" << MI->getParent()->getName()
              << "\n";
   });
 
-  for (const auto &Pair : ASG.getNodes()) {
-    const AbstractStateGraph::Node *N = Pair.second.get();
-    if (!N->MBB)
-      continue;
-    // Entry state = join of predecessors' converged (out) states; cold if none.
-    std::unique_ptr<AbstractState> In;
-    for (unsigned PredId : ASG.getPredecessors(N->Id)) {
-      const auto *Pred = ASG.getNode(PredId);
-      if (!Pred)
-        continue;
-      if (!In)
-        In = Pred->State->clone();
-      else
-        In->join(Pred->State.get());
-    }
-    if (!In)
-      In = May.getInitialState();
-    for (const MachineInstr &MI : *N->MBB)
-      May.process(In.get(), &MI);
+  // Entry state = join of predecessors' converged (out) states; cold if none.
+  for (const MachineBasicBlock &MBB : F) {
+    CacheState In = Solver.getInState(&MBB);
+    May.transfer(In, &MBB);
   }
 }
 
-bool FRAMCacheAnalysisPass::runOnMachineFunction(MachineFunction &F) {
-  // No-op unless the cache model is enabled and configured. This keeps default
-  // runs (and the regression tests) unchanged; FRAMWaitStatePass handles the
-  // no-cache case.
-  if (!FRAMCache || FRAMWaitStates == 0 || !TAR.hasFRAMStart())
-    return false;
+/// -fram-cache-bench: run the must-analysis of \p F again on the virtual
+/// engine (CacheAnalysis through llvm::WorklistSolver), time it, and check it
+/// charges every block what \p Solver did.
+static void benchVirtualEngine(FunctionJob &Job,
+                               const llta::WorklistSolver<CacheDomain> &Solver,
+                               const CacheGeometry &Geo,
+                               const ReplacementPolicy &Policy,
+                               CacheAccessMapper &Mapper,
+                               WorklistSolver::Order Order) {
+  CacheAnalysis Must(Geo, FRAMLineFillCycles, Policy, Mapper,
+                     AnalysisKind::Must);
+  AbstractStateGraph ASG;
+  WorklistSolver Virtual(Must, ASG);
+  Virtual.setOrder(Order);
+  auto Start = std::chrono::steady_clock::now();
+  Virtual.run(*Job.MF, /*MLI=*/nullptr, /*LoopBounds=*/nullptr);
+  Job.VirtualSeconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - Start)
+                           .count();
+  for (const auto &N : ASG.getNodes())
+    if (N.MBB && N.Cost != Solver.getCost(N.MBB))
+      Job.Mismatch = true;
+}
 
-  CacheGeometry Geo(FRAMCacheSets, FRAMCacheWays, FRAMCacheLineBytes);
-  if (!Geo.isValid()) {
-    errs() << "[fram-cache] warning: invalid geometry (sets=" << FRAMCacheSets
-           << ", ways=" << FRAMCacheWays << ", line-bytes=" << FRAMCacheLineBytes
-           << "); sets and line-bytes must be powers of two. Skipping.\n";
-    return false;
-  }
+/// Run the must-analysis (and, under -fram-cache-verbose, the may-analysis)
+/// of \p Job's function. Called concurrently for different jobs.
+static void analyzeFunction(FunctionJob &Job, const TimingAnalysisResults &TAR,
+                            const CacheGeometry &Geo,
+                            WorklistSolver::Order Order, bool Verbose) {
+  MachineFunction &F = *Job.MF;
 
   // Per-instruction fetch and FRAM data-access word counts (shared with
   // FRAMWaitStatePass). DataWords resolves data addresses once per function.
@@ -120,41 +175,148 @@ bool FRAMCacheAnalysisPass::runOnMachineFunction(MachineFunction &F) {
   std::unique_ptr<ReplacementPolicy> Policy = makeMustPolicy(Geo);
   FRAMAccessMapper Mapper(TAR, Geo, Words, DataWords,
                           /*DataAccessCost=*/FRAMWaitStates);
-  CacheAnalysis Must(Geo, FRAMLineFillCycles, *Policy, Mapper,
-                     AnalysisKind::Must);
+  CacheDomain Must(Geo, FRAMLineFillCycles, *Policy, Mapper,
+                   AnalysisKind::Must);
 
-  // Run the cross-block fixpoint through the abstract-interpretation framework.
-  AbstractStateGraph ASG;
-  WorklistSolver Solver(Must, ASG);
-  Solver.run(F, /*MLI=*/nullptr, /*LoopBounds=*/nullptr);
+  // Run the cross-block fixpoint on the statically dispatched engine.
+  llta::WorklistSolver<CacheDomain> Solver(Must);
+  Solver.setOrder(Order);
+  const bool Record = !FixpointStatsFile.empty();
+  FixpointStats MustStats;
+  if (Record) {
+    MustStats = makeStats("fram-cache-must", F);
+    Solver.setStats(&MustStats);
+  }
+  auto Start = std::chrono::steady_clock::now();
+  Solver.solve(&F);
+  Job.StaticSeconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - Start)
+                          .count();
 
-  // Fold the per-block cache penalty into the latency path.
-  auto Map = TAR.getMBBLatencyMap();
+  // The per-block cache penalty, folded into the latency path by the caller.
   unsigned FuncPenalty = 0;
-  for (const auto &Pair : ASG.getNodes()) {
-    const AbstractStateGraph::Node *N = Pair.second.get();
-    if (N->MBB && N->Cost) {
-      Map[N->MBB] += N->Cost;
-      FuncPenalty += N->Cost;
+  for (const MachineBasicBlock &MBB : F)
+    if (unsigned Cost = Solver.getCost(&MBB)) {
+      Job.Penalties.push_back({&MBB, Cost});
+      FuncPenalty += Cost;
     }
-  }
-  TAR.setMBBLatencyMap(Map);
 
-  if (DebugPrints || AddressResolverVerbose || FRAMCacheVerbose)
-    outs() << "[fram-cache] " << F.getName() << ": +" << FuncPenalty
-           << " cycle(s) (policy=" << Policy->name() << ", " << Geo.NumSets
-           << " set(s) x " << Geo.Ways << " way(s), " << Geo.LineBytes
-           << "B lines, " << FRAMLineFillCycles << " cycle(s)/miss line-fill, "
-           << FRAMWaitStates << " wait state(s)/data access)\n";
+  if (Record)
+    Job.Stats.push_back(std::move(MustStats));
+
+  if (FRAMCacheBench)
+    benchVirtualEngine(Job, Solver, Geo, *Policy, Mapper, Order);
+
+  raw_string_ostream OS(Job.Log);
+  if (Verbose)
+    OS << "[fram-cache] " << F.getName() << ": +" << FuncPenalty
+       << " cycle(s) (policy=" << Policy->name() << ", " << Geo.NumSets
+       << " set(s) x " << Geo.Ways << " way(s), " << Geo.LineBytes
+       << "B lines, " << FRAMLineFillCycles << " cycle(s)/miss line-fill, "
+       << FRAMWaitStates << " wait state(s)/data access, "
+       << Solver.getNumVisits() << " fixpoint visit(s) over "
+       << F.size() << " block(s))\n";
 
   // --- May-analysis: always-miss diagnostics (no WCET impact). ---
-  if (FRAMCacheVerbose)
-    reportAlwaysMiss(F, TAR, Geo, Words, DataWords);
+  if (FRAMCacheVerbose) {
+    FixpointStats MayStats;
+    if (Record)
+      MayStats = makeStats("fram-cache-may", F);
+    reportAlwaysMiss(F, TAR, Geo, Order, Words, DataWords, OS,
+                     Record ? &MayStats : nullptr);
+    if (Record)
+      Job.Stats.push_back(std::move(MayStats));
+  }
+}
+
+bool FRAMCacheAnalysisPass::runOnModule(Module &M) {
+  // No-op unless the cache model is enabled and configured. This keeps default
+  // runs (and the regression tests) unchanged; FRAMWaitStatePass handles the
+  // no-cache case.
+  if (!FRAMCache || FRAMWaitStates == 0 || !TAR.hasFRAMStart())
+    return false;
+
+  CacheGeometry Geo(FRAMCacheSets, FRAMCacheWays, FRAMCacheLineBytes);
+  if (!Geo.isValid()) {
+    errs() << "[fram-cache] warning: invalid geometry (sets=" << FRAMCacheSets
+           << ", ways=" << FRAMCacheWays << ", line-bytes=" << FRAMCacheLineBytes
+           << "); sets and line-bytes must be powers of two. Skipping.\n";
+    return false;
+  }
 
+  // One job per function that has a machine function (those with a body).
+  MachineModuleInfo &MMI =
+      getAnalysis<MachineModuleInfoWrapperPass>().getMMI();
+  std::vector<MachineFunction *> MFs;
+  for (const Function &Fn : M)
+    if (MachineFunction *MF = MMI.getMachineFunction(Fn))
+      MFs.push_back(MF);
+  analyzeFunctions(MFs, TAR, Geo, FRAMCacheThreads,
+                   DebugPrints || AddressResolverVerbose || FRAMCacheVerbose,
+                   outs());
   return false;
 }
 
-MachineFunctionPass *createFRAMCacheAnalysisPass(TimingAnalysisResults &TAR) {
+void FRAMCacheAnalysisPass::analyzeFunctions(ArrayRef<MachineFunction *> MFs,
+                                             TimingAnalysisResults &TAR,
+                                             const CacheGeometry &Geo,
+                                             unsigned Threads, bool Verbose,
+                                             raw_ostream &OS) {
+  std::vector<FunctionJob> Jobs;
+  for (MachineFunction *MF : MFs)
+    Jobs.push_back({MF, MF->getInstructionCount(), {}, {}});
+  if (Jobs.empty())
+    return;
+
+  // Largest functions first, so a long fixpoint does not start last. Jobs
+  // write only their own slot, and nothing a job computes depends on the
+  // schedule.
+  std::vector<unsigned> Schedule(Jobs.size());
+  std::iota(Schedule.begin(), Schedule.end(), 0);
+  llvm::stable_sort(Schedule, [&](unsigned A, unsigned B) {
+    return Jobs[A].Size > Jobs[B].Size;
+  });
+  const WorklistSolver::Order Order = WorklistSolver::parseOrder(WorklistOrder);
+  {
+    DefaultThreadPool Pool(hardware_concurrency(Threads));
+    for (unsigned Idx : Schedule)
+      Pool.async([&, Idx] {
+        analyzeFunction(Jobs[Idx], TAR, Geo, Order, Verbose);
+      });
+    Pool.wait();
+  }
+
+  // Merge in the given order: the map is updated once, and the output reads
+  // as it did when the functions were analysed one after another.
+  auto Map = TAR.getMBBLatencyMap();
+  for (const FunctionJob &Job : Jobs) {
+    for (const auto &[MBB, Penalty] : Job.Penalties)
+      Map[MBB] += Penalty;
+    OS << Job.Log;
+    for (const FixpointStats &Stats : Job.Stats)
+      TAR.addFixpointStats(Stats);
+  }
+  TAR.setMBBLatencyMap(Map);
+
+  if (FRAMCacheBench) {
+    double Static = 0, Virtual = 0;
+    unsigned Mismatches = 0;
+    for (const FunctionJob &Job : Jobs) {
+      Static += Job.StaticSeconds;
+      Virtual += Job.VirtualSeconds;
+      Mismatches += Job.Mismatch;
+    }
+    errs() << "[fram-cache] bench: must-analysis fixpoints of " << Jobs.size()
+           << " function(s): " << format("%.6f", Static)
+           << " s statically dispatched, " << format("%.6f", Virtual)
+           << " s virtual\n";
+    if (Mismatches)
+      errs() << "[fram-cache] warning: the engines disagree on " << Mismatches
+             << " function(s)\n";
+  }
+}
+
+ModulePass *createFRAMCacheAnalysisPass(TimingAnalysisResults &TAR) {
   return new FRAMCacheAnalysisPass(TAR);
 }
 
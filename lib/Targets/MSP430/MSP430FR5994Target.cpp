@@ -7,7 +7,7 @@ namespace llta {
 
 llvm::StringRef MSP430FR5994Target::getName() const { return "MSP430FR5994"; }
 
-std::vector<llvm::MachineFunctionPass *>
+std::vector<llvm::Pass *>
 MSP430FR5994Target::getMemoryModelPasses(llvm::TimingAnalysisResults &TAR) const {
   // Order matters: the wait-state pass runs first; the cache analysis, when
   // enabled, supersedes it (the wait-state pass then skips itself).
@@ -54,6 +54,21 @@ cl::opt<bool> FRAMCacheVerbose(
              "change the WCET. Requires -fram-cache."),
     cl::cat(MSP430Cat));
 
+cl::opt<unsigned> FRAMCacheThreads(
+    "fram-cache-threads", cl::init(0),
+    cl::desc("Threads analysing functions for -fram-cache in parallel. "
+             "Default: 0 (all hardware threads). The WCET is the same for "
+             "every value."),
+    cl::cat(MSP430Cat));
+
+cl::opt<bool> FRAMCacheBench(
+    "fram-cache-bench", cl::init(false),
+    cl::desc("Also run the FRAM cache must-analysis on the virtual "
+             "WorklistSolver, check it agrees with the statically dispatched "
+             "engine and print both fixpoint times to stderr. Does not change "
+             "the WCET. Requires -fram-cache."),
+    cl::cat(MSP430Cat));
+
 cl::opt<unsigned> FRAMCacheSets("fram-cache-sets", cl::init(2),
                                 cl::desc("FRAM cache number of sets (FR5994: 2)."),
                                 cl::cat(MSP430Cat));
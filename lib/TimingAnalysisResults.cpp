@@ -31,8 +31,8 @@ void TimingAnalysisResults::setMBBLatencyMap(
   this->MBBLatencyMap = MBBLatencyMap;
 }
 
-std::unordered_map<const MachineBasicBlock *, unsigned int>
-TimingAnalysisResults::getMBBLatencyMap() {
+const std::unordered_map<const MachineBasicBlock *, unsigned int> &
+TimingAnalysisResults::getMBBLatencyMap() const {
   assert(MBBLatencyMapSet && "MBBLatencyMap is not set, and should be set by "
                              "the InstructionLatencyPass");
   return MBBLatencyMap;
@@ -46,8 +46,8 @@ void TimingAnalysisResults::setLoopBoundMap(
   this->LoopBoundMap = LoopBoundMap;
 }
 
-std::unordered_map<const MachineBasicBlock *, unsigned int>
-TimingAnalysisResults::getLoopBoundMap() {
+const std::unordered_map<const MachineBasicBlock *, unsigned int> &
+TimingAnalysisResults::getLoopBoundMap() const {
   // We do not assert here, because it is possible that no loops are found
   return LoopBoundMap;
 }
@@ -162,4 +162,15 @@ bool TimingAnalysisResults::isUnsound() const {
 }
 // END: Unsoundness tracking
 
+// START: Fixpoint statistics
+void TimingAnalysisResults::addFixpointStats(FixpointStats Stats) {
+  FixpointRuns.push_back(std::move(Stats));
+}
+
+const std::vector<FixpointStats> &
+TimingAnalysisResults::getFixpointStats() const {
+  return FixpointRuns;
+}
+// END: Fixpoint statistics
+
 } // namespace llvm
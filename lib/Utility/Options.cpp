@@ -42,5 +42,165 @@ cl::opt<bool> AddressResolverVerbose(
              "function, instruction, expected vs. actual bytes and assembly."),
     cl::cat(LLTA));
 
+cl::opt<bool> ILPReduceGraph(
+    "ilp-reduce", cl::init(true),
+    cl::desc("Collapse straight-line chains and drop zero-cost pass-through "
+             "nodes before building the WCET ILP. The optimum is unchanged; "
+             "execution counts are mapped back to the original nodes."),
+    cl::cat(LLTA));
+
+cl::opt<bool> ILPLPFirst(
+    "ilp-lp-first", cl::init(true),
+    cl::desc("Solve the WCET ILP's LP relaxation first (loop bounds in "
+             "entry-edge form) and skip branch-and-bound when its optimum is "
+             "integral. Pass -ilp-lp-first=false to always solve the MILP."),
+    cl::cat(LLTA));
+
+cl::opt<unsigned> ILPPortfolio(
+    "ilp-portfolio", cl::init(1),
+    cl::desc("Run N differently configured HiGHS instances (presolve, simplex "
+             "strategy, heuristics, random seed; at most 6) on every WCET ILP "
+             "in parallel, keep the first proven optimum, interrupt the rest "
+             "and report the winning configuration. Default: 1 (off)."),
+    cl::cat(LLTA));
+
+cl::opt<unsigned> ILPThreads(
+    "ilp-threads", cl::init(0),
+    cl::desc("Threads per HiGHS instance, also the size of the -ilp-modular "
+             "thread pool. Default: 0 (HiGHS's default; all hardware threads "
+             "for -ilp-modular)."),
+    cl::cat(LLTA));
+
+cl::opt<double> ILPTimeLimit(
+    "ilp-time-limit", cl::init(0.0),
+    cl::desc("Stop each WCET ILP solve after this many seconds. If the "
+             "optimum is not proven by then, the solver's dual bound is "
+             "reported as a sound but looser WCET, with the best path found "
+             "and the gap. Default: 0 (no limit)."),
+    cl::cat(LLTA));
+
+cl::opt<double> ILPGap(
+    "ilp-gap", cl::init(0.0),
+    cl::desc("Stop branch-and-bound once the relative gap between the best "
+             "path and the dual bound is below this value (e.g. 0.01), and "
+             "report the dual bound as the WCET. Default: 0 (branch-and-bound "
+             "runs until the optimum is proven)."),
+    cl::cat(LLTA));
+
+cl::opt<bool> ILPPrintPath(
+    "ilp-print-path", cl::init(false),
+    cl::desc("Print the worst-case path behind the WCET: the blocks in "
+             "execution order with their cost, loop iterations folded into "
+             "counted segments."),
+    cl::cat(LLTA));
+
+cl::opt<unsigned> ILPTopPaths(
+    "ilp-top-paths", cl::init(0),
+    cl::desc("Also list the K next-worst paths, each differing from all "
+             "worse ones in at least one edge, with their cycles and the "
+             "headroom to the WCET (printed in full with -ilp-print-path). "
+             "Solves K more ILPs. Default: 0 (off)."),
+    cl::cat(LLTA));
+
+cl::opt<unsigned> ILPSensitivity(
+    "ilp-sensitivity", cl::init(0),
+    cl::desc("After the WCET solve, report for every bounded loop the WCET "
+             "cycles per unit of its bound, and for the N blocks with the "
+             "largest share of the WCET the cost range over which the "
+             "worst-case path stays the worst (from the LP relaxation's duals "
+             "and ranging). Default: 0 (off)."),
+    cl::cat(LLTA));
+
+cl::opt<bool> ILPModular(
+    "ilp-modular", cl::init(false),
+    cl::desc("Solve the WCET ILP bottom-up: every callee that is entered and "
+             "left only through its call sites is solved once as its own "
+             "sub-ILP (independent callees in parallel) and charged as a "
+             "fixed cost to its call nodes. Recursive callees and their "
+             "callers stay in one monolithic ILP. The WCET is unchanged."),
+    cl::cat(LLTA));
+
+cl::opt<bool> ILPRegions(
+    "ilp-regions", cl::init(false),
+    cl::desc("Before the global ILP, solve every call-free loop that is "
+             "entered at its header and left towards one block as its own "
+             "sub-ILP, innermost first (loops of one nesting level in "
+             "parallel), and replace it by one node costing its WCET per "
+             "entry. The WCET is unchanged."),
+    cl::cat(LLTA));
+
+cl::opt<bool> TimingSchema(
+    "timing-schema", cl::init(false),
+    cl::desc("Compute the WCET structurally over the loop-nesting forest "
+             "instead of solving an ILP when the graph qualifies (one entry, "
+             "reducible bounded loops, no recursion); other graphs still go "
+             "to the ILP solver."),
+    cl::cat(LLTA));
+
+cl::opt<bool> TimingSchemaCheck(
+    "timing-schema-check", cl::init(false),
+    cl::desc("With -timing-schema, also solve the ILP for every structurally "
+             "solved graph and warn (and use the ILP's WCET) if they differ."),
+    cl::cat(LLTA));
+
+cl::opt<std::string> ILPExportFile(
+    "ilp-export", cl::init(""),
+    cl::desc("Write the WCET ILP, exactly as the solver builds it (after "
+             "-ilp-reduce, loop rows per -ilp-lp-first), to <file.mps|.lp>. "
+             "With -ilp-modular the monolithic model is written. Replay it "
+             "with llta-ilp-bench."),
+    cl::cat(LLTA));
+
+cl::opt<unsigned> ContextDepth(
+    "context-depth", cl::init(0),
+    cl::desc("Analyze each callee separately per call string of up to N call "
+             "sites (0 = one context-insensitive instance per function). "
+             "Recursive functions always keep a single instance."),
+    cl::cat(LLTA));
+
+cl::opt<std::string> SaveGraphFile(
+    "save-graph", cl::init(""),
+    cl::desc("Write the solve-ready analysis graph (costs, loop bounds, call "
+             "sites, unsoundness reasons) to this file in LLTA's binary graph "
+             "format, for re-solving later with -load-graph."),
+    cl::cat(LLTA));
+
+cl::opt<std::string> LoadGraphFile(
+    "load-graph", cl::init(""),
+    cl::desc("Skip code generation and analysis: load a graph written by "
+             "-save-graph and solve its WCET ILP directly."),
+    cl::cat(LLTA));
+
+cl::opt<std::string> DumpGraphFile(
+    "dump-graph", cl::init(""),
+    cl::desc("Export the finalized ProgramGraph to this file for inspection. "
+             "A '.zst' suffix compresses the output. Nothing is written "
+             "without this option."),
+    cl::cat(LLTA));
+
+cl::opt<std::string> DumpGraphFormat(
+    "dump-graph-format", cl::init(""),
+    cl::desc("Format for -dump-graph: 'dot', 'graphml' or 'jsonl' (one JSON "
+             "object per node/edge). Default: from the file extension, else "
+             "dot."),
+    cl::cat(LLTA));
+
+cl::opt<std::string> WorklistOrder(
+    "worklist-order", cl::init("fifo"),
+    cl::desc("Scheduling of the abstract-interpretation fixpoints: 'fifo' "
+             "(default) or 'wto', which visits nodes in weak topological "
+             "order so that every loop stabilises, innermost first, before "
+             "its exits are processed. The visit count is reported with "
+             "-fram-cache-verbose and on stderr."),
+    cl::cat(LLTA));
+
+cl::opt<std::string> FixpointStatsFile(
+    "fixpoint-stats", cl::init(""),
+    cl::desc("Write the statistics of every abstract-interpretation fixpoint "
+             "(node visits, joins, transfers, state clones, peak and average "
+             "state size, time, most revisited nodes) to this JSON file. The "
+             "totals are also LLVM -stats counters (llta-fixpoint)."),
+    cl::cat(LLTA));
+
 // MSP430(FR)-specific options (-fram-*) are owned by the MSP430 target:
 // lib/Targets/MSP430/MSP430Options.cpp.
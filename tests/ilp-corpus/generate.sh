@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+#
+# generate.sh — (re)build the WCET ILP corpus replayed by llta-ilp-bench.
+#
+# Analyzes every Maelardalen benchmark (../srcMaelardalen) and every CFG shape
+# (../cfg, as cfg-<name>) through the MSP430 pipeline with
+# `llta -ilp-export=<name>.mps`, keeps the models of the runs that produce a
+# WCET, and records those WCETs in corpus.json. `llta-ilp-bench
+# -expected=corpus.json *.mps` then fails if an objective differs from the
+# manifest; its timing columns show solve-time regressions.
+#
+# Usage:
+#   tests/ilp-corpus/generate.sh            # needs ./config.sh build and
+#                                           # make -C tests/msp430 download
+#
+# Env: BENCH_TIMEOUT (seconds, default 180) bounds each make invocation;
+#      LLTAFLAGS adds llta options (e.g. -ilp-lp-first=false).
+
+set -u
+cd "$(dirname "$0")" || exit 1
+CORPUS_DIR=$(pwd)
+MSP430_DIR=../msp430
+TIMEOUT="${BENCH_TIMEOUT:-180}"
+
+rm -f "$CORPUS_DIR"/*.mps "$CORPUS_DIR"/*.lp
+MANIFEST=$(mktemp)
+trap 'rm -f "$MANIFEST"' EXIT
+
+# analyze <module dir relative to tests/msp430> <benchmark> <model name>
+analyze() {
+    local modules=$1 name=$2 model=$3
+    local wcet_file="$MSP430_DIR/build_$name/$name.wcet"
+    # The .wcet target is up to date after a plain `make analyze`; force the
+    # analysis so the model is written.
+    rm -f "$wcet_file"
+    timeout "$TIMEOUT" make -C "$MSP430_DIR" TEST="$name" MODULES="$modules" \
+        LLTAFLAGS="${LLTAFLAGS:-} -ilp-export=$CORPUS_DIR/$model.mps" \
+        analyze >/dev/null 2>&1
+    local wcet
+    wcet=$(grep -oE 'WCET \(worst-case execution time\): [0-9]+' \
+        "$wcet_file" 2>/dev/null | grep -oE '[0-9]+$' | tail -1)
+    if [ -n "$wcet" ] && [ -f "$CORPUS_DIR/$model.mps" ]; then
+        printf '%s %s\n' "$model.mps" "$wcet" >>"$MANIFEST"
+        printf '%-24s %s\n' "$model" "$wcet"
+    else
+        rm -f "$CORPUS_DIR/$model.mps"
+        printf '%-24s %s\n' "$model" "-"
+    fi
+}
+
+for f in ../srcMaelardalen/*.c; do
+    b=$(basename "$f" .c)
+    analyze ../srcMaelardalen "$b" "$b"
+done
+for f in ../cfg/*.c; do
+    b=$(basename "$f" .c)
+    analyze ../cfg "$b" "cfg-$b"
+done
+
+python3 - "$MANIFEST" >corpus.json <<'PY'
+import json, sys
+models = {}
+with open(sys.argv[1]) as handle:
+    for line in handle:
+        name, wcet = line.split()
+        models[name] = int(wcet)
+print(json.dumps({
+    "_comment": "Generated by tests/ilp-corpus/generate.sh: the WCET each "
+                "exported model must reproduce (see README.md).",
+    "models": dict(sorted(models.items())),
+}, indent=2))
+PY
@@ -5,12 +5,16 @@
 //   - CacheGeometry address decomposition,
 //   - the replacement-policy modules (UnknownPolicy / LRUPolicy / FIFOPolicy),
 //     in both must- and may-analysis directions,
-//   - the generic CacheState (multi-set, barrier, join).
+//   - the generic CacheState (multi-set, barrier, join),
+//   - the CacheSetPool behind it (copy-on-write sharing, interning of joined
+//     sets, recycling through the free list).
 //
 // The FRAMAccessMapper needs a live MachineInstr (covered by the
 // MachineFunctionGraphTests framDataAccessWords test and the end-to-end run),
 // but the CacheAnalysis cost engine is exercised here with a stub mapper that
 // emits chosen events, so the miss/data-access charging is locked in directly.
+// CacheDomain (the value-state form for llta::WorklistSolver) is checked
+// against the CacheAnalysis adapter around it.
 //
 // Run via CTest (`ctest -R LLTACacheModuleTests`) or the `check-llta-cache`
 // build target. Exits non-zero if any check fails.
@@ -91,6 +95,8 @@ static void testUnknownPolicy() {
   CHECK(touch(P, *S, 100));  // re-access -> guaranteed hit
   CHECK(!touch(P, *S, 200)); // distinct line -> miss
   CHECK(!touch(P, *S, 100)); // 100 no longer guaranteed (single-line set)
+  CHECK_EQ(P.size(*S), 1u);
+  CHECK_EQ(P.size(*P.makeEmpty()), 0u);
 
   // Must-join is intersection of the single guaranteed lines.
   auto A = P.makeEmpty();
@@ -177,6 +183,96 @@ public:
 };
 } // namespace
 
+// States of one analysis share their per-set states: a clone copies no set,
+// an access copies only the set it changes (and none if it changes nothing),
+// joins that produce equal sets produce the same object, and freed sets are
+// reused.
+static void testCacheSetSharing() {
+  CacheGeometry G(/*sets=*/2, /*ways=*/2, /*line=*/8);
+  LRUPolicy P(/*ways=*/2);
+  StubMapper M;
+  CacheAnalysis A(G, /*MissPenalty=*/15, P, M, AnalysisKind::Must);
+  const CacheSetPool &Pool = A.getPool();
+  auto copies = [&] { return Pool.getNumAllocated() + Pool.getNumRecycled(); };
+  auto state = [](const std::unique_ptr<AbstractState> &S) {
+    return static_cast<CacheState *>(S.get());
+  };
+
+  // Cold states share the one empty set.
+  auto S = A.getInitialState();
+  auto T = A.getInitialState();
+  unsigned Base = copies();
+  CHECK(state(S)->getSet(0) == state(S)->getSet(1));
+  CHECK(state(S)->getSet(0) == state(T)->getSet(0));
+
+  // 0x4000 and 0x4010 map to set 0; set 1 stays shared.
+  state(S)->access(0x4000);
+  state(S)->access(0x4010); // set 0 is now exclusive: updated in place
+  CHECK_EQ(copies(), Base + 1);
+  CHECK(state(S)->getSet(1) == state(T)->getSet(1));
+
+  auto C = S->clone();
+  CHECK_EQ(copies(), Base + 1);
+  CHECK(state(C)->getSet(0) == state(S)->getSet(0));
+  state(C)->access(0x4010); // LRU hit on the MRU line: nothing changes
+  CHECK(state(C)->getSet(0) == state(S)->getSet(0));
+  state(C)->access(0x4000); // reorders: the clone gets its own copy
+  CHECK(state(C)->getSet(0) != state(S)->getSet(0));
+  CHECK(!S->equals(C.get()));
+
+  // S = {0x4010@0, 0x4000@1} and C = {0x4000@0, 0x4010@1} meet at ages 1.
+  auto J1 = S->clone();
+  auto J2 = C->clone();
+  CHECK(J1->join(C.get()));
+  CHECK(J2->join(S.get()));
+  CHECK(state(J1)->getSet(0) == state(J2)->getSet(0));
+  CHECK(Pool.getNumInternHits() >= 1);
+  CHECK(J1->equals(J2.get()));
+  CHECK(!J1->join(J2.get()));
+
+  // Freed sets are reused instead of allocated.
+  unsigned Allocated = Pool.getNumAllocated();
+  C.reset();
+  J1.reset();
+  J2.reset();
+  auto D = S->clone();
+  state(D)->access(0x4020);
+  CHECK_EQ(Pool.getNumAllocated(), Allocated);
+  CHECK(Pool.getNumRecycled() >= 1);
+}
+
+// The value domain and the AbstractAnalysable adapter compute the same costs
+// and states; value copies share sets like clones do.
+static void testCacheDomain() {
+  CacheGeometry G(/*sets=*/2, /*ways=*/2, /*line=*/8);
+  LRUPolicy P(/*ways=*/2);
+  StubMapper M;
+  M.Events = {CacheEvent::access(0x4000), CacheEvent::access(0x4010)};
+  CacheDomain D(G, /*MissPenalty=*/15, P, M, AnalysisKind::Must);
+  CacheAnalysis A(G, /*MissPenalty=*/15, P, M, AnalysisKind::Must);
+
+  const MachineInstr *NoMI = nullptr; // transfer() is overloaded on blocks
+  CacheState S = D.getInitialState();
+  auto T = A.getInitialState();
+  CHECK_EQ(D.transfer(S, NoMI), 30u);
+  CHECK_EQ(A.process(T.get(), nullptr), 30u);
+  CHECK_EQ(D.transfer(S, NoMI), 0u);
+  CHECK_EQ(A.process(T.get(), nullptr), 0u);
+  CHECK(S.toString() == T->toString());
+  CHECK_EQ(S.getSize(), 2u); // both lines in set 0
+  CHECK_EQ(D.size(S), T->getSize());
+
+  CacheState Copy = S;
+  CHECK(Copy.getSet(0) == S.getSet(0));
+  CHECK(D.equals(Copy, S));
+  CacheState Cold = D.getInitialState();
+  CHECK(!D.equals(Cold, S));
+  CHECK(D.join(Copy, Cold)); // must join with a cold set: nothing guaranteed
+  CHECK(D.equals(Copy, Cold));
+  CHECK_EQ(Copy.getSize(), 0u);
+  CHECK(!D.join(Copy, S));
+}
+
 // (a) A fetch miss costs the full line-fill penalty (MissPenalty), once per
 // line; a subsequent access to the now-resident line is a free hit.
 static void testMissCostsLineFill() {
@@ -228,6 +324,8 @@ int main() {
   testMissCostsLineFill();
   testDataAccessCharged();
   testModelOffShapeIsZero();
+  testCacheSetSharing();
+  testCacheDomain();
 
   if (Failures == 0) {
     std::cout << "All " << Checks << " checks passed.\n";
@@ -0,0 +1,334 @@
+//===- GraphFileTests.cpp - unit tests for the binary graph archive -------===//
+//
+// A dependency-light standalone test binary (no GoogleTest) for
+// lib/Analysis/GraphFile.cpp: a hand-built AbstractStateGraph is written to an
+// in-memory buffer, loaded back, and compared field by field; truncated and
+// foreign buffers must be rejected instead of read out of bounds. A graph
+// attached to a frozen ProgramGraph must read the same edges and write the
+// same bytes as its hand-built equivalent; its block and function names and
+// function maps come back as a ProgramGraph the loaded graph views.
+//
+// Run via CTest (`ctest -R LLTAGraphFileTests`) or `check-llta-ilp`.
+//===----------------------------------------------------------------------===//
+
+#include "Analysis/GraphFile.h"
+#include "Graph/ProgramGraph.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace llvm;
+
+static int Checks = 0;
+static int Failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    ++Checks;                                                                  \
+    if (!(cond)) {                                                             \
+      ++Failures;                                                              \
+      std::cerr << "FAIL [" << __FILE__ << ":" << __LINE__ << "]: " << #cond   \
+                << "\n";                                                       \
+    }                                                                          \
+  } while (0)
+
+static unsigned addNode(AbstractStateGraph &G, unsigned Cost,
+                        bool IsEntry = false, bool IsExit = false) {
+  unsigned Id = G.addNode(nullptr);
+  auto *N = G.getNode(Id);
+  N->Cost = Cost;
+  N->IsEntry = IsEntry;
+  N->IsExit = IsExit;
+  return Id;
+}
+
+static bool hasEdge(const AbstractStateGraph &G, unsigned From, unsigned To,
+                    bool IsBackEdge) {
+  for (const auto &E : G.getSuccessors(From))
+    if (E.To == To)
+      return E.IsBackEdge == IsBackEdge;
+  return false;
+}
+
+static std::string serialize(const AbstractStateGraph &G,
+                             const std::set<std::string> &Reasons,
+                             const std::set<std::string> &Callees) {
+  std::string Bytes;
+  raw_string_ostream OS(Bytes);
+  GraphFile::write(OS, G, Reasons, Callees);
+  OS.flush();
+  return Bytes;
+}
+
+static Expected<GraphFile> loadBytes(StringRef Bytes) {
+  return GraphFile::load(
+      MemoryBuffer::getMemBuffer(Bytes, "graph", /*RequiresNullTerminator=*/
+                                 false));
+}
+
+// Entry -> loop header <-> body, a call into a callee with one return, and
+// the exit; every solver-relevant field must survive the round trip.
+static void testRoundTrip() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, /*IsEntry=*/true);
+  unsigned H = addNode(G, 2);
+  unsigned B = addNode(G, 7);
+  unsigned C = addNode(G, 1);
+  unsigned FE = addNode(G, 30);
+  unsigned FR = addNode(G, 4);
+  unsigned L = addNode(G, 3);
+  unsigned X = addNode(G, 0, /*IsEntry=*/false, /*IsExit=*/true);
+  G.getNode(H)->IsLoopHeader = true;
+  G.getNode(H)->UpperLoopBound = 10;
+  G.addEdge(E, H);
+  G.addEdge(H, B);
+  G.addEdge(B, H, /*IsBackEdge=*/true);
+  G.addEdge(H, C);
+  G.addEdge(C, FE);
+  G.addEdge(FE, FR);
+  G.addEdge(FR, L);
+  G.addEdge(L, X);
+  // A call site that names its callee instance explicitly (context
+  // expansion); a null Callee needs no Function for the name.
+  G.CallSites.push_back({C, L, nullptr, FE, {FR}});
+
+  std::string Bytes =
+      serialize(G, {"no linked ELF"}, {"memcpy", "sqrt"});
+  Expected<GraphFile> File = loadBytes(Bytes);
+  CHECK(!!File);
+  if (!File) {
+    consumeError(File.takeError());
+    return;
+  }
+  CHECK(File->getHeader().Version == GraphFile::Version);
+  CHECK(File->nodes().size() == 8);
+  CHECK(File->edges().size() == 8);
+  CHECK(File->successors(H).size() == 2);
+  CHECK(File->getUnsoundCallees() ==
+        (std::set<std::string>{"memcpy", "sqrt"}));
+  CHECK(File->getUnsoundReasons() ==
+        (std::set<std::string>{"no linked ELF"}));
+
+  LLVMContext Ctx;
+  Module M("loaded", Ctx);
+  ProgramGraph PG;
+  AbstractStateGraph Loaded;
+  File->buildAbstractStateGraph(Loaded, PG, M);
+  CHECK(Loaded.getBase() == &PG && PG.getNumDenseNodes() == 8);
+  CHECK(Loaded.getNodes().size() == G.getNodes().size());
+  for (const auto &N : G.getNodes()) {
+    auto *LN = Loaded.getNode(N.Id);
+    CHECK(LN != nullptr);
+    if (!LN)
+      continue;
+    CHECK(LN->Cost == N.Cost);
+    CHECK(LN->IsEntry == N.IsEntry && LN->IsExit == N.IsExit);
+    CHECK(LN->IsLoopHeader == N.IsLoopHeader);
+    CHECK(LN->UpperLoopBound == N.UpperLoopBound);
+    CHECK(Loaded.getSuccessors(N.Id).size() == G.getSuccessors(N.Id).size());
+  }
+  CHECK(hasEdge(Loaded, B, H, /*IsBackEdge=*/true));
+  CHECK(hasEdge(Loaded, H, B, /*IsBackEdge=*/false));
+  CHECK(Loaded.CallSites.size() == 1);
+  if (!Loaded.CallSites.empty()) {
+    const auto &CS = Loaded.CallSites.front();
+    CHECK(CS.CallNodeId == C && CS.ReturnNodeId == L);
+    CHECK(Loaded.getCalleeEntry(CS) == FE);
+    CHECK(Loaded.getCalleeReturns(CS).size() == 1 &&
+          Loaded.getCalleeReturns(CS).front() == FR);
+  }
+
+  // Writing is deterministic.
+  CHECK(serialize(G, {"no linked ELF"}, {"memcpy", "sqrt"}) == Bytes);
+}
+
+// Foreign, truncated and version-mismatched buffers are errors.
+static void testRejectsMalformed() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned X = addNode(G, 5, false, true);
+  G.addEdge(E, X);
+  std::string Bytes = serialize(G, {}, {});
+
+  Expected<GraphFile> Good = loadBytes(Bytes);
+  CHECK(!!Good);
+  if (!Good)
+    consumeError(Good.takeError());
+
+  auto rejects = [](StringRef Broken) {
+    Expected<GraphFile> File = loadBytes(Broken);
+    if (File)
+      return false;
+    consumeError(File.takeError());
+    return true;
+  };
+  CHECK(rejects("not a graph"));
+  CHECK(rejects(StringRef(Bytes).drop_back(9)));
+  std::string WrongVersion = Bytes;
+  WrongVersion[8] = 99;
+  CHECK(rejects(WrongVersion));
+  std::string BadEdge = Bytes;
+  // First edge record follows the header (48 bytes) and two 28-byte node
+  // records (at 104); point its target past the last node.
+  BadEdge[104] = 42;
+  CHECK(rejects(BadEdge));
+  std::string BadName = Bytes;
+  // The first node's name index (at 48 + 20).
+  BadName[68] = 42;
+  CHECK(rejects(BadName));
+}
+
+// attachTo() views the ProgramGraph's CSR arrays: dense node I is node I,
+// successors carry the back-edge flags, predecessors come back sorted.
+static void testProgramGraphView() {
+  ProgramGraph PG;
+  auto addPGNode = [&](unsigned Cycles) {
+    return PG.addNode(std::make_unique<MuArchState>(Cycles, Cycles), nullptr);
+  };
+  unsigned A = addPGNode(0);
+  unsigned Gap = addPGNode(0);
+  unsigned Hdr = addPGNode(2);
+  unsigned Latch = addPGNode(3);
+  unsigned X = addPGNode(0);
+  PG.removeNode(Gap);
+  PG.addEdge(A, Hdr);
+  PG.addEdge(Hdr, Latch);
+  PG.addEdge(Latch, Hdr);
+  PG.addEdge(Hdr, X);
+  PG.Nodes.at(Hdr).BackEdgePredecessors.insert(Latch);
+  PG.freeze();
+
+  AbstractStateGraph View;
+  View.attachTo(PG, [] { return std::unique_ptr<AbstractState>(); });
+  CHECK(View.getBase() == &PG);
+  CHECK(View.getNumNodes() == 4);
+  unsigned IA = PG.getDenseIndex(A), IH = PG.getDenseIndex(Hdr),
+           IL = PG.getDenseIndex(Latch), IX = PG.getDenseIndex(X);
+  CHECK(View.getSuccessors(IH).size() == 2);
+  CHECK(hasEdge(View, IL, IH, /*IsBackEdge=*/true));
+  CHECK(hasEdge(View, IH, IL, /*IsBackEdge=*/false));
+  CHECK(hasEdge(View, IH, IX, /*IsBackEdge=*/false));
+  ArrayRef<unsigned> Preds = View.getPredecessors(IH);
+  CHECK(Preds.size() == 2 && Preds[0] == IA && Preds[1] == IL);
+  CHECK(View.getSuccessors(IX).empty());
+
+  // The same graph built by hand, with the same per-node data.
+  AbstractStateGraph Owned;
+  for (unsigned I = 0; I != 4; ++I)
+    addNode(Owned, 0);
+  Owned.addEdge(IA, IH);
+  Owned.addEdge(IH, IL);
+  Owned.addEdge(IL, IH, /*IsBackEdge=*/true);
+  Owned.addEdge(IH, IX);
+  for (AbstractStateGraph *G : {&View, &Owned}) {
+    G->getNode(IA)->IsEntry = true;
+    G->getNode(IX)->IsExit = true;
+    G->getNode(IH)->IsLoopHeader = true;
+    G->getNode(IH)->UpperLoopBound = 5;
+    G->getNode(IH)->Cost = 2;
+    G->getNode(IL)->Cost = 3;
+  }
+  CHECK(serialize(View, {}, {}) == serialize(Owned, {}, {}));
+}
+
+// main calls f; written from a ProgramGraph view, the file keeps each node's
+// block and function name and the function maps, and loads back into a
+// ProgramGraph that labels the nodes as the original did.
+static void testNamesAndFunctions() {
+  LLVMContext Ctx;
+  Module Src("src", Ctx);
+  auto *FT = FunctionType::get(Type::getVoidTy(Ctx), false);
+  Function *Main =
+      Function::Create(FT, GlobalValue::ExternalLinkage, "main", &Src);
+  Function *F = Function::Create(FT, GlobalValue::ExternalLinkage, "f", &Src);
+
+  ProgramGraph PG;
+  unsigned E = PG.addNode(0, 0, nullptr, "Entry");
+  unsigned X = PG.addNode(0, 0, nullptr, "Exit");
+  unsigned Call = PG.addNode(1, 1, nullptr, "entry");
+  unsigned Land = PG.addNode(2, 2, nullptr);
+  unsigned FE = PG.addNode(3, 3, nullptr, "entry");
+  unsigned FR = PG.addNode(4, 4, nullptr, "ret");
+  PG.FunctionNames[Main] = PG.intern("main");
+  PG.FunctionNames[F] = PG.intern("f");
+  for (unsigned Id : {Call, Land})
+    PG.NodeToFunctionMap[Id] = Main;
+  for (unsigned Id : {FE, FR})
+    PG.NodeToFunctionMap[Id] = F;
+  PG.addEdge(E, Call);
+  PG.addEdge(Call, FE);
+  PG.addEdge(Call, Land);
+  PG.addEdge(FE, FR);
+  PG.addEdge(FR, Land);
+  PG.addEdge(Land, X);
+  PG.freeze();
+
+  AbstractStateGraph G;
+  G.attachTo(PG, [] { return std::unique_ptr<AbstractState>(); });
+  for (unsigned I = 0; I < G.getNumNodes(); ++I)
+    G.getNode(I)->Cost = PG.getDenseNode(I).getState().MaxCycles;
+  G.getNode(E)->IsEntry = true;
+  G.getNode(X)->IsExit = true;
+  G.FunctionEntries = {{Main, Call}, {F, FE}};
+  G.FunctionReturns = {{Main, {Land}}, {F, {FR}}};
+  G.CallSites.push_back({Call, Land, F});
+
+  std::string Bytes = serialize(G, {}, {});
+  Expected<GraphFile> File = loadBytes(Bytes);
+  CHECK(!!File);
+  if (!File) {
+    consumeError(File.takeError());
+    return;
+  }
+  CHECK(File->getString(File->nodes()[FE].Name) == "entry");
+  CHECK(File->getString(File->nodes()[FE].Function) == "f");
+  CHECK(File->nodes()[E].Function == GraphFile::None);
+
+  Module Dst("loaded", Ctx);
+  ProgramGraph LoadedPG;
+  AbstractStateGraph Loaded;
+  File->buildAbstractStateGraph(Loaded, LoadedPG, Dst);
+  const Function *LMain = Dst.getFunction("main");
+  const Function *LF = Dst.getFunction("f");
+  CHECK(LMain && LF && LMain != Main);
+  CHECK(LoadedPG.getNodeFunction(Land) == LMain);
+  CHECK(LoadedPG.getNodeFunction(E) == nullptr);
+  CHECK(LoadedPG.FunctionToEntryNodeMap.at(LF) == FE);
+  for (unsigned I = 0; I < G.getNumNodes(); ++I)
+    CHECK(Loaded.getNodeLabel(I) == G.getNodeLabel(I));
+  CHECK(Loaded.getNodeLabel(FE) == "f:entry");
+  CHECK(Loaded.getNodeLabel(Land) == "main:n3");
+
+  CHECK(Loaded.FunctionEntries.size() == 2);
+  CHECK(Loaded.FunctionEntries.at(LF) == FE);
+  CHECK(Loaded.FunctionReturns.at(LMain) == std::vector<unsigned>{Land});
+  CHECK(Loaded.CallSites.size() == 1);
+  if (!Loaded.CallSites.empty()) {
+    const auto &CS = Loaded.CallSites.front();
+    CHECK(CS.Callee == LF);
+    CHECK(Loaded.getCalleeEntry(CS) == FE);
+    CHECK(Loaded.getCalleeReturns(CS).size() == 1 &&
+          Loaded.getCalleeReturns(CS).front() == FR);
+  }
+
+  // Saving the loaded graph again gives the same file.
+  CHECK(serialize(Loaded, {}, {}) == Bytes);
+}
+
+int main() {
+  testRoundTrip();
+  testRejectsMalformed();
+  testProgramGraphView();
+  testNamesAndFunctions();
+
+  if (Failures == 0) {
+    std::cout << "All " << Checks << " checks passed.\n";
+    return 0;
+  }
+  std::cerr << Failures << " of " << Checks << " checks FAILED.\n";
+  return 1;
+}
@@ -25,20 +25,43 @@
 // "update me" signal. (Self-recursion was finding #5's GAP; it is now bounded
 // and covered by testRecursionBounded.)
 //
+// The solver runs in its default LP-first mode (entry-edge loop rows, LP
+// relaxation before branch-and-bound); testLPFirstMatchesMILP cross-checks it
+// against the plain MILP, testModularMatchesMonolithic the bottom-up
+// per-function solve (ModularIPET) against the monolithic one, and
+// testExportRoundTrip reads the -ilp-export files back into HiGHS, and
+// testTopPaths and testSensitivity cover the next-worst paths and the
+// loop-bound/block-cost sensitivity of a HighsIPETSession (its re-solving
+// fallback by testSensitivityOtherPath).
+//
 // HiGHS is the always-available open-source backend. When the build has no ILP
-// backend enabled (ENABLE_HIGHS undefined for this target) the tests are
-// skipped with a success exit, because solveWCET cannot produce a result.
+// backend enabled (ENABLE_HIGHS undefined for this target) the solver tests are
+// skipped, because solveWCET cannot produce a result; only the formatting of
+// the sensitivity report (testSensitivityReport) runs.
 //
 // Run via CTest (`ctest -R LLTAILPSolverTests`) or the `check-llta-ilp` target.
 //===----------------------------------------------------------------------===//
 
 #include "Analysis/AbstractStateGraph.h" // pulls in AbstractState.h
+#include "Graph/ProgramGraph.h"
 #include "ILP/AbstractHighsSolver.h"
+#include "ILP/IPETModel.h"
+#include "ILP/IPETReduction.h"
+#include "ILP/ModularIPET.h"
+#include "ILP/TimingSchemaSolver.h"
+#include "ILP/WorstCasePath.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <cmath>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 using namespace llvm;
 
@@ -77,7 +100,58 @@ static int Failures = 0;
     CHECK(cond);                                                               \
   } while (0)
 
+// main: entry -> loop <-> body, loop -> return, as the pass solves it: a view
+// of a frozen ProgramGraph, whose nodes are labelled "main:<block>".
+// WCET = 1 + 4 * 2 + 3 * 3 + 5 = 23.
+struct LabelledLoop {
+  LLVMContext Ctx;
+  Module M{"labels", Ctx};
+  ProgramGraph PG;
+  AbstractStateGraph G;
+  unsigned Loop, Body;
+
+  LabelledLoop() {
+    auto *FT = FunctionType::get(Type::getVoidTy(Ctx), false);
+    Function *Main =
+        Function::Create(FT, GlobalValue::ExternalLinkage, "main", &M);
+    unsigned E = PG.addNode(0, 0, nullptr, "Entry");
+    unsigned X = PG.addNode(0, 0, nullptr, "Exit");
+    unsigned First = PG.addNode(1, 1, nullptr, "entry");
+    Loop = PG.addNode(2, 2, nullptr, "loop");
+    Body = PG.addNode(3, 3, nullptr, "body");
+    unsigned Ret = PG.addNode(5, 5, nullptr, "return");
+    PG.FunctionNames[Main] = PG.intern("main");
+    for (unsigned Id : {First, Loop, Body, Ret})
+      PG.NodeToFunctionMap[Id] = Main;
+    PG.addEdge(E, First);
+    PG.addEdge(First, Loop);
+    PG.addEdge(Loop, Body);
+    PG.addEdge(Body, Loop);
+    PG.addEdge(Loop, Ret);
+    PG.addEdge(Ret, X);
+    PG.Nodes.at(Loop).BackEdgePredecessors.insert(Body);
+    PG.freeze();
+
+    G.attachTo(PG, [] { return std::unique_ptr<AbstractState>(); });
+    for (unsigned I = 0; I < G.getNumNodes(); ++I)
+      G.getNode(I)->Cost = PG.getDenseNode(I).getState().MaxCycles;
+    G.getNode(E)->IsEntry = true;
+    G.getNode(X)->IsExit = true;
+    G.getNode(Loop)->IsLoopHeader = true;
+    G.getNode(Loop)->UpperLoopBound = 4;
+  }
+
+  std::string print(const IPETSensitivity &S, unsigned MaxBlocks) const {
+    std::string Out;
+    raw_string_ostream OS(Out);
+    S.print(OS, 23, MaxBlocks, [&](unsigned Id) { return G.getNodeLabel(Id); });
+    OS.flush();
+    return Out;
+  }
+};
+
 #ifdef ENABLE_HIGHS
+#include "Highs.h"
 
 // WCET is returned as a double; compare against an exact integer expectation.
 static bool wcetEq(double W, long Expected) {
@@ -118,7 +192,7 @@ static void testChain() {
   CHECK(R.Status.empty());
   CHECK(wcetEq(R.WCET, 8)); // 3 + 5
   // Entry executes exactly once.
-  CHECK(R.ExecutionCounts.count(A) && std::llround(R.ExecutionCounts[A]) == 1);
+  CHECK(std::llround(R.getExecutionCount(A)) == 1);
 }
 
 // Single loop, bound N: header runs N times, body N-1 times.
@@ -232,8 +306,7 @@ static void testTwoCallSiteMatching() {
   CHECK(R.Status.empty());
   CHECK(wcetEq(R.WCET, 107)); // 1 + 100 + 2 + 1 + 3
   // The callee entry is executed exactly twice (once per call site).
-  CHECK(R.ExecutionCounts.count(FE) &&
-        std::llround(R.ExecutionCounts[FE]) == 2);
+  CHECK(std::llround(R.getExecutionCount(FE)) == 2);
 }
 
 // Irreducible / multi-entry loop: the cycle {H,B} is entered at both H and B
@@ -381,9 +454,600 @@ static void testMutualRecursionUnboundedGap() {
       "update when a header-less SCC is bounded");
 }
 
+// The IPET graph reduction must not change the optimum, and its expanded
+// execution counts must match a solve of the unreduced graph node for node.
+// The graph has a collapsible prefix chain, a loop whose body contains a
+// diamond with an empty (zero-cost) arm, and a collapsible latch chain.
+//   WCET = 3 (prefix) + 1*4 (header) + (5 + 6 + 2 + 1)*3 (body) = 49
+static void testReductionMatchesFullSolve() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned P1 = addNode(G, 3);
+  unsigned P2 = addNode(G, 0);
+  unsigned OH = addNode(G, 1);
+  unsigned A = addNode(G, 5);
+  unsigned T = addNode(G, 6);
+  unsigned Z = addNode(G, 0);
+  unsigned D = addNode(G, 2);
+  unsigned L = addNode(G, 1);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 4);
+  G.addEdge(E, P1);
+  G.addEdge(P1, P2);
+  G.addEdge(P2, OH);
+  G.addEdge(OH, A);
+  G.addEdge(A, T);
+  G.addEdge(A, Z);
+  G.addEdge(T, D);
+  G.addEdge(Z, D);
+  G.addEdge(D, L);
+  G.addEdge(L, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+
+  AbstractHighsSolver S;
+  auto Full = S.solveWCET(G);
+  IPETReduction Red(G);
+  CHECK(Red.getNumReducedNodes() < Red.getNumOriginalNodes());
+  auto R = Red.expand(S.solveWCET(Red.getReducedGraph()));
+  CHECK(R.Status.empty());
+  CHECK(wcetEq(Full.WCET, 49));
+  CHECK(wcetEq(R.WCET, 49));
+  for (unsigned Id : {E, P1, P2, OH, A, T, Z, D, L, X}) {
+    CHECK_EQ(std::llround(R.getExecutionCount(Id)),
+             std::llround(Full.getExecutionCount(Id)));
+  }
+}
+
+// LP-first mode (the default, used by every test above) rewrites loop rows in
+// entry-edge form and skips branch-and-bound when the relaxation is integral;
+// it must agree with the plain MILP on WCET and counts.
+static void testLPFirstMatchesMILP() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 2);
+  unsigned IH = addNode(G, 3);
+  unsigned IB = addNode(G, 5);
+  unsigned OL = addNode(G, 7);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 4);
+  markLoopHeader(G, IH, 3);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, IB);
+  G.addEdge(IB, IH, /*IsBackEdge=*/true);
+  G.addEdge(IH, OL);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+
+  AbstractHighsSolver LP(AbstractHighsSolver::Mode::LPFirst);
+  AbstractHighsSolver MILP(AbstractHighsSolver::Mode::MILP);
+  auto RL = LP.solveWCET(G);
+  auto RM = MILP.solveWCET(G);
+  CHECK(RL.Status.empty() && RM.Status.empty());
+  CHECK(wcetEq(RL.WCET, 86));
+  CHECK(wcetEq(RM.WCET, 86));
+  CHECK(!RM.LPRelaxationIntegral);
+  for (unsigned Id : {E, OH, IH, IB, OL, X})
+    CHECK_EQ(std::llround(RL.getExecutionCount(Id)),
+             std::llround(RM.getExecutionCount(Id)));
+
+  // A single bounded loop: the entry-edge relaxation is integral.
+  AbstractStateGraph S;
+  unsigned SE = addNode(S, 0, true);
+  unsigned SH = addNode(S, 3);
+  unsigned SB = addNode(S, 5);
+  unsigned SX = addNode(S, 0, false, true);
+  markLoopHeader(S, SH, 10);
+  S.addEdge(SE, SH);
+  S.addEdge(SH, SB);
+  S.addEdge(SB, SH, /*IsBackEdge=*/true);
+  S.addEdge(SH, SX);
+  auto R = LP.solveWCET(S);
+  CHECK(R.LPRelaxationIntegral);
+  CHECK(R.WCET == 75.0);
+  CHECK(R.getExecutionCount(SB) == 9.0);
+}
+
+// HighsIPETSession keeps one model across what-if queries; every mutated
+// re-solve must match a cold solve of the correspondingly changed graph.
+static void testSessionWhatIf() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned Hd = addNode(G, 3);
+  unsigned Body = addNode(G, 5);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, Hd, 10);
+  G.addEdge(E, Hd);
+  G.addEdge(Hd, Body);
+  G.addEdge(Body, Hd, /*IsBackEdge=*/true);
+  G.addEdge(Hd, X);
+
+  for (auto Mode : {AbstractHighsSolver::Mode::LPFirst,
+                    AbstractHighsSolver::Mode::MILP}) {
+    HighsIPETSession S(G, Mode);
+    CHECK(wcetEq(S.solve().WCET, 75)); // 3*10 + 5*9
+
+    CHECK(S.setLoopBound(Hd, 5));
+    CHECK(wcetEq(S.solve().WCET, 35)); // 3*5 + 5*4
+    G.getNode(Hd)->UpperLoopBound = 5;
+    CHECK(wcetEq(AbstractHighsSolver(Mode).solveWCET(G).WCET, 35));
+    G.getNode(Hd)->UpperLoopBound = 10;
+
+    S.setNodeCost(Body, 1);
+    CHECK(wcetEq(S.solve().WCET, 19)); // 3*5 + 1*4
+
+    CHECK(S.fixEdge(Hd, Body, 0));
+    auto R = S.solve();
+    CHECK(wcetEq(R.WCET, 3));
+    CHECK(std::llround(R.getExecutionCount(Body)) == 0);
+    CHECK(S.releaseEdge(Hd, Body));
+    CHECK(wcetEq(S.solve().WCET, 19));
+
+    CHECK(!S.setLoopBound(Body, 3)); // not a loop header
+    CHECK(!S.fixEdge(Body, X));      // no such edge
+    CHECK(S.getNumSolves() == 5);
+  }
+}
+
+// The bottom-up modular solve (leaf g, then f, then main's residual graph) on
+// a callee inside a loop that itself loops around a call: the same WCET and
+// node counts as the monolithic ILP, with and without the graph reduction.
+static void testModularMatchesMonolithic() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned MH = addNode(G, 1);
+  unsigned MC = addNode(G, 1);
+  unsigned ML = addNode(G, 2);
+  unsigned X = addNode(G, 0, false, true);
+  unsigned F0 = addNode(G, 1);
+  unsigned FH = addNode(G, 2);
+  unsigned FC = addNode(G, 1);
+  unsigned FL = addNode(G, 1);
+  unsigned FR = addNode(G, 1);
+  unsigned G0 = addNode(G, 10);
+  markLoopHeader(G, MH, 3);
+  markLoopHeader(G, FH, 4);
+  G.addEdge(E, MH);
+  G.addEdge(MH, MC);
+  G.addEdge(MC, F0); // call f
+  G.addEdge(MC, ML);
+  G.addEdge(FR, ML); // return from f
+  G.addEdge(ML, MH, /*IsBackEdge=*/true);
+  G.addEdge(MH, X);
+  G.addEdge(F0, FH);
+  G.addEdge(FH, FC);
+  G.addEdge(FC, G0); // call g
+  G.addEdge(FC, FL);
+  G.addEdge(G0, FL); // return from g
+  G.addEdge(FL, FH, /*IsBackEdge=*/true);
+  G.addEdge(FH, FR);
+  G.CallSites.push_back({MC, ML, nullptr, F0, {FR}});
+  G.CallSites.push_back({FC, FL, nullptr, G0, {G0}});
+
+  AbstractHighsSolver S;
+  auto Mono = S.solveWCET(G);
+  CHECK(wcetEq(Mono.WCET, 101)); // 3*1 + 2*(1 + 2 + f), f = 1 + 8 + 33 + 3 + 1
+
+  ModularIPET Modular(G);
+  CHECK(Modular.getNumModules() == 2);
+  CHECK(Modular.getNumLevels() == 2);
+  for (bool Reduce : {false, true}) {
+    auto R = Modular.solve([&](const AbstractStateGraph &Sub) {
+      if (!Reduce)
+        return S.solveWCET(Sub);
+      IPETReduction Red(Sub);
+      return Red.expand(S.solveWCET(Red.getReducedGraph()));
+    });
+    CHECK(R.Status.empty());
+    CHECK(wcetEq(R.WCET, 101));
+    for (unsigned Id = 0; Id < G.getNumNodes(); ++Id)
+      CHECK(std::llround(R.getExecutionCount(Id)) ==
+            std::llround(Mono.getExecutionCount(Id)));
+  }
+}
+
+// A portfolio returns the single-configuration optimum whatever member wins,
+// names the winner, and is capped at the number of configurations.
+static void testPortfolio() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 2);
+  unsigned IH = addNode(G, 3);
+  unsigned IB = addNode(G, 5);
+  unsigned OL = addNode(G, 7);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 4);
+  markLoopHeader(G, IH, 3);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, IB);
+  G.addEdge(IB, IH, /*IsBackEdge=*/true);
+  G.addEdge(IH, OL);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+
+  for (auto Mode : {AbstractHighsSolver::Mode::LPFirst,
+                    AbstractHighsSolver::Mode::MILP}) {
+    auto Single = AbstractHighsSolver(Mode).solveWCET(G);
+    CHECK(Single.SolverConfig.empty());
+    for (unsigned Size = 2; Size <= AbstractHighsSolver::MaxPortfolioSize;
+         ++Size) {
+      AbstractHighsSolver S(Mode, Size, /*Threads=*/1);
+      auto R = S.solveWCET(G);
+      CHECK(R.Status.empty());
+      CHECK(wcetEq(R.WCET, std::llround(Single.WCET)));
+      bool Known = false;
+      for (unsigned K = 0; K < Size; ++K)
+        Known |= R.SolverConfig ==
+                 AbstractHighsSolver::getPortfolioConfigName(K);
+      CHECK(Known);
+    }
+  }
+  CHECK(AbstractHighsSolver(AbstractHighsSolver::Mode::LPFirst, 100)
+            .getPortfolioSize() == AbstractHighsSolver::MaxPortfolioSize);
+}
+
+// The structural timing schema agrees with the ILP on loop nests with
+// branches, a break out of two loops, and a callee summarised per call site.
+static void testTimingSchemaMatchesILP() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 1);
+  unsigned IH = addNode(G, 1);
+  unsigned Cheap = addNode(G, 2);
+  unsigned Dear = addNode(G, 9);
+  unsigned IL = addNode(G, 1);
+  unsigned OL = addNode(G, 1);
+  unsigned Brk = addNode(G, 50);
+  unsigned C = addNode(G, 1);
+  unsigned L = addNode(G, 1);
+  unsigned X = addNode(G, 0, false, true);
+  unsigned F0 = addNode(G, 4);
+  unsigned FH = addNode(G, 2);
+  unsigned FB = addNode(G, 3);
+  unsigned FR = addNode(G, 1);
+  markLoopHeader(G, OH, 3);
+  markLoopHeader(G, IH, 5);
+  markLoopHeader(G, FH, 6);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, Cheap);
+  G.addEdge(IH, Dear);
+  G.addEdge(Cheap, IL);
+  G.addEdge(Dear, IL);
+  G.addEdge(IL, IH, /*IsBackEdge=*/true);
+  G.addEdge(IL, Brk);
+  G.addEdge(IH, OL);
+  G.addEdge(OL, C);
+  G.addEdge(C, F0); // call f
+  G.addEdge(C, L);
+  G.addEdge(FR, L); // return from f
+  G.addEdge(L, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+  G.addEdge(Brk, X);
+  G.addEdge(F0, FH);
+  G.addEdge(FH, FB);
+  G.addEdge(FB, FH, /*IsBackEdge=*/true);
+  G.addEdge(FH, FR);
+  G.CallSites.push_back({C, L, nullptr, F0, {FR}});
+
+  TimingSchemaSolver S(std::make_unique<AbstractHighsSolver>(),
+                       /*CrossCheck=*/true);
+  auto R = S.solveWCET(G);
+  CHECK(R.Status.empty());
+  CHECK(R.SolverConfig == TimingSchemaSolver::ConfigName);
+  CHECK(S.getNumCrossChecks() == 1);
+  CHECK(S.getNumMismatches() == 0);
+  auto ILP = AbstractHighsSolver().solveWCET(G);
+  for (unsigned Id = 0; Id < G.getNumNodes(); ++Id)
+    CHECK_EQ(std::llround(R.getExecutionCount(Id)),
+             std::llround(ILP.getExecutionCount(Id)));
+}
+
+// -ilp-export: the MPS and LP files of a model read back into HiGHS as the
+// same integer program (same optimum as solveWCET), in both loop-row forms.
+static void testExportRoundTrip() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 1);
+  unsigned IH = addNode(G, 2);
+  unsigned A = addNode(G, 5);
+  unsigned B = addNode(G, 3);
+  unsigned L = addNode(G, 1);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 4);
+  markLoopHeader(G, IH, 3);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, A);
+  G.addEdge(IH, B);
+  G.addEdge(A, IH, /*IsBackEdge=*/true);
+  G.addEdge(B, L);
+  G.addEdge(L, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+
+  for (auto M : {AbstractHighsSolver::Mode::LPFirst,
+                 AbstractHighsSolver::Mode::MILP}) {
+    AbstractHighsSolver S(M);
+    auto R = S.solveWCET(G);
+    CHECK(R.Status.empty());
+    CHECK(wcetEq(R.WCET, 64)); // 4*1 + 9*2 + 6*5 + 3*3 + 3*1
+    IPETModel Model(G, AbstractHighsSolver::getLoopRowForm(M));
+    for (const char *Ext : {"mps", "lp"}) {
+      SmallString<128> Path;
+      CHECK(!sys::fs::createTemporaryFile("llta-ipet", Ext, Path));
+      CHECK(IPETModel::getExportFormatForPath(Path) ==
+            (StringRef(Ext) == "lp" ? IPETModel::ExportFormat::LP
+                                    : IPETModel::ExportFormat::MPS));
+      CHECK(Model.exportModel(Path, IPETModel::getExportFormatForPath(Path)));
+      Highs H;
+      H.setOptionValue("output_flag", false);
+      CHECK(H.readModel(std::string(Path)) != HighsStatus::kError);
+      CHECK_EQ(H.getLp().num_col_, HighsInt(Model.getNumCols()));
+      CHECK_EQ(H.getLp().num_row_, HighsInt(Model.getNumRows()));
+      H.run();
+      CHECK(H.getModelStatus() == HighsModelStatus::kOptimal);
+      CHECK_EQ(std::llround(H.getInfo().objective_function_value),
+               std::llround(R.WCET));
+      sys::fs::remove(Path);
+    }
+  }
+}
+
+// -ilp-time-limit / -ilp-gap: however early the solver is stopped, the WCET it
+// reports never falls below the optimum, a reported incumbent never exceeds
+// it, and the reported counts are the incumbent's path.
+static void testLimitsStaySound() {
+  AbstractStateGraph G;
+  unsigned Prev = addNode(G, 0, true);
+  for (unsigned K = 0; K < 20; ++K) {
+    unsigned H = addNode(G, 1);
+    unsigned A = addNode(G, K);
+    unsigned B = addNode(G, 2 * K + 1);
+    unsigned L = addNode(G, 1);
+    markLoopHeader(G, H, 3 + K);
+    G.addEdge(Prev, H);
+    G.addEdge(H, A);
+    G.addEdge(H, B);
+    G.addEdge(A, L);
+    G.addEdge(B, L);
+    G.addEdge(L, H, /*IsBackEdge=*/true);
+    Prev = H;
+  }
+  unsigned X = addNode(G, 0, false, true);
+  G.addEdge(Prev, X);
+  const long Optimum =
+      std::llround(AbstractHighsSolver(AbstractHighsSolver::Mode::MILP)
+                       .solveWCET(G)
+                       .WCET);
+
+  for (auto M : {AbstractHighsSolver::Mode::LPFirst,
+                 AbstractHighsSolver::Mode::MILP})
+    for (double TimeLimit : {0.0, 1e-9})
+      for (double Gap : {0.0, 0.5}) {
+        AbstractHighsSolver S(M);
+        S.setTimeLimit(TimeLimit);
+        S.setRelativeGap(Gap);
+        CHECK(S.getTimeLimit() == TimeLimit);
+        CHECK(S.getRelativeGap() == Gap);
+        auto R = S.solveWCET(G);
+        if (!R.Status.empty()) {
+          // Stopped before any bound was known.
+          CHECK(TimeLimit > 0);
+          continue;
+        }
+        CHECK(std::llround(R.WCET) >= Optimum);
+        if (!R.LimitReached) {
+          CHECK(wcetEq(R.WCET, Optimum));
+          continue;
+        }
+        CHECK(std::llround(R.Incumbent) <= Optimum);
+        CHECK(R.Gap >= 0.0 && R.Gap <= 1.0);
+        if (R.ExecutionCounts.empty())
+          continue;
+        double PathCost = 0.0;
+        for (unsigned Id = 0; Id < G.getNumNodes(); ++Id)
+          PathCost += G.getNodes()[Id].Cost * R.getExecutionCount(Id);
+        CHECK_EQ(std::llround(PathCost), std::llround(R.Incumbent));
+      }
+}
+
+// The worst-case path of a HiGHS solution, then the next-worst distinct paths
+// of the warm session: cutting off the all-A path forces B into at least one
+// iteration, after which every edge has been used and nothing is left to cut.
+static void testTopPaths() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned H = addNode(G, 1);
+  unsigned A = addNode(G, 10);
+  unsigned B = addNode(G, 6);
+  unsigned L = addNode(G, 1);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, H, 4);
+  G.addEdge(E, H);
+  G.addEdge(H, A);
+  G.addEdge(H, B);
+  G.addEdge(A, L);
+  G.addEdge(B, L);
+  G.addEdge(L, H, /*IsBackEdge=*/true);
+  G.addEdge(H, X);
+
+  for (auto Mode : {AbstractHighsSolver::Mode::LPFirst,
+                    AbstractHighsSolver::Mode::MILP}) {
+    HighsIPETSession S(G, Mode);
+    auto Worst = S.solve();
+    CHECK(wcetEq(Worst.WCET, 37)); // 1*4 + (10 + 1)*3
+    WorstCasePath P(G, Worst);
+    CHECK((P.expand() ==
+           std::vector<unsigned>{E, H, A, L, H, A, L, H, A, L, H, X}));
+
+    CHECK(S.excludePath(Worst));
+    auto Next = S.solve();
+    CHECK(wcetEq(Next.WCET, 33)); // one iteration through B
+    CHECK(std::llround(Next.getExecutionCount(B)) == 1);
+    CHECK(WorstCasePath(G, Next).getLength() == 12);
+
+    CHECK(!S.excludePath(Next));
+    CHECK(!S.excludePath(AbstractILPResult{}));
+  }
+}
+
+// Sensitivity of the A/B loop: one more iteration of the bound-4 loop adds
+// H + A + L = 12 cycles. A stays on the path while it costs at least B's 6,
+// and B stays off it up to A's 10; ranging is per basis, so the reported
+// ranges hold the current costs and never reach past those limits.
+static void testSensitivity() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned H = addNode(G, 1);
+  unsigned A = addNode(G, 10);
+  unsigned B = addNode(G, 6);
+  unsigned L = addNode(G, 1);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, H, 4);
+  G.addEdge(E, H);
+  G.addEdge(H, A);
+  G.addEdge(H, B);
+  G.addEdge(A, L);
+  G.addEdge(B, L);
+  G.addEdge(L, H, /*IsBackEdge=*/true);
+  G.addEdge(H, X);
+
+  for (auto Mode : {AbstractHighsSolver::Mode::LPFirst,
+                    AbstractHighsSolver::Mode::MILP}) {
+    auto R = AbstractHighsSolver(Mode).solveWCET(G);
+    HighsIPETSession S(G, Mode);
+    IPETSensitivity Sens = S.analyzeSensitivity(R);
+    CHECK(Sens.Status.empty());
+    CHECK(Sens.Exact);
+    CHECK(Sens.Loops.size() == 1);
+    CHECK(Sens.Loops[0].Header == H && Sens.Loops[0].Bound == 4);
+    CHECK(Sens.Loops[0].Entries == 1.0);
+    CHECK(wcetEq(Sens.Loops[0].CyclesPerBound, 12));
+    CHECK(Sens.Blocks.size() == G.getNumNodes());
+    CHECK(Sens.Blocks[A].Count == 3.0 && Sens.Blocks[B].Count == 0.0);
+    CHECK(Sens.Blocks[A].CostLower >= 6.0 - 1e-6);
+    CHECK(Sens.Blocks[A].CostLower <= 10.0 && Sens.Blocks[A].CostUpper >= 10.0);
+    CHECK(Sens.Blocks[B].CostUpper <= 10.0 + 1e-6);
+    CHECK(Sens.Blocks[B].CostLower <= 6.0 && Sens.Blocks[B].CostUpper >= 6.0);
+
+    // The bound +1 the dual predicts.
+    CHECK(S.setLoopBound(H, 5));
+    CHECK(wcetEq(S.solve().WCET, R.WCET + 12));
+  }
+}
+
+// Two equal-cost branches: the worst-case path takes A or B each iteration, so
+// the LP's vertex is one of two paths of equal WCET. The duals describe only
+// that vertex, so analyzing the other path must take the non-exact fallback
+// and re-solve at bound + 1.
+static void testSensitivityOtherPath() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned H = addNode(G, 1);
+  unsigned A = addNode(G, 10);
+  unsigned B = addNode(G, 10);
+  unsigned L = addNode(G, 1);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, H, 4);
+  G.addEdge(E, H);
+  G.addEdge(H, A);
+  G.addEdge(H, B);
+  G.addEdge(A, L);
+  G.addEdge(B, L);
+  G.addEdge(L, H, /*IsBackEdge=*/true);
+  G.addEdge(H, X);
+
+  for (auto Mode : {AbstractHighsSolver::Mode::LPFirst,
+                    AbstractHighsSolver::Mode::MILP}) {
+    auto R = AbstractHighsSolver(Mode).solveWCET(G);
+    CHECK(R.Status.empty());
+    CHECK(wcetEq(R.WCET, 37)); // 4 * 1 + 3 * (10 + 1)
+    // The same path with the branches swapped.
+    AbstractILPResult Swapped = R;
+    std::swap(Swapped.ExecutionCounts[A], Swapped.ExecutionCounts[B]);
+    std::swap(Swapped.EdgeCounts[{H, A}], Swapped.EdgeCounts[{H, B}]);
+    std::swap(Swapped.EdgeCounts[{A, L}], Swapped.EdgeCounts[{B, L}]);
+
+    HighsIPETSession S(G, Mode);
+    IPETSensitivity First = S.analyzeSensitivity(R);
+    IPETSensitivity Second = S.analyzeSensitivity(Swapped);
+    CHECK(First.Status.empty() && Second.Status.empty());
+    CHECK(First.Exact != Second.Exact);
+    const IPETSensitivity &Other = First.Exact ? Second : First;
+    const AbstractILPResult &OtherPath = First.Exact ? Swapped : R;
+    CHECK(Other.Loops.size() == 1);
+    CHECK(Other.Loops[0].Entries == 1.0);
+    CHECK(Other.Blocks[A].Count == OtherPath.getExecutionCount(A));
+    CHECK(Other.Blocks[B].Count == OtherPath.getExecutionCount(B));
+    CHECK(Other.Blocks[A].CostLower == -IPETModel::Infinity);
+    CHECK(Other.Blocks[A].CostUpper == IPETModel::Infinity);
+
+    // The fallback's marginal is the re-solve's, and the bound is restored.
+    CHECK(wcetEq(S.solve().WCET, 37));
+    CHECK(S.setLoopBound(H, 5));
+    double Raised = S.solve().WCET;
+    CHECK(wcetEq(Raised, 49));
+    CHECK(Other.Loops[0].CyclesPerBound == std::round(Raised - R.WCET));
+  }
+}
+
+// The -ilp-sensitivity report of a ProgramGraph-backed graph names its blocks
+// "function:block"; the two costliest are the loop body and header.
+static void testSensitivityLabels() {
+  LabelledLoop L;
+  auto R = AbstractHighsSolver().solveWCET(L.G);
+  CHECK(wcetEq(R.WCET, 23));
+  HighsIPETSession S(L.G);
+  IPETSensitivity Sens = S.analyzeSensitivity(R);
+  CHECK(Sens.Status.empty() && Sens.Exact);
+  std::string Out = L.print(Sens, 2);
+  CHECK(Out.find("    main:loop: bound 4, entered 1x, 5 cycles\n") !=
+        std::string::npos);
+  size_t Body = Out.find("    main:body: 3 x 3, 39.1%, [");
+  size_t Loop = Out.find("    main:loop: 2 x 4, 34.8%, [");
+  CHECK(Body != std::string::npos && Loop != std::string::npos &&
+        Body < Loop);
+  CHECK(Out.find("main:return") == std::string::npos);
+  CHECK(Out.find(" n") == std::string::npos);
+}
+
 #endif // ENABLE_HIGHS
 
+// The report itself, on hand-written results: loops by marginal, blocks by
+// share of the WCET (zero-cost and unvisited ones left out, cut to MaxBlocks),
+// cost ranges only when exact.
+static void testSensitivityReport() {
+  LabelledLoop L;
+  IPETSensitivity S;
+  S.Exact = true;
+  S.Loops = {{L.Loop, 4, 1, 5}};
+  const double Inf = IPETModel::Infinity;
+  S.Blocks = {{0, 0, 1, -Inf, Inf}, {1, 0, 1, -Inf, Inf},
+              {2, 1, 1, -Inf, 4},   {L.Loop, 2, 4, 0, Inf},
+              {L.Body, 3, 3, 1.5, Inf}, {5, 5, 1, -Inf, Inf}};
+  CHECK(L.print(S, 3) ==
+        "\nSensitivity (LP duals and cost ranging):\n"
+        "  Loop bounds (WCET cycles per unit of bound):\n"
+        "    main:loop: bound 4, entered 1x, 5 cycles\n"
+        "  Blocks (cost x count, share of the WCET, cost range keeping the "
+        "path):\n"
+        "    main:body: 3 x 3, 39.1%, [2, inf]\n"
+        "    main:loop: 2 x 4, 34.8%, [0, inf]\n"
+        "    main:return: 5 x 1, 21.7%, [-inf, inf]\n");
+
+  S.Exact = false;
+  CHECK(L.print(S, 1) ==
+        "\nSensitivity (fractional LP relaxation: bounds raised one at a "
+        "time, no cost ranges):\n"
+        "  Loop bounds (WCET cycles per unit of bound):\n"
+        "    main:loop: bound 4, entered 1x, 5 cycles\n"
+        "  Blocks (cost x count, share of the WCET):\n"
+        "    main:body: 3 x 3, 39.1%\n");
+}
+
 int main() {
+  testSensitivityReport();
 #ifdef ENABLE_HIGHS
   testChain();
   testSingleLoop();
@@ -395,6 +1059,22 @@ int main() {
   testRecursionBounded();
   testMutualRecursionBounded();
   testMutualRecursionUnboundedGap();
+  testReductionMatchesFullSolve();
+  testLPFirstMatchesMILP();
+  testSessionWhatIf();
+  testModularMatchesMonolithic();
+  testPortfolio();
+  testTimingSchemaMatchesILP();
+  testExportRoundTrip();
+  testLimitsStaySound();
+  testTopPaths();
+  testSensitivity();
+  testSensitivityOtherPath();
+  testSensitivityLabels();
+#else
+  std::cout << "ILP solver tests skipped: no ILP backend enabled "
+               "(reconfigure with HiGHS).\n";
+#endif
 
   if (Failures == 0) {
     std::cout << "All " << Checks << " checks passed.\n";
@@ -402,9 +1082,4 @@ int main() {
   }
   std::cerr << Failures << " of " << Checks << " checks FAILED.\n";
   return 1;
-#else
-  std::cout << "ILP solver tests skipped: no ILP backend enabled "
-               "(reconfigure with HiGHS).\n";
-  return 0;
-#endif
 }
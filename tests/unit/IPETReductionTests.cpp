@@ -0,0 +1,264 @@
+//===- IPETReductionTests.cpp - unit tests for the IPET graph reduction ---===//
+//
+// A dependency-light standalone test binary (no GoogleTest) for
+// lib/ILP/IPETReduction.cpp: chain collapsing, zero-cost node elimination, the
+// structures the reduction must leave alone (loop headers, back edges, call and
+// return edges), and the mapping of a reduced solution and path back to the
+// original node ids.
+//
+// The reduction is purely structural, so no ILP backend is needed: each test
+// builds an AbstractStateGraph by hand (null AbstractStates, as in
+// ILPSolverTests.cpp) and, where a solution is needed, fabricates the result a
+// solver would return for the reduced graph.
+//
+// Run via CTest (`ctest -R LLTAIPETReductionTests`) or `check-llta-ilp`.
+//===----------------------------------------------------------------------===//
+
+#include "Analysis/AbstractStateGraph.h"
+#include "ILP/IPETReduction.h"
+
+#include <iostream>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+static int Checks = 0;
+static int Failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    ++Checks;                                                                  \
+    if (!(cond)) {                                                             \
+      ++Failures;                                                              \
+      std::cerr << "FAIL [" << __FILE__ << ":" << __LINE__ << "]: " << #cond   \
+                << "\n";                                                       \
+    }                                                                          \
+  } while (0)
+
+static unsigned addNode(AbstractStateGraph &G, unsigned Cost,
+                        bool IsEntry = false, bool IsExit = false) {
+  unsigned Id = G.addNode(nullptr);
+  auto *N = G.getNode(Id);
+  N->Cost = Cost;
+  N->IsEntry = IsEntry;
+  N->IsExit = IsExit;
+  return Id;
+}
+
+static bool hasEdge(const AbstractStateGraph &G, unsigned From, unsigned To) {
+  for (const auto &E : G.getSuccessors(From))
+    if (E.To == To)
+      return true;
+  return false;
+}
+
+// A straight-line chain collapses into one node carrying the summed cost and
+// both the entry and exit role; every original node inherits its count.
+static void testChainCollapse() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, /*IsEntry=*/true);
+  unsigned A = addNode(G, 3);
+  unsigned B = addNode(G, 5);
+  unsigned X = addNode(G, 0, /*IsEntry=*/false, /*IsExit=*/true);
+  G.addEdge(E, A);
+  G.addEdge(A, B);
+  G.addEdge(B, X);
+
+  IPETReduction Red(G);
+  const AbstractStateGraph &RG = Red.getReducedGraph();
+  CHECK(Red.getNumOriginalNodes() == 4);
+  CHECK(Red.getNumReducedNodes() == 1);
+  CHECK(Red.getNumReducedEdges() == 0);
+  const auto &Only = RG.getNodes().front();
+  CHECK(Only.Cost == 8);
+  CHECK(Only.IsEntry && Only.IsExit);
+
+  AbstractILPResult Reduced;
+  Reduced.WCET = 8;
+  Reduced.ExecutionCounts.assign(RG.getNumNodes(), 0.0);
+  Reduced.ExecutionCounts[Only.Id] = 1;
+  AbstractILPResult R = Red.expand(Reduced);
+  CHECK(R.WCET == 8);
+  for (unsigned Id : {E, A, B, X})
+    CHECK(R.getExecutionCount(Id) == 1);
+  CHECK(R.EdgeCounts.size() == 3);
+}
+
+// Loop headers and back edges are kept: a single-block loop body is neither
+// merged into its header nor across the back edge.
+static void testLoopKept() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned H = addNode(G, 2);
+  unsigned B = addNode(G, 5);
+  unsigned X = addNode(G, 0, false, true);
+  G.getNode(H)->IsLoopHeader = true;
+  G.getNode(H)->UpperLoopBound = 10;
+  G.addEdge(E, H);
+  G.addEdge(H, B);
+  G.addEdge(B, H, /*IsBackEdge=*/true);
+  G.addEdge(H, X);
+
+  IPETReduction Red(G);
+  CHECK(Red.getNumReducedNodes() == 4);
+  CHECK(Red.getNumReducedEdges() == 4);
+  unsigned Headers = 0, BackEdges = 0;
+  for (const auto &N : Red.getReducedGraph().getNodes()) {
+    Headers += N.IsLoopHeader && N.UpperLoopBound == 10;
+    for (const auto &Edge : Red.getReducedGraph().getSuccessors(N.Id))
+      BackEdges += Edge.IsBackEdge;
+  }
+  CHECK(Headers == 1);
+  CHECK(BackEdges == 1);
+}
+
+// An empty else-branch (zero cost, one in- and one out-edge) is replaced by a
+// bypass edge, whose flow becomes the eliminated node's count; the surrounding
+// chains collapse around it.
+static void testZeroCostBypass() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned P = addNode(G, 2);
+  unsigned T = addNode(G, 4);
+  unsigned Z = addNode(G, 0);
+  unsigned J = addNode(G, 1);
+  unsigned X = addNode(G, 0, false, true);
+  G.addEdge(E, P);
+  G.addEdge(P, T);
+  G.addEdge(P, Z);
+  G.addEdge(T, J);
+  G.addEdge(Z, J);
+  G.addEdge(J, X);
+
+  IPETReduction Red(G);
+  const AbstractStateGraph &RG = Red.getReducedGraph();
+  CHECK(Red.getNumReducedNodes() == 3); // {E,P}, {T}, {J,X}
+  CHECK(Red.getNumReducedEdges() == 3);
+
+  unsigned Head = ~0u, Then = ~0u, Tail = ~0u;
+  for (const auto &N : RG.getNodes()) {
+    if (N.IsEntry)
+      Head = N.Id;
+    else if (N.IsExit)
+      Tail = N.Id;
+    else
+      Then = N.Id;
+  }
+  CHECK(Head != ~0u && Then != ~0u && Tail != ~0u);
+  CHECK(RG.getNodes()[Head].Cost == 2);
+  CHECK(RG.getNodes()[Tail].Cost == 1);
+  CHECK(hasEdge(RG, Head, Tail)); // the bypass
+
+  // The solver took the (empty) else-branch.
+  AbstractILPResult Reduced;
+  Reduced.WCET = 3;
+  Reduced.ExecutionCounts.assign(RG.getNumNodes(), 0.0);
+  Reduced.ExecutionCounts[Head] = 1;
+  Reduced.ExecutionCounts[Tail] = 1;
+  Reduced.EdgeCounts[{Head, Tail}] = 1;
+  AbstractILPResult R = Red.expand(Reduced);
+  CHECK(R.getExecutionCount(Z) == 1);
+  CHECK(R.getExecutionCount(T) == 0);
+  CHECK(R.getExecutionCount(P) == 1 && R.getExecutionCount(X) == 1);
+  CHECK(R.EdgeCounts.count({P, Z}) && R.EdgeCounts.count({Z, J}));
+  CHECK(!R.EdgeCounts.count({P, T}));
+}
+
+// Call and return edges are read by the call/return matching rows, so they
+// must survive, and the remapped CallSites must still name them.
+static void testCallEdgesPinned() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned C1 = addNode(G, 1);
+  unsigned FE = addNode(G, 50);
+  unsigned FR = addNode(G, 0);
+  unsigned L1 = addNode(G, 2);
+  unsigned C2 = addNode(G, 1);
+  unsigned L2 = addNode(G, 3);
+  unsigned X = addNode(G, 0, false, true);
+  G.addEdge(E, C1);
+  G.addEdge(C1, FE);
+  G.addEdge(FE, FR);
+  G.addEdge(FR, L1);
+  G.addEdge(L1, C2);
+  G.addEdge(C2, FE);
+  G.addEdge(FR, L2);
+  G.addEdge(L2, X);
+  const Function *F = reinterpret_cast<const Function *>(0x1);
+  G.FunctionEntries[F] = FE;
+  G.FunctionReturns[F] = {FR};
+  G.CallSites.push_back({C1, L1, F});
+  G.CallSites.push_back({C2, L2, F});
+
+  IPETReduction Red(G);
+  const AbstractStateGraph &RG = Red.getReducedGraph();
+  CHECK(Red.getNumReducedNodes() < Red.getNumOriginalNodes());
+  CHECK(RG.CallSites.size() == 2);
+  CHECK(RG.FunctionEntries.count(F) && RG.FunctionReturns.count(F));
+  unsigned REntry = RG.FunctionEntries.at(F);
+  for (const auto &CS : RG.CallSites) {
+    CHECK(hasEdge(RG, CS.CallNodeId, REntry));
+    bool HasReturn = false;
+    for (unsigned Ret : RG.FunctionReturns.at(F))
+      HasReturn |= hasEdge(RG, Ret, CS.ReturnNodeId);
+    CHECK(HasReturn);
+  }
+}
+
+// With -context-depth each call site enters its own callee instance, named by
+// the site's EntryNodeId/ReturnNodeIds rather than FunctionEntries; those edges
+// are pinned as well and the per-site ids are remapped into the reduced graph.
+static void testContextCallSites() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned C1 = addNode(G, 1);
+  unsigned L1 = addNode(G, 2);
+  unsigned C2 = addNode(G, 1);
+  unsigned L2 = addNode(G, 3);
+  unsigned X = addNode(G, 0, false, true);
+  unsigned FE1 = addNode(G, 50), FR1 = addNode(G, 4);
+  unsigned FE2 = addNode(G, 50), FR2 = addNode(G, 4);
+  G.addEdge(E, C1);
+  G.addEdge(C1, FE1);
+  G.addEdge(FE1, FR1);
+  G.addEdge(FR1, L1);
+  G.addEdge(L1, C2);
+  G.addEdge(C2, FE2);
+  G.addEdge(FE2, FR2);
+  G.addEdge(FR2, L2);
+  G.addEdge(L2, X);
+  const Function *F = reinterpret_cast<const Function *>(0x1);
+  G.CallSites.push_back({C1, L1, F, FE1, {FR1}});
+  G.CallSites.push_back({C2, L2, F, FE2, {FR2}});
+
+  IPETReduction Red(G);
+  const AbstractStateGraph &RG = Red.getReducedGraph();
+  CHECK(RG.CallSites.size() == 2);
+  std::set<unsigned> Entries;
+  for (const auto &CS : RG.CallSites) {
+    unsigned Entry = RG.getCalleeEntry(CS);
+    CHECK(Entry != ~0u);
+    CHECK(hasEdge(RG, CS.CallNodeId, Entry));
+    CHECK(CS.ReturnNodeIds.size() == 1);
+    for (unsigned Ret : RG.getCalleeReturns(CS))
+      CHECK(hasEdge(RG, Ret, CS.ReturnNodeId));
+    Entries.insert(Entry);
+  }
+  CHECK(Entries.size() == 2);
+}
+
+int main() {
+  testChainCollapse();
+  testLoopKept();
+  testZeroCostBypass();
+  testCallEdgesPinned();
+  testContextCallSites();
+
+  if (Failures == 0) {
+    std::cout << "All " << Checks << " checks passed.\n";
+    return 0;
+  }
+  std::cerr << Failures << " of " << Checks << " checks FAILED.\n";
+  return 1;
+}
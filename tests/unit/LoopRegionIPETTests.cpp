@@ -0,0 +1,294 @@
+//===- LoopRegionIPETTests.cpp - unit tests for loop-region contraction ---===//
+//
+// A dependency-light standalone test binary (no GoogleTest) for
+// lib/ILP/LoopRegionIPET.cpp: which loops are contracted and on which level,
+// the loops that stay in the top-level graph, and the mapping of the
+// per-entry region solutions back to the original node and edge ids.
+//
+// No ILP backend is needed: every (sub-)graph handed to the SolveFn is a
+// reducible, bounded loop nest, which the timing schema solves exactly; the
+// contracted result is compared against the schema on the whole graph.
+// Graphs are built by hand with null AbstractStates.
+//
+// Run via CTest (`ctest -R LLTALoopRegionIPETTests`) or `check-llta-ilp`.
+//===----------------------------------------------------------------------===//
+
+#include "Analysis/AbstractStateGraph.h"
+#include "ILP/LoopRegionIPET.h"
+#include "ILP/TimingSchemaSolver.h"
+
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace llvm;
+
+static int Checks = 0;
+static int Failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    ++Checks;                                                                  \
+    if (!(cond)) {                                                             \
+      ++Failures;                                                              \
+      std::cerr << "FAIL [" << __FILE__ << ":" << __LINE__ << "]: " << #cond   \
+                << "\n";                                                       \
+    }                                                                          \
+  } while (0)
+
+static unsigned addNode(AbstractStateGraph &G, unsigned Cost,
+                        bool IsEntry = false, bool IsExit = false) {
+  unsigned Id = G.addNode(nullptr);
+  auto *N = G.getNode(Id);
+  N->Cost = Cost;
+  N->IsEntry = IsEntry;
+  N->IsExit = IsExit;
+  return Id;
+}
+
+static void markLoopHeader(AbstractStateGraph &G, unsigned Id, unsigned Bound) {
+  G.getNode(Id)->IsLoopHeader = true;
+  G.getNode(Id)->UpperLoopBound = Bound;
+}
+
+static AbstractILPResult solveSchema(const AbstractStateGraph &G) {
+  TimingSchemaSolver S(nullptr);
+  return S.solveWCET(G);
+}
+
+/// Same WCET and the same node and edge counts as the schema on all of \p G.
+static bool matchesMonolithic(const AbstractStateGraph &G,
+                              const AbstractILPResult &R) {
+  AbstractILPResult Whole = solveSchema(G);
+  if (!R.Status.empty() || R.WCET != Whole.WCET)
+    return false;
+  for (unsigned V = 0; V < G.getNumNodes(); ++V)
+    if (std::abs(R.getExecutionCount(V) - Whole.getExecutionCount(V)) > 1e-6)
+      return false;
+  if (R.EdgeCounts.size() != Whole.EdgeCounts.size())
+    return false;
+  for (const auto &[Edge, Count] : Whole.EdgeCounts) {
+    auto It = R.EdgeCounts.find(Edge);
+    if (It == R.EdgeCounts.end() || std::abs(It->second - Count) > 1e-6)
+      return false;
+  }
+  return true;
+}
+
+// The inner loop is contracted first, which makes the outer one innermost;
+// the top-level graph is entry, summary, exit.
+static void testNestedLoops() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 2);
+  unsigned IH = addNode(G, 3);
+  unsigned IB = addNode(G, 5);
+  unsigned OL = addNode(G, 7);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 4);
+  markLoopHeader(G, IH, 3);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, IB);
+  G.addEdge(IB, IH, /*IsBackEdge=*/true);
+  G.addEdge(IH, OL);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+
+  LoopRegionIPET Regions(G);
+  CHECK(Regions.getNumRegions() == 2);
+  CHECK(Regions.getNumLevels() == 2);
+  CHECK(Regions.getNumTopNodes() == 3);
+
+  AbstractILPResult R = Regions.solve(solveSchema);
+  CHECK(R.WCET == 86);
+  CHECK(R.getExecutionCount(IB) == 6);
+  CHECK(matchesMonolithic(G, R));
+}
+
+// The inner loop is left through the outer loop's back edge, and the first
+// of two sibling loops leads straight into the second one's header. The
+// second loop's summary is carried up to the top level with its WCET.
+static void testExitEdges() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 1);
+  unsigned IH = addNode(G, 4);
+  unsigned IB = addNode(G, 2);
+  unsigned H2 = addNode(G, 1);
+  unsigned B2 = addNode(G, 6);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 3);
+  markLoopHeader(G, IH, 5);
+  markLoopHeader(G, H2, 2);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, IB);
+  G.addEdge(IB, IH, /*IsBackEdge=*/true);
+  G.addEdge(IH, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, H2);
+  G.addEdge(H2, B2);
+  G.addEdge(B2, H2, /*IsBackEdge=*/true);
+  G.addEdge(H2, X);
+
+  LoopRegionIPET Regions(G);
+  CHECK(Regions.getNumRegions() == 3);
+  CHECK(Regions.getNumLevels() == 2);
+  CHECK(Regions.getNumTopNodes() == 4);
+  AbstractILPResult R = Regions.solve(solveSchema);
+  CHECK(matchesMonolithic(G, R));
+  CHECK((R.EdgeCounts[{IH, OH}] == 2));
+  CHECK((R.EdgeCounts[{OH, H2}] == 1));
+}
+
+// Loops that do not qualify stay in the top-level graph: one with exits to
+// two targets (and the loop around it, which never becomes innermost), and
+// one with a call inside. A graph without regions goes to the SolveFn as is.
+static void testUncontracted() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 1);
+  unsigned IH = addNode(G, 1);
+  unsigned IB = addNode(G, 9);
+  unsigned OL = addNode(G, 1);
+  unsigned Brk = addNode(G, 50);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 2);
+  markLoopHeader(G, IH, 5);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, IB);
+  G.addEdge(IB, IH, /*IsBackEdge=*/true);
+  G.addEdge(IB, Brk);
+  G.addEdge(IH, OL);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+  G.addEdge(Brk, X);
+
+  LoopRegionIPET Regions(G);
+  CHECK(Regions.getNumRegions() == 0);
+  CHECK(Regions.getNumLevels() == 0);
+  CHECK(Regions.getNumTopNodes() == G.getNumNodes());
+  unsigned Solves = 0;
+  AbstractILPResult R = Regions.solve([&](const AbstractStateGraph &Sub) {
+    ++Solves;
+    CHECK(&Sub == &G);
+    return solveSchema(Sub);
+  });
+  CHECK(Solves == 1);
+  CHECK(matchesMonolithic(G, R));
+
+  AbstractStateGraph C;
+  unsigned CE = addNode(C, 0, true);
+  unsigned H1 = addNode(C, 1);
+  unsigned B1 = addNode(C, 2);
+  unsigned H2 = addNode(C, 1);
+  unsigned Call = addNode(C, 1);
+  unsigned Land = addNode(C, 1);
+  unsigned F = addNode(C, 8);
+  unsigned CX = addNode(C, 0, false, true);
+  markLoopHeader(C, H1, 5);
+  markLoopHeader(C, H2, 3);
+  C.addEdge(CE, H1);
+  C.addEdge(H1, B1);
+  C.addEdge(B1, H1, /*IsBackEdge=*/true);
+  C.addEdge(H1, H2);
+  C.addEdge(H2, Call);
+  C.addEdge(Call, F);
+  C.addEdge(Call, Land);
+  C.addEdge(F, Land);
+  C.addEdge(Land, H2, /*IsBackEdge=*/true);
+  C.addEdge(H2, CX);
+  C.CallSites.push_back({Call, Land, nullptr, F, {F}});
+
+  LoopRegionIPET CallRegions(C);
+  CHECK(CallRegions.getNumRegions() == 1);
+  CHECK(CallRegions.getNumTopNodes() == C.getNumNodes() - 1);
+}
+
+// Regions of one level are solved concurrently, each once; the result does
+// not depend on the thread count.
+static void testParallelLevel() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned Prev = E;
+  const unsigned NumLoops = 6;
+  for (unsigned K = 0; K < NumLoops; ++K) {
+    unsigned H = addNode(G, 1);
+    unsigned B = addNode(G, 2 + K);
+    unsigned L = addNode(G, 1);
+    markLoopHeader(G, H, 2 + K);
+    G.addEdge(Prev, H);
+    G.addEdge(H, B);
+    G.addEdge(B, H, /*IsBackEdge=*/true);
+    G.addEdge(H, L);
+    Prev = L;
+  }
+  unsigned X = addNode(G, 0, false, true);
+  G.addEdge(Prev, X);
+
+  LoopRegionIPET Regions(G);
+  CHECK(Regions.getNumRegions() == NumLoops);
+  CHECK(Regions.getNumLevels() == 1);
+  for (unsigned Threads : {1u, 4u}) {
+    std::atomic<unsigned> Solves{0};
+    AbstractILPResult R = Regions.solve(
+        [&](const AbstractStateGraph &Sub) {
+          ++Solves;
+          return solveSchema(Sub);
+        },
+        Threads);
+    CHECK(Solves == NumLoops + 1);
+    CHECK(matchesMonolithic(G, R));
+  }
+}
+
+// A failing region fails the whole solve with its status; a limited one
+// without an incumbent has no counts to map back.
+static void testRegionFailure() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned H = addNode(G, 1);
+  unsigned B = addNode(G, 4);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, H, 3);
+  G.addEdge(E, H);
+  G.addEdge(H, B);
+  G.addEdge(B, H, /*IsBackEdge=*/true);
+  G.addEdge(H, X);
+
+  LoopRegionIPET Regions(G);
+  CHECK(Regions.getNumRegions() == 1);
+  for (bool Limited : {false, true}) {
+    AbstractILPResult R = Regions.solve(
+        [&](const AbstractStateGraph &Sub) -> AbstractILPResult {
+          // The top-level graph is entry, summary, exit.
+          if (Sub.getNumNodes() == 3)
+            return solveSchema(Sub);
+          AbstractILPResult Failed;
+          Failed.WCET = Limited ? 20.0 : 0.0;
+          Failed.LimitReached = Limited;
+          if (!Limited)
+            Failed.Status = "Infeasible";
+          return Failed;
+        });
+    CHECK(R.Status == (Limited ? ModularIPET::NoIncumbent : "Infeasible"));
+    CHECK(R.ExecutionCounts.empty());
+  }
+}
+
+int main() {
+  testNestedLoops();
+  testExitEdges();
+  testUncontracted();
+  testParallelLevel();
+  testRegionFailure();
+
+  if (Failures == 0) {
+    std::cout << "All " << Checks << " checks passed.\n";
+    return 0;
+  }
+  std::cerr << Failures << " of " << Checks << " checks FAILED.\n";
+  return 1;
+}
@@ -13,6 +13,11 @@
 //   2. an entry function with blocks but NO return block (noreturn / infinite
 //      loop): must fall back to wiring the last block -> Exit.
 //
+// It also runs finalize() with -context-depth 1 and 2 on a hand-built call
+// graph, which needs the same MachineFunction/MachineModuleInfo pair, and the
+// FRAM cache jobs of FRAMCacheAnalysisPass on several hand-built functions,
+// serially and in parallel.
+//
 // A genuinely empty MachineFunction cannot be produced from C, so this is the
 // only place case (1) is exercised through the production fillGraphWithFunction.
 //
@@ -26,6 +31,10 @@
 //===----------------------------------------------------------------------===//
 
 #include "Graph/ProgramGraph.h"
+#include "Targets/MSP430/FRAMCacheAnalysisPass.h"
+#include "Targets/MSP430/MSP430FR5994Target.h"
+#include "Targets/MSP430/MSP430Options.h"
+#include "TimingAnalysisResults.h"
 #include "Utility/DataMemoryAccess.h"
 
 #include "llvm/CodeGen/CodeGenTargetMachineImpl.h"
@@ -51,6 +60,7 @@
 
 #include <iostream>
 #include <memory>
+#include <unordered_map>
 
 using namespace llvm;
 
@@ -193,6 +203,7 @@ struct MFFixture {
   MachineModuleInfo MMI;
   Function *F;
   std::unique_ptr<MachineFunction> MF;
+  std::vector<std::unique_ptr<MachineFunction>> MoreMFs;
 
   MFFixture()
       : M("test", Ctx), MMI(createTargetMachine()) {
@@ -204,12 +215,24 @@ struct MFFixture {
   }
 
   // Append a fresh (empty, hence non-return) MachineBasicBlock.
-  MachineBasicBlock *addBlock() {
-    auto *MBB = MF->CreateMachineBasicBlock();
-    MF->insert(MF->end(), MBB);
+  MachineBasicBlock *addBlock() { return addBlock(*MF); }
+  static MachineBasicBlock *addBlock(MachineFunction &Fn) {
+    auto *MBB = Fn.CreateMachineBasicBlock();
+    Fn.insert(Fn.end(), MBB);
     return MBB;
   }
 
+  // Another (empty) MachineFunction in the same module and MMI.
+  MachineFunction &addFunction(const Twine &Name) {
+    auto *TM = createTargetMachine();
+    auto *FT = FunctionType::get(Type::getVoidTy(Ctx), false);
+    auto *Fn = Function::Create(FT, GlobalValue::ExternalLinkage, Name, &M);
+    MoreMFs.push_back(std::make_unique<MachineFunction>(
+        *Fn, *TM, *TM->getSubtargetImpl(*Fn), MMI.getContext(),
+        /*FunctionNum=*/MoreMFs.size()));
+    return *MoreMFs.back();
+  }
+
   // A bare MachineInstr carrying the given MCID flags (e.g. MayLoad). The desc
   // must outlive the instruction (MachineInstr stores a pointer to it), so the
   // caller passes a long-lived MCInstrDesc.
@@ -394,11 +417,292 @@ static void testFramDataAccessWordsResolved() {
   CHECK(framDataAccessWords(*NoInfo, FRAMStart, Resolve) == 1u);
 }
 
+// -fram-cache-threads: the FRAM cache jobs of several functions must merge to
+// the same penalties and the same verbose log (the always-miss reports
+// included) on one thread as on many.
+static void testFRAMCacheThreadsMatchSerial() {
+  MFFixture Fx;
+  TimingAnalysisResults TAR;
+  TAR.setTarget(std::make_unique<llta::MSP430FR5994Target>());
+  TAR.setFRAMStart(0x4000);
+  GlobalVariable *Table = Fx.makeGlobal("table");
+  TAR.addDataObject({"table", 0x6000, 64});
+  const MCInstrDesc PlainDesc = {TargetOpcode::COPY, 0, 0, 0, 0, 0, 0, 0, 0,
+                                 0, 0};
+  const MCInstrDesc LoadDesc = {
+      TargetOpcode::COPY, 0, 0, 0, 0, 0, 0, 0, 0, (1ULL << MCID::MayLoad), 0};
+
+  // Functions of different sizes, each entry -> loop (with a load from the
+  // FRAM table) -> exit, laid out one after another in FRAM with 1- to 3-word
+  // instructions.
+  std::vector<MachineFunction *> MFs;
+  std::unordered_map<const MachineBasicBlock *, unsigned> Base;
+  uint64_t Addr = 0x4400;
+  for (unsigned I = 0; I < 12; ++I) {
+    MachineFunction &MF = Fx.addFunction("f" + Twine(I));
+    MachineBasicBlock *Entry = MFFixture::addBlock(MF);
+    MachineBasicBlock *Loop = MFFixture::addBlock(MF);
+    MachineBasicBlock *Exit = MFFixture::addBlock(MF);
+    Entry->addSuccessor(Loop);
+    Loop->addSuccessor(Loop);
+    Loop->addSuccessor(Exit);
+    unsigned Size = 2 + I % 5;
+    for (MachineBasicBlock *MBB : {Entry, Loop, Exit}) {
+      for (unsigned K = 0; K < Size; ++K) {
+        bool IsLoad = MBB == Loop && K == 0;
+        MachineInstr *MI =
+            MF.CreateMachineInstr(IsLoad ? LoadDesc : PlainDesc, DebugLoc());
+        if (IsLoad)
+          MI->addMemOperand(MF, MF.getMachineMemOperand(
+                                    MachinePointerInfo(Table),
+                                    MachineMemOperand::MOLoad, 2, Align(2)));
+        MBB->push_back(MI);
+        TAR.setInstructionAddress(MI, Addr);
+        Addr += 2 * (1 + (I + K) % 3);
+      }
+      Base[MBB] = 1;
+      Size = Size * 3 % 7 + 2;
+    }
+    MFs.push_back(&MF);
+  }
+
+  unsigned SavedWaitStates = FRAMWaitStates;
+  bool SavedVerbose = FRAMCacheVerbose;
+  FRAMWaitStates = 1;
+  FRAMCacheVerbose = true;
+  CacheGeometry Geo(FRAMCacheSets, FRAMCacheWays, FRAMCacheLineBytes);
+  auto run = [&](unsigned Threads, std::string &Log) {
+    TAR.setMBBLatencyMap(Base);
+    raw_string_ostream OS(Log);
+    FRAMCacheAnalysisPass::analyzeFunctions(MFs, TAR, Geo, Threads,
+                                            /*Verbose=*/true, OS);
+    OS.flush();
+    return TAR.getMBBLatencyMap();
+  };
+
+  std::string SerialLog;
+  auto Serial = run(1, SerialLog);
+  CHECK(Serial.size() == Base.size() && Serial != Base);
+  CHECK(SerialLog.find("[fram-cache] f11: +") != std::string::npos);
+  CHECK(SerialLog.find("always-miss") != std::string::npos);
+  for (unsigned Threads : {2u, 8u, 0u}) {
+    std::string Log;
+    CHECK(run(Threads, Log) == Serial);
+    CHECK(Log == SerialLog);
+  }
+  FRAMWaitStates = SavedWaitStates;
+  FRAMCacheVerbose = SavedVerbose;
+}
+
+// Append F's body the way fillGraphWithFunction lays it out: one node per
+// block at consecutive ids, the first block being the entry.
+static std::vector<unsigned> addBody(ProgramGraph &G, const Function *F,
+                                     ArrayRef<unsigned> Costs) {
+  G.FunctionNames[F] = G.intern(F->getName());
+  std::vector<unsigned> Ids;
+  for (unsigned I = 0; I < Costs.size(); ++I) {
+    Ids.push_back(G.addNode(Costs[I], Costs[I], nullptr,
+                            ("bb." + Twine(I)).str()));
+    G.NodeToFunctionMap[Ids.back()] = F;
+  }
+  G.FunctionNodeRanges[F] = {Ids.front(), Ids.back() + 1};
+  G.FunctionToEntryNodeMap[F] = Ids.front();
+  return Ids;
+}
+
+// Whether the frozen view has the edge From -> To (node ids); its back-edge
+// flag goes to *IsBack.
+static bool hasDenseEdge(const ProgramGraph &G, unsigned From, unsigned To,
+                         bool *IsBack = nullptr) {
+  unsigned I = G.getDenseIndex(From), J = G.getDenseIndex(To);
+  if (I == ProgramGraph::InvalidIndex || J == ProgramGraph::InvalidIndex)
+    return false;
+  ArrayRef<unsigned> Succs = G.getSuccessorIndices(I);
+  for (unsigned K = 0; K < Succs.size(); ++K)
+    if (Succs[K] == J) {
+      if (IsBack)
+        *IsBack = G.getSuccessorBackEdgeFlags(I)[K];
+      return true;
+    }
+  return false;
+}
+
+// Call-string context expansion through finalize(). main calls f from two
+// sites; f calls g (which has a loop) and the self-recursive r:
+//
+//   main: m0 -call f-> m1 -call f-> m2        (sites 0 and 1)
+//   f:    f0 -call g-> f1 -call r-> f2        (sites 2 and 3)
+//   g:    g0 -> g1 <-> g2, g1 -> g3           (g1 a loop header, bound 3)
+//   r:    r0 -> r1 -call r-> r2 -> r3         (site 4, recursion_bound 2)
+//
+// Depth 1 keeps only the last call site, so both f instances share one g
+// instance; depth 2 gives each its own. r stays one context-free instance.
+static void testContextExpansion(unsigned Depth) {
+  MFFixture Fx;
+  auto *FT = FunctionType::get(Type::getVoidTy(Fx.Ctx), false);
+  auto makeFunction = [&](StringRef Name) {
+    return Function::Create(FT, GlobalValue::ExternalLinkage, Name, &Fx.M);
+  };
+  const Function *Main = makeFunction("main"), *F = makeFunction("f"),
+                 *G = makeFunction("g"), *R = makeFunction("r");
+
+  ProgramGraph PG;
+  unsigned Entry = PG.addNode(0, 0, nullptr, "Entry");
+  unsigned Exit = PG.addNode(0, 0, nullptr, "Exit");
+  PG.EntryNodeId = Entry;
+  PG.HasEntryNode = true;
+  PG.StartFunction = Main;
+  auto M = addBody(PG, Main, {1, 2, 3});
+  PG.wireEntryExit(M, {M[2]}, Entry, Exit);
+  PG.addEdge(M[0], M[1]);
+  PG.addEdge(M[1], M[2]);
+  auto FB = addBody(PG, F, {4, 5, 6});
+  PG.addEdge(FB[0], FB[1]);
+  PG.addEdge(FB[1], FB[2]);
+  auto GB = addBody(PG, G, {7, 8, 9, 10});
+  PG.addEdge(GB[0], GB[1]);
+  PG.addEdge(GB[1], GB[2]);
+  PG.addEdge(GB[2], GB[1]);
+  PG.addEdge(GB[1], GB[3]);
+  PG.Nodes.at(GB[1]).IsLoop = true;
+  PG.Nodes.at(GB[1]).IsNestedLoop = true;
+  PG.Nodes.at(GB[1]).UpperLoopBound = 3;
+  PG.Nodes.at(GB[1]).BackEdgePredecessors.insert(GB[2]);
+  auto RB = addBody(PG, R, {11, 12, 13, 14});
+  PG.addEdge(RB[0], RB[1]);
+  PG.addEdge(RB[1], RB[2]);
+  PG.addEdge(RB[2], RB[3]);
+  PG.FunctionToReturnNodesMap[Main] = {M[2]};
+  PG.FunctionToReturnNodesMap[F] = {FB[2]};
+  PG.FunctionToReturnNodesMap[G] = {GB[3]};
+  PG.FunctionToReturnNodesMap[R] = {RB[3]};
+  PG.CallSites = {{M[0], F, M[1], true},
+                  {M[1], F, M[2], true},
+                  {FB[0], G, FB[1], true},
+                  {FB[1], R, FB[2], true},
+                  {RB[1], R, RB[2], true}};
+
+  PG.finalize(*Fx.MF, &Fx.MMI, /*Target=*/nullptr, {{"r", 2}}, Depth);
+  CHECK(PG.isFrozen());
+
+  // main and r context-free, two f instances, one g instance per depth.
+  CHECK(PG.ContextInstances.size() == 2 + Depth);
+  CHECK(PG.NumContextInstances == 4 + Depth);
+  // Entry, Exit, main, r and the instances; f's and g's own bodies are only
+  // the instances' templates now.
+  CHECK(PG.getNumDenseNodes() == 2 + 3 + 4 + 2 * 3 + Depth * 4);
+  for (unsigned Id : {FB[0], FB[2], GB[1]})
+    CHECK(PG.getDenseIndex(Id) == ProgramGraph::InvalidIndex);
+  CHECK(PG.getDenseIndex(RB[0]) != ProgramGraph::InvalidIndex);
+
+  // Every call edge is a ContextCallSite: 2 in main, 2 in each f instance,
+  // the recursive one in r.
+  CHECK(PG.ContextCallSites.size() == 7u);
+  auto callsFrom = [&](unsigned CallNode) {
+    std::vector<const ProgramGraph::ContextCallSite *> Sites;
+    for (const auto &CS : PG.ContextCallSites)
+      if (CS.CallNode == CallNode)
+        Sites.push_back(&CS);
+    return Sites;
+  };
+
+  std::vector<unsigned> FBases;
+  for (auto [CallNode, Landing] : {std::pair(M[0], M[1]), {M[1], M[2]}}) {
+    auto Sites = callsFrom(CallNode);
+    CHECK(Sites.size() == 1u);
+    if (Sites.size() != 1)
+      return;
+    const auto &CS = *Sites.front();
+    CHECK(CS.Callee == F && CS.LandingNode == Landing);
+    const ProgramGraph::ContextInstance *I = nullptr;
+    for (const auto &Inst : PG.ContextInstances)
+      if (Inst.Base == CS.EntryNode)
+        I = &Inst;
+    CHECK(I && I->F == F && I->First == FB[0] && I->End == FB[2] + 1);
+    CHECK(CS.ReturnNodes == std::vector<unsigned>{CS.EntryNode + 2});
+    CHECK(hasDenseEdge(PG, CallNode, CS.EntryNode));
+    CHECK(hasDenseEdge(PG, CS.EntryNode + 2, Landing));
+    FBases.push_back(CS.EntryNode);
+  }
+  CHECK(FBases.size() == 2u && FBases[0] != FBases[1]);
+  if (FBases.size() != 2)
+    return;
+
+  std::vector<unsigned> GBases;
+  for (unsigned FBase : FBases) {
+    // The f instance: the template's costs, names and intra-function edges.
+    unsigned I0 = PG.getDenseIndex(FBase);
+    CHECK(PG.getNodeIdAt(I0) == FBase);
+    CHECK(PG.getTemplateId(FBase + 1) == FB[1]);
+    CHECK(PG.getNodeFunction(FBase + 1) == F);
+    CHECK(PG.getDenseNode(I0).Name == "bb.0");
+    CHECK(PG.getDenseNode(I0).getState().MaxCycles == 4u);
+    CHECK(hasDenseEdge(PG, FBase, FBase + 1));
+    CHECK(hasDenseEdge(PG, FBase + 1, FBase + 2));
+
+    auto ToG = callsFrom(FBase);
+    CHECK(ToG.size() == 1u);
+    if (ToG.size() == 1) {
+      CHECK(ToG.front()->Callee == G && ToG.front()->LandingNode == FBase + 1);
+      CHECK(ToG.front()->ReturnNodes ==
+            std::vector<unsigned>{ToG.front()->EntryNode + 3});
+      GBases.push_back(ToG.front()->EntryNode);
+    }
+
+    // r is recursive: every context calls its one context-free instance.
+    auto ToR = callsFrom(FBase + 1);
+    CHECK(ToR.size() == 1u);
+    if (ToR.size() == 1) {
+      CHECK(ToR.front()->EntryNode == RB[0]);
+      CHECK(ToR.front()->ReturnNodes == std::vector<unsigned>{RB[3]});
+      CHECK(hasDenseEdge(PG, RB[3], FBase + 2));
+    }
+  }
+
+  // k-limiting: at depth 1 the call strings [0, 2] and [1, 2] both shorten
+  // to [2] and share g's instance.
+  CHECK(GBases.size() == 2u);
+  if (GBases.size() != 2)
+    return;
+  CHECK((GBases[0] == GBases[1]) == (Depth == 1));
+  for (unsigned GBase : GBases) {
+    bool IsBack = false;
+    CHECK(hasDenseEdge(PG, GBase + 2, GBase + 1, &IsBack) && IsBack);
+    CHECK(hasDenseEdge(PG, GBase + 1, GBase + 2, &IsBack) && !IsBack);
+    const Node &Header = PG.getDenseNode(PG.getDenseIndex(GBase + 1));
+    CHECK(Header.IsLoop && Header.IsNestedLoop);
+    CHECK(Header.UpperLoopBound == 3u);
+  }
+
+  // r's recursive call is bounded like a loop on its entry.
+  bool IsBack = false;
+  CHECK(hasDenseEdge(PG, RB[1], RB[0], &IsBack) && IsBack);
+  const Node &REntry = PG.getDenseNode(PG.getDenseIndex(RB[0]));
+  CHECK(REntry.IsLoop && REntry.UpperLoopBound == 2u);
+  CHECK(PG.getBoundedRecursionFunctions().count("r"));
+
+  // The exporters list the instance nodes with their function.
+  std::string Out;
+  raw_string_ostream OS(Out);
+  PG.exportGraph(OS, ProgramGraph::ExportFormat::JSONL);
+  OS.flush();
+  size_t NumNodeLines = 0;
+  for (size_t Pos = Out.find("\"type\":\"node\""); Pos != std::string::npos;
+       Pos = Out.find("\"type\":\"node\"", Pos + 1))
+    ++NumNodeLines;
+  CHECK(NumNodeLines == PG.getNumDenseNodes());
+  CHECK(Out.find("\"id\":" + std::to_string(GBases[1] + 1) +
+                 ",\"name\":\"bb.1\",\"function\":\"g\"") != std::string::npos);
+}
+
 int main() {
   testEmptyMachineFunction();
   testNoReturnBlockMachineFunction();
   testFramDataAccessWords();
   testFramDataAccessWordsResolved();
+  testContextExpansion(/*Depth=*/1);
+  testContextExpansion(/*Depth=*/2);
+  testFRAMCacheThreadsMatchSerial();
 
   if (Failures == 0) {
     std::cout << "All " << Checks << " checks passed.\n";
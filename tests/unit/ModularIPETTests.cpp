@@ -0,0 +1,333 @@
+//===- ModularIPETTests.cpp - unit tests for the bottom-up modular IPET ---===//
+//
+// A dependency-light standalone test binary (no GoogleTest) for
+// lib/ILP/ModularIPET.cpp: which callee instances are summarised and on which
+// call-graph level, the fallback of recursive and non-closed callees to the
+// residual graph, and the mapping of the per-module solutions back to the
+// original node ids.
+//
+// No ILP backend is needed: the test graphs are acyclic apart from recursion,
+// so each (sub-)graph handed to the SolveFn is solved exactly by a
+// longest-path pass. Graphs are built by hand with null AbstractStates, as in
+// ILPSolverTests.cpp.
+//
+// Run via CTest (`ctest -R LLTAModularIPETTests`) or `check-llta-ilp`.
+//===----------------------------------------------------------------------===//
+
+#include "Analysis/AbstractStateGraph.h"
+#include "ILP/ModularIPET.h"
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+using namespace llvm;
+
+static int Checks = 0;
+static int Failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    ++Checks;                                                                  \
+    if (!(cond)) {                                                             \
+      ++Failures;                                                              \
+      std::cerr << "FAIL [" << __FILE__ << ":" << __LINE__ << "]: " << #cond   \
+                << "\n";                                                       \
+    }                                                                          \
+  } while (0)
+
+static unsigned addNode(AbstractStateGraph &G, unsigned Cost,
+                        bool IsEntry = false, bool IsExit = false) {
+  unsigned Id = G.addNode(nullptr);
+  auto *N = G.getNode(Id);
+  N->Cost = Cost;
+  N->IsEntry = IsEntry;
+  N->IsExit = IsExit;
+  return Id;
+}
+
+/// A call from \p Call into the callee instance (\p Entry, \p Returns) that
+/// comes back to \p Landing, wired the way the ProgramGraph wires it.
+static void addCall(AbstractStateGraph &G, unsigned Call, unsigned Landing,
+                    unsigned Entry, std::vector<unsigned> Returns) {
+  G.addEdge(Call, Entry);
+  G.addEdge(Call, Landing);
+  for (unsigned R : Returns)
+    G.addEdge(R, Landing);
+  G.CallSites.push_back({Call, Landing, nullptr, Entry, std::move(Returns)});
+}
+
+/// Longest entry-to-exit path of an acyclic graph, reported like a solver
+/// result: the WCET and 0/1 node and edge counts along the path.
+static AbstractILPResult longestPath(const AbstractStateGraph &G) {
+  const unsigned N = G.getNumNodes();
+  std::vector<unsigned> InDegree(N, 0), Order;
+  for (unsigned U = 0; U < N; ++U)
+    for (const auto &E : G.getSuccessors(U))
+      ++InDegree[E.To];
+  for (unsigned U = 0; U < N; ++U)
+    if (!InDegree[U])
+      Order.push_back(U);
+  for (unsigned K = 0; K < Order.size(); ++K)
+    for (const auto &E : G.getSuccessors(Order[K]))
+      if (!--InDegree[E.To])
+        Order.push_back(E.To);
+
+  AbstractILPResult R;
+  R.WCET = 0.0;
+  if (Order.size() != N) {
+    R.Status = "Cyclic";
+    return R;
+  }
+  const double Unreached = -1.0;
+  std::vector<double> Dist(N, Unreached);
+  std::vector<unsigned> Pred(N, ~0u);
+  for (unsigned U : Order) {
+    if (G.getNodes()[U].IsEntry)
+      Dist[U] = G.getNodes()[U].Cost;
+    if (Dist[U] == Unreached)
+      continue;
+    for (const auto &E : G.getSuccessors(U))
+      if (Dist[U] + G.getNodes()[E.To].Cost > Dist[E.To]) {
+        Dist[E.To] = Dist[U] + G.getNodes()[E.To].Cost;
+        Pred[E.To] = U;
+      }
+  }
+  unsigned Best = ~0u;
+  for (unsigned U = 0; U < N; ++U)
+    if (G.getNodes()[U].IsExit && Dist[U] != Unreached &&
+        (Best == ~0u || Dist[U] > Dist[Best]))
+      Best = U;
+  if (Best == ~0u) {
+    R.Status = "Infeasible";
+    return R;
+  }
+  R.WCET = Dist[Best];
+  R.ExecutionCounts.assign(N, 0.0);
+  for (unsigned U = Best; U != ~0u; U = Pred[U]) {
+    R.ExecutionCounts[U] = 1.0;
+    if (Pred[U] != ~0u)
+      R.EdgeCounts[{Pred[U], U}] = 1.0;
+  }
+  return R;
+}
+
+static double edgeCount(const AbstractILPResult &R, unsigned From,
+                        unsigned To) {
+  auto It = R.EdgeCounts.find({From, To});
+  return It == R.EdgeCounts.end() ? 0.0 : It->second;
+}
+
+// main calls f twice; f calls the leaf g on one of its branches. Both callees
+// are summarised (g on level 0, f on level 1) and only main is left; f's and
+// g's counts come out scaled by their number of calls.
+static void testTwoLevels() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, /*IsEntry=*/true);
+  unsigned M1 = addNode(G, 2);
+  unsigned M2 = addNode(G, 1);
+  unsigned M3 = addNode(G, 1);
+  unsigned X = addNode(G, 0, /*IsEntry=*/false, /*IsExit=*/true);
+  unsigned F0 = addNode(G, 3);
+  unsigned F1 = addNode(G, 1);
+  unsigned F2 = addNode(G, 2);
+  unsigned F3 = addNode(G, 1);
+  unsigned G0 = addNode(G, 4);
+  G.addEdge(E, M1);
+  G.addEdge(M3, X);
+  G.addEdge(F0, F1);
+  G.addEdge(F0, F2);
+  G.addEdge(F2, F3);
+  addCall(G, M1, M2, F0, {F3});
+  addCall(G, M2, M3, F0, {F3});
+  addCall(G, F1, F3, G0, {G0});
+
+  ModularIPET Modular(G);
+  CHECK(Modular.getNumModules() == 2);
+  CHECK(Modular.getNumLevels() == 2);
+  CHECK(Modular.getNumResidualNodes() == 5);
+
+  // W(g) = 4, W(f) = 3 + max(1 + 4, 2) + 1 = 9, main = 2 + 9 + 1 + 9 + 1.
+  AbstractILPResult R = Modular.solve(longestPath);
+  CHECK(R.Status.empty());
+  CHECK(R.WCET == 22);
+  for (unsigned Id : {E, M1, M2, M3, X})
+    CHECK(R.getExecutionCount(Id) == 1);
+  for (unsigned Id : {F0, F1, F3, G0})
+    CHECK(R.getExecutionCount(Id) == 2);
+  CHECK(R.getExecutionCount(F2) == 0);
+  CHECK(edgeCount(R, M1, F0) == 1);
+  CHECK(edgeCount(R, M2, F0) == 1);
+  CHECK(edgeCount(R, F3, M2) == 1);
+  CHECK(edgeCount(R, F3, M3) == 1);
+  CHECK(edgeCount(R, F1, G0) == 2);
+  CHECK(edgeCount(R, G0, F3) == 2);
+  CHECK(edgeCount(R, F0, F1) == 2);
+  // The call nodes' direct edges to their landings carry no flow.
+  CHECK(edgeCount(R, M1, M2) == 0);
+  CHECK(edgeCount(R, F1, F3) == 0);
+}
+
+// A recursive callee and its callers stay in the residual graph, as does a
+// callee that can leave through a graph exit; an unrelated leaf is still
+// summarised.
+static void testFallbacks() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned M1 = addNode(G, 1);
+  unsigned M2 = addNode(G, 1);
+  unsigned M3 = addNode(G, 1);
+  unsigned M4 = addNode(G, 1);
+  unsigned X = addNode(G, 0, false, true);
+  // f calls the self-recursive r.
+  unsigned F0 = addNode(G, 1);
+  unsigned F1 = addNode(G, 1);
+  unsigned R0 = addNode(G, 1);
+  unsigned R1 = addNode(G, 1);
+  unsigned R2 = addNode(G, 1);
+  // a may abort (an edge to the exit sink).
+  unsigned A0 = addNode(G, 1);
+  unsigned A1 = addNode(G, 1);
+  // h is a leaf.
+  unsigned H0 = addNode(G, 7);
+  G.addEdge(E, M1);
+  G.addEdge(M4, X);
+  G.addEdge(R0, R1);
+  G.addEdge(R0, R2);
+  G.addEdge(A0, A1);
+  G.addEdge(A0, X);
+  addCall(G, M1, M2, F0, {F1});
+  addCall(G, F0, F1, R0, {R2});
+  addCall(G, R1, R2, R0, {R2});
+  addCall(G, M2, M3, A0, {A1});
+  addCall(G, M3, M4, H0, {H0});
+
+  ModularIPET Modular(G);
+  CHECK(Modular.getNumModules() == 1);
+  CHECK(Modular.getNumLevels() == 1);
+  CHECK(Modular.getNumResidualNodes() == G.getNumNodes() - 1);
+}
+
+// Independent leaves share level 0 and are solved concurrently; the result is
+// the same on one thread and on several, and each module is solved once.
+static void testParallelLeaves() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned Prev = E;
+  const unsigned NumLeaves = 8;
+  double Expected = 0;
+  for (unsigned K = 0; K < NumLeaves; ++K) {
+    unsigned Call = addNode(G, 1);
+    unsigned Landing = addNode(G, 1);
+    unsigned Leaf = addNode(G, 10 + K);
+    G.addEdge(Prev, Call);
+    addCall(G, Call, Landing, Leaf, {Leaf});
+    Prev = Landing;
+    Expected += 2 + 10 + K;
+  }
+  unsigned X = addNode(G, 0, false, true);
+  G.addEdge(Prev, X);
+
+  ModularIPET Modular(G);
+  CHECK(Modular.getNumModules() == NumLeaves);
+  CHECK(Modular.getNumLevels() == 1);
+
+  for (unsigned Threads : {1u, 4u}) {
+    std::atomic<unsigned> Solves{0};
+    AbstractILPResult R = Modular.solve(
+        [&](const AbstractStateGraph &Sub) {
+          ++Solves;
+          return longestPath(Sub);
+        },
+        Threads);
+    CHECK(R.Status.empty());
+    CHECK(R.WCET == Expected);
+    CHECK(Solves == NumLeaves + 1);
+  }
+}
+
+// A failing sub-ILP fails the whole solve with its status.
+static void testSubFailure() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned C = addNode(G, 1);
+  unsigned L = addNode(G, 1, false, true);
+  unsigned F = addNode(G, 5);
+  G.addEdge(E, C);
+  addCall(G, C, L, F, {F});
+
+  ModularIPET Modular(G);
+  CHECK(Modular.getNumModules() == 1);
+  AbstractILPResult R =
+      Modular.solve([&](const AbstractStateGraph &Sub) -> AbstractILPResult {
+        if (Sub.getNumNodes() == 3) {
+          AbstractILPResult Failed;
+          Failed.WCET = 0.0;
+          Failed.Status = "Infeasible";
+          return Failed;
+        }
+        return longestPath(Sub);
+      });
+  CHECK(R.Status == "Infeasible");
+  CHECK(R.ExecutionCounts.empty());
+}
+
+// A sub-ILP stopped by a solver limit contributes its dual bound: the total
+// WCET stays a sound bound, and the incumbent is the cost of the mapped-back
+// path. Without an incumbent there is no path to map back.
+static void testLimitedSubILP() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned C = addNode(G, 1);
+  unsigned L = addNode(G, 1, false, true);
+  unsigned F = addNode(G, 5);
+  G.addEdge(E, C);
+  addCall(G, C, L, F, {F});
+
+  ModularIPET Modular(G);
+  for (bool HasIncumbent : {true, false}) {
+    AbstractILPResult R =
+        Modular.solve([&](const AbstractStateGraph &Sub) -> AbstractILPResult {
+          AbstractILPResult Path = longestPath(Sub);
+          // The module is F between its entry/exit stubs; the residual graph
+          // has three nodes as well, but no node of cost 5.
+          if (Sub.getNodes()[1].Cost != 5)
+            return Path;
+          // The callee's path costs 5; pretend the solver only proved 8.
+          Path.LimitReached = true;
+          Path.Incumbent = Path.WCET;
+          Path.WCET = 8;
+          if (!HasIncumbent) {
+            Path.ExecutionCounts.clear();
+            Path.EdgeCounts.clear();
+          }
+          return Path;
+        });
+    if (!HasIncumbent) {
+      CHECK(R.Status == ModularIPET::NoIncumbent);
+      continue;
+    }
+    CHECK(R.Status.empty());
+    CHECK(R.LimitReached);
+    CHECK(R.WCET == 10);
+    CHECK(R.Incumbent == 7);
+    CHECK(R.Gap == 0.3);
+    CHECK(R.getExecutionCount(F) == 1);
+    CHECK(edgeCount(R, C, F) == 1);
+  }
+}
+
+int main() {
+  testTwoLevels();
+  testFallbacks();
+  testParallelLeaves();
+  testSubFailure();
+  testLimitedSubILP();
+
+  if (Failures == 0) {
+    std::cout << "All " << Checks << " checks passed.\n";
+    return 0;
+  }
+  std::cerr << Failures << " of " << Checks << " checks FAILED.\n";
+  return 1;
+}
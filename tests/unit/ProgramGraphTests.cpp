@@ -3,14 +3,17 @@
 // A dependency-light standalone test binary (no GoogleTest) exercising the
 // hand-constructable surface of the legacy ProgramGraph (lib/Graph/): node and
 // edge insertion, successor/predecessor symmetry, edge queries, edge removal,
-// the removeNode() isFree() invariant, and the BackEdgePredecessors bookkeeping
-// the IPET loop-bound row keys off of.
+// the removeNode() isFree() invariant, the BackEdgePredecessors bookkeeping
+// the IPET loop-bound row keys off of, the frozen CSR view consumers read, and
+// the arena/string-pool ownership of node states and names, and the graph
+// exporters.
 //
 // The MachineFunction-driven paths -- fillGraphWithFunction(), finalize()'s call
 // wiring / reachability pruning / irreducible-backedge marking -- need a live
 // MachineFunction and MachineModuleInfo, so they are covered end-to-end by the
-// tests/cfg/*.ll integration suite instead. These unit tests pin the graph data
-// structure those passes build on.
+// tests/cfg/*.ll integration suite instead; finalize()'s call-context expansion
+// is tested in MachineFunctionGraphTests.cpp. These unit tests pin the graph
+// data structure those passes build on.
 //
 // Run via CTest (`ctest -R LLTAProgramGraphTests`) or `check-llta-cfg`.
 //===----------------------------------------------------------------------===//
@@ -19,6 +22,7 @@
 
 #include <iostream>
 #include <memory>
+#include <string>
 
 using namespace llvm;
 
@@ -39,6 +43,30 @@ static unsigned addNode(ProgramGraph &G, unsigned Cycles) {
   return G.addNode(std::make_unique<MuArchState>(Cycles, Cycles), nullptr);
 }
 
+// Arena-owned states and interned names: names survive their source buffer,
+// equal names share storage, and moving the graph keeps both valid.
+static void testArenaAndInterning() {
+  ProgramGraph G;
+  std::string Scratch = "bb.0.entry";
+  unsigned A = G.addNode(3, 7, nullptr, Scratch, "dbg");
+  unsigned B = G.addNode(std::make_unique<MuArchState>(2, 2), nullptr,
+                         "bb.0.entry");
+  Scratch.assign("clobbered!");
+  CHECK(G.getNodes().at(A).Name == "bb.0.entry");
+  CHECK(G.getNodes().at(A).Name.data() == G.getNodes().at(B).Name.data());
+  CHECK(G.getNodes().at(A).getState().getLowerBoundCycles() == 3);
+  CHECK(G.getNodes().at(A).getState().getUpperBoundCycles() == 7);
+  CHECK(G.getNodes().at(A).getState().DebugInfo == "dbg");
+  CHECK(G.getNodes().at(B).getState().getUpperBoundCycles() == 2);
+
+  G.setNodeName(B, std::string("renamed"));
+  const MuArchState *StateA = &G.getNodes().at(A).getState();
+  ProgramGraph Moved(std::move(G));
+  CHECK(&Moved.getNodes().at(A).getState() == StateA);
+  CHECK(Moved.getNodes().at(B).Name == "renamed");
+  CHECK(Moved.intern("renamed").data() == Moved.getNodes().at(B).Name.data());
+}
+
 // Node/edge insertion and successor/predecessor symmetry.
 static void testNodesAndEdges() {
   ProgramGraph G;
@@ -111,6 +139,53 @@ static void testBackEdgeBookkeeping() {
   CHECK(G.Nodes.at(Latch).BackEdgePredecessors.count(Hdr) == 0);
 }
 
+// freeze() builds the dense CSR view: ascending-id dense indices, per-source
+// contiguous out-edges, sorted in-edges with their edge ids, back-edge flags,
+// and a builder mutation thaws it.
+static void testFreeze() {
+  ProgramGraph G;
+  unsigned A = addNode(G, 1);
+  unsigned Gap = addNode(G, 0);
+  unsigned Hdr = addNode(G, 2);
+  unsigned Latch = addNode(G, 3);
+  unsigned X = addNode(G, 4);
+  G.removeNode(Gap); // ids stay sparse; dense indices must not
+  G.addEdge(A, Hdr);
+  G.addEdge(Hdr, Latch);
+  G.addEdge(Latch, Hdr);
+  G.addEdge(Hdr, X);
+  G.Nodes.at(Hdr).BackEdgePredecessors.insert(Latch);
+  CHECK(!G.isFrozen());
+
+  G.freeze();
+  CHECK(G.isFrozen());
+  CHECK(G.getNumDenseNodes() == 4);
+  CHECK(G.getNumDenseEdges() == 4);
+  CHECK(G.getDenseIndex(Gap) == ProgramGraph::InvalidIndex);
+  unsigned IA = G.getDenseIndex(A), IH = G.getDenseIndex(Hdr),
+           IL = G.getDenseIndex(Latch), IX = G.getDenseIndex(X);
+  CHECK(IA == 0 && IH == 1 && IL == 2 && IX == 3);
+  CHECK(G.getNodeIdAt(IH) == Hdr);
+  CHECK(G.getDenseNode(IL).getState().getUpperBoundCycles() == 3);
+
+  ArrayRef<unsigned> HSucc = G.getSuccessorIndices(IH);
+  CHECK(HSucc.size() == 2 && HSucc[0] == IL && HSucc[1] == IX);
+  ArrayRef<unsigned> HPred = G.getPredecessorIndices(IH);
+  CHECK(HPred.size() == 2 && HPred[0] == IA && HPred[1] == IL);
+  CHECK(G.getSuccessorIndices(IX).empty());
+  CHECK(G.getPredecessorIndices(IA).empty());
+
+  // Out-edges of a node are contiguous; in-edges map back to the same ids.
+  unsigned LatchEdge = G.getSuccessorEdgeBegin(IL);
+  CHECK(G.getEdgeSource(LatchEdge) == IL && G.getEdgeTarget(LatchEdge) == IH);
+  CHECK(G.isBackEdge(LatchEdge));
+  CHECK(!G.isBackEdge(G.getSuccessorEdgeBegin(IA)));
+  CHECK(G.getPredecessorEdges(IH)[1] == LatchEdge);
+
+  G.addEdge(A, X);
+  CHECK(!G.isFrozen());
+}
+
 // wireEntryExit() is the pure helper that connects an entry function's synthetic
 // Entry/Exit nodes. These cases exercise the two shapes that are NOT reachable
 // through the C->ELF toolchain (they need a live MachineFunction), so the helper
@@ -159,14 +234,77 @@ static void testWireEntryExitMultipleReturns() {
   CHECK(!G.hasEdge(B0, Exit)); // non-return block is not wired to exit
 }
 
+// Graph export: each format streams every node and edge, clusters runs of
+// same-function nodes, and marks back edges.
+static void testExport() {
+  ProgramGraph G;
+  const Function *F = reinterpret_cast<const Function *>(0x1);
+  G.FunctionNames[F] = G.intern("f<int>");
+  unsigned Entry = G.addNode(0, 0, nullptr, "Entry");
+  unsigned H = G.addNode(2, 3, nullptr, "bb.0");
+  unsigned B = G.addNode(5, 5, nullptr, "bb.1");
+  G.NodeToFunctionMap[H] = F;
+  G.NodeToFunctionMap[B] = F;
+  G.addEdge(Entry, H);
+  G.addEdge(H, B);
+  G.addEdge(B, H);
+  Node &Header = G.Nodes.at(H);
+  Header.IsLoop = true;
+  Header.UpperLoopBound = 10;
+  Header.BackEdgePredecessors.insert(B);
+  G.freeze();
+
+  auto exportTo = [&](ProgramGraph::ExportFormat Format) {
+    std::string Out;
+    raw_string_ostream OS(Out);
+    G.exportGraph(OS, Format);
+    OS.flush();
+    return Out;
+  };
+  auto countOf = [](const std::string &S, const std::string &Needle) {
+    size_t N = 0;
+    for (size_t Pos = S.find(Needle); Pos != std::string::npos;
+         Pos = S.find(Needle, Pos + 1))
+      ++N;
+    return N;
+  };
+
+  std::string Dot = exportTo(ProgramGraph::ExportFormat::DOT);
+  CHECK(countOf(Dot, "subgraph cluster_") == 1);
+  CHECK(Dot.find("label=\"f<int>\"") != std::string::npos);
+  CHECK(countOf(Dot, " -> ") == 3);
+
+  std::string GraphML = exportTo(ProgramGraph::ExportFormat::GraphML);
+  CHECK(countOf(GraphML, "<node ") == 3);
+  CHECK(countOf(GraphML, "<edge ") == 3);
+  CHECK(GraphML.find("f&lt;int&gt;") != std::string::npos);
+  CHECK(countOf(GraphML, ">true</data></edge>") == 1);
+
+  std::string JSONL = exportTo(ProgramGraph::ExportFormat::JSONL);
+  CHECK(countOf(JSONL, "\n") == 6);
+  CHECK(countOf(JSONL, "\"type\":\"node\"") == 3);
+  CHECK(countOf(JSONL, "\"back_edge\":true") == 1);
+  CHECK(JSONL.find("\"loop_bound\":10") != std::string::npos);
+
+  CHECK(ProgramGraph::getExportFormatForPath("g.graphml.zst") ==
+        ProgramGraph::ExportFormat::GraphML);
+  CHECK(ProgramGraph::getExportFormatForPath("g.jsonl") ==
+        ProgramGraph::ExportFormat::JSONL);
+  CHECK(ProgramGraph::getExportFormatForPath("g.dot") ==
+        ProgramGraph::ExportFormat::DOT);
+}
+
 int main() {
   testNodesAndEdges();
+  testArenaAndInterning();
   testRemoval();
   testSelfLoop();
   testBackEdgeBookkeeping();
+  testFreeze();
   testWireEntryExitEmpty();
   testWireEntryExitNoReturn();
   testWireEntryExitMultipleReturns();
+  testExport();
 
   if (Failures == 0) {
     std::cout << "All " << Checks << " checks passed.\n";
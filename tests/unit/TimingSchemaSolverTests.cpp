@@ -0,0 +1,316 @@
+//===- TimingSchemaSolverTests.cpp - unit tests for the timing schema -----===//
+//
+// A dependency-light standalone test binary (no GoogleTest) for
+// lib/ILP/TimingSchemaSolver.cpp: the structural WCET over the loop-nesting
+// forest (loop bounds, nesting, multi-level exits, call sites summarised
+// through ModularIPET), its counts, the shapes it declines, and the fallback
+// and cross-check against a second solver.
+//
+// No ILP backend is needed: the expected values are derived by hand from the
+// IPET semantics (a loop of bound B runs its header B times and its back edge
+// B - 1 times), and the fallback is a stub. ILPSolverTests.cpp cross-checks
+// the schema against HiGHS. Graphs are built by hand with null AbstractStates.
+//
+// Run via CTest (`ctest -R LLTATimingSchemaSolverTests`) or `check-llta-ilp`.
+//===----------------------------------------------------------------------===//
+
+#include "Analysis/AbstractStateGraph.h"
+#include "ILP/TimingSchemaSolver.h"
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+
+static int Checks = 0;
+static int Failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    ++Checks;                                                                  \
+    if (!(cond)) {                                                             \
+      ++Failures;                                                              \
+      std::cerr << "FAIL [" << __FILE__ << ":" << __LINE__ << "]: " << #cond   \
+                << "\n";                                                       \
+    }                                                                          \
+  } while (0)
+
+static unsigned addNode(AbstractStateGraph &G, unsigned Cost,
+                        bool IsEntry = false, bool IsExit = false) {
+  unsigned Id = G.addNode(nullptr);
+  auto *N = G.getNode(Id);
+  N->Cost = Cost;
+  N->IsEntry = IsEntry;
+  N->IsExit = IsExit;
+  return Id;
+}
+
+static void markLoopHeader(AbstractStateGraph &G, unsigned Id, unsigned Bound) {
+  G.getNode(Id)->IsLoopHeader = true;
+  G.getNode(Id)->UpperLoopBound = Bound;
+}
+
+static double edgeCount(const AbstractILPResult &R, unsigned From,
+                        unsigned To) {
+  auto It = R.EdgeCounts.find({From, To});
+  return It == R.EdgeCounts.end() ? 0.0 : It->second;
+}
+
+/// Stands in for the ILP: returns a fixed WCET and counts its calls.
+class StubSolver : public AbstractILPSolver {
+public:
+  explicit StubSolver(double WCET, unsigned &Calls)
+      : WCET(WCET), Calls(Calls) {}
+  AbstractILPResult solveWCET(const AbstractStateGraph &) override {
+    ++Calls;
+    AbstractILPResult R;
+    R.WCET = WCET;
+    return R;
+  }
+
+private:
+  double WCET;
+  unsigned &Calls;
+};
+
+static AbstractILPResult solveSchema(const AbstractStateGraph &G) {
+  TimingSchemaSolver S(nullptr);
+  return S.solveWCET(G);
+}
+
+// Two nested loops (outer bound 4, inner bound 3): the inner loop is entered
+// once per outer iteration.
+static void testNestedLoops() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 2);
+  unsigned IH = addNode(G, 3);
+  unsigned IB = addNode(G, 5);
+  unsigned OL = addNode(G, 7);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 4);
+  markLoopHeader(G, IH, 3);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, IB);
+  G.addEdge(IB, IH, /*IsBackEdge=*/true);
+  G.addEdge(IH, OL);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+
+  auto R = solveSchema(G);
+  CHECK(R.Status.empty());
+  CHECK(R.SolverConfig == TimingSchemaSolver::ConfigName);
+  CHECK(R.WCET == 86); // 2*4 + 3*9 + 5*6 + 7*3
+  CHECK(R.getExecutionCount(E) == 1);
+  CHECK(R.getExecutionCount(OH) == 4);
+  CHECK(R.getExecutionCount(IH) == 9);
+  CHECK(R.getExecutionCount(IB) == 6);
+  CHECK(R.getExecutionCount(OL) == 3);
+  CHECK(R.getExecutionCount(X) == 1);
+  CHECK(edgeCount(R, IB, IH) == 6);
+  CHECK(edgeCount(R, OL, OH) == 3);
+  CHECK(edgeCount(R, OH, IH) == 3);
+  CHECK(edgeCount(R, OH, X) == 1);
+}
+
+// The longest arm of a branch inside a loop is taken on every iteration, and
+// a break out of both loops from the inner body is a valid final pass.
+static void testBranchesAndBreak() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 1);
+  unsigned IH = addNode(G, 1);
+  unsigned Cheap = addNode(G, 2);
+  unsigned Dear = addNode(G, 9);
+  unsigned IL = addNode(G, 1);
+  unsigned OL = addNode(G, 1);
+  unsigned Brk = addNode(G, 50);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 2);
+  markLoopHeader(G, IH, 5);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, Cheap);
+  G.addEdge(IH, Dear);
+  G.addEdge(Cheap, IL);
+  G.addEdge(Dear, IL);
+  G.addEdge(IL, IH, /*IsBackEdge=*/true);
+  G.addEdge(IL, Brk); // leaves both loops
+  G.addEdge(IH, OL);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+  G.addEdge(Brk, X);
+
+  // Inner iteration: 1 + 9 + 1 = 11. Inner entry leaving to OL: 4*11 + 1,
+  // leaving through the break: 4*11 + 11. One outer iteration through OL
+  // (1 + 45 + 1), then the final pass breaks out (1 + 55 + 50).
+  auto R = solveSchema(G);
+  CHECK(R.Status.empty());
+  CHECK(R.WCET == 47 + 106);
+  CHECK(R.getExecutionCount(Dear) == 9); // 4 + 4 iterations, the break pass
+  CHECK(R.getExecutionCount(Cheap) == 0);
+  CHECK(R.getExecutionCount(Brk) == 1);
+  CHECK(R.getExecutionCount(OL) == 1);
+  CHECK(R.getExecutionCount(IH) == 10);
+  CHECK(edgeCount(R, OH, X) == 0);
+  CHECK(edgeCount(R, IL, Brk) == 1);
+}
+
+// Call sites are summarised first: f (with its own loop) is called from a
+// loop in main, and every call is charged f's WCET.
+static void testCallsInLoop() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned MH = addNode(G, 1);
+  unsigned MC = addNode(G, 1);
+  unsigned ML = addNode(G, 2);
+  unsigned X = addNode(G, 0, false, true);
+  unsigned F0 = addNode(G, 1);
+  unsigned FH = addNode(G, 2);
+  unsigned FB = addNode(G, 3);
+  unsigned FR = addNode(G, 1);
+  markLoopHeader(G, MH, 3);
+  markLoopHeader(G, FH, 4);
+  G.addEdge(E, MH);
+  G.addEdge(MH, MC);
+  G.addEdge(MC, F0);
+  G.addEdge(MC, ML);
+  G.addEdge(FR, ML);
+  G.addEdge(ML, MH, /*IsBackEdge=*/true);
+  G.addEdge(MH, X);
+  G.addEdge(F0, FH);
+  G.addEdge(FH, FB);
+  G.addEdge(FB, FH, /*IsBackEdge=*/true);
+  G.addEdge(FH, FR);
+  G.CallSites.push_back({MC, ML, nullptr, F0, {FR}});
+
+  // f = 1 + 2*4 + 3*3 + 1 = 19; main = 1*3 + 2*(1 + 19 + 2).
+  auto R = solveSchema(G);
+  CHECK(R.Status.empty());
+  CHECK(R.SolverConfig == TimingSchemaSolver::ConfigName);
+  CHECK(R.WCET == 47);
+  CHECK(R.getExecutionCount(F0) == 2);
+  CHECK(R.getExecutionCount(FB) == 6);
+  CHECK(edgeCount(R, MC, F0) == 2);
+  CHECK(edgeCount(R, FR, ML) == 2);
+}
+
+// Shapes the schema declines: an irreducible cycle, an unbounded loop, a
+// recursive call. Each goes to the fallback; without one the status says so.
+static void testFallback() {
+  std::vector<AbstractStateGraph> Graphs(3);
+  {
+    AbstractStateGraph &G = Graphs[0];
+    unsigned E = addNode(G, 0, true);
+    unsigned H = addNode(G, 1);
+    unsigned B = addNode(G, 1);
+    unsigned X = addNode(G, 0, false, true);
+    markLoopHeader(G, H, 5);
+    G.addEdge(E, H);
+    G.addEdge(E, B); // second entry into the cycle
+    G.addEdge(H, B);
+    G.addEdge(B, H, /*IsBackEdge=*/true);
+    G.addEdge(H, X);
+  }
+  {
+    AbstractStateGraph &G = Graphs[1];
+    unsigned E = addNode(G, 0, true);
+    unsigned H = addNode(G, 1);
+    unsigned B = addNode(G, 1);
+    unsigned X = addNode(G, 0, false, true);
+    markLoopHeader(G, H, 0);
+    G.addEdge(E, H);
+    G.addEdge(H, B);
+    G.addEdge(B, H, /*IsBackEdge=*/true);
+    G.addEdge(H, X);
+  }
+  {
+    AbstractStateGraph &G = Graphs[2];
+    unsigned E = addNode(G, 0, true);
+    unsigned C = addNode(G, 1);
+    unsigned L = addNode(G, 1);
+    unsigned X = addNode(G, 0, false, true);
+    unsigned R0 = addNode(G, 1);
+    unsigned RC = addNode(G, 1);
+    unsigned RL = addNode(G, 1);
+    G.addEdge(E, C);
+    G.addEdge(C, R0);
+    G.addEdge(C, L);
+    G.addEdge(L, X);
+    G.addEdge(R0, RC);
+    G.addEdge(R0, RL);
+    G.addEdge(RC, R0);
+    G.addEdge(RC, RL);
+    G.addEdge(RL, L);
+    G.addEdge(RL, RL);
+    G.CallSites.push_back({C, L, nullptr, R0, {RL}});
+    G.CallSites.push_back({RC, RL, nullptr, R0, {RL}});
+  }
+
+  for (const AbstractStateGraph &G : Graphs) {
+    AbstractILPResult Direct;
+    CHECK(!TimingSchemaSolver::solveStructured(G, Direct));
+    CHECK(solveSchema(G).Status == TimingSchemaSolver::NotStructured);
+
+    unsigned Calls = 0;
+    TimingSchemaSolver S(std::make_unique<StubSolver>(42, Calls));
+    auto R = S.solveWCET(G);
+    CHECK(R.WCET == 42);
+    CHECK(R.SolverConfig.empty());
+    CHECK(Calls == 1);
+    CHECK(S.getNumFallbacks() == 1);
+  }
+}
+
+// With a cross-check the fallback solves every structured graph too; a
+// disagreement is counted and the fallback's result wins.
+static void testCrossCheck() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned H = addNode(G, 3);
+  unsigned B = addNode(G, 5);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, H, 10);
+  G.addEdge(E, H);
+  G.addEdge(H, B);
+  G.addEdge(B, H, /*IsBackEdge=*/true);
+  G.addEdge(H, X);
+
+  unsigned Calls = 0;
+  TimingSchemaSolver Agree(std::make_unique<StubSolver>(75, Calls),
+                           /*CrossCheck=*/true);
+  auto R = Agree.solveWCET(G);
+  CHECK(R.WCET == 75);
+  CHECK(R.SolverConfig == TimingSchemaSolver::ConfigName);
+  CHECK(Agree.getNumCrossChecks() == 1);
+  CHECK(Agree.getNumMismatches() == 0);
+
+  TimingSchemaSolver Disagree(std::make_unique<StubSolver>(80, Calls),
+                              /*CrossCheck=*/true);
+  R = Disagree.solveWCET(G);
+  CHECK(R.WCET == 80);
+  CHECK(R.SolverConfig.empty());
+  CHECK(Disagree.getNumMismatches() == 1);
+  CHECK(Calls == 2);
+
+  TimingSchemaSolver Unchecked(std::make_unique<StubSolver>(80, Calls));
+  CHECK(Unchecked.solveWCET(G).WCET == 75);
+  CHECK(Calls == 2);
+}
+
+int main() {
+  testNestedLoops();
+  testBranchesAndBreak();
+  testCallsInLoop();
+  testFallback();
+  testCrossCheck();
+
+  if (Failures == 0) {
+    std::cout << "All " << Checks << " checks passed.\n";
+    return 0;
+  }
+  std::cerr << Failures << " of " << Checks << " checks FAILED.\n";
+  return 1;
+}
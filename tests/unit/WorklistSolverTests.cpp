@@ -0,0 +1,412 @@
+//===- WorklistSolverTests.cpp - unit tests for the worklist scheduling ---===//
+//
+// A dependency-light standalone test binary (no GoogleTest) for the node
+// scheduling of lib/Analysis/WorklistSolver.cpp: the weak topological order
+// (components contiguous and headed, nested loops before the rest of their
+// parent, loops before their exits) and a fixpoint over a ProgramGraph under
+// both orders, which must agree on the states while WTO visits fewer nodes.
+//
+// The analysis is a toy max-propagation: nodes carry no MBB, so the transfer
+// is the identity and a node's state is the join of its predecessors'. The
+// same propagation as a value domain runs on the statically dispatched
+// llta::WorklistSolver (include/Solver/WorklistSolver.h) over a toy graph
+// with GraphTraits, and must match the virtual engine visit for visit. Both
+// engines fill a FixpointStats record, which round-trips through its JSON.
+//
+// Run via CTest (`ctest -R LLTAWorklistSolverTests`) or `check-llta-cfg`.
+//===----------------------------------------------------------------------===//
+
+#include "Analysis/AbstractStateGraph.h"
+#include "Analysis/FixpointStats.h"
+#include "Analysis/WorklistSolver.h"
+#include "Graph/ProgramGraph.h"
+#include "Solver/WorklistSolver.h"
+
+#include "llvm/ADT/GraphTraits.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static int Checks = 0;
+static int Failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    ++Checks;                                                                  \
+    if (!(cond)) {                                                             \
+      ++Failures;                                                              \
+      std::cerr << "FAIL [" << __FILE__ << ":" << __LINE__ << "]: " << #cond   \
+                << "\n";                                                       \
+    }                                                                          \
+  } while (0)
+
+namespace {
+
+struct MaxState : AbstractState {
+  int Value;
+  explicit MaxState(int Value) : Value(Value) {}
+  std::unique_ptr<AbstractState> clone() const override {
+    return std::make_unique<MaxState>(Value);
+  }
+  bool equals(const AbstractState *Other) const override {
+    return Value == static_cast<const MaxState *>(Other)->Value;
+  }
+  bool join(const AbstractState *Other) override {
+    int Old = Value;
+    Value = std::max(Value, static_cast<const MaxState *>(Other)->Value);
+    return Value != Old;
+  }
+  unsigned getSize() const override { return Value; }
+  std::string toString() const override { return std::to_string(Value); }
+};
+
+/// Every node starts at 0; a node without predecessors (the entry) is
+/// recomputed from a fresh initial state, which is 5 once the graph is
+/// attached.
+struct MaxAnalysis : AbstractAnalysable {
+  unsigned Remaining;
+  explicit MaxAnalysis(unsigned NumNodes) : Remaining(NumNodes) {}
+  std::unique_ptr<AbstractState> getInitialState() override {
+    if (Remaining) {
+      --Remaining;
+      return std::make_unique<MaxState>(0);
+    }
+    return std::make_unique<MaxState>(5);
+  }
+  unsigned process(AbstractState *, const MachineInstr *) override {
+    return 0;
+  }
+};
+
+/// A block of a toy CFG for llta::WorklistSolver: it raises the state to at
+/// least Gen and costs Gen.
+struct ToyBlock {
+  int Gen = 0;
+  std::vector<const ToyBlock *> Succs;
+};
+
+struct ToyGraph {
+  std::deque<ToyBlock> Storage;
+  std::vector<const ToyBlock *> Blocks; // Blocks.front() is the entry
+
+  ToyBlock *add(int Gen = 0) {
+    Storage.emplace_back();
+    Storage.back().Gen = Gen;
+    Blocks.push_back(&Storage.back());
+    return &Storage.back();
+  }
+};
+
+/// MaxAnalysis as a value domain.
+struct MaxDomain {
+  using StateType = int;
+  unsigned Transfers = 0;
+  int getInitialState() const { return 0; }
+  bool join(int &Into, int Other) const {
+    int Old = Into;
+    Into = std::max(Into, Other);
+    return Into != Old;
+  }
+  bool equals(int A, int B) const { return A == B; }
+  unsigned size(int S) const { return S; }
+  unsigned transfer(int &S, const ToyBlock *B) {
+    ++Transfers;
+    S = std::max(S, B->Gen);
+    return B->Gen;
+  }
+};
+
+} // namespace
+
+namespace llvm {
+template <> struct GraphTraits<const ToyGraph *> {
+  using NodeRef = const ToyBlock *;
+  using ChildIteratorType = std::vector<const ToyBlock *>::const_iterator;
+  using nodes_iterator = std::vector<const ToyBlock *>::const_iterator;
+  static NodeRef getEntryNode(const ToyGraph *G) { return G->Blocks.front(); }
+  static ChildIteratorType child_begin(NodeRef N) { return N->Succs.begin(); }
+  static ChildIteratorType child_end(NodeRef N) { return N->Succs.end(); }
+  static nodes_iterator nodes_begin(const ToyGraph *G) {
+    return G->Blocks.begin();
+  }
+  static nodes_iterator nodes_end(const ToyGraph *G) { return G->Blocks.end(); }
+};
+} // namespace llvm
+
+static unsigned addNode(AbstractStateGraph &G, bool IsEntry = false) {
+  unsigned Id = G.addNode(nullptr);
+  G.getNode(Id)->IsEntry = IsEntry;
+  return Id;
+}
+
+static unsigned positionOf(const std::vector<unsigned> &Order, unsigned V) {
+  return std::find(Order.begin(), Order.end(), V) - Order.begin();
+}
+
+// Ids are chosen so that a plain depth-first order would reach the exit and
+// the outer latch before the inner loop: E=0, X=1, OL=2, IB=3, IH=4, OH=5.
+static void testNestedLoopOrder() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, true);
+  unsigned X = addNode(G);
+  unsigned OL = addNode(G);
+  unsigned IB = addNode(G);
+  unsigned IH = addNode(G);
+  unsigned OH = addNode(G);
+  G.addEdge(E, OH);
+  G.addEdge(OH, X);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, OL);
+  G.addEdge(IH, IB);
+  G.addEdge(IB, IH, /*IsBackEdge=*/true);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+
+  auto Order = WorklistSolver::getWeakTopologicalOrder(G);
+  CHECK((Order == std::vector<unsigned>{E, OH, IH, IB, OL, X}));
+}
+
+// An irreducible cycle is one component headed by the node the search
+// enters first; unreachable nodes still get a position in topological order.
+static void testIrreducibleAndUnreachable() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, true);
+  unsigned A = addNode(G);
+  unsigned B = addNode(G);
+  unsigned X = addNode(G);
+  unsigned U = addNode(G);
+  G.addEdge(E, A);
+  G.addEdge(E, B);
+  G.addEdge(A, B);
+  G.addEdge(B, A);
+  G.addEdge(B, X);
+  G.addEdge(U, X);
+
+  auto Order = WorklistSolver::getWeakTopologicalOrder(G);
+  CHECK(Order.size() == G.getNumNodes());
+  std::vector<unsigned> Sorted(Order);
+  std::sort(Sorted.begin(), Sorted.end());
+  CHECK((Sorted == std::vector<unsigned>{E, A, B, X, U}));
+  unsigned PA = positionOf(Order, A);
+  CHECK(positionOf(Order, E) < PA);
+  CHECK(PA + 1 < Order.size() && Order[PA + 1] == B);
+  CHECK(positionOf(Order, B) < positionOf(Order, X));
+  CHECK(positionOf(Order, U) < positionOf(Order, X));
+}
+
+/// The nested loop of testNestedLoopOrder as a frozen ProgramGraph.
+static ProgramGraph buildNestedLoopPG() {
+  ProgramGraph PG;
+  std::vector<unsigned> Id;
+  for (unsigned K = 0; K < 6; ++K)
+    Id.push_back(PG.addNode(std::make_unique<MuArchState>(1, 1), nullptr));
+  const unsigned E = Id[0], X = Id[1], OL = Id[2], IB = Id[3], IH = Id[4],
+                 OH = Id[5];
+  PG.addEdge(E, OH);
+  PG.addEdge(OH, X);
+  PG.addEdge(OH, IH);
+  PG.addEdge(IH, OL);
+  PG.addEdge(IH, IB);
+  PG.addEdge(IB, IH);
+  PG.addEdge(OL, OH);
+  PG.Nodes.at(IH).BackEdgePredecessors.insert(IB);
+  PG.Nodes.at(IH).UpperLoopBound = 3;
+  PG.Nodes.at(OH).BackEdgePredecessors.insert(OL);
+  PG.Nodes.at(OH).UpperLoopBound = 4;
+  PG.freeze();
+  return PG;
+}
+
+// Both orders reach the same fixpoint; FIFO (node id order) processes the
+// loop bodies before the entry's value has reached them and revisits them,
+// WTO takes every loop once plus one check of its header.
+static void testVisitCounts() {
+  ProgramGraph PG = buildNestedLoopPG();
+  unsigned Visits[2];
+  for (auto O : {WorklistSolver::Order::FIFO, WorklistSolver::Order::WTO}) {
+    MaxAnalysis Analysis(PG.getNumDenseNodes());
+    AbstractStateGraph ASG;
+    WorklistSolver Solver(Analysis, ASG);
+    Solver.setOrder(O);
+    CHECK(Solver.getOrder() == O);
+    Solver.run(PG);
+    for (const auto &N : ASG.getNodes())
+      CHECK(static_cast<const MaxState *>(N.State.get())->Value == 5);
+    CHECK(Solver.getNumUpdates() == PG.getNumDenseNodes());
+    Visits[O == WorklistSolver::Order::WTO] = Solver.getNumVisits();
+  }
+  CHECK(Visits[0] == 12);
+  CHECK(Visits[1] == 8);
+}
+
+// The template engine on the nested loop of buildNestedLoopPG, in the same
+// block order. The entry raises the state to 1 and the inner body to 4, so
+// the outer loop has to be taken twice: FIFO does so by alternating between
+// the loops, WTO stabilises the inner loop first. An unreachable block is
+// never transferred, and a rerun starts from scratch.
+static void testStaticEngine() {
+  ToyGraph G;
+  ToyBlock *E = G.add(1);
+  ToyBlock *X = G.add();
+  ToyBlock *OL = G.add();
+  ToyBlock *IB = G.add(4);
+  ToyBlock *IH = G.add();
+  ToyBlock *OH = G.add();
+  ToyBlock *U = G.add(9);
+  E->Succs = {OH};
+  OH->Succs = {X, IH};
+  IH->Succs = {OL, IB, IB}; // a duplicate edge is one edge
+  IB->Succs = {IH};
+  OL->Succs = {OH};
+  U->Succs = {X};
+
+  unsigned Visits[2];
+  for (auto O : {WorklistSolver::Order::FIFO, WorklistSolver::Order::WTO}) {
+    MaxDomain D;
+    llta::WorklistSolver<MaxDomain, const ToyGraph *> Solver(D);
+    Solver.setOrder(O);
+    Solver.solve(&G);
+    CHECK(Solver.getNumBlocks() == 7);
+    CHECK(Solver.getState(E) == 1);
+    for (const ToyBlock *B : {X, OL, IB, IH, OH})
+      CHECK(Solver.getState(B) == 4);
+    CHECK(Solver.getState(U) == 0);
+    CHECK(Solver.getCost(U) == 0);
+    CHECK(Solver.getCost(IB) == 4);
+    CHECK(Solver.getInState(OH) == 4);
+    CHECK(D.Transfers == Solver.getNumVisits());
+    Visits[O == WorklistSolver::Order::WTO] = Solver.getNumVisits();
+
+    Solver.solve(&G);
+    CHECK(Solver.getNumVisits() == Visits[O == WorklistSolver::Order::WTO]);
+  }
+  CHECK(Visits[0] == 13);
+  CHECK(Visits[1] == 10);
+}
+
+// The counters of both engines, with and without a record attached, and the
+// JSON report.
+static void testFixpointStats() {
+  ProgramGraph PG = buildNestedLoopPG();
+  MaxAnalysis Analysis(PG.getNumDenseNodes());
+  AbstractStateGraph ASG;
+  WorklistSolver Solver(Analysis, ASG);
+  FixpointStats Virtual;
+  Virtual.Analysis = "max";
+  Solver.setStats(&Virtual);
+  Solver.run(PG);
+  CHECK(Virtual.Order == "fifo");
+  CHECK(Virtual.Nodes == 6);
+  CHECK(Virtual.Visits == 12);
+  CHECK(Virtual.Updates == 6);
+  CHECK(Virtual.Transfers == 0); // the nodes carry no blocks
+  CHECK(Virtual.Clones == Solver.getNumClones());
+  CHECK(Virtual.Joins == Solver.getNumJoins());
+  CHECK(Virtual.PeakStateSize == 5);
+  CHECK(Virtual.getAverageStateSize() == 5.0);
+  CHECK(Virtual.NodeNames.size() == 6);
+  unsigned Sum = 0;
+  for (unsigned V : Virtual.NodeVisits)
+    Sum += V;
+  CHECK(Sum == 12);
+
+  // The toy graph of testStaticEngine under FIFO: every block but the entry
+  // starts from a clone, the two-predecessor blocks join once per visit.
+  ToyGraph G;
+  ToyBlock *E = G.add(1);
+  ToyBlock *X = G.add();
+  ToyBlock *OL = G.add();
+  ToyBlock *IB = G.add(4);
+  ToyBlock *IH = G.add();
+  ToyBlock *OH = G.add();
+  ToyBlock *U = G.add(9);
+  E->Succs = {OH};
+  OH->Succs = {X, IH};
+  IH->Succs = {OL, IB};
+  IB->Succs = {IH};
+  OL->Succs = {OH};
+  U->Succs = {X};
+  MaxDomain D;
+  llta::WorklistSolver<MaxDomain, const ToyGraph *> Static(D);
+  Static.solve(&G);
+  CHECK(Static.getNumClones() == 12);
+  CHECK(Static.getNumJoins() == 8);
+  FixpointStats S;
+  S.Analysis = "max";
+  S.Function = "toy";
+  S.NodeNames = {"E", "X", "OL", "IB", "IH", "OH", "U"};
+  Static.setStats(&S);
+  Static.solve(&G);
+  CHECK(S.Visits == 13 && S.Transfers == 13);
+  CHECK(S.Updates == 10);
+  CHECK(S.Clones == 12 && S.Joins == 8);
+  CHECK(S.PeakStateSize == 4);
+  CHECK(S.getAverageStateSize() == 2.5);
+  auto Most = S.getMostVisited();
+  CHECK((Most == std::vector<std::pair<unsigned, unsigned>>{
+             {4, 3}, {5, 3}, {1, 2}, {2, 2}, {3, 2}}));
+  CHECK(S.getMostVisited(1).size() == 1);
+
+  SmallString<128> Path;
+  CHECK(!sys::fs::createTemporaryFile("fixpoint-stats", "json", Path));
+  CHECK(!errorToBool(writeFixpointStats(Path, {Virtual, S})));
+  auto Buffer = MemoryBuffer::getFile(Path);
+  CHECK(bool(Buffer));
+  if (Buffer) {
+    Expected<json::Value> Root = json::parse((*Buffer)->getBuffer());
+    CHECK(bool(Root));
+    const json::Object *O = Root ? Root->getAsObject() : nullptr;
+    CHECK(O);
+    const json::Array *Runs = O ? O->getArray("runs") : nullptr;
+    if (O) {
+      auto Version = O->getInteger("version");
+      CHECK(Version && *Version == 1);
+    }
+    CHECK(Runs && Runs->size() == 2);
+    if (Runs && Runs->size() == 2) {
+      const json::Object *R = (*Runs)[1].getAsObject();
+      CHECK(R->getString("function") == StringRef("toy"));
+      auto Joins = R->getInteger("joins");
+      CHECK(Joins && *Joins == 8);
+      auto Average = R->getNumber("average_state_size");
+      CHECK(Average && *Average == 2.5);
+      const json::Array *MV = R->getArray("most_visited");
+      CHECK(MV && MV->size() == 5);
+      if (MV && !MV->empty())
+        CHECK((*MV)[0].getAsObject()->getString("name") == StringRef("IH"));
+    }
+  } else {
+    consumeError(errorCodeToError(Buffer.getError()));
+  }
+  sys::fs::remove(Path);
+}
+
+static void testParseOrder() {
+  CHECK(WorklistSolver::parseOrder("wto") == WorklistSolver::Order::WTO);
+  CHECK(WorklistSolver::parseOrder("fifo") == WorklistSolver::Order::FIFO);
+  CHECK(WorklistSolver::parseOrder("bogus") == WorklistSolver::Order::FIFO);
+}
+
+int main() {
+  testNestedLoopOrder();
+  testIrreducibleAndUnreachable();
+  testVisitCounts();
+  testStaticEngine();
+  testFixpointStats();
+  testParseOrder();
+
+  if (Failures == 0) {
+    std::cout << "All " << Checks << " checks passed.\n";
+    return 0;
+  }
+  std::cerr << Failures << " of " << Checks << " checks FAILED.\n";
+  return 1;
+}
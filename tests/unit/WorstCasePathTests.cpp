@@ -0,0 +1,356 @@
+//===- WorstCasePathTests.cpp - unit tests for worst-case path rebuilding -===//
+//
+// A dependency-light standalone test binary (no GoogleTest) for
+// lib/ILP/WorstCasePath.cpp: the ordered path rebuilt from a solution's edge
+// flows (loop iterations spread over the loop's entries, returns matched to
+// their call site), the folding of repeated runs into counted segments (also
+// for bounds far too large to spell the path out), and the printed form.
+//
+// No ILP backend is needed: the counts come from the timing schema or are
+// written by hand. ILPSolverTests.cpp covers paths of HiGHS solutions and the
+// next-worst paths of HighsIPETSession::excludePath(). Graphs are built by
+// hand with null AbstractStates, or as a view of a hand-built ProgramGraph.
+//
+// Run via CTest (`ctest -R LLTAWorstCasePathTests`) or `check-llta-ilp`.
+//===----------------------------------------------------------------------===//
+
+#include "Analysis/AbstractStateGraph.h"
+#include "ILP/TimingSchemaSolver.h"
+#include "Graph/ProgramGraph.h"
+#include "ILP/WorstCasePath.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static int Checks = 0;
+static int Failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    ++Checks;                                                                  \
+    if (!(cond)) {                                                             \
+      ++Failures;                                                              \
+      std::cerr << "FAIL [" << __FILE__ << ":" << __LINE__ << "]: " << #cond   \
+                << "\n";                                                       \
+    }                                                                          \
+  } while (0)
+
+static unsigned addNode(AbstractStateGraph &G, unsigned Cost,
+                        bool IsEntry = false, bool IsExit = false) {
+  unsigned Id = G.addNode(nullptr);
+  auto *N = G.getNode(Id);
+  N->Cost = Cost;
+  N->IsEntry = IsEntry;
+  N->IsExit = IsExit;
+  return Id;
+}
+
+static void markLoopHeader(AbstractStateGraph &G, unsigned Id, unsigned Bound) {
+  G.getNode(Id)->IsLoopHeader = true;
+  G.getNode(Id)->UpperLoopBound = Bound;
+}
+
+static AbstractILPResult solveSchema(const AbstractStateGraph &G) {
+  TimingSchemaSolver S(nullptr);
+  return S.solveWCET(G);
+}
+
+// The inner loop runs its share of iterations in every outer iteration, not
+// all of them in the first one.
+static void testNestedLoops() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 2);
+  unsigned IH = addNode(G, 3);
+  unsigned IB = addNode(G, 5);
+  unsigned OL = addNode(G, 7);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 4);
+  markLoopHeader(G, IH, 3);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, IB);
+  G.addEdge(IB, IH, /*IsBackEdge=*/true);
+  G.addEdge(IH, OL);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+
+  auto R = solveSchema(G);
+  CHECK(R.WCET == 86);
+  WorstCasePath P(G, R);
+  std::vector<unsigned> Expected = {E};
+  for (int Outer = 0; Outer < 3; ++Outer)
+    Expected.insert(Expected.end(), {OH, IH, IB, IH, IB, IH, OL});
+  Expected.insert(Expected.end(), {OH, X});
+  CHECK(P.expand() == Expected);
+  CHECK(P.getUncoveredFlow() == 0);
+
+  CHECK(P.getLength() == Expected.size());
+  unsigned long long Cost = 0;
+  for (unsigned Id : P.expand())
+    Cost += G.getNodes()[Id].Cost;
+  CHECK(Cost == 86);
+
+  // E, 3 x (OH, 2 x (IH, IB), IH, OL), OH, X
+  ArrayRef<WorstCasePath::Segment> Segments = P.getSegments();
+  CHECK(WorstCasePath::compress(P.expand()).size() == Segments.size());
+  CHECK(Segments.size() == 4);
+  CHECK(Segments[0].Node == E);
+  CHECK(Segments[1].Repeat == 3 && Segments[1].Body.size() == 4);
+  CHECK(Segments[1].Body[1].Repeat == 2);
+  CHECK(Segments[1].Body[1].Body.size() == 2);
+  CHECK(Segments[1].Body[1].Body[0].Node == IH);
+  CHECK(P.getCost(Segments[1]) == 3 * 28);
+  CHECK(Segments[3].Node == X);
+
+  std::string Out;
+  raw_string_ostream OS(Out);
+  P.print(OS, [](unsigned Id) { return "n" + std::to_string(Id); });
+  OS.flush();
+  CHECK(Out.find("  3 x (28 cycles each)\n    n1 (2 cycles)\n") !=
+        std::string::npos);
+  CHECK(Out.find("    2 x (8 cycles each)\n      n2 (3 cycles)\n") !=
+        std::string::npos);
+}
+
+// Bounds in the thousands: each loop is walked once per distinct iteration
+// and repeated as a whole, so the 12M-block path is never spelled out.
+static void testLargeBounds() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 2);
+  unsigned IH = addNode(G, 3);
+  unsigned IB = addNode(G, 5);
+  unsigned OL = addNode(G, 7);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 3001);
+  markLoopHeader(G, IH, 2001);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, IB);
+  G.addEdge(IB, IH, /*IsBackEdge=*/true);
+  G.addEdge(IH, OL);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+
+  auto R = solveSchema(G);
+  WorstCasePath P(G, R);
+  CHECK(P.getUncoveredFlow() == 0);
+  CHECK(P.getLength() == 1 + 3000ull * (1 + 2000 * 2 + 2) + 2);
+
+  // E, 3000 x (OH, 2000 x (IH, IB), IH, OL), OH, X
+  ArrayRef<WorstCasePath::Segment> Segments = P.getSegments();
+  CHECK(Segments.size() == 4);
+  CHECK(Segments[1].Repeat == 3000 && Segments[1].Body.size() == 4);
+  CHECK(Segments[1].Body[1].Repeat == 2000);
+  unsigned long long Cost = 0;
+  for (const WorstCasePath::Segment &S : Segments)
+    Cost += P.getCost(S);
+  CHECK(Cost == static_cast<unsigned long long>(R.WCET));
+}
+
+// A loop entered twice: the first entry leaves through the outer latch after
+// its share of iterations, the second spends the rest and breaks out.
+static void testBranchesAndBreak() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned OH = addNode(G, 1);
+  unsigned IH = addNode(G, 1);
+  unsigned Cheap = addNode(G, 2);
+  unsigned Dear = addNode(G, 9);
+  unsigned IL = addNode(G, 1);
+  unsigned OL = addNode(G, 1);
+  unsigned Brk = addNode(G, 50);
+  unsigned X = addNode(G, 0, false, true);
+  markLoopHeader(G, OH, 2);
+  markLoopHeader(G, IH, 5);
+  G.addEdge(E, OH);
+  G.addEdge(OH, IH);
+  G.addEdge(IH, Cheap);
+  G.addEdge(IH, Dear);
+  G.addEdge(Cheap, IL);
+  G.addEdge(Dear, IL);
+  G.addEdge(IL, IH, /*IsBackEdge=*/true);
+  G.addEdge(IL, Brk);
+  G.addEdge(IH, OL);
+  G.addEdge(OL, OH, /*IsBackEdge=*/true);
+  G.addEdge(OH, X);
+  G.addEdge(Brk, X);
+
+  auto R = solveSchema(G);
+  CHECK(R.WCET == 153);
+  WorstCasePath P(G, R);
+  std::vector<unsigned> Expected = {E, OH, IH};
+  for (int I = 0; I < 4; ++I)
+    Expected.insert(Expected.end(), {Dear, IL, IH});
+  Expected.insert(Expected.end(), {OL, OH, IH});
+  for (int I = 0; I < 4; ++I)
+    Expected.insert(Expected.end(), {Dear, IL, IH});
+  Expected.insert(Expected.end(), {Dear, IL, Brk, X});
+  CHECK(P.expand() == Expected);
+  CHECK(P.getUncoveredFlow() == 0);
+}
+
+// f is called from two sites and its return node has an edge to both
+// landings (the second site's first); each call returns to its own site.
+static void testReturnsMatchCalls() {
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 0, true);
+  unsigned L2 = addNode(G, 1);
+  unsigned C1 = addNode(G, 1);
+  unsigned L1 = addNode(G, 1);
+  unsigned C2 = addNode(G, 1);
+  unsigned X = addNode(G, 0, false, true);
+  unsigned F0 = addNode(G, 4);
+  unsigned FR = addNode(G, 1);
+  G.addEdge(E, C1);
+  G.addEdge(C1, F0);
+  G.addEdge(C1, L1);
+  G.addEdge(L1, C2);
+  G.addEdge(C2, F0);
+  G.addEdge(C2, L2);
+  G.addEdge(L2, X);
+  G.addEdge(F0, FR);
+  G.addEdge(FR, L2);
+  G.addEdge(FR, L1);
+  G.CallSites.push_back({C1, L1, nullptr, F0, {FR}});
+  G.CallSites.push_back({C2, L2, nullptr, F0, {FR}});
+
+  AbstractILPResult R;
+  R.WCET = 16;
+  R.ExecutionCounts = {1, 1, 1, 1, 1, 1, 2, 2};
+  R.EdgeCounts = {{{E, C1}, 1},  {{C1, F0}, 1}, {{L1, C2}, 1},
+                  {{C2, F0}, 1}, {{L2, X}, 1},  {{F0, FR}, 2},
+                  {{FR, L2}, 1}, {{FR, L1}, 1}};
+  WorstCasePath P(G, R);
+  CHECK((P.expand() ==
+         std::vector<unsigned>{E, C1, F0, FR, L1, C2, F0, FR, L2, X}));
+  CHECK(P.getUncoveredFlow() == 0);
+}
+
+// A graph viewing a ProgramGraph, as the pass solves it, has no
+// MachineBasicBlocks; its path is labelled with the ProgramGraph's block and
+// function names (n<Id> for an unnamed block).
+static void testProgramGraphLabels() {
+  LLVMContext Ctx;
+  Module M("labels", Ctx);
+  auto *FT = FunctionType::get(Type::getVoidTy(Ctx), false);
+  Function *Main =
+      Function::Create(FT, GlobalValue::ExternalLinkage, "main", &M);
+  Function *F = Function::Create(FT, GlobalValue::ExternalLinkage, "f", &M);
+
+  ProgramGraph PG;
+  unsigned E = PG.addNode(0, 0, nullptr, "Entry");
+  unsigned X = PG.addNode(0, 0, nullptr, "Exit");
+  unsigned Call = PG.addNode(1, 1, nullptr, "entry");
+  unsigned Cont = PG.addNode(2, 2, nullptr, "cont");
+  unsigned H = PG.addNode(3, 3, nullptr, "loop");
+  unsigned Latch = PG.addNode(4, 4, nullptr);
+  unsigned Ret = PG.addNode(5, 5, nullptr, "return");
+  unsigned F0 = PG.addNode(6, 6, nullptr, "entry");
+  unsigned FR = PG.addNode(7, 7, nullptr);
+  PG.FunctionNames[Main] = PG.intern("main");
+  PG.FunctionNames[F] = PG.intern("f");
+  for (unsigned Id : {Call, Cont, H, Latch, Ret})
+    PG.NodeToFunctionMap[Id] = Main;
+  for (unsigned Id : {F0, FR})
+    PG.NodeToFunctionMap[Id] = F;
+  std::vector<std::pair<unsigned, unsigned>> Edges = {
+      {E, Call}, {Call, F0}, {Call, Cont}, {F0, FR},   {FR, Cont},
+      {Cont, H}, {H, Latch}, {Latch, H},   {H, Ret},   {Ret, X}};
+  for (auto [From, To] : Edges)
+    PG.addEdge(From, To);
+  PG.Nodes.at(H).BackEdgePredecessors.insert(Latch);
+  PG.freeze();
+
+  AbstractStateGraph G;
+  G.attachTo(PG, [] { return std::unique_ptr<AbstractState>(); });
+  for (unsigned I = 0; I < G.getNumNodes(); ++I)
+    G.getNode(I)->Cost = PG.getDenseNode(I).getState().MaxCycles;
+  G.getNode(E)->IsEntry = true;
+  G.getNode(X)->IsExit = true;
+  markLoopHeader(G, H, 3);
+  G.CallSites.push_back({Call, Cont, F, F0, {FR}});
+
+  AbstractILPResult R;
+  R.WCET = 38;
+  R.ExecutionCounts = {1, 1, 1, 1, 3, 2, 1, 1, 1};
+  R.EdgeCounts = {{{E, Call}, 1}, {{Call, F0}, 1}, {{F0, FR}, 1},
+                  {{FR, Cont}, 1}, {{Cont, H}, 1},  {{H, Latch}, 2},
+                  {{Latch, H}, 2}, {{H, Ret}, 1},   {{Ret, X}, 1}};
+  WorstCasePath P(G, R);
+  std::string Out;
+  raw_string_ostream OS(Out);
+  P.print(
+      OS, [&](unsigned Id) { return G.getNodeLabel(Id); }, /*Indent=*/0);
+  OS.flush();
+  CHECK(Out == "Entry (0 cycles)\n"
+               "main:entry (1 cycles)\n"
+               "f:entry (6 cycles)\n"
+               "f:n8 (7 cycles)\n"
+               "main:cont (2 cycles)\n"
+               "2 x (7 cycles each)\n"
+               "  main:loop (3 cycles)\n"
+               "  main:n5 (4 cycles)\n"
+               "main:loop (3 cycles)\n"
+               "main:return (5 cycles)\n"
+               "Exit (0 cycles)\n");
+
+  // Without a ProgramGraph or MachineBasicBlock a node is just its id.
+  AbstractStateGraph Owned;
+  addNode(Owned, 1, true);
+  CHECK(Owned.getNodeLabel(0) == "n0");
+}
+
+// Runs fold innermost first; a result without counts has no path.
+static void testCompressAndEmpty() {
+  auto S = WorstCasePath::compress({1, 2, 3, 2, 3, 2, 3, 4});
+  CHECK(S.size() == 3);
+  CHECK(S[0].Node == 1 && S[0].Body.empty());
+  CHECK(S[1].Repeat == 3 && S[1].Body.size() == 2);
+  CHECK(S[1].Body[0].Node == 2 && S[1].Body[1].Node == 3);
+  CHECK(S[2].Node == 4);
+
+  // 0, 2 x (1, 3 x (2)), 9
+  S = WorstCasePath::compress({0, 1, 2, 2, 2, 1, 2, 2, 2, 9});
+  CHECK(S.size() == 3);
+  CHECK(S[1].Repeat == 2 && S[1].Body.size() == 2);
+  CHECK(S[1].Body[0].Node == 1);
+  CHECK(S[1].Body[1].Repeat == 3 && S[1].Body[1].Body.size() == 1);
+  CHECK(S[2].Node == 9);
+
+  CHECK(WorstCasePath::compress({}).empty());
+  CHECK(WorstCasePath::compress({5, 6, 7}).size() == 3);
+
+  AbstractStateGraph G;
+  unsigned E = addNode(G, 3, true);
+  unsigned X = addNode(G, 1, false, true);
+  G.addEdge(E, X);
+  AbstractILPResult None;
+  None.WCET = 0;
+  CHECK(WorstCasePath(G, None).getSegments().empty());
+  CHECK(WorstCasePath(G, None).getLength() == 0);
+}
+
+int main() {
+  testNestedLoops();
+  testLargeBounds();
+  testBranchesAndBreak();
+  testReturnsMatchCalls();
+  testProgramGraphLabels();
+  testCompressAndEmpty();
+
+  if (Failures == 0) {
+    std::cout << "All " << Checks << " checks passed.\n";
+    return 0;
+  }
+  std::cerr << Failures << " of " << Checks << " checks FAILED.\n";
+  return 1;
+}
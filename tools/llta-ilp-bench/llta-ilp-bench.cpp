@@ -0,0 +1,299 @@
+//===- llta-ilp-bench.cpp - time HiGHS on exported WCET ILPs --------------===//
+//
+// Replays WCET ILPs written by `llta -ilp-export` (MPS or CPLEX LP) through
+// HiGHS, independent of the analysis that produced them, and reports per
+// model: its size, the time to read/build it, its size after presolve, and
+// the solve time (the median of -repeat runs). Solves follow llta's own
+// -ilp-lp-first strategy by default, so the numbers are those of the
+// analysis' solve.
+//
+// With -expected, each objective is checked against a JSON manifest (as
+// written by tests/ilp-corpus/generate.sh), and any mismatch fails the run;
+// -json writes the measurements for comparison across revisions.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "Highs.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static cl::OptionCategory BenchCat("llta-ilp-bench options");
+
+static cl::list<std::string> ModelFiles(cl::Positional, cl::OneOrMore,
+                                        cl::desc("<model.mps|model.lp>..."),
+                                        cl::cat(BenchCat));
+
+static cl::list<std::string> HighsOptions(
+    "highs-option", cl::CommaSeparated,
+    cl::desc("HiGHS option override as name=value (repeatable, or "
+             "comma-separated), e.g. -highs-option=presolve=off"),
+    cl::cat(BenchCat));
+
+static cl::opt<bool> LPFirst(
+    "lp-first", cl::init(true),
+    cl::desc("Solve the LP relaxation first and only run branch-and-bound "
+             "when it is fractional, as llta -ilp-lp-first does"),
+    cl::cat(BenchCat));
+
+static cl::opt<unsigned> Repeat("repeat", cl::init(1),
+                                cl::desc("Solve each model N times and "
+                                         "report the median solve time"),
+                                cl::cat(BenchCat));
+
+static cl::opt<std::string>
+    ExpectedFile("expected", cl::init(""),
+                 cl::desc("JSON manifest {\"models\": {\"<file name>\": "
+                          "<WCET>}}; a differing objective fails the run"),
+                 cl::cat(BenchCat));
+
+static cl::opt<std::string> JSONFile("json", cl::init(""),
+                                     cl::desc("Also write the measurements "
+                                              "to this JSON file"),
+                                     cl::cat(BenchCat));
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double msSince(Clock::time_point Start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - Start)
+      .count();
+}
+
+struct Measurement {
+  std::string Name;
+  HighsInt Cols = 0, Rows = 0, Nonzeros = 0;
+  double ReadMs = 0;
+  /// Presolved size; -1 if presolve failed.
+  HighsInt PresolvedCols = -1, PresolvedRows = -1, PresolvedNonzeros = -1;
+  double PresolveMs = 0;
+  double SolveMs = 0;
+  bool BranchAndBound = false;
+  std::string Status;
+  double Objective = 0;
+  /// Manifest value, if any.
+  bool HasExpected = false;
+  double Expected = 0;
+};
+
+bool configure(Highs &H) {
+  H.setOptionValue("output_flag", false);
+  // llta proves its optima (-ilp-gap=0); -highs-option may relax this.
+  H.setOptionValue("mip_rel_gap", 0.0);
+  for (const std::string &Opt : HighsOptions) {
+    auto [Name, Value] = StringRef(Opt).split('=');
+    if (H.setOptionValue(Name.str(), Value.str()) == HighsStatus::kError) {
+      errs() << "llta-ilp-bench: invalid HiGHS option '" << Opt << "'\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isIntegral(const std::vector<double> &Values) {
+  return all_of(Values, [](double V) {
+    return std::fabs(V - std::round(V)) <= 1e-6;
+  });
+}
+
+/// One solve of \p Model; fills the solve fields of \p M.
+void solveOnce(const HighsModel &Model, Measurement &M) {
+  Highs H;
+  configure(H);
+  H.passModel(Model);
+  const HighsLp &Lp = Model.lp_;
+  bool HasIntegers =
+      any_of(Lp.integrality_,
+             [](HighsVarType T) { return T != HighsVarType::kContinuous; });
+
+  auto Start = Clock::now();
+  M.BranchAndBound = HasIntegers;
+  if (HasIntegers && LPFirst) {
+    std::vector<HighsVarType> Continuous(Lp.num_col_,
+                                         HighsVarType::kContinuous);
+    H.changeColsIntegrality(0, Lp.num_col_ - 1, Continuous.data());
+    H.run();
+    if (H.getModelStatus() == HighsModelStatus::kOptimal &&
+        isIntegral(H.getSolution().col_value)) {
+      M.BranchAndBound = false;
+    } else {
+      H.changeColsIntegrality(0, Lp.num_col_ - 1, Lp.integrality_.data());
+      H.run();
+    }
+  } else {
+    H.run();
+  }
+  M.SolveMs = msSince(Start);
+  M.Status = H.modelStatusToString(H.getModelStatus());
+  M.Objective = H.getInfo().objective_function_value;
+}
+
+bool measure(StringRef Path, Measurement &M) {
+  M.Name = sys::path::filename(Path).str();
+
+  Highs Reader;
+  if (!configure(Reader))
+    return false;
+  auto Start = Clock::now();
+  if (Reader.readModel(Path.str()) == HighsStatus::kError) {
+    errs() << "llta-ilp-bench: cannot read " << Path << "\n";
+    return false;
+  }
+  M.ReadMs = msSince(Start);
+  const HighsModel &Model = Reader.getModel();
+  M.Cols = Model.lp_.num_col_;
+  M.Rows = Model.lp_.num_row_;
+  M.Nonzeros = Model.lp_.a_matrix_.numNz();
+
+  {
+    Highs P;
+    configure(P);
+    P.passModel(Model);
+    Start = Clock::now();
+    HighsStatus S = P.presolve();
+    M.PresolveMs = msSince(Start);
+    HighsPresolveStatus PS = P.getModelPresolveStatus();
+    bool Presolved = PS == HighsPresolveStatus::kNotReduced ||
+                     PS == HighsPresolveStatus::kReduced ||
+                     PS == HighsPresolveStatus::kReducedToEmpty;
+    if (S != HighsStatus::kError && Presolved) {
+      const HighsLp &Pre = P.getPresolvedLp();
+      M.PresolvedCols = Pre.num_col_;
+      M.PresolvedRows = Pre.num_row_;
+      M.PresolvedNonzeros = Pre.a_matrix_.numNz();
+    }
+  }
+
+  SmallVector<double, 8> Times;
+  for (unsigned R = 0; R < std::max(1u, unsigned(Repeat)); ++R) {
+    solveOnce(Model, M);
+    Times.push_back(M.SolveMs);
+  }
+  llvm::sort(Times);
+  M.SolveMs = Times[Times.size() / 2];
+  return true;
+}
+
+bool loadExpected(StringRef Path, std::vector<Measurement> &Ms) {
+  auto Buf = MemoryBuffer::getFile(Path);
+  if (!Buf) {
+    errs() << "llta-ilp-bench: cannot read " << Path << ": "
+           << Buf.getError().message() << "\n";
+    return false;
+  }
+  Expected<json::Value> Root = json::parse((*Buf)->getBuffer());
+  if (!Root) {
+    errs() << "llta-ilp-bench: " << Path << ": " << toString(Root.takeError())
+           << "\n";
+    return false;
+  }
+  const json::Object *Models =
+      Root->getAsObject() ? Root->getAsObject()->getObject("models") : nullptr;
+  if (!Models) {
+    errs() << "llta-ilp-bench: " << Path << ": no \"models\" object\n";
+    return false;
+  }
+  for (Measurement &M : Ms)
+    if (auto V = Models->getNumber(M.Name)) {
+      M.HasExpected = true;
+      M.Expected = *V;
+    }
+  return true;
+}
+
+void writeJSON(StringRef Path, const std::vector<Measurement> &Ms) {
+  json::Array Models;
+  for (const Measurement &M : Ms)
+    Models.push_back(json::Object{
+        {"name", M.Name},
+        {"cols", M.Cols},
+        {"rows", M.Rows},
+        {"nonzeros", M.Nonzeros},
+        {"read_ms", M.ReadMs},
+        {"presolved_cols", M.PresolvedCols},
+        {"presolved_rows", M.PresolvedRows},
+        {"presolved_nonzeros", M.PresolvedNonzeros},
+        {"presolve_ms", M.PresolveMs},
+        {"solve_ms", M.SolveMs},
+        {"branch_and_bound", M.BranchAndBound},
+        {"status", M.Status},
+        {"objective", M.Objective},
+    });
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::OF_Text);
+  if (EC) {
+    errs() << "Error opening file: " << EC.message() << "\n";
+    return;
+  }
+  json::Value Root = json::Object{{"models", std::move(Models)}};
+  OS << formatv("{0:2}", Root) << "\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::HideUnrelatedOptions(BenchCat);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Time HiGHS on WCET ILPs exported by "
+                              "llta -ilp-export\n");
+
+  std::vector<Measurement> Ms;
+  bool Failed = false;
+  for (const std::string &Path : ModelFiles) {
+    Measurement M;
+    if (!measure(Path, M)) {
+      Failed = true;
+      continue;
+    }
+    Ms.push_back(std::move(M));
+  }
+  if (!ExpectedFile.empty() && !loadExpected(ExpectedFile, Ms))
+    return 1;
+
+  outs() << "model                       cols    rows      nnz   read ms  "
+            " presolved c/r presolve ms   solve ms B&B  objective\n";
+  for (const Measurement &M : Ms) {
+    std::string Presolved =
+        M.PresolvedCols < 0 ? "-"
+                            : std::to_string(M.PresolvedCols) + "/" +
+                                  std::to_string(M.PresolvedRows);
+    outs() << format("%-24s %7d %7d %8d %9.2f %15s %11.2f %10.2f %3s  ",
+                     M.Name.c_str(), M.Cols, M.Rows, M.Nonzeros, M.ReadMs,
+                     Presolved.c_str(), M.PresolveMs, M.SolveMs,
+                     M.BranchAndBound ? "yes" : "no");
+    if (M.Status != "Optimal") {
+      outs() << M.Status;
+      Failed |= M.HasExpected;
+    } else {
+      long long Objective = std::llround(M.Objective);
+      outs() << Objective;
+      if (M.HasExpected && Objective != std::llround(M.Expected)) {
+        outs() << "  MISMATCH (expected " << std::llround(M.Expected) << ")";
+        Failed = true;
+      }
+    }
+    outs() << "\n";
+  }
+
+  if (!JSONFile.empty())
+    writeJSON(JSONFile, Ms);
+  return Failed ? 1 : 0;
+}